@@ -211,6 +211,22 @@
 #endif
 
 
+/**
+ * Macro PJ_SCANNER_USE_SIMD is defined and non-zero (by default yes) will
+ * enable the use of vector instructions to find the end of a run of
+ * characters in a character input specification (cis), which is used by
+ * functions such as #pj_scan_get() and #pj_scan_get_until(). On x86,
+ * AVX2 or SSSE3 code is selected at run time by CPU support, unless the
+ * compiler already targets it (e.g. with -mavx2 or -march=native). On
+ * AArch64 NEON is used. It requires GCC 5 or later, or Clang; otherwise
+ * the scanner uses the plain byte-at-a-time loop. Skipping whitespace and
+ * newlines always uses the plain loop.
+ */
+#ifndef PJ_SCANNER_USE_SIMD
+#  define PJ_SCANNER_USE_SIMD			    1
+#endif
+
+
 
 /* **************************************************************************
  * STUN CLIENT CONFIGURATION
@@ -44,6 +44,32 @@ PJ_BEGIN_DECL
 #  include <pjlib-util/scanner_cis_uint.h>
 #endif
 
+/**
+ * Add ASCII character to the ascii_map of the specification. The map has
+ * one byte for each low nibble of the character, with bit N set if the
+ * character with high nibble N is a member, so that it can be looked up
+ * with vector byte shuffle. Non-ASCII characters are not in the map.
+ * This is called by PJ_CIS_SET(), so application does not need to call
+ * it directly.
+ *
+ * @param cis       Pointer to character input specification.
+ * @param c         The character.
+ */
+#define PJ_CIS_ASCII_SET(cis,c) \
+	    ((unsigned)(c) < 128 ? \
+	     ((cis)->ascii_map[(c) & 15] |= (pj_uint8_t)(1 << ((c) >> 4))) : 0)
+
+/**
+ * Remove ASCII character from the ascii_map of the specification. This is
+ * called by PJ_CIS_CLR().
+ *
+ * @param cis       Pointer to character input specification.
+ * @param c         The character.
+ */
+#define PJ_CIS_ASCII_CLR(cis,c) \
+	    ((unsigned)(c) < 128 ? \
+	     ((cis)->ascii_map[(c) & 15] &= (pj_uint8_t)~(1 << ((c) >> 4))) : 0)
+
 /**
  * Initialize scanner input specification buffer.
  *
@@ -188,6 +214,18 @@ struct pj_scanner;
 typedef void (*pj_syn_err_func_ptr)(struct pj_scanner *scanner);
 
 
+/**
+ * This structure can be used by application to store the state of the parser,
+ * so that the scanner state can be rollback to this state when necessary.
+ */
+typedef struct pj_scan_state
+{
+    char *curptr;       /**< Current scanner's pointer. */
+    int   line;         /**< Current line.		*/
+    char *start_line;   /**< Start of current line.	*/
+} pj_scan_state;
+
+
 /**
  * The text scanner structure.
  */
@@ -200,21 +238,11 @@ typedef struct pj_scanner
     char *start_line;   /**< Where current line starts.	*/
     int   skip_ws;      /**< Skip whitespace flag.	*/
     pj_syn_err_func_ptr callback;   /**< Syntax error callback. */
+    pj_bool_t has_err;  /**< Syntax error has been recorded. */
+    pj_scan_state err_state;	    /**< Where the error was recorded. */
 } pj_scanner;
 
 
-/**
- * This structure can be used by application to store the state of the parser,
- * so that the scanner state can be rollback to this state when necessary.
- */
-typedef struct pj_scan_state
-{
-    char *curptr;       /**< Current scanner's pointer. */
-    int   line;         /**< Current line.		*/
-    char *start_line;   /**< Start of current line.	*/
-} pj_scan_state;
-
-
 /**
  * Initialize the scanner. Note that the input string buffer must have
  * length at least buflen+1 because the scanner will NULL terminate the
@@ -237,6 +265,59 @@ PJ_DECL(void) pj_scan_init( pj_scanner *scanner, char *bufstart,
 			    pj_syn_err_func_ptr callback );
 
 
+/**
+ * Report syntax error at the current position to the scanner's syntax
+ * error callback. Parsers can call this function when they find an error
+ * that the scanner can't detect by itself, such as unexpected token value.
+ *
+ * If the callback returns (see #pj_scan_set_error()), the caller must
+ * stop parsing and return to its caller.
+ *
+ * @param scanner   The scanner.
+ */
+PJ_DECL(void) pj_scan_syntax_err( pj_scanner *scanner );
+
+
+/**
+ * Record syntax error at the current position, and move the scanner to the
+ * end of input, so that subsequent scanning functions fail immediately.
+ * Only the position of the first error is kept. Scanning functions that
+ * fail leave empty string in their output argument.
+ *
+ * Parsers that report syntax errors with return value rather than with
+ * exception can call this function from their syntax error callback, check
+ * #pj_scan_has_error() after each step that may fail, and call
+ * #pj_scan_clear_error() when they have handled the error.
+ *
+ * @param scanner   The scanner.
+ */
+PJ_DECL(void) pj_scan_set_error( pj_scanner *scanner );
+
+
+/**
+ * Determine whether syntax error has been recorded by #pj_scan_set_error().
+ *
+ * @param scanner   The scanner.
+ *
+ * @return Non-zero if syntax error has been recorded.
+ */
+PJ_INLINE(pj_bool_t) pj_scan_has_error( const pj_scanner *scanner )
+{
+    return scanner->has_err;
+}
+
+
+/**
+ * Clear syntax error recorded by #pj_scan_set_error(), and move the scanner
+ * back to the position where the error was found.
+ *
+ * @param scanner   The scanner.
+ *
+ * @return PJ_TRUE if there was an error recorded.
+ */
+PJ_DECL(pj_bool_t) pj_scan_clear_error( pj_scanner *scanner );
+
+
 /** 
  * Call this function when application has finished using the scanner.
  *
@@ -60,6 +60,8 @@ typedef struct pj_cis_t
 {
     pj_cis_elem_t   *cis_buf;       /**< Pointer to buffer.     */
     int              cis_id;        /**< Id.                    */
+    pj_uint8_t       ascii_map[16]; /**< ASCII members, see
+					 PJ_CIS_ASCII_SET().	    */
 } pj_cis_t;
 
 
@@ -70,7 +72,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id))
+#define PJ_CIS_SET(cis,c)   (PJ_CIS_ASCII_SET(cis,c), \
+			     ((cis)->cis_buf[(int)(c)] |= (1 << (cis)->cis_id)))
 
 /**
  * Remove the membership of the specified character.
@@ -79,7 +82,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id))
+#define PJ_CIS_CLR(cis,c)   (PJ_CIS_ASCII_CLR(cis,c), \
+			     ((cis)->cis_buf[(int)c] &= ~(1 << (cis)->cis_id)))
 
 /**
  * Check the membership of the specified character.
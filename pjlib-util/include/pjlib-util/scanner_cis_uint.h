@@ -47,6 +47,8 @@ typedef int pj_cis_buf_t;
 typedef struct pj_cis_t
 {
     PJ_CIS_ELEM_TYPE	cis_buf[256];	/**< Internal buffer.	*/
+    pj_uint8_t		ascii_map[16];	/**< ASCII members, see
+					     PJ_CIS_ASCII_SET().	*/
 } pj_cis_t;
 
 
@@ -57,7 +59,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character.
  */
-#define PJ_CIS_SET(cis,c)   ((cis)->cis_buf[(int)(c)] = 1)
+#define PJ_CIS_SET(cis,c)   (PJ_CIS_ASCII_SET(cis,c), \
+			     ((cis)->cis_buf[(int)(c)] = 1))
 
 /**
  * Remove the membership of the specified character.
@@ -66,7 +69,8 @@ typedef struct pj_cis_t
  * @param cis       Pointer to character input specification.
  * @param c         The character to be removed from the membership.
  */
-#define PJ_CIS_CLR(cis,c)   ((cis)->cis_buf[(int)c] = 0)
+#define PJ_CIS_CLR(cis,c)   (PJ_CIS_ASCII_CLR(cis,c), \
+			     ((cis)->cis_buf[(int)c] = 0))
 
 /**
  * Check the membership of the specified character.
@@ -0,0 +1,149 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+#include "test.h"
+
+#define THIS_FILE	"scanner_test.c"
+
+#if INCLUDE_SCANNER_TEST
+
+#include <pjlib-util/scanner.h>
+#include <pj/log.h>
+#include <pj/rand.h>
+#include <pj/string.h>
+
+/* Compare pj_scan_get() and pj_scan_get_until(), which use vector
+ * scanning for long runs when it is enabled, with a plain loop over
+ * pj_cis_match(). Inputs have random length and alignment, so the runs
+ * end in full and partial blocks, and contain non-ASCII bytes which are
+ * members and non-members of the cis.
+ */
+
+#define LOOP		2000
+#define MAX_RUN		300
+#define MAX_TAIL	40
+#define MAX_OFFSET	32
+
+static char buf[MAX_OFFSET + MAX_RUN + MAX_TAIL + 1];
+
+static void on_syntax_error(pj_scanner *scanner)
+{
+    PJ_UNUSED_ARG(scanner);
+}
+
+/* Random non-NULL byte which is a member of cis if member is true */
+static char rand_char(const pj_cis_t *cis, pj_bool_t member)
+{
+    for (;;) {
+	int c;
+
+	/* Prefer non-ASCII bytes now and then */
+	if ((pj_rand() % 8) == 0)
+	    c = 0x80 + (pj_rand() % 0x80);
+	else
+	    c = 1 + (pj_rand() % 0x7F);
+
+	if ((pj_cis_match(cis, c) != 0) == (member != 0))
+	    return (char)c;
+    }
+}
+
+static int compare_scan(const pj_cis_t *cis, pj_bool_t until)
+{
+    unsigned i;
+
+    for (i = 0; i < LOOP; ++i) {
+	unsigned off, run, tail, len, j;
+	char *s, *expected;
+	pj_scanner scanner;
+	pj_str_t out;
+
+	off = pj_rand() % MAX_OFFSET;
+	run = 1 + (pj_rand() % MAX_RUN);
+	tail = pj_rand() % MAX_TAIL;
+	len = run + tail;
+	s = buf + off;
+
+	/* A run of members (non-members for until), then random bytes */
+	for (j = 0; j < run; ++j)
+	    s[j] = rand_char(cis, !until);
+	for (; j < len; ++j)
+	    s[j] = rand_char(cis, pj_rand() % 2);
+	s[len] = '\0';
+
+	expected = s;
+	if (until) {
+	    while (expected != s + len && !pj_cis_match(cis, *expected))
+		++expected;
+	} else {
+	    while (pj_cis_match(cis, *expected))
+		++expected;
+	}
+
+	pj_scan_init(&scanner, s, len, 0, &on_syntax_error);
+	if (until)
+	    pj_scan_get_until(&scanner, cis, &out);
+	else
+	    pj_scan_get(&scanner, cis, &out);
+
+	if (out.ptr != s || out.ptr + out.slen != expected ||
+	    scanner.curptr != expected)
+	{
+	    PJ_LOG(3, (THIS_FILE, "  error: %s stopped at %d, expecting %d "
+		       "(len=%u, offset=%u)",
+		       (until ? "pj_scan_get_until()" : "pj_scan_get()"),
+		       (int)(scanner.curptr - s), (int)(expected - s),
+		       len, off));
+	    return -10;
+	}
+
+	pj_scan_fini(&scanner);
+    }
+
+    return 0;
+}
+
+int scanner_test(void)
+{
+    pj_cis_buf_t cis_buf;
+    pj_cis_t cis;
+    int rc;
+
+    pj_cis_buf_init(&cis_buf);
+    pj_cis_init(&cis_buf, &cis);
+    pj_cis_add_alpha(&cis);
+    pj_cis_add_num(&cis);
+    pj_cis_add_str(&cis, "-.!%*_+`'~");
+    pj_cis_add_range(&cis, 0xC0, 0xE0);
+
+    PJ_LOG(3, (THIS_FILE, "  pj_scan_get() test"));
+    rc = compare_scan(&cis, PJ_FALSE);
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3, (THIS_FILE, "  pj_scan_get_until() test"));
+    rc = compare_scan(&cis, PJ_TRUE);
+    if (rc != 0)
+	return rc - 10;
+
+    return 0;
+}
+
+#else
+int scanner_dummy;
+#endif
@@ -76,6 +76,10 @@ static int test_inner(void)
     DO_TEST(json_test());
 #endif
 
+#if INCLUDE_SCANNER_TEST
+    DO_TEST(scanner_test());
+#endif
+
 #if INCLUDE_ENCRYPTION_TEST
     DO_TEST(encryption_test());
     DO_TEST(encryption_benchmark());
@@ -25,9 +25,11 @@
 #define INCLUDE_STUN_TEST	    1
 #define INCLUDE_RESOLVER_TEST	    1
 #define INCLUDE_HTTP_CLIENT_TEST    1
+#define INCLUDE_SCANNER_TEST	    1
 
 extern int xml_test(void);
 extern int json_test(void);
+extern int scanner_test(void);
 extern int encryption_test();
 extern int encryption_benchmark();
 extern int stun_test();
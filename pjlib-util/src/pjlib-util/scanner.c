@@ -38,11 +38,343 @@
 #endif
 
 
-static void pj_scan_syntax_err(pj_scanner *scanner)
+/*
+ * Vector scanning of cis, using ascii_map (see PJ_CIS_ASCII_SET()).
+ * Each block looks up the low nibble of every byte in the map with byte
+ * shuffle, and the high nibble in a table of single bits. The results
+ * are combined into a bitmask of bytes that are ASCII members of the cis
+ * (CIS_MASK_BITS bits per byte). Non-ASCII bytes are left to the scalar
+ * loop.
+ *
+ * On x86, the SSSE3 and AVX2 code is built regardless of the compiler
+ * flags, and is selected at run time unless the compiler already targets
+ * it, so plain SSE2 builds also use it.
+ */
+#if defined(PJ_SCANNER_USE_SIMD) && PJ_SCANNER_USE_SIMD != 0 && \
+    (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#  if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#    define CIS_SIMD		1
+#    define CIS_SIMD_X86	1
+#    define CIS_SIMD_WIDTH	16
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    include <arm_neon.h>
+#    define CIS_SIMD		1
+#    define CIS_SIMD_WIDTH	16
+#    define CIS_MASK_BITS	4
+#    define CIS_MASK_ALL	PJ_UINT64(0xFFFFFFFFFFFFFFFF)
+typedef uint8x16_t cis_vec_t;
+#  endif
+#endif
+
+#ifndef CIS_SIMD
+#  define CIS_SIMD		0
+#endif
+
+/* Runs are scanned with the plain loop up to this length before switching
+ * to vector, since most tokens are short and vector setup cost more.
+ */
+#define CIS_SCALAR_LEN		32
+
+#if CIS_SIMD
+
+/* Bit for each high nibble of ASCII character, zero for non-ASCII. */
+static const pj_uint8_t cis_hi_bit[16] = {
+    1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+#if CIS_SIMD_X86
+
+#if defined(__SSSE3__)
+#   define CIS_TARGET_SSSE3
+#else
+#   define CIS_TARGET_SSSE3	__attribute__((target("ssse3")))
+#endif
+#if defined(__AVX2__)
+#   define CIS_TARGET_AVX2
+#else
+#   define CIS_TARGET_AVX2	__attribute__((target("avx2")))
+#endif
+
+/* Get the ASCII members (return value) and non-ASCII bytes (high) of
+ * 16 bytes.
+ */
+CIS_TARGET_SSSE3
+static pj_uint32_t cis_block_ssse3(__m128i map, __m128i hi_bit,
+				   const char *p, pj_uint32_t *high)
+{
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i v, lo, hi, m;
+
+    v  = _mm_loadu_si128((const __m128i*)p);
+    lo = _mm_and_si128(v, nibble);
+    hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    m  = _mm_and_si128(_mm_shuffle_epi8(map, lo),
+		       _mm_shuffle_epi8(hi_bit, hi));
+    m  = _mm_cmpeq_epi8(m, _mm_setzero_si128());
+
+    *high = (pj_uint32_t)_mm_movemask_epi8(v);
+    return ~(pj_uint32_t)_mm_movemask_epi8(m) & 0xFFFF;
+}
+
+/* Get the ASCII members (return value) and non-ASCII bytes (high) of
+ * 32 bytes.
+ */
+CIS_TARGET_AVX2
+static pj_uint32_t cis_block_avx2(__m256i map, __m256i hi_bit,
+				  const char *p, pj_uint32_t *high)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i v, lo, hi, m;
+
+    v  = _mm256_loadu_si256((const __m256i*)p);
+    lo = _mm256_and_si256(v, nibble);
+    hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    m  = _mm256_and_si256(_mm256_shuffle_epi8(map, lo),
+			  _mm256_shuffle_epi8(hi_bit, hi));
+    m  = _mm256_cmpeq_epi8(m, _mm256_setzero_si256());
+
+    *high = (pj_uint32_t)_mm256_movemask_epi8(v);
+    return ~(pj_uint32_t)_mm256_movemask_epi8(m);
+}
+
+/* Scan 16 byte blocks, see cis_simd_scan(). */
+CIS_TARGET_SSSE3
+static char *cis_scan_ssse3(const pj_cis_t *cis, char *s, const char *end,
+			    pj_bool_t until)
+{
+    __m128i map = _mm_loadu_si128((const __m128i*)cis->ascii_map);
+    __m128i hi_bit = _mm_loadu_si128((const __m128i*)cis_hi_bit);
+
+    while (end - s >= 16) {
+	pj_uint32_t member, high, stop;
+
+	member = cis_block_ssse3(map, hi_bit, s, &high);
+	stop = until ? (member | high) : (~member & 0xFFFF);
+	if (stop)
+	    return s + __builtin_ctz(stop);
+
+	s += 16;
+    }
+    return s;
+}
+
+/* Scan 32 byte blocks, then the rest with 16 byte blocks. */
+CIS_TARGET_AVX2
+static char *cis_scan_avx2(const pj_cis_t *cis, char *s, const char *end,
+			   pj_bool_t until)
+{
+    __m256i map, hi_bit;
+
+    map = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i*)cis->ascii_map));
+    hi_bit = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i*)cis_hi_bit));
+
+    while (end - s >= 32) {
+	pj_uint32_t member, high, stop;
+
+	member = cis_block_avx2(map, hi_bit, s, &high);
+	stop = until ? (member | high) : ~member;
+	if (stop)
+	    return s + __builtin_ctz(stop);
+
+	s += 32;
+    }
+    return cis_scan_ssse3(cis, s, end, until);
+}
+
+#if defined(__AVX2__)
+#   define cis_simd_scan	cis_scan_avx2
+#else
+
+#if !defined(__SSSE3__)
+/* Scan byte by byte, for CPUs without SSSE3. */
+static char *cis_scan_plain(const pj_cis_t *cis, char *s, const char *end,
+			    pj_bool_t until)
+{
+    for (; end - s >= CIS_SIMD_WIDTH; ++s) {
+	pj_uint8_t c = (pj_uint8_t)*s;
+	pj_bool_t member = (c < 0x80 && pj_cis_match(cis, c));
+
+	if (until ? (member || c >= 0x80) : !member)
+	    break;
+    }
+    return s;
+}
+#endif
+
+typedef char *(*cis_scan_func)(const pj_cis_t *cis, char *s,
+			       const char *end, pj_bool_t until);
+
+static char *cis_scan_select(const pj_cis_t *cis, char *s, const char *end,
+			     pj_bool_t until);
+
+/* The scan function for the CPU, selected on first use. Threads racing
+ * on the first use select the same function.
+ */
+static cis_scan_func cis_simd_scan = &cis_scan_select;
+
+static char *cis_scan_select(const pj_cis_t *cis, char *s, const char *end,
+			     pj_bool_t until)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+	cis_simd_scan = &cis_scan_avx2;
+#if defined(__SSSE3__)
+    else
+	cis_simd_scan = &cis_scan_ssse3;
+#else
+    else if (__builtin_cpu_supports("ssse3"))
+	cis_simd_scan = &cis_scan_ssse3;
+    else
+	cis_simd_scan = &cis_scan_plain;
+#endif
+
+    return (*cis_simd_scan)(cis, s, end, until);
+}
+
+#endif	/* __AVX2__ */
+
+#else	/* NEON */
+
+static cis_vec_t cis_load_map(const pj_uint8_t map[16])
+{
+    return vld1q_u8(map);
+}
+
+/* NEON has no movemask, so narrow each byte of the 0x00/0xFF vector
+ * to four bits of a 64bit mask.
+ */
+static pj_uint64_t cis_movemask(uint8x16_t v)
+{
+    uint8x8_t n = vshrn_n_u16(vreinterpretq_u16_u8(v), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(n), 0);
+}
+
+/* Get the ASCII members (return value) and non-ASCII bytes (high) */
+static pj_uint64_t cis_block(cis_vec_t map, cis_vec_t hi_bit,
+			     const char *p, pj_uint64_t *high)
+{
+    uint8x16_t v, m;
+
+    v = vld1q_u8((const pj_uint8_t*)p);
+    m = vandq_u8(vqtbl1q_u8(map, vandq_u8(v, vdupq_n_u8(0x0F))),
+		 vqtbl1q_u8(hi_bit, vshrq_n_u8(v, 4)));
+
+    *high = cis_movemask(vcgeq_u8(v, vdupq_n_u8(0x80)));
+    return cis_movemask(vtstq_u8(m, m));
+}
+
+/* Find the first byte in full blocks from s that stops the scan. If
+ * until is false, this is the first byte that is not an ASCII member of
+ * the cis, otherwise it is the first byte that is an ASCII member or
+ * non-ASCII. If there is none, return the start of the last partial
+ * block, which is less than CIS_SIMD_WIDTH bytes before end.
+ */
+static char *cis_simd_scan(const pj_cis_t *cis, char *s, const char *end,
+			   pj_bool_t until)
+{
+    cis_vec_t map = cis_load_map(cis->ascii_map);
+    cis_vec_t hi_bit = cis_load_map(cis_hi_bit);
+
+    while (end - s >= CIS_SIMD_WIDTH) {
+	pj_uint64_t member, high, stop;
+
+	member = cis_block(map, hi_bit, s, &high);
+	stop = until ? (member | high) : (~member & CIS_MASK_ALL);
+	if (stop)
+	    return s + (__builtin_ctzll(stop) / CIS_MASK_BITS);
+
+	s += CIS_SIMD_WIDTH;
+    }
+    return s;
+}
+
+#endif	/* CIS_SIMD_X86 */
+
+#endif	/* CIS_SIMD */
+
+
+/* Skip characters that are members of the cis. The input must be NULL
+ * terminated at end, and the cis must not match NULL.
+ */
+static char *cis_skip(const pj_cis_t *cis, char *s, const char *end)
+{
+#if CIS_SIMD
+    if (end - s > CIS_SCALAR_LEN) {
+	const char *limit = s + CIS_SCALAR_LEN;
+
+	/* No need to check end since NULL is not a member */
+	do {
+	    if (!pj_cis_match(cis, s[0])) return s;
+	    if (!pj_cis_match(cis, s[1])) return s+1;
+	    if (!pj_cis_match(cis, s[2])) return s+2;
+	    if (!pj_cis_match(cis, s[3])) return s+3;
+	    s += 4;
+	} while (s != limit);
+
+	while (end - s >= CIS_SIMD_WIDTH) {
+	    s = cis_simd_scan(cis, s, end, PJ_FALSE);
+	    /* The scan may have stopped at non-ASCII member */
+	    if (!pj_cis_match(cis, *s))
+		return s;
+	    ++s;
+	}
+    }
+#else
+    PJ_UNUSED_ARG(end);
+#endif
+
+    while (pj_cis_match(cis, *s))
+	++s;
+    return s;
+}
+
+
+/* Find the first character that is a member of the cis, or end. */
+static char *cis_find(const pj_cis_t *cis, char *s, const char *end)
+{
+#if CIS_SIMD
+    if (end - s > CIS_SCALAR_LEN) {
+	const char *limit = s + CIS_SCALAR_LEN;
+
+	do {
+	    if (pj_cis_match(cis, *s))
+		return s;
+	} while (++s != limit);
+
+	while (end - s >= CIS_SIMD_WIDTH) {
+	    s = cis_simd_scan(cis, s, end, PJ_TRUE);
+	    /* The scan may have stopped at non-ASCII non-member */
+	    if (s == end || pj_cis_match(cis, *s))
+		return s;
+	    ++s;
+	}
+    }
+#endif
+
+    while (s != end && !pj_cis_match(cis, *s))
+	++s;
+    return s;
+}
+
+
+PJ_DEF(void) pj_scan_syntax_err(pj_scanner *scanner)
 {
     (*scanner->callback)(scanner);
 }
 
+/* Report syntax error, leaving empty output for callers that continue
+ * after the callback returns.
+ */
+static void syntax_err_out(pj_scanner *scanner, pj_str_t *out)
+{
+    out->ptr = scanner->curptr;
+    out->slen = 0;
+    pj_scan_syntax_err(scanner);
+}
+
 
 PJ_DEF(void) pj_cis_add_range(pj_cis_t *cis, int cstart, int cend)
 {
@@ -123,12 +455,34 @@ PJ_DEF(void) pj_scan_init( pj_scanner *scanner, char *bufstart,
     scanner->start_line = scanner->begin;
     scanner->callback = callback;
     scanner->skip_ws = options;
+    scanner->has_err = PJ_FALSE;
 
     if (scanner->skip_ws) 
 	pj_scan_skip_whitespace(scanner);
 }
 
 
+PJ_DEF(void) pj_scan_set_error( pj_scanner *scanner )
+{
+    if (!scanner->has_err) {
+	scanner->has_err = PJ_TRUE;
+	pj_scan_save_state(scanner, &scanner->err_state);
+    }
+    scanner->curptr = scanner->end;
+}
+
+
+PJ_DEF(pj_bool_t) pj_scan_clear_error( pj_scanner *scanner )
+{
+    if (!scanner->has_err)
+	return PJ_FALSE;
+
+    pj_scan_restore_state(scanner, &scanner->err_state);
+    scanner->has_err = PJ_FALSE;
+    return PJ_TRUE;
+}
+
+
 PJ_DEF(void) pj_scan_fini( pj_scanner *scanner )
 {
     PJ_CHECK_STACK();
@@ -207,13 +561,12 @@ PJ_DEF(int) pj_scan_peek( pj_scanner *scanner,
     register char *s = scanner->curptr;
 
     if (s >= scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return -1;
     }
 
     /* Don't need to check EOF with PJ_SCAN_CHECK_EOF(s) */
-    while (pj_cis_match(spec, *s))
-	++s;
+    s = cis_skip(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -226,7 +579,7 @@ PJ_DEF(int) pj_scan_peek_n( pj_scanner *scanner,
     char *endpos = scanner->curptr + len;
 
     if (endpos > scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return -1;
     }
 
@@ -242,12 +595,11 @@ PJ_DEF(int) pj_scan_peek_until( pj_scanner *scanner,
     register char *s = scanner->curptr;
 
     if (s >= scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return -1;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match( spec, *s))
-	++s;
+    s = cis_find(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
     return *s;
@@ -263,13 +615,11 @@ PJ_DEF(void) pj_scan_get( pj_scanner *scanner,
 
     /* EOF is detected implicitly */
     if (!pj_cis_match(spec, *s)) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
-    do {
-	++s;
-    } while (pj_cis_match(spec, *s));
+    s = cis_skip(spec, s+1, scanner->end);
     /* No need to check EOF here (PJ_SCAN_CHECK_EOF(s)) because
      * buffer is NULL terminated and pj_cis_match(spec,0) should be
      * false.
@@ -298,7 +648,7 @@ PJ_DEF(void) pj_scan_get_unescape( pj_scanner *scanner,
 
     /* EOF is detected implicitly */
     if (!pj_cis_match(spec, *s) && *s != '%') {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
@@ -321,9 +671,7 @@ PJ_DEF(void) pj_scan_get_unescape( pj_scanner *scanner,
 	
 	if (pj_cis_match(spec, *s)) {
 	    char *start = s;
-	    do {
-		++s;
-	    } while (pj_cis_match(spec, *s));
+	    s = cis_skip(spec, s+1, scanner->end);
 
 	    if (dst != start) pj_memmove(dst, start, s-start);
 	    dst += (s-start);
@@ -367,7 +715,7 @@ PJ_DEF(void) pj_scan_get_quotes(pj_scanner *scanner,
 	}
     }
     if (qpair == -1) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
     ++s;
@@ -406,7 +754,7 @@ PJ_DEF(void) pj_scan_get_quotes(pj_scanner *scanner,
 
     /* Check and eat the end quote. */
     if (*s != end_quote[qpair]) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
     ++s;
@@ -425,7 +773,7 @@ PJ_DEF(void) pj_scan_get_n( pj_scanner *scanner,
 			    unsigned N, pj_str_t *out)
 {
     if (scanner->curptr + N > scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
@@ -500,13 +848,11 @@ PJ_DEF(void) pj_scan_get_until( pj_scanner *scanner,
     register char *s = scanner->curptr;
 
     if (s >= scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && !pj_cis_match(spec, *s)) {
-	++s;
-    }
+    s = cis_find(spec, s, scanner->end);
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -524,13 +870,13 @@ PJ_DEF(void) pj_scan_get_until_ch( pj_scanner *scanner,
     register char *s = scanner->curptr;
 
     if (s >= scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
-    while (PJ_SCAN_CHECK_EOF(s) && *s != until_char) {
-	++s;
-    }
+    s = (char*)memchr(s, until_char, scanner->end - s);
+    if (!s)
+	s = scanner->end;
 
     pj_strset3(out, scanner->curptr, s);
 
@@ -549,7 +895,7 @@ PJ_DEF(void) pj_scan_get_until_chr( pj_scanner *scanner,
     pj_size_t speclen;
 
     if (s >= scanner->end) {
-	pj_scan_syntax_err(scanner);
+	syntax_err_out(scanner, out);
 	return;
     }
 
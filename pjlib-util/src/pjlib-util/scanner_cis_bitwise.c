@@ -34,6 +34,7 @@ PJ_DEF(pj_status_t) pj_cis_init(pj_cis_buf_t *cis_buf, pj_cis_t *cis)
     unsigned i;
 
     cis->cis_buf = cis_buf->cis_buf;
+    pj_bzero(cis->ascii_map, sizeof(cis->ascii_map));
 
     for (i=0; i<PJ_CIS_MAX_INDEX; ++i) {
         if ((cis_buf->use_mask & (1 << i)) == 0) {
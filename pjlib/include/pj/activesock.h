@@ -391,6 +391,16 @@ PJ_DECL(pj_status_t) pj_activesock_set_user_data(pj_activesock_t *asock,
  */
 PJ_DECL(void*) pj_activesock_get_user_data(pj_activesock_t *asock);
 
+/**
+ * Retrieve the ioqueue key of this active socket, e.g: to move it to
+ * another shard of the ioqueue with #pj_ioqueue_set_shard().
+ *
+ * @param asock	    The active socket.
+ *
+ * @return	    The ioqueue key.
+ */
+PJ_DECL(pj_ioqueue_key_t*) pj_activesock_get_key(pj_activesock_t *asock);
+
 
 /**
  * Starts read operation on this active socket. This function will create
@@ -537,6 +537,48 @@
 #endif
 
 
+/**
+ * Number of pools of each size that each thread keeps in its own cache
+ * (magazine) in front of the free lists of the caching pool factory. A
+ * thread creates and releases small pools (up to 8KB) from its magazine
+ * without taking the lock of the caching pool, and only moves pools
+ * between its magazine and the shared free lists in batches of half the
+ * magazine size. The pools in the magazines are counted in the capacity
+ * of the caching pool, so they are also limited by its maximum capacity.
+ * A thread should call pj_pool_factory_release_thread() before it quits
+ * to give back the pools in its magazine, otherwise they are only released
+ * when the caching pool is destroyed. Set to zero to disable the
+ * per-thread caches.
+ *
+ * This requires thread support and GCC or Clang atomic built-ins, and is
+ * disabled otherwise.
+ *
+ * Default: 8
+ */
+#ifndef PJ_CACHING_POOL_MAGAZINE_SIZE
+#   define PJ_CACHING_POOL_MAGAZINE_SIZE    8
+#endif
+
+
+/**
+ * Track the memory usage of the pools created by the caching pool factory
+ * by tag, i.e. by the beginning of the pool name, such as the number of
+ * live pools, their capacity and its high-water mark, and the unused
+ * slack. See #pj_caching_pool_get_tag_stat().
+ *
+ * The counters are updated with atomic operations each time a pool is
+ * created, grown or released, which roughly halves the pool create/release
+ * throughput in the pool benchmark, hence it is disabled by default. With
+ * threads, this requires GCC or Clang atomic built-ins and is disabled
+ * otherwise.
+ *
+ * Default: 0
+ */
+#ifndef PJ_CACHING_POOL_HAS_TAG_STAT
+#   define PJ_CACHING_POOL_HAS_TAG_STAT	    0
+#endif
+
+
 /**
  * Enable timer heap debugging facility. When this is enabled, application
  * can call pj_timer_heap_dump() to show the contents of the timer heap
@@ -550,6 +592,29 @@
 #endif
 
 
+/**
+ * Use the hierarchical timing wheel instead of the binary heap for the
+ * timer heaps created with pj_timer_heap_create(). The timing wheel has
+ * O(1) schedule and cancel, which pays off with many concurrent timers.
+ *
+ * Default: 0
+ */
+#ifndef PJ_TIMER_HEAP_USE_WHEEL
+#  define PJ_TIMER_HEAP_USE_WHEEL   0
+#endif
+
+
+/**
+ * The resolution of the timing wheel, in milliseconds. Timers scheduled
+ * in a timing wheel may expire up to this much later than requested.
+ *
+ * Default: 1
+ */
+#ifndef PJ_TIMER_WHEEL_RESOLUTION
+#  define PJ_TIMER_WHEEL_RESOLUTION 1
+#endif
+
+
 /**
  * Set this to 1 to enable debugging on the group lock. Default: 0
  */
@@ -704,6 +769,72 @@
 #endif
 
 
+/**
+ * Specify whether the select/epoll ioqueue may use recvmmsg() to receive
+ * several datagrams in a single system call, for keys that have enabled
+ * batched receive with #pj_ioqueue_set_recv_batch().
+ *
+ * Default: 1 on Linux (except Android), 0 on other platforms.
+ */
+#ifndef PJ_IOQUEUE_HAS_RECVMMSG
+#   if defined(PJ_LINUX) && PJ_LINUX!=0 && \
+       !(defined(PJ_ANDROID) && PJ_ANDROID!=0)
+#	define PJ_IOQUEUE_HAS_RECVMMSG	1
+#   else
+#	define PJ_IOQUEUE_HAS_RECVMMSG	0
+#   endif
+#endif
+
+
+/**
+ * Maximum number of datagrams that can be received in one batch by the
+ * ioqueue (see #pj_ioqueue_set_recv_batch()). Larger values given to
+ * the function will be clipped to this value.
+ *
+ * Default: 16
+ */
+#ifndef PJ_IOQUEUE_MAX_RECV_BATCH
+#   define PJ_IOQUEUE_MAX_RECV_BATCH	16
+#endif
+
+
+/**
+ * Specify whether the select/epoll ioqueue may use sendmmsg() to send
+ * several queued datagrams in a single system call, for keys that have
+ * enabled batched send with #pj_ioqueue_set_send_batch().
+ *
+ * Default: 1 on Linux (except Android), 0 on other platforms.
+ */
+#ifndef PJ_IOQUEUE_HAS_SENDMMSG
+#   define PJ_IOQUEUE_HAS_SENDMMSG	PJ_IOQUEUE_HAS_RECVMMSG
+#endif
+
+
+/**
+ * Maximum number of datagrams that can be sent in one batch by the
+ * ioqueue (see #pj_ioqueue_set_send_batch()). Larger values given to
+ * the function will be clipped to this value.
+ *
+ * Default: 16
+ */
+#ifndef PJ_IOQUEUE_MAX_SEND_BATCH
+#   define PJ_IOQUEUE_MAX_SEND_BATCH	16
+#endif
+
+
+/**
+ * Maximum number of shards that can be created in a sharded ioqueue
+ * (see #pj_ioqueue_create_sharded()). Each shard has its own event
+ * descriptor and can be polled by its own thread. Only the epoll backend
+ * supports more than one shard.
+ *
+ * Default: 16
+ */
+#ifndef PJ_IOQUEUE_MAX_SHARDS
+#   define PJ_IOQUEUE_MAX_SHARDS	16
+#endif
+
+
 /**
  * Determine if FD_SETSIZE is changeable/set-able. If so, then we will
  * set it to PJ_IOQUEUE_MAX_HANDLES. Currently we detect this by checking
@@ -957,6 +1088,75 @@
 #endif
 
 
+/**
+ * Maximum number of SSL contexts kept by the secure socket for reuse.
+ * Secure sockets created with the same credentials (certificate, private
+ * key, CA list, protocol and role) share one reference-counted context,
+ * so certificates and keys are loaded only once instead of on every
+ * connection. Contexts are also the anchor for TLS session resumption
+ * (session cache and tickets), so disabling this also disables
+ * resumption. The least recently used context is dropped when the cache
+ * is full. Set to zero to create a new context for every connection.
+ *
+ * Default: 8
+ */
+#ifndef PJ_SSL_SOCK_CTX_CACHE_SIZE
+#  define PJ_SSL_SOCK_CTX_CACHE_SIZE	8
+#endif
+
+
+/**
+ * Maximum number of TLS sessions kept in the server side session cache
+ * of each shared SSL context. Session tickets are also enabled on shared
+ * server contexts, so clients supporting tickets do not consume entries
+ * in this cache.
+ *
+ * Default: 1024
+ */
+#ifndef PJ_SSL_SOCK_SESS_CACHE_SIZE
+#  define PJ_SSL_SOCK_SESS_CACHE_SIZE	1024
+#endif
+
+
+/**
+ * Lifetime of a resumable TLS session, in seconds.
+ *
+ * Default: 300
+ */
+#ifndef PJ_SSL_SOCK_SESS_TIMEOUT
+#  define PJ_SSL_SOCK_SESS_TIMEOUT	300
+#endif
+
+
+/**
+ * Maximum number of TLS sessions kept by the client side session cache
+ * of each shared SSL context, for resuming sessions on reconnection.
+ * Sessions are keyed by remote host, i.e: the server name (SNI) and the
+ * remote address. Set to zero to disable client side session resumption.
+ *
+ * Default: 32
+ */
+#ifndef PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE
+#  define PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE	32
+#endif
+
+
+/**
+ * Enable kernel TLS (kTLS) support in the OpenSSL backend, see
+ * \a enable_ktls in #pj_ssl_sock_param. This also requires OpenSSL 3.0
+ * or later built with kTLS support, otherwise the setting is ignored.
+ *
+ * Default: 1 on Linux, 0 otherwise
+ */
+#ifndef PJ_SSL_SOCK_HAS_KTLS
+#  if defined(PJ_LINUX) && PJ_LINUX!=0
+#    define PJ_SSL_SOCK_HAS_KTLS		1
+#  else
+#    define PJ_SSL_SOCK_HAS_KTLS		0
+#  endif
+#endif
+
+
 /**
  * Disable WSAECONNRESET error for UDP sockets on Win32 platforms. See
  * https://trac.pjsip.org/repos/ticket/1197.
@@ -968,6 +1168,53 @@
 #endif
 
 
+/**
+ * Specify whether #pj_sock_sendv() may use sendmsg() to transmit several
+ * buffers with a single system call. When this is disabled, the buffers
+ * are transmitted one by one with #pj_sock_send().
+ *
+ * Default: 1 on Linux and Darwin, 0 on other platforms.
+ */
+#ifndef PJ_SOCK_HAS_SENDMSG
+#   if (defined(PJ_LINUX) && PJ_LINUX!=0) || \
+       (defined(PJ_DARWINOS) && PJ_DARWINOS!=0)
+#	define PJ_SOCK_HAS_SENDMSG	1
+#   else
+#	define PJ_SOCK_HAS_SENDMSG	0
+#   endif
+#endif
+
+
+/**
+ * Specify whether #pj_sock_accept2() may use accept4() to accept a
+ * connection and set the flags of the new socket with a single system
+ * call. When this is disabled, the flags are set with separate calls
+ * after the connection is accepted.
+ *
+ * Default: 1 on Linux (except Android), 0 on other platforms.
+ */
+#ifndef PJ_SOCK_HAS_ACCEPT4
+#   if defined(PJ_LINUX) && PJ_LINUX!=0 && \
+       !(defined(PJ_ANDROID) && PJ_ANDROID!=0)
+#	define PJ_SOCK_HAS_ACCEPT4	1
+#   else
+#	define PJ_SOCK_HAS_ACCEPT4	0
+#   endif
+#endif
+
+
+/**
+ * Maximum number of buffers to be transmitted by a single call to
+ * #pj_sock_sendv(). Buffers beyond this limit are not sent, and the
+ * caller will see them as a partial transmission.
+ *
+ * Default: 64
+ */
+#ifndef PJ_SOCK_MAX_IOV
+#   define PJ_SOCK_MAX_IOV		64
+#endif
+
+
 /** @} */
 
 /********************************************************************
@@ -85,6 +85,44 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
                                           char *result,
                                           const pj_str_t *key);
 
+
+/**
+ * Calculate the hash value of the specified key using the randomly seeded
+ * hash function, which is the function used internally by the hash table.
+ * The key is processed four bytes at a time, and the seed is chosen once
+ * per process, so remote peers can't craft keys that collide in the hash
+ * table. Hash values that are precomputed and passed to the hash table
+ * functions (such as #pj_hash_get() or #pj_hash_set()) must be calculated
+ * with this function (or #pj_hash_calc_seeded_tolower() for the "lower"
+ * variants).
+ *
+ * Unlike #pj_hash_calc(), the resulting value differs between processes,
+ * so it must not be used for persistent or transmitted identifiers.
+ *
+ * @param key	    the key to calculate.
+ * @param keylen    the length of the key, or PJ_HASH_KEY_STRING to treat
+ *		    the key as null terminated string.
+ *
+ * @return          the hash value.
+ */
+PJ_DECL(pj_uint32_t) pj_hash_calc_seeded(const void *key, unsigned keylen);
+
+
+/**
+ * Variant of #pj_hash_calc_seeded() with the key being converted to
+ * lowercase (ASCII letters only) when calculating the hash value. The
+ * resulting string is stored in \c result.
+ *
+ * @param result    Optional. Buffer to store the result, which must be enough
+ *                  to hold the string.
+ * @param key       The input key to be converted and calculated.
+ *
+ * @return          The hash value.
+ */
+PJ_DECL(pj_uint32_t) pj_hash_calc_seeded_tolower(char *result,
+						 const pj_str_t *key);
+
+
 /**
  * Create a hash table with the specified 'bucket' size.
  *
@@ -96,6 +134,46 @@ PJ_DECL(pj_uint32_t) pj_hash_calc_tolower(pj_uint32_t hval,
 PJ_DECL(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size);
 
 
+/**
+ * Options for #pj_hash_create2(), which can be bitmask combined.
+ */
+typedef enum pj_hash_option
+{
+    /**
+     * Let the hash table grow as entries are added. When the number of
+     * entries exceeds the number of buckets, the number of buckets is
+     * doubled, and the entries are migrated to the new buckets a few
+     * buckets at a time on each subsequent insertion, so no single
+     * operation has to rehash the whole table. The bucket arrays are
+     * allocated from the pool specified when creating the hash table, so
+     * that pool must not be used concurrently by other threads without
+     * the lock that protects the hash table. The retired bucket arrays
+     * are not freed until the pool is released, but since the table
+     * doubles each time, they never add up to more than the size of the
+     * current bucket array.
+     *
+     * Lookup, removal, and iteration never migrate entries, so removing
+     * the current entry while iterating remains safe.
+     */
+    PJ_HASH_GROWABLE = 1
+
+} pj_hash_option;
+
+
+/**
+ * Create a hash table with the specified initial 'bucket' size and options.
+ *
+ * @param pool	    the pool from which the hash table will be allocated from.
+ * @param size	    the bucket size, which will be round-up to the nearest
+ *		    2^n-1.
+ * @param options   bitmask combination of #pj_hash_option.
+ *
+ * @return the hash table.
+ */
+PJ_DECL(pj_hash_table_t*) pj_hash_create2(pj_pool_t *pool, unsigned size,
+					  unsigned options);
+
+
 /**
  * Get the value associated with the specified key.
  *
@@ -94,6 +94,10 @@ PJ_BEGIN_DECL
  *  - <tt><b>/dev/epoll</b></tt> on Linux (user mode and kernel mode), 
  *    a much faster replacement for select() on Linux (and more importantly
  *    doesn't have limitation on number of descriptors).
+ *  - <tt><b>io_uring</b></tt> on Linux 5.11 or later, where the socket
+ *    operations themselves are submitted to the kernel and the operations
+ *    started from the callbacks are submitted in batch after each poll.
+ *    Enable with <tt>--enable-uring</tt> configure option.
  *  - <b>I/O Completion ports</b> on Windows NT/2000/XP, which is the most 
  *    efficient way to dispatch events in Windows NT based OSes, and most 
  *    importantly, it doesn't have the limit on how many handles to monitor.
@@ -331,6 +335,16 @@ typedef enum pj_ioqueue_operation_e
  */
 #define PJ_IOQUEUE_ALWAYS_ASYNC	    ((pj_uint32_t)1 << (pj_uint32_t)31)
 
+/**
+ * When this flag is specified in ioqueue's sendto() operation on a key
+ * which has enabled batched send with #pj_ioqueue_set_send_batch(), the
+ * datagram will not be sent immediately. Instead it will be queued, and
+ * sent together with other queued datagrams of the key when the ioqueue
+ * is polled. The flag is ignored when batched send is not enabled or not
+ * supported, in which case the datagram is sent as usual.
+ */
+#define PJ_IOQUEUE_BATCH_SEND	    ((pj_uint32_t)1 << (pj_uint32_t)30)
+
 /**
  * Return the name of the ioqueue implementation.
  *
@@ -353,6 +367,59 @@ PJ_DECL(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 					pj_size_t max_fd,
 					pj_ioqueue_t **ioqueue);
 
+/**
+ * Create a new I/O Queue framework with the specified number of shards.
+ * Each shard has its own event descriptor, and registered handles are
+ * assigned to the shards in round-robin fashion (or explicitly with
+ * #pj_ioqueue_set_shard()). A thread which has been bound to a shard
+ * with #pj_ioqueue_set_thread_shard() only polls the handles of that
+ * shard, so the callbacks of a handle are always called by the same
+ * thread(s). Threads which are not bound to any shard poll all shards.
+ *
+ * Backends which don't support sharding create an I/O queue with a
+ * single shard.
+ *
+ * @param pool		The pool to allocate the I/O queue structure. 
+ * @param max_fd	The maximum number of handles to be supported, which 
+ *			should not exceed PJ_IOQUEUE_MAX_HANDLES.
+ * @param shard_cnt	Number of shards, up to PJ_IOQUEUE_MAX_SHARDS. Zero
+ *			is treated as one.
+ * @param ioqueue	Pointer to hold the newly created I/O Queue.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_create_sharded( pj_pool_t *pool,
+						pj_size_t max_fd,
+						unsigned shard_cnt,
+						pj_ioqueue_t **ioqueue);
+
+/**
+ * Get the number of shards in the I/O queue.
+ *
+ * @param ioqueue	The I/O Queue.
+ *
+ * @return		Number of shards, which is 1 if the I/O queue is
+ *			not sharded.
+ */
+PJ_DECL(unsigned) pj_ioqueue_get_shard_count(pj_ioqueue_t *ioqueue);
+
+/**
+ * Bind the calling thread to a shard of the I/O queue, so that
+ * subsequent #pj_ioqueue_poll() calls by this thread only poll the
+ * handles assigned to that shard. Application must make sure that every
+ * shard is polled by at least one thread, or that some threads remain
+ * unbound.
+ *
+ * @param ioqueue	The I/O Queue.
+ * @param shard_hint	Shard index, which will be taken modulo the number
+ *			of shards (so e.g. worker thread index can be used
+ *			directly), or negative value to unbind the thread.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_thread_shard(pj_ioqueue_t *ioqueue,
+						 int shard_hint);
+
 /**
  * Destroy the I/O queue.
  *
@@ -513,6 +580,73 @@ PJ_DECL(pj_status_t) pj_ioqueue_set_user_data( pj_ioqueue_key_t *key,
 PJ_DECL(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
 						pj_bool_t allow);
 
+/**
+ * Enable or disable batched receive for the specified datagram key. When
+ * batched receive is enabled and the socket becomes readable, the ioqueue
+ * will complete up to \a max_cnt pending #pj_ioqueue_recv() or
+ * #pj_ioqueue_recvfrom() operations of the key with a single system call
+ * (recvmmsg() on Linux), and call the key's \a on_read_complete callback
+ * for each of them in a burst.
+ *
+ * Batching only helps when the application keeps more than one read
+ * operation pending on the key (for example, by setting \a async_cnt in
+ * #pj_activesock_cfg). Pending operations are batched together only if
+ * they were submitted with the same flags.
+ *
+ * @param key	    The key that was previously obtained from registration.
+ * @param max_cnt   Maximum number of datagrams to be received in one
+ *		    batch, which will be clipped to
+ *		    PJ_IOQUEUE_MAX_RECV_BATCH. Zero or one disables
+ *		    batching (the default).
+ *
+ * @return	    PJ_SUCCESS on success, PJ_ENOTSUP if the ioqueue
+ *		    backend does not support batched receive, or the
+ *		    appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_recv_batch(pj_ioqueue_key_t *key,
+					       unsigned max_cnt);
+
+/**
+ * Enable or disable batched send for the specified datagram key. When
+ * batched send is enabled, datagrams that are submitted with
+ * #pj_ioqueue_sendto() with PJ_IOQUEUE_BATCH_SEND flag are queued by
+ * the ioqueue (the function will return PJ_EPENDING), and when the
+ * socket is polled as writable, up to \a max_cnt queued datagrams are
+ * sent with a single system call (sendmmsg() on Linux). The key's
+ * \a on_write_complete callback will be called for each of them.
+ *
+ * Since the data is sent asynchronously, the application must keep the
+ * buffer and the operation key untouched until the callback is called,
+ * as with any other pending write operation.
+ *
+ * @param key	    The key that was previously obtained from registration.
+ * @param max_cnt   Maximum number of datagrams to be sent in one batch,
+ *		    which will be clipped to PJ_IOQUEUE_MAX_SEND_BATCH.
+ *		    Zero or one disables batching (the default).
+ *
+ * @return	    PJ_SUCCESS on success, PJ_ENOTSUP if the ioqueue
+ *		    backend does not support batched send, or the
+ *		    appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_send_batch(pj_ioqueue_key_t *key,
+					       unsigned max_cnt);
+
+/**
+ * Move the key to the specified shard of its I/O queue, so that its
+ * callbacks will be called by the thread(s) polling that shard. This is
+ * useful to keep handles that belong together (for example, RTP and RTCP
+ * sockets of a media stream) on the same thread.
+ *
+ * @param key		The key that was previously obtained from
+ *			registration.
+ * @param shard_hint	Shard index, which will be taken modulo the number
+ *			of shards.
+ *
+ * @return		PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_ioqueue_set_shard(pj_ioqueue_key_t *key,
+					  unsigned shard_hint);
+
 /**
  * Acquire the key's mutex. When the key's concurrency is disabled, 
  * application may call this function to synchronize its operation
@@ -600,6 +734,10 @@ PJ_DECL(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
  * immediately available, the function returns PJ_SUCCESS with the new
  * connection; in this case, the callback WILL NOT be called.
  *
+ * The new socket is in non-blocking mode, ready to be registered to the
+ * I/O queue, and is closed on exec() where the platform supports it
+ * (see #pj_sock_accept2()).
+ *
  * @param key	    The key which registered to the server socket.
  * @param op_key    An operation specific key to be associated with the
  *                  pending operation, so that application can keep track of
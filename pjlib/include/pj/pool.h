@@ -734,6 +734,28 @@ struct pj_pool_factory
      */
     void (*on_block_free)(pj_pool_factory *factory, pj_size_t size);
 
+    /**
+     * This is optional callback to be called by the pool when its capacity
+     * has changed after it was created, i.e. when it allocates a new memory
+     * block or when it is reset. The factory may use this callback for
+     * example to keep track of the memory used by each pool.
+     *
+     * @param factory	    The pool factory.
+     * @param pool	    The pool.
+     * @param old_capacity  Capacity of the pool before the change.
+     */
+    void (*on_pool_resize)(pj_pool_factory *factory, pj_pool_t *pool,
+			   pj_size_t old_capacity);
+
+    /**
+     * This is optional callback to be called by a thread before it quits,
+     * see #pj_pool_factory_release_thread(). The factory may use this
+     * callback to release the resources which it keeps for the thread.
+     *
+     * @param factory	    The pool factory.
+     */
+    void (*release_thread)(pj_pool_factory *factory);
+
 };
 
 /**
@@ -781,6 +803,21 @@ PJ_INLINE(void) pj_pool_factory_dump( pj_pool_factory *pf,
     (*pf->dump_status)(pf, detail);
 }
 
+/**
+ * Release the resources which the pool factory keeps for the calling
+ * thread, such as the per-thread pool cache of the caching pool (see
+ * PJ_CACHING_POOL_MAGAZINE_SIZE). Threads which create pools should call
+ * this before they quit. Pools created by the thread can still be used
+ * and released afterwards.
+ *
+ * @param pf	    The pool factory.
+ */
+PJ_INLINE(void) pj_pool_factory_release_thread( pj_pool_factory *pf )
+{
+    if (pf->release_thread)
+	(*pf->release_thread)(pf);
+}
+
 /**
  *  @}	// PJ_POOL_FACTORY
  */
@@ -808,6 +845,67 @@ PJ_INLINE(void) pj_pool_factory_dump( pj_pool_factory *pf,
  */
 #define PJ_CACHING_POOL_ARRAY_SIZE	16
 
+/**
+ * Maximum number of pool tags whose usage is tracked by the caching pool,
+ * see #pj_caching_pool_get_tag_stat(). Pools of tags which don't fit are
+ * counted in the last tag, named "(other)".
+ */
+#ifndef PJ_CACHING_POOL_MAX_TAGS
+#   define PJ_CACHING_POOL_MAX_TAGS	32
+#endif
+
+/**
+ * Number of lists of the caching pool which hold the pools created from the
+ * per-thread caches (see PJ_CACHING_POOL_MAGAZINE_SIZE).
+ */
+#define PJ_CACHING_POOL_USED_LIST_CNT	8
+
+/**
+ * Maximum length of pool tag, including the NULL terminator.
+ */
+#define PJ_POOL_TAG_LEN			16
+
+/**
+ * Memory usage of the pools of one tag in the caching pool. The tag of a
+ * pool is the beginning of the name given when the pool is created, up to
+ * the first digit or format character, e.g. "tsx" for "tsx%p", so that the
+ * pools created by the same component share the same tag.
+ */
+typedef struct pj_pool_tag_stat
+{
+    /** The tag. */
+    char	tag[PJ_POOL_TAG_LEN];
+
+    /** Number of pools currently held by application. */
+    pj_size_t	pool_cnt;
+
+    /** Highest number of pools held by application at the same time. */
+    pj_size_t	peak_pool_cnt;
+
+    /** Total capacity of the pools currently held by application. */
+    pj_size_t	capacity;
+
+    /** Highest total capacity of the pools (high-water mark). */
+    pj_size_t	peak_capacity;
+
+    /** Number of pools that have been created. */
+    pj_size_t	create_cnt;
+
+    /** Number of memory blocks that pools have allocated in addition to
+     *  their initial block, i.e. how often the initial size was not
+     *  enough. */
+    pj_size_t	block_cnt;
+
+    /** Highest capacity of a single pool when it was released. */
+    pj_size_t	max_pool_capacity;
+
+    /** Total unused capacity of the pools when they were released, i.e.
+     *  the memory wasted by the slack in the blocks. Divide by the number
+     *  of released pools (create_cnt - pool_cnt) to get the average. */
+    pj_size_t	slack;
+
+} pj_pool_tag_stat;
+
 /**
  * Declaration for caching pool. Application doesn't normally need to
  * care about the contents of this struct, it is only provided here because
@@ -871,6 +969,42 @@ struct pj_caching_pool
      * Mutex.
      */
     pj_lock_t	   *lock;
+
+    /**
+     * Thread local storage index of the per-thread pool caches, or -1 if
+     * they are not used (see PJ_CACHING_POOL_MAGAZINE_SIZE). Pools which
+     * are kept in the per-thread caches are counted in @a capacity, and
+     * pools which are created from them are put in @a mag_used_list
+     * instead of @a used_list.
+     */
+    long	    tls_id;
+
+    /**
+     * List of the per-thread pool caches.
+     */
+    pj_list	    magazine_list;
+
+    /**
+     * Lists of pools created from the per-thread caches which are currently
+     * allocated by applications. The list of a pool is selected by its
+     * address, so that threads rarely contend for the same list.
+     */
+    pj_list	    mag_used_list[PJ_CACHING_POOL_USED_LIST_CNT];
+
+    /**
+     * Spinlocks of @a mag_used_list.
+     */
+    int		    mag_used_busy[PJ_CACHING_POOL_USED_LIST_CNT];
+
+    /**
+     * Memory usage of the pools by tag, see #pj_caching_pool_get_tag_stat().
+     */
+    pj_pool_tag_stat tag_stat[PJ_CACHING_POOL_MAX_TAGS];
+
+    /**
+     * Number of tags in @a tag_stat.
+     */
+    unsigned	    tag_cnt;
 };
 
 
@@ -898,6 +1032,32 @@ PJ_DECL(void) pj_caching_pool_init( pj_caching_pool *ch_pool,
  */
 PJ_DECL(void) pj_caching_pool_destroy( pj_caching_pool *ch_pool );
 
+/**
+ * Get the memory usage of the pools of the caching pool, grouped by the
+ * tag of the pool name (see #pj_pool_tag_stat). This is only available
+ * when PJ_CACHING_POOL_HAS_TAG_STAT is enabled, otherwise no tag is
+ * returned.
+ *
+ * @param ch_pool	The caching pool.
+ * @param stat		Array to receive the usage of each tag.
+ * @param count		On input, the number of elements in the array. On
+ *			output, the number of tags returned.
+ *
+ * @return		PJ_SUCCESS on success, or PJ_ENOTSUP if usage is
+ *			not tracked.
+ */
+PJ_DECL(pj_status_t) pj_caching_pool_get_tag_stat(pj_caching_pool *ch_pool,
+						  pj_pool_tag_stat stat[],
+						  unsigned *count);
+
+/**
+ * Dump the memory usage of the pools by tag to log, see
+ * #pj_caching_pool_get_tag_stat().
+ *
+ * @param ch_pool	The caching pool.
+ */
+PJ_DECL(void) pj_caching_pool_dump_tag_stat(pj_caching_pool *ch_pool);
+
 /**
  * @}	// PJ_CACHING_POOL
  */
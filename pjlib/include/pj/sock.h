@@ -313,6 +313,12 @@ extern const pj_uint16_t PJ_SO_REUSEADDR;
 /** Do not generate SIGPIPE. @see pj_SO_NOSIGPIPE */
 extern const pj_uint16_t PJ_SO_NOSIGPIPE;
 
+/** Allow several sockets to bind to the same address and port, and
+ *  have the kernel distribute incoming connections (or datagrams) among
+ *  them. The value is 0xFFFF when the platform does not support it.
+ *  @see pj_SO_REUSEPORT */
+extern const pj_uint16_t PJ_SO_REUSEPORT;
+
 /** Set the protocol-defined priority for all packets to be sent on socket.
  */
 extern const pj_uint16_t PJ_SO_PRIORITY;
@@ -352,6 +358,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_NOSIGPIPE constant */
     PJ_DECL(pj_uint16_t) pj_SO_NOSIGPIPE(void);
 
+    /** Get #PJ_SO_REUSEPORT constant */
+    PJ_DECL(pj_uint16_t) pj_SO_REUSEPORT(void);
+
     /** Get #PJ_SO_PRIORITY constant */
     PJ_DECL(pj_uint16_t) pj_SO_PRIORITY(void);
 
@@ -388,6 +397,9 @@ extern const pj_uint16_t PJ_IP_DROP_MEMBERSHIP;
     /** Get #PJ_SO_NOSIGPIPE constant */
 #   define pj_SO_NOSIGPIPE() PJ_SO_NOSIGPIPE
 
+    /** Get #PJ_SO_REUSEPORT constant */
+#   define pj_SO_REUSEPORT() PJ_SO_REUSEPORT
+
     /** Get #PJ_SO_PRIORITY constant */
 #   define pj_SO_PRIORITY() PJ_SO_PRIORITY
 
@@ -1272,6 +1284,43 @@ PJ_DECL(pj_status_t) pj_sock_accept( pj_sock_t serverfd,
 				     pj_sock_t *newsock,
 				     pj_sockaddr_t *addr,
 				     int *addrlen);
+
+/**
+ * Flags to be applied to the new socket by #pj_sock_accept2().
+ */
+typedef enum pj_sock_accept_flag
+{
+    /** Put the new socket in non-blocking mode. */
+    PJ_SOCK_ACCEPT_NONBLOCK = 1,
+
+    /** Close the new socket on exec(). This is only honored when
+     *  accept4() is available (see #PJ_SOCK_HAS_ACCEPT4). */
+    PJ_SOCK_ACCEPT_CLOEXEC = 2
+
+} pj_sock_accept_flag;
+
+/**
+ * Accept new connection on the specified connection oriented server socket,
+ * and apply the specified flags to the new socket. When the platform
+ * supports it (see #PJ_SOCK_HAS_ACCEPT4), this is done with a single
+ * system call, which saves the additional calls otherwise needed by
+ * callers that accept many connections.
+ *
+ * @param serverfd  The server socket.
+ * @param newsock   New socket on success, of PJ_INVALID_SOCKET if failed.
+ * @param addr	    A pointer to sockaddr type. If the argument is not NULL,
+ *		    it will be filled by the address of connecting entity.
+ * @param addrlen   Initially specifies the length of the address, and upon
+ *		    return will be filled with the exact address length.
+ * @param flags	    Bitmask combination of #pj_sock_accept_flag.
+ *
+ * @return	    Zero on success, or the error number.
+ */
+PJ_DECL(pj_status_t) pj_sock_accept2( pj_sock_t serverfd,
+				      pj_sock_t *newsock,
+				      pj_sockaddr_t *addr,
+				      int *addrlen,
+				      unsigned flags);
 #endif
 
 /**
@@ -1451,6 +1500,38 @@ PJ_DECL(pj_status_t) pj_sock_send(pj_sock_t sockfd,
 				  pj_ssize_t *len,
 				  unsigned flags);
 
+/**
+ * This structure describes a buffer to be transmitted by #pj_sock_sendv().
+ */
+typedef struct pj_sock_iovec
+{
+    const void	*buf;	    /**< Pointer to the data.	    */
+    pj_size_t	 len;	    /**< Length of the data.	    */
+} pj_sock_iovec;
+
+/**
+ * Transmit several buffers to a connected socket as one contiguous stream
+ * of data, with a single system call when the platform supports it (see
+ * #PJ_SOCK_HAS_SENDMSG). Just like #pj_sock_send(), the function may
+ * transmit less data than requested, e.g: when the socket is non-blocking
+ * and its send buffer is full.
+ *
+ * @param sockfd	Socket descriptor.
+ * @param iov		Array of buffers to be sent, in order.
+ * @param iovcnt	Number of buffers in the array. Only the first
+ *			#PJ_SOCK_MAX_IOV buffers will be sent.
+ * @param len		Upon return, it will be filled with the total length
+ *			of data sent.
+ * @param flags		Flags (such as pj_MSG_DONTROUTE()).
+ *
+ * @return		PJ_SUCCESS or the status code.
+ */
+PJ_DECL(pj_status_t) pj_sock_sendv(pj_sock_t sockfd,
+				   const pj_sock_iovec iov[],
+				   unsigned iovcnt,
+				   pj_ssize_t *len,
+				   unsigned flags);
+
 /**
  * Transmit data to the socket to the specified address.
  *
@@ -710,6 +710,20 @@ typedef struct pj_ssl_sock_info
      */
     pj_uint32_t		verify_status;
 
+    /**
+     * Describes whether the connection was established by resuming a
+     * previous TLS session (abbreviated handshake), this will only be set
+     * when connection is established.
+     */
+    pj_bool_t		session_reused;
+
+    /**
+     * Describes whether TLS record encryption for sending has been
+     * offloaded to the kernel (kTLS), see \a enable_ktls in
+     * #pj_ssl_sock_param.
+     */
+    pj_bool_t		ktls_send;
+
     /**
      * Last native error returned by the backend.
      */
@@ -829,10 +843,11 @@ typedef struct pj_ssl_sock_param
     pj_bool_t whole_data;
 
     /**
-     * Specify buffer size for sending operation. Buffering sending data
-     * is used for allowing application to perform multiple outstanding 
-     * send operations. Whenever application specifies this setting too
-     * small, sending operation may return PJ_ENOMEM.
+     * Specify buffer size for sending operation. While the socket is busy
+     * sending previous data, secured data of subsequent send operations
+     * is accumulated up to this size and then sent at once, further send
+     * operations are queued until the socket is ready, so application can
+     * perform multiple outstanding send operations.
      *  
      * Default value is 8192 bytes.
      */
@@ -949,6 +964,15 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t reuse_addr;
 
+    /**
+     * The incoming connection backlog number to be set in listen(). This
+     * option will only be used with accept() operation. Zero means
+     * PJ_SOMAXCONN.
+     *
+     * Default is zero.
+     */
+    int backlog;
+
     /**
      * QoS traffic type to be set on this transport. When application wants
      * to apply QoS tagging to the transport, it's preferable to set this
@@ -992,6 +1016,22 @@ typedef struct pj_ssl_sock_param
      */
     pj_bool_t sockopt_ignore_error;
 
+    /**
+     * Offload TLS record encryption for sending to the kernel (kTLS) once
+     * the handshake is completed, so the data is written to the socket
+     * as plain data. Decryption of received data is still done by the
+     * SSL library. When kTLS is not supported by the SSL library or by
+     * the kernel, or not usable for the negotiated cipher, the socket
+     * silently keeps encrypting in user space. Check \a ktls_send in
+     * #pj_ssl_sock_info to see if the offload is active.
+     *
+     * This is currently only supported by the OpenSSL backend on Linux,
+     * see also #PJ_SSL_SOCK_HAS_KTLS.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_ktls;
+
 } pj_ssl_sock_param;
 
 
@@ -1199,9 +1239,8 @@ PJ_DECL(pj_status_t) pj_ssl_sock_start_recvfrom2(pj_ssl_sock_t *ssock,
  * @param flags		Flags to be given to pj_ioqueue_send().
  *
  * @return		PJ_SUCCESS if data has been sent immediately, or
- *			PJ_EPENDING if data cannot be sent immediately or
- *			PJ_ENOMEM when sending buffer could not handle all
- *			queued data, see \a send_buffer_size. The callback
+ *			PJ_EPENDING if data cannot be sent immediately, see
+ *			also \a send_buffer_size. The callback
  *			\a on_data_sent() will be called when data is actually
  *			sent. Any other return value indicates error condition.
  */
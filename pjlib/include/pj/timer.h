@@ -52,6 +52,13 @@ PJ_BEGIN_DECL
  *
  * ACE is Copyright (C)1993-2006 Douglas C. Schmidt <d.schmidt@vanderbilt.edu>
  *
+ * Alternatively, the timer heap can be organized as a hierarchical timing
+ * wheel (see #pj_timer_heap_create2() and #PJ_TIMER_HEAP_USE_WHEEL), where
+ * scheduling and canceling a timer is O(1) regardless of the number of
+ * timers, at the cost of rounding the expiration up to the wheel
+ * resolution (#PJ_TIMER_WHEEL_RESOLUTION). This suits applications with
+ * many concurrent timers which are mostly cancelled before they expire.
+ *
  * @{
  *
  * \section pj_timer_examples_sec Examples
@@ -125,6 +132,12 @@ typedef struct pj_timer_entry
      */
     pj_grp_lock_t *_grp_lock;
 
+    /**
+     * Internal: the timer heap where the entry is scheduled. For a sharded
+     * timer heap, this is the shard which owns the entry.
+     */
+    pj_timer_heap_t *_timer_heap;
+
 #if PJ_TIMER_DEBUG
     const char	*src_file;
     int		 src_line;
@@ -132,6 +145,20 @@ typedef struct pj_timer_entry
 } pj_timer_entry;
 
 
+/**
+ * The timer heap implementation types, see #pj_timer_heap_create2().
+ */
+typedef enum pj_timer_heap_type
+{
+    /** Binary heap, O(log N) schedule, cancel, and expiration. */
+    PJ_TIMER_HEAP_BINARY,
+
+    /** Hierarchical timing wheel, O(1) schedule and cancel. */
+    PJ_TIMER_HEAP_WHEEL
+
+} pj_timer_heap_type;
+
+
 /**
  * Calculate memory size required to create a timer heap.
  *
@@ -159,6 +186,86 @@ PJ_DECL(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 					   pj_size_t count,
                                            pj_timer_heap_t **ht);
 
+/**
+ * Create a timer heap with the specified implementation. The
+ * #pj_timer_heap_create() function creates a binary heap, unless
+ * #PJ_TIMER_HEAP_USE_WHEEL is enabled.
+ *
+ * @param pool      The pool where allocations in the timer heap will be
+ *                  allocated.
+ * @param count     The maximum number of timer entries to be supported
+ *                  initially. If the application registers more entries
+ *                  during runtime, then the timer heap will resize.
+ * @param type      The implementation type.
+ * @param ht        Pointer to receive the created timer heap.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					    pj_size_t count,
+					    pj_timer_heap_type type,
+					    pj_timer_heap_t **ht);
+
+/**
+ * Create a timer heap consisting of the specified number of shards, each
+ * being an independent timer heap with its own lock. A thread which has
+ * been bound to a shard with #pj_timer_heap_set_thread_shard() schedules
+ * its timer entries to that shard, and its #pj_timer_heap_poll() calls only
+ * expire the entries of that shard, so threads don't contend on a single
+ * timer heap lock. Entries scheduled by unbound threads are spread among
+ * the shards, and unbound threads poll all shards.
+ *
+ * An entry remembers the shard where it is scheduled, so it can be
+ * cancelled by any thread. The group lock semantic of
+ * #pj_timer_heap_schedule_w_grp_lock() is unchanged, and the callback is
+ * called with the sharded timer heap as the \a timer_heap argument.
+ *
+ * Each shard is created with #pj_timer_heap_create() and a recursive
+ * mutex. The lock set with #pj_timer_heap_set_lock() to the sharded timer
+ * heap itself is not used.
+ *
+ * @param pool      The pool where allocations in the timer heap will be
+ *                  allocated.
+ * @param count     The maximum number of timer entries to be supported
+ *                  initially, which is divided among the shards.
+ * @param shard_cnt Number of shards. Zero or one creates a normal timer
+ *                  heap with #pj_timer_heap_create().
+ * @param ht        Pointer to receive the created timer heap.
+ *
+ * @return          PJ_SUCCESS, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_create_sharded( pj_pool_t *pool,
+						   pj_size_t count,
+						   unsigned shard_cnt,
+						   pj_timer_heap_t **ht);
+
+/**
+ * Get the number of shards of the timer heap.
+ *
+ * @param ht        The timer heap.
+ *
+ * @return          Number of shards, which is 1 if the timer heap is
+ *                  not sharded.
+ */
+PJ_DECL(unsigned) pj_timer_heap_get_shard_count(pj_timer_heap_t *ht);
+
+/**
+ * Bind the calling thread to a shard of the timer heap, so that timer
+ * entries scheduled by this thread go to that shard, and subsequent
+ * #pj_timer_heap_poll() calls by this thread only expire the entries of
+ * that shard. Application must make sure that every shard is polled by at
+ * least one thread, or that some polling threads remain unbound.
+ *
+ * @param ht         The timer heap.
+ * @param shard_hint Shard index, which will be taken modulo the number
+ *                   of shards (so e.g. worker thread index can be used
+ *                   directly), or negative value to unbind the thread.
+ *
+ * @return           PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pj_timer_heap_set_thread_shard(pj_timer_heap_t *ht,
+						    int shard_hint);
+
 /**
  * Destroy the timer heap.
  *
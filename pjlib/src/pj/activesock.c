@@ -328,6 +328,13 @@ PJ_DEF(void*) pj_activesock_get_user_data(pj_activesock_t *asock)
 }
 
 
+PJ_DEF(pj_ioqueue_key_t*) pj_activesock_get_key(pj_activesock_t *asock)
+{
+    PJ_ASSERT_RETURN(asock, NULL);
+    return asock->key;
+}
+
+
 PJ_DEF(pj_status_t) pj_activesock_start_read(pj_activesock_t *asock,
 					     pj_pool_t *pool,
 					     unsigned buff_size,
@@ -22,6 +22,7 @@
 #include <pj/string.h>
 #include <pj/pool.h>
 #include <pj/os.h>
+#include <pj/rand.h>
 #include <pj/ctype.h>
 #include <pj/assert.h>
 
@@ -30,6 +31,13 @@
  */
 #define PJ_HASH_MULTIPLIER	33
 
+/**
+ * Number of buckets of the old bucket array to migrate on each insertion
+ * while a growable hash table is being resized. This must be more than
+ * one so that the migration completes before the next resize is due.
+ */
+#define REHASH_STEP		4
+
 
 struct pj_hash_entry
 {
@@ -46,6 +54,18 @@ struct pj_hash_table_t
     pj_hash_entry     **table;
     unsigned		count, rows;
     pj_hash_iterator_t	iterator;
+
+    /* Pool to allocate bigger bucket array from, or NULL if the table
+     * is not growable.
+     */
+    pj_pool_t	       *pool;
+
+    /* While resizing, the previous bucket array whose entries are being
+     * migrated to <table>, starting from bucket <rehash_idx>.
+     */
+    pj_hash_entry     **old_table;
+    unsigned		old_rows;
+    unsigned		rehash_idx;
 };
 
 
@@ -88,7 +108,160 @@ PJ_DEF(pj_uint32_t) pj_hash_calc_tolower( pj_uint32_t hval,
 }
 
 
+/*
+ * The seeded hash is based on the MurmurHash3 (x86, 32bit) algorithm by
+ * Austin Appleby, which is in public domain. The key is processed four
+ * bytes at a time.
+ */
+#define ROTL32(x,r)	(((x) << (r)) | ((x) >> (32 - (r))))
+#define MURMUR_C1	0xcc9e2d51
+#define MURMUR_C2	0x1b873593
+
+static pj_uint32_t hash_seed;
+static pj_bool_t hash_seed_initialized;
+
+/* Get the per-process random seed, initializing it on first call. */
+static pj_uint32_t get_hash_seed(void)
+{
+    if (!hash_seed_initialized) {
+	pj_enter_critical_section();
+	if (!hash_seed_initialized) {
+	    pj_timestamp ts;
+	    pj_uint32_t seed;
+
+	    /* Mix the current time, address space layout, and some random
+	     * values, so the seed can't be guessed by remote peers.
+	     */
+	    pj_get_timestamp(&ts);
+	    seed = ts.u32.lo ^ ROTL32(ts.u32.hi, 16);
+	    seed = seed * 33 + (pj_uint32_t)(pj_ssize_t)&hash_seed;
+	    seed = seed * 33 + (pj_uint32_t)(pj_ssize_t)&ts;
+	    seed = seed * 33 + (pj_uint32_t)pj_getpid();
+	    seed = seed * 33 + (pj_uint32_t)pj_rand();
+
+	    hash_seed = seed;
+	    hash_seed_initialized = PJ_TRUE;
+	}
+	pj_leave_critical_section();
+    }
+    return hash_seed;
+}
+
+/* Mix four bytes of the key into the hash value. */
+PJ_INLINE(pj_uint32_t) murmur_mix(pj_uint32_t h, pj_uint32_t k)
+{
+    k *= MURMUR_C1;
+    k = ROTL32(k, 15);
+    k *= MURMUR_C2;
+
+    h ^= k;
+    h = ROTL32(h, 13);
+    return h * 5 + 0xe6546b64;
+}
+
+/* Mix the remaining 0-3 bytes and the key length, and finalize. */
+PJ_INLINE(pj_uint32_t) murmur_final(pj_uint32_t h, pj_uint32_t tail,
+				    unsigned keylen)
+{
+    if (keylen & 3) {
+	tail *= MURMUR_C1;
+	tail = ROTL32(tail, 15);
+	tail *= MURMUR_C2;
+	h ^= tail;
+    }
+
+    h ^= keylen;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Read four bytes of the key in host byte order, regardless of alignment. */
+PJ_INLINE(pj_uint32_t) load32(const pj_uint8_t *p)
+{
+    pj_uint32_t v;
+    pj_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Convert the ASCII uppercase letters in the four bytes to lowercase. */
+PJ_INLINE(pj_uint32_t) tolower32(pj_uint32_t x)
+{
+    pj_uint32_t heptets = x & 0x7F7F7F7F;
+    pj_uint32_t ge_a = heptets + 0x3F3F3F3F;	/* bit 7 set if >= 'A' */
+    pj_uint32_t gt_z = heptets + 0x25252525;	/* bit 7 set if >  'Z' */
+    pj_uint32_t upper = (ge_a ^ gt_z) & ~x & 0x80808080;
+
+    return x | (upper >> 2);
+}
+
+PJ_DEF(pj_uint32_t) pj_hash_calc_seeded(const void *key, unsigned keylen)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key;
+    pj_uint32_t h = get_hash_seed();
+    pj_uint32_t tail = 0;
+    unsigned i, nwords;
+
+    if (keylen==PJ_HASH_KEY_STRING)
+	keylen = (unsigned)pj_ansi_strlen((const char*)key);
+
+    nwords = keylen / 4;
+    for (i=0; i<nwords; ++i, p+=4)
+	h = murmur_mix(h, load32(p));
+
+    switch (keylen & 3) {
+    case 3: tail ^= p[2] << 16;
+    /* fallthrough */
+    case 2: tail ^= p[1] << 8;
+    /* fallthrough */
+    case 1: tail ^= p[0];
+    }
+
+    return murmur_final(h, tail, keylen);
+}
+
+PJ_DEF(pj_uint32_t) pj_hash_calc_seeded_tolower(char *result,
+						const pj_str_t *key)
+{
+    const pj_uint8_t *p = (const pj_uint8_t*)key->ptr;
+    unsigned keylen = (unsigned)key->slen;
+    pj_uint32_t h = get_hash_seed();
+    pj_uint32_t tail = 0;
+    unsigned i, nwords;
+
+    nwords = keylen / 4;
+    for (i=0; i<nwords; ++i, p+=4) {
+	pj_uint32_t k = tolower32(load32(p));
+	if (result) {
+	    pj_memcpy(result, &k, sizeof(k));
+	    result += 4;
+	}
+	h = murmur_mix(h, k);
+    }
+
+    for (i=keylen & 3; i>0; --i) {
+	pj_uint8_t c = p[i-1];
+	if (c >= 'A' && c <= 'Z')
+	    c |= 0x20;
+	if (result)
+	    result[i-1] = (char)c;
+	tail = (tail << 8) | c;
+    }
+
+    return murmur_final(h, tail, keylen);
+}
+
+
 PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
+{
+    return pj_hash_create2(pool, size, 0);
+}
+
+PJ_DEF(pj_hash_table_t*) pj_hash_create2(pj_pool_t *pool, unsigned size,
+					 unsigned options)
 {
     pj_hash_table_t *h;
     unsigned table_size;
@@ -96,8 +269,9 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     /* Check that PJ_HASH_ENTRY_BUF_SIZE is correct. */
     PJ_ASSERT_RETURN(sizeof(pj_hash_entry)<=PJ_HASH_ENTRY_BUF_SIZE, NULL);
 
-    h = PJ_POOL_ALLOC_T(pool, pj_hash_table_t);
+    h = PJ_POOL_ZALLOC_T(pool, pj_hash_table_t);
     h->count = 0;
+    h->pool = (options & PJ_HASH_GROWABLE) ? pool : NULL;
 
     PJ_LOG( 6, ("hashtbl", "hash table %p created from pool %s", h, pj_pool_getobjname(pool)));
 
@@ -117,6 +291,77 @@ PJ_DEF(pj_hash_table_t*) pj_hash_create(pj_pool_t *pool, unsigned size)
     return h;
 }
 
+/* Migrate some buckets of the old bucket array to the current one. */
+static void rehash_step(pj_hash_table_t *ht, unsigned count)
+{
+    while (count-- && ht->rehash_idx <= ht->old_rows) {
+	pj_hash_entry *entry = ht->old_table[ht->rehash_idx];
+
+	while (entry) {
+	    pj_hash_entry *next = entry->next;
+	    pj_hash_entry **bucket = &ht->table[entry->hash & ht->rows];
+
+	    entry->next = *bucket;
+	    *bucket = entry;
+	    entry = next;
+	}
+	ht->old_table[ht->rehash_idx++] = NULL;
+    }
+
+    if (ht->rehash_idx > ht->old_rows)
+	ht->old_table = NULL;
+}
+
+/* Double the number of buckets. The entries are migrated to the new
+ * bucket array gradually by subsequent insertions, see rehash_step().
+ */
+static void start_resize(pj_hash_table_t *ht)
+{
+    pj_hash_entry **table;
+    unsigned rows = ht->rows * 2 + 1;
+
+    /* Finish the previous resize first (shouldn't happen normally) */
+    if (ht->old_table)
+	rehash_step(ht, ht->old_rows + 1);
+
+    table = (pj_hash_entry**)
+	    pj_pool_calloc(ht->pool, rows + 1, sizeof(pj_hash_entry*));
+    if (!table)
+	return;
+
+    PJ_LOG(6, ("hashtbl", "%p: resizing from %u to %u buckets", ht,
+	       ht->rows + 1, rows + 1));
+
+    ht->old_table = ht->table;
+    ht->old_rows = ht->rows;
+    ht->rehash_idx = 0;
+    ht->table = table;
+    ht->rows = rows;
+}
+
+/* Find the entry with the specified key in a bucket. Returns pointer to
+ * the link pointing to the entry, or to the tail of the bucket if not
+ * found.
+ */
+static pj_hash_entry **scan_bucket( pj_hash_entry **p_entry,
+				    const void *key, unsigned keylen,
+				    pj_uint32_t hash, pj_bool_t lower)
+{
+    pj_hash_entry *entry;
+
+    for (entry=*p_entry; entry; p_entry = &entry->next, entry = *p_entry) {
+	if (entry->hash==hash && entry->keylen==keylen &&
+            ((lower && pj_ansi_strnicmp((const char*)entry->key,
+        			        (const char*)key, keylen)==0) ||
+	     (!lower && pj_memcmp(entry->key, key, keylen)==0)))
+	{
+	    break;
+	}
+    }
+
+    return p_entry;
+}
+
 static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht, 
 				   const void *key, unsigned keylen,
 				   void *val, pj_uint32_t *hval,
@@ -125,34 +370,20 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     pj_uint32_t hash;
     pj_hash_entry **p_entry, *entry;
 
+    if (keylen==PJ_HASH_KEY_STRING) {
+	keylen = (unsigned)pj_ansi_strlen((const char*)key);
+    }
+
     if (hval && *hval != 0) {
 	hash = *hval;
-	if (keylen==PJ_HASH_KEY_STRING) {
-	    keylen = (unsigned)pj_ansi_strlen((const char*)key);
-	}
     } else {
-	/* This slightly differs with pj_hash_calc() because we need 
-	 * to get the keylen when keylen is PJ_HASH_KEY_STRING.
-	 */
-	hash=0;
-	if (keylen==PJ_HASH_KEY_STRING) {
-	    const pj_uint8_t *p = (const pj_uint8_t*)key;
-	    for ( ; *p; ++p ) {
-                if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else 
-		    hash = hash * PJ_HASH_MULTIPLIER + *p;
-	    }
-	    keylen = (unsigned)(p - (const unsigned char*)key);
+	if (lower) {
+	    pj_str_t str;
+	    str.ptr = (char*)key;
+	    str.slen = keylen;
+	    hash = pj_hash_calc_seeded_tolower(NULL, &str);
 	} else {
-	    const pj_uint8_t *p = (const pj_uint8_t*)key,
-				  *end = p + keylen;
-	    for ( ; p!=end; ++p) {
-		if (lower)
-                    hash = hash * PJ_HASH_MULTIPLIER + pj_tolower(*p);
-                else
-                    hash = hash * PJ_HASH_MULTIPLIER + *p;
-	    }
+	    hash = pj_hash_calc_seeded(key, keylen);
 	}
 
 	/* Report back the computed hash. */
@@ -161,22 +392,38 @@ static pj_hash_entry **find_entry( pj_pool_t *pool, pj_hash_table_t *ht,
     }
 
     /* scan the linked list */
-    for (p_entry = &ht->table[hash & ht->rows], entry=*p_entry; 
-	 entry; 
-	 p_entry = &entry->next, entry = *p_entry)
+    p_entry = scan_bucket(&ht->table[hash & ht->rows], key, keylen, hash,
+			  lower);
+
+    /* The entry may still be in the old buckets while resizing */
+    if (*p_entry == NULL && ht->old_table &&
+	(hash & ht->old_rows) >= ht->rehash_idx)
     {
-	if (entry->hash==hash && entry->keylen==keylen &&
-            ((lower && pj_ansi_strnicmp((const char*)entry->key,
-        			        (const char*)key, keylen)==0) ||
-	     (!lower && pj_memcmp(entry->key, key, keylen)==0)))
-	{
-	    break;
-	}
+	pj_hash_entry **p_old;
+
+	p_old = scan_bucket(&ht->old_table[hash & ht->old_rows], key, keylen,
+			    hash, lower);
+	if (*p_old)
+	    p_entry = p_old;
     }
 
-    if (entry || val==NULL)
+    if (*p_entry || val==NULL)
 	return p_entry;
 
+    /* Continue resizing, or start a new one when the average chain length
+     * goes above one, before adding new entry to a growable table.
+     */
+    if (ht->pool) {
+	if (ht->old_table)
+	    rehash_step(ht, REHASH_STEP);
+	else if (ht->count > ht->rows)
+	    start_resize(ht);
+
+	for (p_entry = &ht->table[hash & ht->rows]; *p_entry;
+	     p_entry = &(*p_entry)->next)
+	    ;
+    }
+
     /* Entry not found, create a new one. 
      * If entry_buf is specified, use it. Otherwise allocate from pool.
      */
@@ -287,14 +534,20 @@ PJ_DEF(unsigned) pj_hash_count( pj_hash_table_t *ht )
     return ht->count;
 }
 
-PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
-					   pj_hash_iterator_t *it )
+/* Find the next non-empty bucket starting from the iterator's index. While
+ * resizing, the index covers the old buckets followed by the new buckets.
+ */
+static pj_hash_iterator_t *find_bucket( pj_hash_table_t *ht,
+					pj_hash_iterator_t *it )
 {
-    it->index = 0;
-    it->entry = NULL;
+    unsigned old_cnt = ht->old_table ? ht->old_rows + 1 : 0;
 
-    for (; it->index <= ht->rows; ++it->index) {
-	it->entry = ht->table[it->index];
+    it->entry = NULL;
+    for (; it->index < old_cnt + ht->rows + 1; ++it->index) {
+	if (it->index < old_cnt)
+	    it->entry = ht->old_table[it->index];
+	else
+	    it->entry = ht->table[it->index - old_cnt];
 	if (it->entry) {
 	    break;
 	}
@@ -303,6 +556,13 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
     return it->entry ? it : NULL;
 }
 
+PJ_DEF(pj_hash_iterator_t*) pj_hash_first( pj_hash_table_t *ht,
+					   pj_hash_iterator_t *it )
+{
+    it->index = 0;
+    return find_bucket(ht, it);
+}
+
 PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht, 
 					  pj_hash_iterator_t *it )
 {
@@ -311,14 +571,8 @@ PJ_DEF(pj_hash_iterator_t*) pj_hash_next( pj_hash_table_t *ht,
 	return it;
     }
 
-    for (++it->index; it->index <= ht->rows; ++it->index) {
-	it->entry = ht->table[it->index];
-	if (it->entry) {
-	    break;
-	}
-    }
-
-    return it->entry ? it : NULL;
+    ++it->index;
+    return find_bucket(ht, it);
 }
 
 PJ_DEF(void*) pj_hash_this( pj_hash_table_t *ht, pj_hash_iterator_t *it )
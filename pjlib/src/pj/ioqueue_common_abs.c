@@ -88,6 +88,8 @@ static pj_status_t ioqueue_init_key( pj_pool_t *pool,
     pj_list_init(&key->accept_list);
     key->connecting = 0;
 #endif
+    key->recv_batch = 0;
+    key->send_batch = 0;
 
     /* Save callback. */
     pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
@@ -189,6 +191,113 @@ PJ_INLINE(int) key_has_pending_connect(pj_ioqueue_key_t *key)
 #endif
 
 
+#if PJ_IOQUEUE_HAS_SENDMMSG
+/*
+ * ioqueue_dispatch_write_batch()
+ *
+ * Send up to h->send_batch queued datagrams with a single sendmmsg()
+ * call. Caller must hold the key's lock, which will be released by this
+ * function.
+ */
+static void ioqueue_dispatch_write_batch( pj_ioqueue_t *ioqueue,
+				          pj_ioqueue_key_t *h )
+{
+    struct write_operation *write_op[PJ_IOQUEUE_MAX_SEND_BATCH];
+    struct mmsghdr msg[PJ_IOQUEUE_MAX_SEND_BATCH];
+    struct iovec iov[PJ_IOQUEUE_MAX_SEND_BATCH];
+    struct write_operation *op;
+    unsigned flags, max_cnt, cnt, done, i;
+    pj_bool_t has_lock;
+    int n;
+
+    max_cnt = h->send_batch;
+    if (max_cnt > PJ_IOQUEUE_MAX_SEND_BATCH)
+	max_cnt = PJ_IOQUEUE_MAX_SEND_BATCH;
+
+    /* Collect queued write operations which have the same flags. */
+    op = h->write_list.next;
+    flags = op->flags;
+    for (cnt=0; cnt<max_cnt && op != &h->write_list; ++cnt) {
+	struct write_operation *next = op->next;
+
+	if ((op->op != PJ_IOQUEUE_OP_SEND_TO &&
+	     op->op != PJ_IOQUEUE_OP_SEND) || op->flags != flags)
+	{
+	    break;
+	}
+
+	pj_list_erase(op);
+	write_op[cnt] = op;
+
+	iov[cnt].iov_base = op->buf;
+	iov[cnt].iov_len = op->size;
+
+	pj_bzero(&msg[cnt], sizeof(msg[cnt]));
+	if (op->op == PJ_IOQUEUE_OP_SEND_TO) {
+	    msg[cnt].msg_hdr.msg_name = &op->rmt_addr;
+	    msg[cnt].msg_hdr.msg_namelen = op->rmt_addrlen;
+	}
+	msg[cnt].msg_hdr.msg_iov = &iov[cnt];
+	msg[cnt].msg_hdr.msg_iovlen = 1;
+
+	op = next;
+    }
+
+    pj_assert(cnt > 0);
+
+    n = sendmmsg(h->fd, msg, cnt, flags);
+    if (n > 0) {
+	done = n;
+	for (i=0; i<done; ++i)
+	    write_op[i]->written = msg[i].msg_len;
+    } else {
+	/* Report the error to the first operation only, as it would be
+	 * without batching.
+	 */
+	done = 1;
+	write_op[0]->written = -pj_get_netos_error();
+    }
+
+    for (i=0; i<done; ++i)
+	write_op[i]->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Put back operations that haven't been sent, preserving order. */
+    for (i=cnt; i>done; --i)
+	pj_list_insert_after(&h->write_list, write_op[i-1]);
+
+    /* Clear operation if there's no more data to send. */
+    if (pj_list_empty(&h->write_list))
+	ioqueue_remove_from_set(ioqueue, h, WRITEABLE_EVENT);
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback for each completed operation. */
+    for (i=0; i<done; ++i) {
+	if (!h->cb.on_write_complete || IS_CLOSING(h))
+	    break;
+
+	(*h->cb.on_write_complete)(h, (pj_ioqueue_op_key_t*)write_op[i],
+				   write_op[i]->written);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+}
+#endif	/* PJ_IOQUEUE_HAS_SENDMMSG */
+
 /*
  * ioqueue_dispatch_event()
  *
@@ -294,6 +403,13 @@ pj_bool_t ioqueue_dispatch_write_event( pj_ioqueue_t *ioqueue,
 
     } else 
 #endif /* PJ_HAS_TCP */
+#if PJ_IOQUEUE_HAS_SENDMMSG
+    if (h->send_batch > 1 && key_has_pending_write(h) &&
+	h->fd_type == pj_SOCK_DGRAM())
+    {
+	ioqueue_dispatch_write_batch(ioqueue, h);
+    } else
+#endif
     if (key_has_pending_write(h)) {
 	/* Socket is writable. */
         struct write_operation *write_op;
@@ -430,6 +546,121 @@ pj_bool_t ioqueue_dispatch_write_event( pj_ioqueue_t *ioqueue,
     return PJ_TRUE;
 }
 
+#if PJ_IOQUEUE_HAS_RECVMMSG
+/*
+ * ioqueue_dispatch_read_batch()
+ *
+ * Complete up to h->recv_batch pending recv()/recvfrom() operations with
+ * a single recvmmsg() call. Caller must hold the key's lock, which will
+ * be released by this function.
+ */
+static void ioqueue_dispatch_read_batch( pj_ioqueue_t *ioqueue,
+				         pj_ioqueue_key_t *h )
+{
+    struct read_operation *read_op[PJ_IOQUEUE_MAX_RECV_BATCH];
+    struct mmsghdr msg[PJ_IOQUEUE_MAX_RECV_BATCH];
+    struct iovec iov[PJ_IOQUEUE_MAX_RECV_BATCH];
+    pj_ssize_t bytes_read[PJ_IOQUEUE_MAX_RECV_BATCH];
+    struct read_operation *op;
+    unsigned flags, max_cnt, cnt, done, i;
+    pj_bool_t has_lock;
+    int n;
+
+    max_cnt = h->recv_batch;
+    if (max_cnt > PJ_IOQUEUE_MAX_RECV_BATCH)
+	max_cnt = PJ_IOQUEUE_MAX_RECV_BATCH;
+
+    /* Collect pending read operations which have the same flags. */
+    op = h->read_list.next;
+    flags = op->flags;
+    for (cnt=0; cnt<max_cnt && op != &h->read_list; ++cnt) {
+	struct read_operation *next = op->next;
+
+	if ((op->op != PJ_IOQUEUE_OP_RECV_FROM &&
+	     op->op != PJ_IOQUEUE_OP_RECV) || op->flags != flags)
+	{
+	    break;
+	}
+
+	pj_list_erase(op);
+	read_op[cnt] = op;
+
+	iov[cnt].iov_base = op->buf;
+	iov[cnt].iov_len = op->size;
+
+	pj_bzero(&msg[cnt], sizeof(msg[cnt]));
+	if (op->op == PJ_IOQUEUE_OP_RECV_FROM && op->rmt_addr &&
+	    op->rmt_addrlen)
+	{
+	    msg[cnt].msg_hdr.msg_name = op->rmt_addr;
+	    msg[cnt].msg_hdr.msg_namelen = *op->rmt_addrlen;
+	}
+	msg[cnt].msg_hdr.msg_iov = &iov[cnt];
+	msg[cnt].msg_hdr.msg_iovlen = 1;
+
+	op = next;
+    }
+
+    pj_assert(cnt > 0);
+
+    n = recvmmsg(h->fd, msg, cnt, flags, NULL);
+    if (n > 0) {
+	done = n;
+	for (i=0; i<done; ++i) {
+	    bytes_read[i] = msg[i].msg_len;
+	    if (msg[i].msg_hdr.msg_name) {
+		*read_op[i]->rmt_addrlen = msg[i].msg_hdr.msg_namelen;
+		PJ_SOCKADDR_RESET_LEN(read_op[i]->rmt_addr);
+	    }
+	}
+    } else {
+	/* Report the error to the first operation only, as it would be
+	 * without batching.
+	 */
+	done = 1;
+	bytes_read[0] = -pj_get_netos_error();
+    }
+
+    for (i=0; i<done; ++i)
+	read_op[i]->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Put back operations that didn't get any data, preserving order. */
+    for (i=cnt; i>done; --i)
+	pj_list_insert_after(&h->read_list, read_op[i-1]);
+
+    /* Clear fdset if there is no pending read. */
+    if (pj_list_empty(&h->read_list))
+	ioqueue_remove_from_set(ioqueue, h, READABLE_EVENT);
+
+    /* Unlock; from this point we don't need to hold key's mutex
+     * (unless concurrency is disabled, which in this case we should
+     * hold the mutex while calling the callback) */
+    if (h->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	has_lock = PJ_FALSE;
+	pj_ioqueue_unlock_key(h);
+	PJ_RACE_ME(5);
+    } else {
+	has_lock = PJ_TRUE;
+    }
+
+    /* Call callback for each completed operation. */
+    for (i=0; i<done; ++i) {
+	if (!h->cb.on_read_complete || IS_CLOSING(h))
+	    break;
+
+	(*h->cb.on_read_complete)(h, (pj_ioqueue_op_key_t*)read_op[i],
+				  bytes_read[i]);
+    }
+
+    if (has_lock) {
+	pj_ioqueue_unlock_key(h);
+    }
+}
+#endif	/* PJ_IOQUEUE_HAS_RECVMMSG */
+
 pj_bool_t ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue,
 				       pj_ioqueue_key_t *h )
 {
@@ -461,8 +692,9 @@ pj_bool_t ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue,
         if (pj_list_empty(&h->accept_list))
             ioqueue_remove_from_set(ioqueue, h, READABLE_EVENT);
 
-	rc=pj_sock_accept(h->fd, accept_op->accept_fd, 
-                          accept_op->rmt_addr, accept_op->addrlen);
+	rc=pj_sock_accept2(h->fd, accept_op->accept_fd, 
+                           accept_op->rmt_addr, accept_op->addrlen,
+                           PJ_SOCK_ACCEPT_NONBLOCK | PJ_SOCK_ACCEPT_CLOEXEC);
 	if (rc==PJ_SUCCESS && accept_op->local_addr) {
 	    rc = pj_sock_getsockname(*accept_op->accept_fd, 
                                      accept_op->local_addr,
@@ -495,6 +727,19 @@ pj_bool_t ioqueue_dispatch_read_event( pj_ioqueue_t *ioqueue,
 	}
     }
     else
+#   endif
+#   if PJ_IOQUEUE_HAS_RECVMMSG
+    /* Only batch when the first pending read is a recv()/recvfrom(),
+     * otherwise there is nothing to collect for recvmmsg().
+     */
+    if (h->recv_batch > 1 && key_has_pending_read(h) &&
+	h->fd_type == pj_SOCK_DGRAM() &&
+	(h->read_list.next->op == PJ_IOQUEUE_OP_RECV ||
+	 h->read_list.next->op == PJ_IOQUEUE_OP_RECV_FROM))
+    {
+	ioqueue_dispatch_read_batch(ioqueue, h);
+    }
+    else
 #   endif
     if (key_has_pending_read(h)) {
         struct read_operation *read_op;
@@ -976,6 +1221,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
     struct write_operation *write_op;
     unsigned retry;
     pj_bool_t restart_retry = PJ_FALSE;
+    pj_bool_t defer;
     pj_status_t status;
     pj_ssize_t sent;
 
@@ -992,8 +1238,15 @@ retry_on_restart:
     if (IS_CLOSING(key))
 	return PJ_ECANCELLED;
 
+    /* Queue the datagram if batched send is requested and enabled */
+#if PJ_IOQUEUE_HAS_SENDMMSG
+    defer = (flags & PJ_IOQUEUE_BATCH_SEND) && key->send_batch > 1;
+#else
+    defer = PJ_FALSE;
+#endif
+
     /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write */
-    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC | PJ_IOQUEUE_BATCH_SEND);
 
     /* Fast track:
      *   Try to send data immediately, only if there's no pending write!
@@ -1009,7 +1262,7 @@ retry_on_restart:
      *      - pj_list_empty() is safe to be invoked by multiple threads,
      *        even when other threads are modifying the list.
      */
-    if (pj_list_empty(&key->write_list)) {
+    if (!defer && pj_list_empty(&key->write_list)) {
         /*
          * See if data can be sent immediately.
          */
@@ -1098,8 +1351,13 @@ retry_on_restart:
 	pj_ioqueue_unlock_key(key);
 	return PJ_ECANCELLED;
     }
+    /* The descriptor is already in the write set if there are other
+     * pending writes, so avoid the (possibly expensive) update when
+     * datagrams are being queued for batched send.
+     */
+    if (!defer || pj_list_empty(&key->write_list))
+	ioqueue_add_to_set(key->ioqueue, key, WRITEABLE_EVENT);
     pj_list_insert_before(&key->write_list, write_op);
-    ioqueue_add_to_set(key->ioqueue, key, WRITEABLE_EVENT);
     pj_ioqueue_unlock_key(key);
 
     return PJ_EPENDING;
@@ -1133,7 +1391,9 @@ PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
      *  See if there's new connection available immediately.
      */
     if (pj_list_empty(&key->accept_list)) {
-        status = pj_sock_accept(key->fd, new_sock, remote, addrlen);
+        status = pj_sock_accept2(key->fd, new_sock, remote, addrlen,
+                                 PJ_SOCK_ACCEPT_NONBLOCK |
+                                 PJ_SOCK_ACCEPT_CLOEXEC);
         if (status == PJ_SUCCESS) {
             /* Yes! New connection is available! */
             if (local && addrlen) {
@@ -1341,6 +1601,40 @@ PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pj_ioqueue_set_send_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+#if PJ_IOQUEUE_HAS_SENDMMSG
+    if (max_cnt > PJ_IOQUEUE_MAX_SEND_BATCH)
+	max_cnt = PJ_IOQUEUE_MAX_SEND_BATCH;
+
+    key->send_batch = max_cnt;
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(max_cnt);
+    return PJ_ENOTSUP;
+#endif
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_recv_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+#if PJ_IOQUEUE_HAS_RECVMMSG
+    if (max_cnt > PJ_IOQUEUE_MAX_RECV_BATCH)
+	max_cnt = PJ_IOQUEUE_MAX_RECV_BATCH;
+
+    key->recv_batch = max_cnt;
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(max_cnt);
+    return PJ_ENOTSUP;
+#endif
+}
+
 PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
 {
     if (key->grp_lock)
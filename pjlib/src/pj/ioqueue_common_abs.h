@@ -111,6 +111,8 @@ union operation_key
     void		   *user_data;              \
     pj_ioqueue_callback	    cb;                     \
     int                     connecting;             \
+    unsigned		    recv_batch;		    \
+    unsigned		    send_batch;		    \
     struct read_operation   read_list;              \
     struct write_operation  write_list;             \
     struct accept_operation accept_list;	    \
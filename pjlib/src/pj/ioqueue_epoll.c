@@ -24,6 +24,10 @@
  * API in _both_ Linux user-mode and kernel-mode.
  */
 
+/* Needed for recvmmsg() */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
 #include <pj/ioqueue.h>
 #include <pj/os.h>
 #include <pj/lock.h>
@@ -157,6 +161,7 @@
 struct pj_ioqueue_key_t
 {
     DECLARE_COMMON_KEY
+    unsigned		    shard;
 };
 
 struct queue
@@ -179,6 +184,15 @@ struct pj_ioqueue_t
     //struct epoll_event *events;
     //struct queue       *queue;
 
+    /* Shards. Each shard has its own epoll descriptor. When there is only
+     * one shard, it uses epfd above, otherwise the shard descriptors are
+     * registered to epfd so that polling epfd will poll all shards.
+     */
+    unsigned		shard_cnt;
+    unsigned		next_shard;
+    int			shard_epfd[PJ_IOQUEUE_MAX_SHARDS];
+    long		thread_shard_id;
+
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     pj_mutex_t	       *ref_cnt_mutex;
     pj_ioqueue_key_t	closing_list;
@@ -196,6 +210,9 @@ struct pj_ioqueue_t
 static void scan_closing_keys(pj_ioqueue_t *ioqueue);
 #endif
 
+/* Get the epoll descriptor of the shard where the key is registered */
+#define KEY_EPFD(key)	((key)->ioqueue->shard_epfd[(key)->shard])
+
 /*
  * pj_ioqueue_name()
  */
@@ -211,11 +228,82 @@ PJ_DEF(const char*) pj_ioqueue_name(void)
 /*
  * pj_ioqueue_create()
  *
- * Create select ioqueue.
+ * Create epoll ioqueue.
  */
 PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool, 
                                        pj_size_t max_fd,
                                        pj_ioqueue_t **p_ioqueue)
+{
+    return pj_ioqueue_create_sharded(pool, max_fd, 1, p_ioqueue);
+}
+
+/* Close the shard descriptors */
+static void destroy_shards(pj_ioqueue_t *ioqueue)
+{
+    unsigned i;
+
+    if (ioqueue->shard_cnt > 1) {
+	for (i=0; i<ioqueue->shard_cnt; ++i) {
+	    if (ioqueue->shard_epfd[i] > 0)
+		os_close(ioqueue->shard_epfd[i]);
+	    ioqueue->shard_epfd[i] = 0;
+	}
+	if (ioqueue->thread_shard_id != -1) {
+	    pj_thread_local_free(ioqueue->thread_shard_id);
+	    ioqueue->thread_shard_id = -1;
+	}
+    }
+}
+
+/* Create the shard descriptors, or just use the main descriptor when
+ * there is only one shard.
+ */
+static pj_status_t create_shards(pj_ioqueue_t *ioqueue, pj_size_t max_fd)
+{
+    unsigned i;
+    pj_status_t rc;
+
+    if (ioqueue->shard_cnt == 1) {
+	ioqueue->shard_epfd[0] = ioqueue->epfd;
+	return PJ_SUCCESS;
+    }
+
+    rc = pj_thread_local_alloc(&ioqueue->thread_shard_id);
+    if (rc != PJ_SUCCESS)
+	return rc;
+
+    for (i=0; i<ioqueue->shard_cnt; ++i) {
+	struct epoll_event ev;
+
+	ioqueue->shard_epfd[i] = os_epoll_create(max_fd);
+	if (ioqueue->shard_epfd[i] < 0) {
+	    rc = PJ_RETURN_OS_ERROR(pj_get_native_os_error());
+	    ioqueue->shard_epfd[i] = 0;
+	    destroy_shards(ioqueue);
+	    return rc;
+	}
+
+	ev.events = EPOLLIN;
+	ev.epoll_data = (epoll_data_type)&ioqueue->shard_epfd[i];
+	if (os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, ioqueue->shard_epfd[i],
+			 &ev) < 0)
+	{
+	    rc = pj_get_os_error();
+	    destroy_shards(ioqueue);
+	    return rc;
+	}
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_create_sharded()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create_sharded( pj_pool_t *pool,
+					       pj_size_t max_fd,
+					       unsigned shard_cnt,
+					       pj_ioqueue_t **p_ioqueue)
 {
     pj_ioqueue_t *ioqueue;
     pj_status_t rc;
@@ -225,6 +313,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     /* Check that arguments are valid. */
     PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL && 
                      max_fd > 0, PJ_EINVAL);
+    PJ_ASSERT_RETURN(shard_cnt <= PJ_IOQUEUE_MAX_SHARDS, PJ_ETOOMANY);
 
     /* Check that size of pj_ioqueue_op_key_t is sufficient */
     PJ_ASSERT_RETURN(sizeof(pj_ioqueue_op_key_t)-sizeof(void*) >=
@@ -237,6 +326,9 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     ioqueue->max = max_fd;
     ioqueue->count = 0;
     pj_list_init(&ioqueue->active_list);
+    ioqueue->shard_cnt = shard_cnt ? shard_cnt : 1;
+    ioqueue->next_shard = 0;
+    ioqueue->thread_shard_id = -1;
 
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* When safe unregistration is used (the default), we pre-create
@@ -291,6 +383,13 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
 	ioqueue_destroy(ioqueue);
 	return PJ_RETURN_OS_ERROR(pj_get_native_os_error());
     }
+
+    rc = create_shards(ioqueue, max_fd);
+    if (rc != PJ_SUCCESS) {
+	os_close(ioqueue->epfd);
+	ioqueue_destroy(ioqueue);
+	return rc;
+    }
     
     /*ioqueue->events = pj_pool_calloc(pool, max_fd, sizeof(struct epoll_event));
     PJ_ASSERT_RETURN(ioqueue->events != NULL, PJ_ENOMEM);
@@ -298,7 +397,8 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     ioqueue->queue = pj_pool_calloc(pool, max_fd, sizeof(struct queue));
     PJ_ASSERT_RETURN(ioqueue->queue != NULL, PJ_ENOMEM);
    */
-    PJ_LOG(4, ("pjlib", "epoll I/O Queue created (%p)", ioqueue));
+    PJ_LOG(4, ("pjlib", "epoll I/O Queue created (%p), %d shard(s)", ioqueue,
+	       ioqueue->shard_cnt));
 
     *p_ioqueue = ioqueue;
     return PJ_SUCCESS;
@@ -317,6 +417,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
     PJ_ASSERT_RETURN(ioqueue->epfd > 0, PJ_EINVALIDOP);
 
     pj_lock_acquire(ioqueue->lock);
+    destroy_shards(ioqueue);
     os_close(ioqueue->epfd);
     ioqueue->epfd = 0;
 
@@ -418,10 +519,14 @@ PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
 	goto on_return;
     }
 */
+    /* Assign the key to the shards in round-robin fashion */
+    key->shard = ioqueue->next_shard;
+    ioqueue->next_shard = (ioqueue->next_shard + 1) % ioqueue->shard_cnt;
+
     /* os_epoll_ctl. */
     ev.events = EPOLLIN | EPOLLERR;
     ev.epoll_data = (epoll_data_type)key;
-    status = os_epoll_ctl(ioqueue->epfd, EPOLL_CTL_ADD, sock, &ev);
+    status = os_epoll_ctl(KEY_EPFD(key), EPOLL_CTL_ADD, sock, &ev);
     if (status < 0) {
 	rc = pj_get_os_error();
 	pj_lock_destroy(key->lock);
@@ -527,7 +632,7 @@ PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
 
     ev.events = 0;
     ev.epoll_data = (epoll_data_type)key;
-    status = os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_DEL, key->fd, &ev);
+    status = os_epoll_ctl( KEY_EPFD(key), EPOLL_CTL_DEL, key->fd, &ev);
     if (status != 0) {
 	pj_status_t rc = pj_get_os_error();
 	pj_lock_release(ioqueue->lock);
@@ -590,12 +695,14 @@ static void ioqueue_remove_from_set( pj_ioqueue_t *ioqueue,
                                      pj_ioqueue_key_t *key, 
                                      enum ioqueue_event_type event_type)
 {
+    PJ_UNUSED_ARG(ioqueue);
+
     if (event_type == WRITEABLE_EVENT) {
 	struct epoll_event ev;
 
 	ev.events = EPOLLIN | EPOLLERR;
 	ev.epoll_data = (epoll_data_type)key;
-	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_MOD, key->fd, &ev);
+	os_epoll_ctl( KEY_EPFD(key), EPOLL_CTL_MOD, key->fd, &ev);
     }	
 }
 
@@ -609,12 +716,14 @@ static void ioqueue_add_to_set( pj_ioqueue_t *ioqueue,
                                 pj_ioqueue_key_t *key,
                                 enum ioqueue_event_type event_type )
 {
+    PJ_UNUSED_ARG(ioqueue);
+
     if (event_type == WRITEABLE_EVENT) {
 	struct epoll_event ev;
 
 	ev.events = EPOLLIN | EPOLLOUT | EPOLLERR;
 	ev.epoll_data = (epoll_data_type)key;
-	os_epoll_ctl( ioqueue->epfd, EPOLL_CTL_MOD, key->fd, &ev);
+	os_epoll_ctl( KEY_EPFD(key), EPOLL_CTL_MOD, key->fd, &ev);
     }	
 }
 
@@ -646,13 +755,14 @@ static void scan_closing_keys(pj_ioqueue_t *ioqueue)
 #endif
 
 /*
- * pj_ioqueue_poll()
+ * ioqueue_poll_epfd()
  *
+ * Poll the specified epoll descriptor, which is either the main descriptor
+ * or a shard's descriptor.
  */
-PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+static int ioqueue_poll_epfd( pj_ioqueue_t *ioqueue, int epfd, int msec)
 {
     int i, count, event_cnt, processed_cnt;
-    int msec;
     //struct epoll_event *events = ioqueue->events;
     //struct queue *queue = ioqueue->queue;
     enum { MAX_EVENTS = PJ_IOQUEUE_MAX_CAND_EVENTS };
@@ -662,13 +772,11 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     
     PJ_CHECK_STACK();
 
-    msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
-
     TRACE_((THIS_FILE, "start os_epoll_wait, msec=%d", msec));
     pj_get_timestamp(&t1);
  
     //count = os_epoll_wait( ioqueue->epfd, events, ioqueue->max, msec);
-    count = os_epoll_wait( ioqueue->epfd, events, MAX_EVENTS, msec);
+    count = os_epoll_wait( epfd, events, MAX_EVENTS, msec);
     if (count == 0) {
 #if PJ_IOQUEUE_HAS_SAFE_UNREG
     /* Check the closing keys only when there's no activity and when there are
@@ -836,3 +944,134 @@ PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
     return processed_cnt;
 }
 
+/*
+ * pj_ioqueue_poll()
+ *
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    struct epoll_event events[PJ_IOQUEUE_MAX_SHARDS];
+    int i, count, msec, processed_cnt;
+    void *thread_shard;
+
+    msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
+
+    if (ioqueue->shard_cnt == 1)
+	return ioqueue_poll_epfd(ioqueue, ioqueue->epfd, msec);
+
+    /* Only poll the thread's own shard if it's bound to one */
+    thread_shard = pj_thread_local_get(ioqueue->thread_shard_id);
+    if (thread_shard) {
+	unsigned shard = (unsigned)(pj_ssize_t)thread_shard - 1;
+	return ioqueue_poll_epfd(ioqueue, ioqueue->shard_epfd[shard], msec);
+    }
+
+    /* Otherwise wait for any shard to become ready and poll it */
+    count = os_epoll_wait(ioqueue->epfd, events, ioqueue->shard_cnt, msec);
+    if (count < 0)
+	return -pj_get_netos_error();
+
+    if (count == 0) {
+#if PJ_IOQUEUE_HAS_SAFE_UNREG
+	if (!pj_list_empty(&ioqueue->closing_list)) {
+	    pj_lock_acquire(ioqueue->lock);
+	    scan_closing_keys(ioqueue);
+	    pj_lock_release(ioqueue->lock);
+	}
+#endif
+	return 0;
+    }
+
+    processed_cnt = 0;
+    for (i=0; i<count; ++i) {
+	int *epfd = (int*)(epoll_data_type)events[i].epoll_data;
+	int rc;
+
+	rc = ioqueue_poll_epfd(ioqueue, *epfd, 0);
+	if (rc > 0)
+	    processed_cnt += rc;
+    }
+
+    return processed_cnt;
+}
+
+/*
+ * pj_ioqueue_get_shard_count()
+ */
+PJ_DEF(unsigned) pj_ioqueue_get_shard_count(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, 0);
+    return ioqueue->shard_cnt;
+}
+
+/*
+ * pj_ioqueue_set_shard()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_shard(pj_ioqueue_key_t *key,
+					 unsigned shard_hint)
+{
+    pj_ioqueue_t *ioqueue;
+    struct epoll_event ev;
+    unsigned shard;
+    pj_status_t rc = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+    shard = shard_hint % ioqueue->shard_cnt;
+
+    /* The key lock also serializes this with the key's own epoll updates
+     * (ioqueue_add_to_set() etc), which use the current shard.
+     */
+    pj_ioqueue_lock_key(key);
+    pj_lock_acquire(ioqueue->lock);
+
+    if (IS_CLOSING(key)) {
+	rc = PJ_ECANCELLED;
+	goto on_return;
+    }
+
+    if (shard == key->shard)
+	goto on_return;
+
+    ev.events = EPOLLIN | EPOLLERR;
+    if (key_has_pending_write(key) || key_has_pending_connect(key))
+	ev.events |= EPOLLOUT;
+    ev.epoll_data = (epoll_data_type)key;
+
+    if (os_epoll_ctl(ioqueue->shard_epfd[shard], EPOLL_CTL_ADD, key->fd,
+		     &ev) < 0)
+    {
+	rc = pj_get_os_error();
+	goto on_return;
+    }
+    os_epoll_ctl(KEY_EPFD(key), EPOLL_CTL_DEL, key->fd, &ev);
+    key->shard = shard;
+
+on_return:
+    pj_lock_release(ioqueue->lock);
+    pj_ioqueue_unlock_key(key);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_set_thread_shard()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_thread_shard(pj_ioqueue_t *ioqueue,
+						int shard_hint)
+{
+    void *value;
+
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+
+    if (ioqueue->shard_cnt == 1)
+	return PJ_SUCCESS;
+
+    if (shard_hint < 0)
+	value = NULL;
+    else
+	value = (void*)(pj_ssize_t)(shard_hint % ioqueue->shard_cnt + 1);
+
+    return pj_thread_local_set(ioqueue->thread_shard_id, value);
+}
+
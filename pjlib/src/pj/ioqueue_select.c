@@ -26,6 +26,10 @@
  * Win32, Linux, Linux kernel, etc.).
  */
 
+/* Needed for recvmmsg() */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
 #include <pj/ioqueue.h>
 #include <pj/os.h>
 #include <pj/lock.h>
@@ -268,6 +272,43 @@ PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+/*
+ * pj_ioqueue_create_sharded()
+ *
+ * Sharding is not supported by this backend, so just create an ioqueue
+ * with a single shard.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create_sharded( pj_pool_t *pool,
+					       pj_size_t max_fd,
+					       unsigned shard_cnt,
+					       pj_ioqueue_t **p_ioqueue)
+{
+    PJ_ASSERT_RETURN(shard_cnt <= PJ_IOQUEUE_MAX_SHARDS, PJ_ETOOMANY);
+    return pj_ioqueue_create(pool, max_fd, p_ioqueue);
+}
+
+PJ_DEF(unsigned) pj_ioqueue_get_shard_count(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, 0);
+    return 1;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_thread_shard(pj_ioqueue_t *ioqueue,
+						int shard_hint)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_shard(pj_ioqueue_key_t *key,
+					 unsigned shard_hint)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
 /*
  * pj_ioqueue_destroy()
  *
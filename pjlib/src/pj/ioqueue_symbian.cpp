@@ -473,6 +473,43 @@ PJ_DEF(pj_status_t) pj_ioqueue_create(	pj_pool_t *pool,
 }
 
 
+/*
+ * pj_ioqueue_create_sharded()
+ *
+ * Sharding is not supported by this backend, so just create an ioqueue
+ * with a single shard.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create_sharded( pj_pool_t *pool,
+					       pj_size_t max_fd,
+					       unsigned shard_cnt,
+					       pj_ioqueue_t **p_ioqueue)
+{
+    PJ_ASSERT_RETURN(shard_cnt <= PJ_IOQUEUE_MAX_SHARDS, PJ_ETOOMANY);
+    return pj_ioqueue_create(pool, max_fd, p_ioqueue);
+}
+
+PJ_DEF(unsigned) pj_ioqueue_get_shard_count(pj_ioqueue_t *ioqueue)
+{
+    PJ_ASSERT_RETURN(ioqueue, 0);
+    return 1;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_thread_shard(pj_ioqueue_t *ioqueue,
+						int shard_hint)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_shard(pj_ioqueue_key_t *key,
+					 unsigned shard_hint)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
 /*
  * Destroy the I/O queue.
  */
@@ -824,8 +861,8 @@ PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
     if (status != PJ_SUCCESS)
     	return status;
     
-    // Clear flag
-    flags &= ~PJ_IOQUEUE_ALWAYS_ASYNC;
+    // Clear flags (batched send is not supported)
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC | PJ_IOQUEUE_BATCH_SEND);
 
     aBuffer.Set((const TUint8*)data, (TInt)*length);
     CPjSocket *pjSock = key->cbObj->get_pj_socket();
@@ -851,6 +888,24 @@ PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
 	return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pj_ioqueue_set_send_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+	/* Not supported */
+	PJ_UNUSED_ARG(key);
+	PJ_UNUSED_ARG(max_cnt);
+	return PJ_ENOTSUP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_recv_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+	/* Not supported */
+	PJ_UNUSED_ARG(key);
+	PJ_UNUSED_ARG(max_cnt);
+	return PJ_ENOTSUP;
+}
+
 PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
 {
 	/* Not supported, just return PJ_SUCCESS silently */
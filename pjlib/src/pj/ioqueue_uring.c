@@ -0,0 +1,2083 @@
+/* $Id$ */
+/*
+ * Copyright (C) 2008-2011 Teluu Inc. (http://www.teluu.com)
+ * Copyright (C) 2003-2008 Benny Prijono <benny@prijono.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+/*
+ * ioqueue_uring.c
+ *
+ * This is the implementation of IOQueue framework using Linux io_uring.
+ *
+ * Unlike the select() and epoll backends, which wait for the socket to
+ * become ready and then perform the I/O from user space, this backend
+ * submits the socket operations themselves to the kernel and receives
+ * their results in the completion queue. A completed operation therefore
+ * costs no additional system call. Operations which are started from
+ * within a completion callback are not submitted right away, but are
+ * submitted together with a single system call after all callbacks of
+ * the current poll have been called.
+ *
+ * The ring is accessed with raw system calls, so liburing is not needed.
+ */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+#include <pj/ioqueue.h>
+#include <pj/os.h>
+#include <pj/lock.h>
+#include <pj/log.h>
+#include <pj/list.h>
+#include <pj/pool.h>
+#include <pj/string.h>
+#include <pj/assert.h>
+#include <pj/errno.h>
+#include <pj/sock.h>
+#include <pj/compat/socket.h>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if !PJ_IOQUEUE_HAS_SAFE_UNREG
+#   error "io_uring ioqueue requires PJ_IOQUEUE_HAS_SAFE_UNREG"
+#endif
+
+#define THIS_FILE   "ioq_uring"
+
+//#define TRACE_(expr) PJ_LOG(3,expr)
+#define TRACE_(expr)
+
+#define PENDING_RETRY	2
+
+/* Minimum and maximum number of submission queue entries. The actual
+ * number is derived from the maximum number of descriptors.
+ */
+#define MIN_SQ_ENTRIES	64
+#define MAX_SQ_ENTRIES	4096
+
+/* The completion queue is made this many times larger than the
+ * submission queue, since many operations may be in progress at the
+ * same time (e.g. several pending recvfrom() per UDP socket).
+ */
+#define CQ_FACTOR	4
+
+/* Memory barriers for the shared ring indexes */
+#define LOAD_ACQUIRE(p)		__atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)	__atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+/*
+ * The operation record. This is stored in the internal buffer of
+ * pj_ioqueue_op_key_t, and its address is used as the user data of the
+ * submission, so the completion can be associated with it.
+ */
+struct uring_op
+{
+    PJ_DECL_LIST_MEMBER(struct uring_op);
+    pj_ioqueue_operation_e  op;
+    pj_ioqueue_key_t	   *key;
+    unsigned		    seq;	/* Incremented on each submission. */
+    pj_bool_t		    inflight;	/* Owned by the kernel.		   */
+    pj_bool_t		    cancelling;	/* Cancel request has been queued. */
+    char		   *buf;
+    pj_size_t		    size;
+    pj_size_t		    written;
+    unsigned		    flags;
+    pj_sockaddr_t	   *rmt_addr;
+    int			   *rmt_addrlen;
+    pj_sock_t		   *accept_fd;
+    pj_sockaddr_t	   *local_addr;
+    struct msghdr	    msg;
+    struct iovec	    iov;
+    pj_sockaddr		    addr;	/* Destination of sendto().	   */
+    int			    addr_len;
+};
+
+/*
+ * This describes each key.
+ */
+struct pj_ioqueue_key_t
+{
+    PJ_DECL_LIST_MEMBER(struct pj_ioqueue_key_t);
+    pj_ioqueue_t	   *ioqueue;
+    pj_grp_lock_t	   *grp_lock;
+    pj_lock_t		   *lock;
+    pj_bool_t		    allow_concurrent;
+    pj_sock_t		    fd;
+    int			    fd_type;
+    void		   *user_data;
+    pj_ioqueue_callback	    cb;
+    unsigned		    send_batch;
+    struct uring_op	    read_list;
+    struct uring_op	    write_list;
+#if PJ_HAS_TCP
+    struct uring_op	    accept_list;
+    struct uring_op	    connect_op;
+    int			    connecting;
+#endif
+    unsigned		    ref_count;
+    pj_bool_t		    closing;
+    pj_time_val		    free_time;
+};
+
+/*
+ * A completion which has been taken from the completion queue but has
+ * not been dispatched yet. The key's reference counter is held while
+ * the completion is waiting to be dispatched.
+ */
+struct completion
+{
+    pj_ioqueue_key_t	   *key;
+    struct uring_op	   *op;
+    unsigned		    seq;
+    int			    res;
+};
+
+/*
+ * This describes the I/O queue.
+ */
+struct pj_ioqueue_t
+{
+    pj_lock_t		   *lock;
+    pj_bool_t		    auto_delete_lock;
+    pj_bool_t		    default_concurrency;
+
+    unsigned		    max, count;
+    pj_ioqueue_key_t	    active_list;
+    pj_ioqueue_key_t	    closing_list;
+    pj_ioqueue_key_t	    free_list;
+    pj_mutex_t		   *ref_cnt_mutex;
+
+    /* The ring */
+    int			    ring_fd;
+    void		   *sq_ptr;
+    pj_size_t		    sq_ptr_sz;
+    void		   *cq_ptr;
+    pj_size_t		    cq_ptr_sz;
+    struct io_uring_sqe	   *sqes;
+    pj_size_t		    sqes_sz;
+
+    /* Submission queue, protected by sq_mutex */
+    pj_mutex_t		   *sq_mutex;
+    unsigned		   *sq_head;
+    unsigned		   *sq_tail;
+    unsigned		   *sq_array;
+    unsigned		    sq_mask;
+    unsigned		    sq_entries;
+
+    /* Completion queue and backlog, protected by cq_mutex */
+    pj_mutex_t		   *cq_mutex;
+    unsigned		   *cq_head;
+    unsigned		   *cq_tail;
+    unsigned		    cq_mask;
+    struct io_uring_cqe	   *cqes;
+    struct completion	   *backlog;
+    unsigned		    backlog_max;
+    unsigned		    backlog_start;
+    unsigned		    backlog_cnt;
+
+    /* Thread local to mark threads which are dispatching completions */
+    long		    dispatch_tls_id;
+};
+
+static void scan_closing_keys(pj_ioqueue_t *ioqueue);
+
+/*
+ * pj_ioqueue_name()
+ */
+PJ_DEF(const char*) pj_ioqueue_name(void)
+{
+    return "io_uring";
+}
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+			      unsigned min_complete, unsigned flags,
+			      void *arg, pj_size_t argsz)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+			flags, arg, argsz);
+}
+
+/* Unmap the rings and close the ring descriptor */
+static void close_ring(pj_ioqueue_t *ioqueue)
+{
+    if (ioqueue->sqes && ioqueue->sqes != MAP_FAILED)
+	munmap(ioqueue->sqes, ioqueue->sqes_sz);
+    if (ioqueue->cq_ptr && ioqueue->cq_ptr != MAP_FAILED &&
+	ioqueue->cq_ptr != ioqueue->sq_ptr)
+    {
+	munmap(ioqueue->cq_ptr, ioqueue->cq_ptr_sz);
+    }
+    if (ioqueue->sq_ptr && ioqueue->sq_ptr != MAP_FAILED)
+	munmap(ioqueue->sq_ptr, ioqueue->sq_ptr_sz);
+    if (ioqueue->ring_fd >= 0)
+	close(ioqueue->ring_fd);
+
+    ioqueue->sqes = NULL;
+    ioqueue->cq_ptr = ioqueue->sq_ptr = NULL;
+    ioqueue->ring_fd = -1;
+}
+
+/* Create the ring and map the queues to our address space */
+static pj_status_t open_ring(pj_pool_t *pool, pj_ioqueue_t *ioqueue,
+			     pj_size_t max_fd)
+{
+    struct io_uring_params p;
+    unsigned entries;
+    char *sq_ptr, *cq_ptr;
+    pj_status_t status;
+
+    entries = MIN_SQ_ENTRIES;
+    while (entries < max_fd * 2 && entries < MAX_SQ_ENTRIES)
+	entries <<= 1;
+
+    pj_bzero(&p, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * CQ_FACTOR;
+    ioqueue->ring_fd = sys_io_uring_setup(entries, &p);
+    if (ioqueue->ring_fd < 0 && errno == EINVAL) {
+	/* Older kernel without IORING_SETUP_CQSIZE */
+	pj_bzero(&p, sizeof(p));
+	ioqueue->ring_fd = sys_io_uring_setup(entries, &p);
+    }
+    if (ioqueue->ring_fd < 0) {
+	status = PJ_RETURN_OS_ERROR(errno);
+	PJ_PERROR(3,(THIS_FILE, status, "io_uring_setup() error"));
+	return status;
+    }
+
+    /* We need completions to be kept when the completion queue overflows,
+     * and the timeout argument for io_uring_enter().
+     */
+    if ((p.features & IORING_FEAT_NODROP) == 0 ||
+	(p.features & IORING_FEAT_EXT_ARG) == 0)
+    {
+	PJ_LOG(3,(THIS_FILE, "io_uring features %x are not sufficient",
+		  p.features));
+	close(ioqueue->ring_fd);
+	ioqueue->ring_fd = -1;
+	return PJ_ENOTSUP;
+    }
+
+    ioqueue->sq_ptr_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ioqueue->cq_ptr_sz = p.cq_off.cqes +
+			 p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+	if (ioqueue->cq_ptr_sz > ioqueue->sq_ptr_sz)
+	    ioqueue->sq_ptr_sz = ioqueue->cq_ptr_sz;
+	ioqueue->cq_ptr_sz = ioqueue->sq_ptr_sz;
+    }
+
+    ioqueue->sq_ptr = mmap(0, ioqueue->sq_ptr_sz, PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+			   IORING_OFF_SQ_RING);
+    if (ioqueue->sq_ptr == MAP_FAILED)
+	goto on_map_error;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+	ioqueue->cq_ptr = ioqueue->sq_ptr;
+    } else {
+	ioqueue->cq_ptr = mmap(0, ioqueue->cq_ptr_sz, PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+			       IORING_OFF_CQ_RING);
+	if (ioqueue->cq_ptr == MAP_FAILED)
+	    goto on_map_error;
+    }
+
+    ioqueue->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    ioqueue->sqes = (struct io_uring_sqe*)
+		    mmap(0, ioqueue->sqes_sz, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, ioqueue->ring_fd,
+			 IORING_OFF_SQES);
+    if (ioqueue->sqes == MAP_FAILED)
+	goto on_map_error;
+
+    sq_ptr = (char*)ioqueue->sq_ptr;
+    ioqueue->sq_head = (unsigned*)(sq_ptr + p.sq_off.head);
+    ioqueue->sq_tail = (unsigned*)(sq_ptr + p.sq_off.tail);
+    ioqueue->sq_array = (unsigned*)(sq_ptr + p.sq_off.array);
+    ioqueue->sq_mask = *(unsigned*)(sq_ptr + p.sq_off.ring_mask);
+    ioqueue->sq_entries = p.sq_entries;
+
+    cq_ptr = (char*)ioqueue->cq_ptr;
+    ioqueue->cq_head = (unsigned*)(cq_ptr + p.cq_off.head);
+    ioqueue->cq_tail = (unsigned*)(cq_ptr + p.cq_off.tail);
+    ioqueue->cq_mask = *(unsigned*)(cq_ptr + p.cq_off.ring_mask);
+    ioqueue->cqes = (struct io_uring_cqe*)(cq_ptr + p.cq_off.cqes);
+
+    /* Completions which have been reaped but not dispatched yet */
+    ioqueue->backlog_max = p.cq_entries * 2;
+    ioqueue->backlog = (struct completion*)
+		       pj_pool_calloc(pool, ioqueue->backlog_max,
+				      sizeof(struct completion));
+    ioqueue->backlog_start = ioqueue->backlog_cnt = 0;
+
+    return PJ_SUCCESS;
+
+on_map_error:
+    status = PJ_RETURN_OS_ERROR(errno);
+    close_ring(ioqueue);
+    return status;
+}
+
+/*
+ * pj_ioqueue_create()
+ *
+ * Create io_uring ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create( pj_pool_t *pool,
+                                       pj_size_t max_fd,
+                                       pj_ioqueue_t **p_ioqueue)
+{
+    pj_ioqueue_t *ioqueue;
+    pj_lock_t *lock;
+    pj_status_t rc;
+    unsigned i;
+
+    /* Check that arguments are valid. */
+    PJ_ASSERT_RETURN(pool != NULL && p_ioqueue != NULL &&
+                     max_fd > 0, PJ_EINVAL);
+
+    /* Check that size of pj_ioqueue_op_key_t is sufficient */
+    PJ_ASSERT_RETURN(sizeof(pj_ioqueue_op_key_t)-sizeof(void*) >=
+                     sizeof(struct uring_op), PJ_EBUG);
+
+    ioqueue = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_t);
+    ioqueue->default_concurrency = PJ_IOQUEUE_DEFAULT_ALLOW_CONCURRENCY;
+    ioqueue->max = (unsigned)max_fd;
+    ioqueue->ring_fd = -1;
+    ioqueue->dispatch_tls_id = -1;
+    pj_list_init(&ioqueue->active_list);
+    pj_list_init(&ioqueue->free_list);
+    pj_list_init(&ioqueue->closing_list);
+
+    rc = pj_mutex_create_simple(pool, NULL, &ioqueue->ref_cnt_mutex);
+    if (rc != PJ_SUCCESS)
+	return rc;
+
+    /* Pre-create all keys according to max_fd */
+    for (i=0; i<max_fd; ++i) {
+	pj_ioqueue_key_t *key;
+
+	key = PJ_POOL_ZALLOC_T(pool, pj_ioqueue_key_t);
+	rc = pj_lock_create_recursive_mutex(pool, NULL, &key->lock);
+	if (rc != PJ_SUCCESS)
+	    goto on_error;
+
+	pj_list_push_back(&ioqueue->free_list, key);
+    }
+
+    rc = pj_mutex_create_simple(pool, "ioqs%p", &ioqueue->sq_mutex);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_mutex_create_simple(pool, "ioqc%p", &ioqueue->cq_mutex);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_thread_local_alloc(&ioqueue->dispatch_tls_id);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_lock_create_simple_mutex(pool, "ioq%p", &lock);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    rc = pj_ioqueue_set_lock(ioqueue, lock, PJ_TRUE);
+    if (rc != PJ_SUCCESS) {
+	pj_lock_destroy(lock);
+	goto on_error;
+    }
+
+    rc = open_ring(pool, ioqueue, max_fd);
+    if (rc != PJ_SUCCESS)
+	goto on_error;
+
+    PJ_LOG(4, ("pjlib", "io_uring I/O Queue created (%p), %u entries",
+	       ioqueue, ioqueue->sq_entries));
+
+    *p_ioqueue = ioqueue;
+    return PJ_SUCCESS;
+
+on_error:
+    {
+	pj_ioqueue_key_t *key = ioqueue->free_list.next;
+	while (key != &ioqueue->free_list) {
+	    pj_lock_destroy(key->lock);
+	    key = key->next;
+	}
+    }
+    if (ioqueue->dispatch_tls_id != -1)
+	pj_thread_local_free(ioqueue->dispatch_tls_id);
+    if (ioqueue->cq_mutex)
+	pj_mutex_destroy(ioqueue->cq_mutex);
+    if (ioqueue->sq_mutex)
+	pj_mutex_destroy(ioqueue->sq_mutex);
+    if (ioqueue->auto_delete_lock)
+	pj_lock_destroy(ioqueue->lock);
+    pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+    return rc;
+}
+
+/*
+ * pj_ioqueue_create_sharded()
+ *
+ * The io_uring ioqueue has only one shard.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_create_sharded( pj_pool_t *pool,
+					       pj_size_t max_fd,
+					       unsigned shard_cnt,
+					       pj_ioqueue_t **p_ioqueue)
+{
+    PJ_UNUSED_ARG(shard_cnt);
+    return pj_ioqueue_create(pool, max_fd, p_ioqueue);
+}
+
+PJ_DEF(unsigned) pj_ioqueue_get_shard_count(pj_ioqueue_t *ioqueue)
+{
+    PJ_UNUSED_ARG(ioqueue);
+    return 1;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_thread_shard(pj_ioqueue_t *ioqueue,
+						int shard_hint)
+{
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_shard(pj_ioqueue_key_t *key,
+					 unsigned shard_hint)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_destroy()
+ *
+ * Destroy ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_destroy(pj_ioqueue_t *ioqueue)
+{
+    pj_ioqueue_key_t *key;
+
+    PJ_ASSERT_RETURN(ioqueue, PJ_EINVAL);
+    PJ_ASSERT_RETURN(ioqueue->ring_fd >= 0, PJ_EINVALIDOP);
+
+    pj_lock_acquire(ioqueue->lock);
+    close_ring(ioqueue);
+
+    key = ioqueue->active_list.next;
+    while (key != &ioqueue->active_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    key = ioqueue->closing_list.next;
+    while (key != &ioqueue->closing_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    key = ioqueue->free_list.next;
+    while (key != &ioqueue->free_list) {
+	pj_lock_destroy(key->lock);
+	key = key->next;
+    }
+
+    pj_thread_local_free(ioqueue->dispatch_tls_id);
+    pj_mutex_destroy(ioqueue->cq_mutex);
+    pj_mutex_destroy(ioqueue->sq_mutex);
+    pj_mutex_destroy(ioqueue->ref_cnt_mutex);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock ) {
+	pj_lock_release(ioqueue->lock);
+        return pj_lock_destroy(ioqueue->lock);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_set_lock()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_lock( pj_ioqueue_t *ioqueue,
+					 pj_lock_t *lock,
+					 pj_bool_t auto_delete )
+{
+    PJ_ASSERT_RETURN(ioqueue && lock, PJ_EINVAL);
+
+    if (ioqueue->auto_delete_lock && ioqueue->lock) {
+        pj_lock_destroy(ioqueue->lock);
+    }
+
+    ioqueue->lock = lock;
+    ioqueue->auto_delete_lock = auto_delete;
+
+    return PJ_SUCCESS;
+}
+
+/*
+ * pj_ioqueue_register_sock()
+ *
+ * Register a socket to ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock2(pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      pj_grp_lock_t *grp_lock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+                                              pj_ioqueue_key_t **p_key)
+{
+    pj_ioqueue_key_t *key = NULL;
+    unsigned long value;
+    int optlen;
+    pj_status_t rc = PJ_SUCCESS;
+
+    PJ_ASSERT_RETURN(pool && ioqueue && sock != PJ_INVALID_SOCKET &&
+                     cb && p_key, PJ_EINVAL);
+
+    pj_lock_acquire(ioqueue->lock);
+
+    if (ioqueue->count >= ioqueue->max) {
+        rc = PJ_ETOOMANY;
+	TRACE_((THIS_FILE, "pj_ioqueue_register_sock error: too many files"));
+	goto on_return;
+    }
+
+    /* Set socket to nonblocking, the immediate I/O attempts rely on it. */
+    value = 1;
+    if (ioctl(sock, FIONBIO, &value)) {
+        rc = pj_get_netos_error();
+	goto on_return;
+    }
+
+    /* Scan closing_keys first to let them come back to free_list */
+    scan_closing_keys(ioqueue);
+
+    pj_assert(!pj_list_empty(&ioqueue->free_list));
+    if (pj_list_empty(&ioqueue->free_list)) {
+	rc = PJ_ETOOMANY;
+	goto on_return;
+    }
+
+    key = ioqueue->free_list.next;
+    pj_list_erase(key);
+
+    /* Initialize the key */
+    key->ioqueue = ioqueue;
+    key->fd = sock;
+    key->user_data = user_data;
+    key->send_batch = 0;
+    pj_list_init(&key->read_list);
+    pj_list_init(&key->write_list);
+#if PJ_HAS_TCP
+    pj_list_init(&key->accept_list);
+    key->connecting = 0;
+    key->connect_op.op = PJ_IOQUEUE_OP_CONNECT;
+    key->connect_op.key = key;
+    key->connect_op.inflight = PJ_FALSE;
+#endif
+    pj_memcpy(&key->cb, cb, sizeof(pj_ioqueue_callback));
+
+    /* Set initial reference count to 1 */
+    pj_assert(key->ref_count == 0);
+    ++key->ref_count;
+    key->closing = 0;
+
+    pj_ioqueue_set_concurrency(key, ioqueue->default_concurrency);
+
+    /* Get socket type. For stream sockets, writes are submitted one
+     * at a time to keep the order of the data.
+     */
+    optlen = sizeof(key->fd_type);
+    rc = pj_sock_getsockopt(sock, pj_SOL_SOCKET(), pj_SO_TYPE(),
+                            &key->fd_type, &optlen);
+    if (rc != PJ_SUCCESS)
+        key->fd_type = pj_SOCK_STREAM();
+    rc = PJ_SUCCESS;
+
+    /* Group lock */
+    key->grp_lock = grp_lock;
+    if (key->grp_lock) {
+	pj_grp_lock_add_ref_dbg(key->grp_lock, "ioqueue", 0);
+    }
+
+    /* Register */
+    pj_list_insert_before(&ioqueue->active_list, key);
+    ++ioqueue->count;
+
+on_return:
+    *p_key = key;
+    pj_lock_release(ioqueue->lock);
+
+    return rc;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_register_sock( pj_pool_t *pool,
+					      pj_ioqueue_t *ioqueue,
+					      pj_sock_t sock,
+					      void *user_data,
+					      const pj_ioqueue_callback *cb,
+					      pj_ioqueue_key_t **p_key)
+{
+    return pj_ioqueue_register_sock2(pool, ioqueue, sock, NULL, user_data,
+                                     cb, p_key);
+}
+
+/* Increment key's reference counter */
+static void increment_counter(pj_ioqueue_key_t *key)
+{
+    pj_mutex_lock(key->ioqueue->ref_cnt_mutex);
+    ++key->ref_count;
+    pj_mutex_unlock(key->ioqueue->ref_cnt_mutex);
+}
+
+/* Decrement the key's reference counter, and when the counter reach zero,
+ * destroy the key.
+ *
+ * Note: MUST NOT CALL THIS FUNCTION WHILE HOLDING ioqueue's LOCK.
+ */
+static void decrement_counter(pj_ioqueue_key_t *key)
+{
+    pj_lock_acquire(key->ioqueue->lock);
+    pj_mutex_lock(key->ioqueue->ref_cnt_mutex);
+    --key->ref_count;
+    if (key->ref_count == 0) {
+
+	pj_assert(key->closing == 1);
+	pj_gettickcount(&key->free_time);
+	key->free_time.msec += PJ_IOQUEUE_KEY_FREE_DELAY;
+	pj_time_val_normalize(&key->free_time);
+
+	pj_list_erase(key);
+	pj_list_push_back(&key->ioqueue->closing_list, key);
+
+    }
+    pj_mutex_unlock(key->ioqueue->ref_cnt_mutex);
+    pj_lock_release(key->ioqueue->lock);
+}
+
+/* Scan closing keys to be put to free list again */
+static void scan_closing_keys(pj_ioqueue_t *ioqueue)
+{
+    pj_time_val now;
+    pj_ioqueue_key_t *h;
+
+    pj_gettickcount(&now);
+    h = ioqueue->closing_list.next;
+    while (h != &ioqueue->closing_list) {
+	pj_ioqueue_key_t *next = h->next;
+
+	pj_assert(h->closing != 0);
+
+	if (PJ_TIME_VAL_GTE(now, h->free_time)) {
+	    pj_list_erase(h);
+	    pj_list_push_back(&ioqueue->free_list, h);
+	}
+	h = next;
+    }
+}
+
+/* Number of entries which have been queued but not submitted yet */
+static unsigned get_unsubmitted(pj_ioqueue_t *ioqueue)
+{
+    return *ioqueue->sq_tail - LOAD_ACQUIRE(ioqueue->sq_head);
+}
+
+/* Submit queued entries and optionally wait for completions. */
+static int enter_ring(pj_ioqueue_t *ioqueue, unsigned min_complete,
+		      int msec)
+{
+    unsigned to_submit = get_unsubmitted(ioqueue);
+    int rc;
+
+    if (min_complete) {
+	struct io_uring_getevents_arg arg;
+	struct __kernel_timespec ts;
+
+	ts.tv_sec = msec / 1000;
+	ts.tv_nsec = (msec % 1000) * 1000000;
+	pj_bzero(&arg, sizeof(arg));
+	arg.ts = (pj_uint64_t)(pj_size_t)&ts;
+
+	rc = sys_io_uring_enter(ioqueue->ring_fd, to_submit, min_complete,
+				IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+				&arg, sizeof(arg));
+    } else if (to_submit) {
+	rc = sys_io_uring_enter(ioqueue->ring_fd, to_submit, 0, 0, NULL, 0);
+    } else {
+	return 0;
+    }
+
+    /* Timeout, signal, and a full completion queue are not errors
+     * for us; the entries stay in the queue and will be submitted on
+     * the next call.
+     */
+    if (rc < 0 && (errno == ETIME || errno == EINTR || errno == EBUSY ||
+		   errno == EAGAIN))
+    {
+	rc = 0;
+    }
+    return rc;
+}
+
+/* Check if the calling thread is dispatching completions of the ioqueue,
+ * in which case submissions are deferred until the dispatching is done.
+ */
+static pj_bool_t is_dispatching(pj_ioqueue_t *ioqueue)
+{
+    return pj_thread_local_get(ioqueue->dispatch_tls_id) == ioqueue;
+}
+
+/* Fill in the submission entry for the operation */
+static void prep_sqe(struct io_uring_sqe *sqe, struct uring_op *op)
+{
+    pj_ioqueue_key_t *key = op->key;
+
+    pj_bzero(sqe, sizeof(*sqe));
+    sqe->fd = (int)key->fd;
+    sqe->user_data = (pj_uint64_t)(pj_size_t)op;
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_READ:
+	sqe->opcode = IORING_OP_RECV;
+	sqe->addr = (pj_uint64_t)(pj_size_t)op->buf;
+	sqe->len = (unsigned)op->size;
+	sqe->msg_flags = op->flags;
+	break;
+    case PJ_IOQUEUE_OP_RECV_FROM:
+	pj_bzero(&op->msg, sizeof(op->msg));
+	op->iov.iov_base = op->buf;
+	op->iov.iov_len = op->size;
+	op->msg.msg_iov = &op->iov;
+	op->msg.msg_iovlen = 1;
+	if (op->rmt_addr && op->rmt_addrlen) {
+	    op->msg.msg_name = op->rmt_addr;
+	    op->msg.msg_namelen = *op->rmt_addrlen;
+	}
+	sqe->opcode = IORING_OP_RECVMSG;
+	sqe->addr = (pj_uint64_t)(pj_size_t)&op->msg;
+	sqe->len = 1;
+	sqe->msg_flags = op->flags;
+	break;
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_WRITE:
+	sqe->opcode = IORING_OP_SEND;
+	sqe->addr = (pj_uint64_t)(pj_size_t)(op->buf + op->written);
+	sqe->len = (unsigned)(op->size - op->written);
+#ifdef MSG_NOSIGNAL
+	sqe->msg_flags = op->flags | MSG_NOSIGNAL;
+#else
+	sqe->msg_flags = op->flags;
+#endif
+	break;
+    case PJ_IOQUEUE_OP_SEND_TO:
+	pj_bzero(&op->msg, sizeof(op->msg));
+	op->iov.iov_base = op->buf;
+	op->iov.iov_len = op->size;
+	op->msg.msg_iov = &op->iov;
+	op->msg.msg_iovlen = 1;
+	op->msg.msg_name = &op->addr;
+	op->msg.msg_namelen = op->addr_len;
+	sqe->opcode = IORING_OP_SENDMSG;
+	sqe->addr = (pj_uint64_t)(pj_size_t)&op->msg;
+	sqe->len = 1;
+	sqe->msg_flags = op->flags;
+	break;
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+	sqe->opcode = IORING_OP_ACCEPT;
+	if (op->rmt_addr && op->rmt_addrlen) {
+	    sqe->addr = (pj_uint64_t)(pj_size_t)op->rmt_addr;
+	    sqe->addr2 = (pj_uint64_t)(pj_size_t)op->rmt_addrlen;
+	}
+	/* Same as the accept4() of the fast track */
+	sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+	break;
+    case PJ_IOQUEUE_OP_CONNECT:
+	/* Wait until the non-blocking connect() completes */
+	sqe->opcode = IORING_OP_POLL_ADD;
+	sqe->poll_events = POLLOUT | POLLERR | POLLHUP;
+	break;
+#endif
+    default:
+	pj_assert(!"Invalid operation");
+	sqe->opcode = IORING_OP_NOP;
+	break;
+    }
+}
+
+/* Get a free submission entry. Must be called with sq_mutex held. */
+static struct io_uring_sqe *get_sqe(pj_ioqueue_t *ioqueue)
+{
+    unsigned tail = *ioqueue->sq_tail;
+
+    if (tail - LOAD_ACQUIRE(ioqueue->sq_head) >= ioqueue->sq_entries) {
+	/* Queue is full, submit the queued entries first */
+	enter_ring(ioqueue, 0, 0);
+	if (tail - LOAD_ACQUIRE(ioqueue->sq_head) >= ioqueue->sq_entries)
+	    return NULL;
+    }
+    return &ioqueue->sqes[tail & ioqueue->sq_mask];
+}
+
+/* Publish the submission entry obtained with get_sqe(). */
+static void commit_sqe(pj_ioqueue_t *ioqueue)
+{
+    unsigned tail = *ioqueue->sq_tail;
+
+    ioqueue->sq_array[tail & ioqueue->sq_mask] = tail & ioqueue->sq_mask;
+    STORE_RELEASE(ioqueue->sq_tail, tail + 1);
+}
+
+/*
+ * Submit the operation to the kernel. Must be called with the key locked.
+ * When called from a completion callback, the actual submission is
+ * deferred until the callbacks of the poll have been called.
+ */
+static pj_status_t submit_op(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+    struct io_uring_sqe *sqe;
+
+    pj_mutex_lock(ioqueue->sq_mutex);
+    sqe = get_sqe(ioqueue);
+    if (!sqe) {
+	pj_mutex_unlock(ioqueue->sq_mutex);
+	return PJ_ETOOMANY;
+    }
+    op->key = key;
+    ++op->seq;
+    op->inflight = PJ_TRUE;
+    op->cancelling = PJ_FALSE;
+    prep_sqe(sqe, op);
+    commit_sqe(ioqueue);
+    pj_mutex_unlock(ioqueue->sq_mutex);
+
+    if (!is_dispatching(ioqueue))
+	enter_ring(ioqueue, 0, 0);
+
+    return PJ_SUCCESS;
+}
+
+/* Request the kernel to cancel an operation which is in progress. If the
+ * submission queue is full, the request is not queued and the operation
+ * is not marked as cancelling, so wait_released() will try again.
+ */
+static void cancel_op(pj_ioqueue_t *ioqueue, struct uring_op *op)
+{
+    struct io_uring_sqe *sqe;
+
+    pj_mutex_lock(ioqueue->sq_mutex);
+    sqe = get_sqe(ioqueue);
+    if (sqe) {
+	pj_bzero(sqe, sizeof(*sqe));
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->fd = -1;
+	sqe->addr = (pj_uint64_t)(pj_size_t)op;
+	sqe->user_data = 0;
+	commit_sqe(ioqueue);
+	op->cancelling = PJ_TRUE;
+    }
+    pj_mutex_unlock(ioqueue->sq_mutex);
+}
+
+static void cancel_all(pj_ioqueue_key_t *key);
+
+/*
+ * Move completions from the kernel's completion queue to the backlog.
+ * Must be called with cq_mutex held.
+ */
+static void reap_completions(pj_ioqueue_t *ioqueue)
+{
+    unsigned head = *ioqueue->cq_head;
+    unsigned tail = LOAD_ACQUIRE(ioqueue->cq_tail);
+
+    while (head != tail && ioqueue->backlog_cnt < ioqueue->backlog_max) {
+	struct io_uring_cqe *cqe = &ioqueue->cqes[head & ioqueue->cq_mask];
+	struct uring_op *op = (struct uring_op*)(pj_size_t)cqe->user_data;
+	struct completion *rec;
+
+	++head;
+
+	/* Completion of a cancel request */
+	if (op == NULL)
+	    continue;
+
+	rec = &ioqueue->backlog[(ioqueue->backlog_start +
+				 ioqueue->backlog_cnt) % ioqueue->backlog_max];
+	rec->key = op->key;
+	rec->op = op;
+	rec->seq = op->seq;
+	rec->res = cqe->res;
+	++ioqueue->backlog_cnt;
+
+	/* Hold the key until the completion is dispatched */
+	increment_counter(rec->key);
+	if (rec->key->grp_lock)
+	    pj_grp_lock_add_ref_dbg(rec->key->grp_lock, "ioqueue", 0);
+
+	/* The kernel is done with the operation. From now on, the op and
+	 * its buffer may be reused or released by other threads.
+	 */
+	op->inflight = PJ_FALSE;
+    }
+
+    STORE_RELEASE(ioqueue->cq_head, head);
+}
+
+/* Take up to max_cnt completions from the backlog */
+static unsigned get_completions(pj_ioqueue_t *ioqueue,
+				struct completion recs[],
+				unsigned max_cnt)
+{
+    unsigned cnt = 0;
+
+    pj_mutex_lock(ioqueue->cq_mutex);
+    reap_completions(ioqueue);
+    while (cnt < max_cnt && ioqueue->backlog_cnt) {
+	recs[cnt++] = ioqueue->backlog[ioqueue->backlog_start];
+	ioqueue->backlog_start = (ioqueue->backlog_start + 1) %
+				 ioqueue->backlog_max;
+	--ioqueue->backlog_cnt;
+    }
+    pj_mutex_unlock(ioqueue->cq_mutex);
+
+    return cnt;
+}
+
+/* Check if any of the key's operations (or only the specified one)
+ * is still owned by the kernel. Must be called with cq_mutex held.
+ */
+static pj_bool_t is_inflight(pj_ioqueue_key_t *key, struct uring_op *only)
+{
+    struct uring_op *lists[3];
+    unsigned i, cnt = 0;
+
+    if (only)
+	return only->inflight;
+
+    lists[cnt++] = &key->read_list;
+    lists[cnt++] = &key->write_list;
+#if PJ_HAS_TCP
+    lists[cnt++] = &key->accept_list;
+    if (key->connect_op.inflight)
+	return PJ_TRUE;
+#endif
+
+    for (i=0; i<cnt; ++i) {
+	struct uring_op *op = lists[i]->next;
+	while (op != lists[i]) {
+	    if (op->inflight)
+		return PJ_TRUE;
+	    op = op->next;
+	}
+    }
+    return PJ_FALSE;
+}
+
+/*
+ * Wait until the kernel has released the key's operations (or only the
+ * specified operation), after they have been cancelled. This guarantees
+ * that the kernel will not write to the buffers after the application
+ * has been told that the operation is no longer pending.
+ */
+static void wait_released(pj_ioqueue_key_t *key, struct uring_op *only)
+{
+    pj_ioqueue_t *ioqueue = key->ioqueue;
+
+    for (;;) {
+	pj_bool_t busy;
+
+	pj_mutex_lock(ioqueue->cq_mutex);
+	reap_completions(ioqueue);
+	busy = is_inflight(key, only);
+	pj_mutex_unlock(ioqueue->cq_mutex);
+
+	if (!busy)
+	    break;
+
+	/* Queue the cancel requests which didn't fit in the submission
+	 * queue earlier.
+	 */
+	if (only) {
+	    if (only->inflight && !only->cancelling)
+		cancel_op(ioqueue, only);
+	} else {
+	    cancel_all(key);
+	}
+
+	/* This also submits the cancel requests */
+	enter_ring(ioqueue, 1, 1);
+    }
+}
+
+/* Cancel the key's operations which are in progress, and for which no
+ * cancel request has been queued yet.
+ */
+static void cancel_all(pj_ioqueue_key_t *key)
+{
+    struct uring_op *lists[3];
+    unsigned i, cnt = 0;
+
+    lists[cnt++] = &key->read_list;
+    lists[cnt++] = &key->write_list;
+#if PJ_HAS_TCP
+    lists[cnt++] = &key->accept_list;
+    if (key->connect_op.inflight && !key->connect_op.cancelling)
+	cancel_op(key->ioqueue, &key->connect_op);
+#endif
+
+    for (i=0; i<cnt; ++i) {
+	struct uring_op *op = lists[i]->next;
+	while (op != lists[i]) {
+	    if (op->inflight && !op->cancelling)
+		cancel_op(key->ioqueue, op);
+	    op = op->next;
+	}
+    }
+}
+
+/*
+ * pj_ioqueue_unregister()
+ *
+ * Unregister handle from ioqueue.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_unregister( pj_ioqueue_key_t *key)
+{
+    pj_ioqueue_t *ioqueue;
+
+    PJ_ASSERT_RETURN(key != NULL, PJ_EINVAL);
+
+    ioqueue = key->ioqueue;
+
+    /* Lock the key to make sure no callback is simultaneously modifying
+     * the key. We need to lock the key before ioqueue here to prevent
+     * deadlock.
+     */
+    pj_ioqueue_lock_key(key);
+
+    /* Also lock ioqueue */
+    pj_lock_acquire(ioqueue->lock);
+    pj_assert(ioqueue->count > 0);
+    --ioqueue->count;
+
+    /* Mark key is closing. Completions which arrive from now on will be
+     * discarded.
+     */
+    key->closing = 1;
+    pj_lock_release(ioqueue->lock);
+
+    /* Cancel the pending operations, and wait until the kernel no longer
+     * uses them before closing the socket.
+     */
+    cancel_all(key);
+    wait_released(key, NULL);
+
+    /* Destroy the key. */
+    pj_sock_close(key->fd);
+
+    /* Decrement counter. */
+    decrement_counter(key);
+
+    /* Done. */
+    if (key->grp_lock) {
+	/* just dec_ref and unlock. we will set grp_lock to NULL
+	 * elsewhere */
+	pj_grp_lock_t *grp_lock = key->grp_lock;
+	// Don't set grp_lock to NULL otherwise the other thread
+	// will crash. Just leave it as dangling pointer, but this
+	// should be safe
+	//key->grp_lock = NULL;
+	pj_grp_lock_dec_ref_dbg(grp_lock, "ioqueue", 0);
+	pj_grp_lock_release(grp_lock);
+    } else {
+	pj_ioqueue_unlock_key(key);
+    }
+
+    return PJ_SUCCESS;
+}
+
+/* Check that the completion still refers to a pending operation of the
+ * key. The operation may have been cancelled or completed with
+ * pj_ioqueue_post_completion() in the mean time.
+ */
+static pj_bool_t is_valid_completion(pj_ioqueue_key_t *key,
+				     const struct completion *rec)
+{
+    struct uring_op *lists[3];
+    unsigned i, cnt = 0;
+
+#if PJ_HAS_TCP
+    if (rec->op == &key->connect_op)
+	return key->connecting && key->connect_op.seq == rec->seq;
+    lists[cnt++] = &key->accept_list;
+#endif
+    lists[cnt++] = &key->read_list;
+    lists[cnt++] = &key->write_list;
+
+    /* Compare the pointers first, the op must not be accessed if it's
+     * no longer pending since the application may have released it.
+     */
+    for (i=0; i<cnt; ++i) {
+	struct uring_op *op = lists[i]->next;
+	while (op != lists[i]) {
+	    if (op == rec->op)
+		return op->seq == rec->seq && !op->inflight;
+	    op = op->next;
+	}
+    }
+    return PJ_FALSE;
+}
+
+/* Release the key lock before calling the callback if concurrency is
+ * allowed. Returns whether the lock is still held.
+ */
+static pj_bool_t release_for_callback(pj_ioqueue_key_t *key)
+{
+    if (!key->allow_concurrent) {
+	/* concurrency may be changed while we're in the callback, so
+	 * save it to a flag.
+	 */
+	return PJ_TRUE;
+    }
+
+    pj_ioqueue_unlock_key(key);
+    PJ_RACE_ME(5);
+    return PJ_FALSE;
+}
+
+/* Convert the completion result to the status value of the callbacks */
+static pj_ssize_t res_to_bytes(int res)
+{
+    return res >= 0 ? res : -(pj_ssize_t)PJ_STATUS_FROM_OS(-res);
+}
+
+/* Dispatch read completion. Called with the key locked. */
+static void dispatch_read(pj_ioqueue_key_t *key, struct uring_op *op,
+			  int res)
+{
+    pj_ssize_t bytes_read = res_to_bytes(res);
+    pj_bool_t has_lock;
+
+    pj_list_erase(op);
+    if (op->op == PJ_IOQUEUE_OP_RECV_FROM && res >= 0 && op->rmt_addrlen)
+	*op->rmt_addrlen = op->msg.msg_namelen;
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    has_lock = release_for_callback(key);
+
+    if (key->cb.on_read_complete && !key->closing) {
+	(*key->cb.on_read_complete)(key, (pj_ioqueue_op_key_t*)op,
+				    bytes_read);
+    }
+
+    if (has_lock)
+	pj_ioqueue_unlock_key(key);
+}
+
+/* Dispatch write completion. Called with the key locked. */
+static void dispatch_write(pj_ioqueue_key_t *key, struct uring_op *op,
+			   int res)
+{
+    pj_ssize_t bytes_sent;
+    pj_bool_t has_lock;
+
+    if (key->fd_type != pj_SOCK_DGRAM()) {
+	if (res > 0) {
+	    op->written += res;
+
+	    /* Send the rest of the data */
+	    if (op->written < op->size && submit_op(key, op) == PJ_SUCCESS) {
+		pj_ioqueue_unlock_key(key);
+		return;
+	    }
+	}
+	bytes_sent = res < 0 ? res_to_bytes(res) : (pj_ssize_t)op->written;
+
+	/* Start the next queued write */
+	pj_list_erase(op);
+	if (!pj_list_empty(&key->write_list))
+	    submit_op(key, key->write_list.next);
+    } else {
+	bytes_sent = res_to_bytes(res);
+	pj_list_erase(op);
+    }
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    has_lock = release_for_callback(key);
+
+    if (key->cb.on_write_complete && !key->closing) {
+	(*key->cb.on_write_complete)(key, (pj_ioqueue_op_key_t*)op,
+				     bytes_sent);
+    }
+
+    if (has_lock)
+	pj_ioqueue_unlock_key(key);
+}
+
+#if PJ_HAS_TCP
+/* Dispatch accept completion. Called with the key locked. */
+static void dispatch_accept(pj_ioqueue_key_t *key, struct uring_op *op,
+			    int res)
+{
+    pj_status_t status;
+    pj_bool_t has_lock;
+
+    pj_list_erase(op);
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    if (res >= 0) {
+	*op->accept_fd = res;
+	status = PJ_SUCCESS;
+	if (op->local_addr && op->rmt_addrlen) {
+	    status = pj_sock_getsockname(*op->accept_fd, op->local_addr,
+					 op->rmt_addrlen);
+	    if (status != PJ_SUCCESS) {
+		pj_sock_close(*op->accept_fd);
+		*op->accept_fd = PJ_INVALID_SOCKET;
+	    }
+	}
+    } else {
+	*op->accept_fd = PJ_INVALID_SOCKET;
+	status = PJ_STATUS_FROM_OS(-res);
+    }
+
+    has_lock = release_for_callback(key);
+
+    if (key->cb.on_accept_complete && !key->closing) {
+	(*key->cb.on_accept_complete)(key, (pj_ioqueue_op_key_t*)op,
+				      *op->accept_fd, status);
+    }
+
+    if (has_lock)
+	pj_ioqueue_unlock_key(key);
+}
+
+/* Dispatch connect completion. Called with the key locked. */
+static void dispatch_connect(pj_ioqueue_key_t *key, int res)
+{
+    pj_status_t status = PJ_SUCCESS;
+    pj_bool_t has_lock;
+    int value;
+    int vallen = sizeof(value);
+
+    key->connecting = 0;
+
+    /* Use getsockopt to read the SO_ERROR option to determine whether
+     * connect() completed successfully. If that fails, just indicate
+     * that the socket is connected; the application will get the error
+     * as soon as it tries to use the socket.
+     */
+    if (res < 0) {
+	status = PJ_STATUS_FROM_OS(-res);
+    } else if (pj_sock_getsockopt(key->fd, SOL_SOCKET, SO_ERROR,
+				  &value, &vallen) == 0)
+    {
+	status = PJ_STATUS_FROM_OS(value);
+    }
+
+    has_lock = release_for_callback(key);
+
+    if (key->cb.on_connect_complete && !key->closing)
+	(*key->cb.on_connect_complete)(key, status);
+
+    if (has_lock)
+	pj_ioqueue_unlock_key(key);
+}
+#endif	/* PJ_HAS_TCP */
+
+/* Dispatch a completion. Returns non-zero if the callback was called. */
+static pj_bool_t dispatch_completion(const struct completion *rec)
+{
+    pj_ioqueue_key_t *key = rec->key;
+    struct uring_op *op = rec->op;
+
+    pj_ioqueue_lock_key(key);
+
+    if (key->closing || !is_valid_completion(key, rec)) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_FALSE;
+    }
+
+    switch (op->op) {
+    case PJ_IOQUEUE_OP_READ:
+    case PJ_IOQUEUE_OP_RECV:
+    case PJ_IOQUEUE_OP_RECV_FROM:
+	dispatch_read(key, op, rec->res);
+	break;
+    case PJ_IOQUEUE_OP_WRITE:
+    case PJ_IOQUEUE_OP_SEND:
+    case PJ_IOQUEUE_OP_SEND_TO:
+	dispatch_write(key, op, rec->res);
+	break;
+#if PJ_HAS_TCP
+    case PJ_IOQUEUE_OP_ACCEPT:
+	dispatch_accept(key, op, rec->res);
+	break;
+    case PJ_IOQUEUE_OP_CONNECT:
+	dispatch_connect(key, rec->res);
+	break;
+#endif
+    default:
+	pj_ioqueue_unlock_key(key);
+	return PJ_FALSE;
+    }
+
+    return PJ_TRUE;
+}
+
+/*
+ * pj_ioqueue_poll()
+ *
+ */
+PJ_DEF(int) pj_ioqueue_poll( pj_ioqueue_t *ioqueue, const pj_time_val *timeout)
+{
+    enum { MAX_EVENTS = PJ_IOQUEUE_MAX_CAND_EVENTS };
+    struct completion recs[MAX_EVENTS];
+    unsigned i, count, max_cnt;
+    int msec, processed_cnt = 0;
+    void *prev_dispatch;
+
+    PJ_CHECK_STACK();
+
+    msec = timeout ? PJ_TIME_VAL_MSEC(*timeout) : 9000;
+    max_cnt = PJ_IOQUEUE_MAX_EVENTS_IN_SINGLE_POLL;
+    if (max_cnt > MAX_EVENTS)
+	max_cnt = MAX_EVENTS;
+
+    /* Take the completions which are already available, otherwise wait
+     * for them (this also submits the deferred entries).
+     */
+    count = get_completions(ioqueue, recs, max_cnt);
+    if (count == 0) {
+	int rc;
+
+	rc = enter_ring(ioqueue, 1, msec);
+	if (rc < 0) {
+	    pj_status_t status = pj_get_os_error();
+	    TRACE_((THIS_FILE, "io_uring_enter() error"));
+	    pj_thread_sleep(msec);
+	    return -status;
+	}
+	count = get_completions(ioqueue, recs, max_cnt);
+    }
+
+    if (count == 0) {
+	/* Check the closing keys only when there's no activity and when
+	 * there are pending closing keys.
+	 */
+	if (!pj_list_empty(&ioqueue->closing_list)) {
+	    pj_lock_acquire(ioqueue->lock);
+	    scan_closing_keys(ioqueue);
+	    pj_lock_release(ioqueue->lock);
+	}
+	return 0;
+    }
+
+    /* Operations started by the callbacks will be submitted in one go
+     * after all completions have been dispatched.
+     */
+    prev_dispatch = pj_thread_local_get(ioqueue->dispatch_tls_id);
+    pj_thread_local_set(ioqueue->dispatch_tls_id, ioqueue);
+
+    for (i=0; i<count; ++i) {
+	if (dispatch_completion(&recs[i]))
+	    ++processed_cnt;
+
+	decrement_counter(recs[i].key);
+	if (recs[i].key->grp_lock)
+	    pj_grp_lock_dec_ref_dbg(recs[i].key->grp_lock, "ioqueue", 0);
+    }
+
+    pj_thread_local_set(ioqueue->dispatch_tls_id, prev_dispatch);
+
+    if (prev_dispatch != ioqueue)
+	enter_ring(ioqueue, 0, 0);
+
+    return processed_cnt;
+}
+
+/*
+ * pj_ioqueue_get_user_data()
+ *
+ * Obtain value associated with a key.
+ */
+PJ_DEF(void*) pj_ioqueue_get_user_data( pj_ioqueue_key_t *key )
+{
+    PJ_ASSERT_RETURN(key != NULL, NULL);
+    return key->user_data;
+}
+
+/*
+ * pj_ioqueue_set_user_data()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_user_data( pj_ioqueue_key_t *key,
+                                              void *user_data,
+                                              void **old_data)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+
+    if (old_data)
+        *old_data = key->user_data;
+    key->user_data = user_data;
+
+    return PJ_SUCCESS;
+}
+
+/* Queue the read operation and submit it. */
+static pj_status_t start_read(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_status_t status;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (key->closing) {
+	op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->read_list, op);
+    status = submit_op(key, op);
+    if (status != PJ_SUCCESS) {
+	pj_list_erase(op);
+	op->op = PJ_IOQUEUE_OP_NONE;
+    }
+    pj_ioqueue_unlock_key(key);
+
+    return status == PJ_SUCCESS ? PJ_EPENDING : status;
+}
+
+/*
+ * pj_ioqueue_recv()
+ *
+ * Start asynchronous recv() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recv(  pj_ioqueue_key_t *key,
+                                      pj_ioqueue_op_key_t *op_key,
+				      void *buffer,
+				      pj_ssize_t *length,
+				      unsigned flags )
+{
+    struct uring_op *op;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing (need to do this first before accessing
+     * other variables, since they might have been destroyed. See ticket
+     * #469).
+     */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    op = (struct uring_op*)op_key;
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Try to see if there's data immediately available.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0) {
+	pj_status_t status;
+	pj_ssize_t size;
+
+	size = *length;
+	status = pj_sock_recv(key->fd, buffer, &size, flags);
+	if (status == PJ_SUCCESS) {
+	    /* Yes! Data is available! */
+	    *length = size;
+	    return PJ_SUCCESS;
+	} else {
+	    /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+	     * the error to caller.
+	     */
+	    if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+		return status;
+	}
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * No data is immediately available.
+     * Must submit asynchronous operation to the kernel.
+     */
+    op->op = PJ_IOQUEUE_OP_RECV;
+    op->buf = (char*)buffer;
+    op->size = *length;
+    op->flags = flags;
+
+    return start_read(key, op);
+}
+
+/*
+ * pj_ioqueue_recvfrom()
+ *
+ * Start asynchronous recvfrom() from the socket.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_recvfrom( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key,
+				         void *buffer,
+				         pj_ssize_t *length,
+                                         unsigned flags,
+				         pj_sockaddr_t *addr,
+				         int *addrlen)
+{
+    struct uring_op *op;
+
+    PJ_ASSERT_RETURN(key && op_key && buffer && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    op = (struct uring_op*)op_key;
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Try to see if there's data immediately available.
+     */
+    if ((flags & PJ_IOQUEUE_ALWAYS_ASYNC) == 0) {
+	pj_status_t status;
+	pj_ssize_t size;
+
+	size = *length;
+	status = pj_sock_recvfrom(key->fd, buffer, &size, flags,
+				  addr, addrlen);
+	if (status == PJ_SUCCESS) {
+	    /* Yes! Data is available! */
+	    *length = size;
+	    return PJ_SUCCESS;
+	} else {
+	    /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+	     * the error to caller.
+	     */
+	    if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL))
+		return status;
+	}
+    }
+
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /*
+     * No data is immediately available.
+     * Must submit asynchronous operation to the kernel.
+     */
+    op->op = PJ_IOQUEUE_OP_RECV_FROM;
+    op->buf = (char*)buffer;
+    op->size = *length;
+    op->flags = flags;
+    op->rmt_addr = addr;
+    op->rmt_addrlen = addrlen;
+
+    return start_read(key, op);
+}
+
+/* Wait for a moment if the op key still has a pending operation.
+ * Returns PJ_EBUSY if it's still pending.
+ */
+static pj_status_t check_op_busy(struct uring_op *op)
+{
+    unsigned retry;
+
+    /* Spin if op has pending operation */
+    for (retry=0; op->op != 0 && retry<PENDING_RETRY; ++retry)
+	pj_thread_sleep(0);
+
+    /* Unable to send packet because there is already pending write on
+     * the op key. Application should specify multiple write operation
+     * keys in this situation.
+     */
+    return op->op ? PJ_EBUSY : PJ_SUCCESS;
+}
+
+/* Queue the write operation, and submit it unless the stream socket
+ * has another write in progress.
+ */
+static pj_status_t start_write(pj_ioqueue_key_t *key, struct uring_op *op)
+{
+    pj_status_t status = PJ_SUCCESS;
+    pj_bool_t submit;
+
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous check
+     * in multithreaded app. See #913
+     */
+    if (key->closing) {
+	op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+
+    /* Datagrams are submitted in parallel, while data on stream sockets
+     * is written one operation at a time to keep it in order.
+     */
+    submit = key->fd_type == pj_SOCK_DGRAM() ||
+	     pj_list_empty(&key->write_list);
+    pj_list_insert_before(&key->write_list, op);
+    if (submit) {
+	status = submit_op(key, op);
+	if (status != PJ_SUCCESS) {
+	    pj_list_erase(op);
+	    op->op = PJ_IOQUEUE_OP_NONE;
+	}
+    }
+    pj_ioqueue_unlock_key(key);
+
+    return status == PJ_SUCCESS ? PJ_EPENDING : status;
+}
+
+/*
+ * pj_ioqueue_send()
+ *
+ * Start asynchronous send() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_send( pj_ioqueue_key_t *key,
+                                     pj_ioqueue_op_key_t *op_key,
+			             const void *data,
+			             pj_ssize_t *length,
+                                     unsigned flags)
+{
+    struct uring_op *op;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write. */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     *   We are speculating that the list is empty here without acquiring
+     *   the key's lock first, see ioqueue_common_abs.c for the rationale.
+     */
+    if (pj_list_empty(&key->write_list)) {
+        sent = *length;
+        status = pj_sock_send(key->fd, data, &sent, flags);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * Schedule asynchronous send.
+     */
+    op = (struct uring_op*)op_key;
+    status = check_op_busy(op);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    op->op = PJ_IOQUEUE_OP_SEND;
+    op->buf = (char*)data;
+    op->size = *length;
+    op->written = 0;
+    op->flags = flags;
+
+    return start_write(key, op);
+}
+
+/*
+ * pj_ioqueue_sendto()
+ *
+ * Start asynchronous write() to the descriptor.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_sendto( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               const void *data,
+			               pj_ssize_t *length,
+                                       pj_uint32_t flags,
+			               const pj_sockaddr_t *addr,
+			               int addrlen)
+{
+    struct uring_op *op;
+    pj_bool_t defer;
+    pj_status_t status;
+    pj_ssize_t sent;
+
+    PJ_ASSERT_RETURN(key && op_key && data && length, PJ_EINVAL);
+    PJ_CHECK_STACK();
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* Batched send is only meaningful in the polling thread, where the
+     * submission is deferred until the end of the poll. Elsewhere, an
+     * immediate sendto() is cheaper than a submission.
+     */
+    defer = (flags & PJ_IOQUEUE_BATCH_SEND) && key->send_batch > 1 &&
+	    is_dispatching(key->ioqueue);
+
+    /* We can not use PJ_IOQUEUE_ALWAYS_ASYNC for socket write */
+    flags &= ~(PJ_IOQUEUE_ALWAYS_ASYNC | PJ_IOQUEUE_BATCH_SEND);
+
+    /* Fast track:
+     *   Try to send data immediately, only if there's no pending write!
+     */
+    if (!defer && pj_list_empty(&key->write_list)) {
+        sent = *length;
+        status = pj_sock_sendto(key->fd, data, &sent, flags, addr, addrlen);
+        if (status == PJ_SUCCESS) {
+            /* Success! */
+            *length = sent;
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * Check that address storage can hold the address parameter.
+     */
+    PJ_ASSERT_RETURN(addrlen <= (int)sizeof(pj_sockaddr), PJ_EBUG);
+
+    /*
+     * Schedule asynchronous send.
+     */
+    op = (struct uring_op*)op_key;
+    status = check_op_busy(op);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    op->op = PJ_IOQUEUE_OP_SEND_TO;
+    op->buf = (char*)data;
+    op->size = *length;
+    op->written = 0;
+    op->flags = flags;
+    pj_memcpy(&op->addr, addr, addrlen);
+    op->addr_len = addrlen;
+
+    return start_write(key, op);
+}
+
+#if PJ_HAS_TCP
+/*
+ * Initiate overlapped accept() operation.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_accept( pj_ioqueue_key_t *key,
+                                       pj_ioqueue_op_key_t *op_key,
+			               pj_sock_t *new_sock,
+			               pj_sockaddr_t *local,
+			               pj_sockaddr_t *remote,
+			               int *addrlen)
+{
+    struct uring_op *op;
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && op_key && new_sock, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    op = (struct uring_op*)op_key;
+    op->op = PJ_IOQUEUE_OP_NONE;
+
+    /* Fast track:
+     *  See if there's new connection available immediately.
+     */
+    if (pj_list_empty(&key->accept_list)) {
+        status = pj_sock_accept2(key->fd, new_sock, remote, addrlen,
+                                 PJ_SOCK_ACCEPT_NONBLOCK |
+                                 PJ_SOCK_ACCEPT_CLOEXEC);
+        if (status == PJ_SUCCESS) {
+            /* Yes! New connection is available! */
+            if (local && addrlen) {
+                status = pj_sock_getsockname(*new_sock, local, addrlen);
+                if (status != PJ_SUCCESS) {
+                    pj_sock_close(*new_sock);
+                    *new_sock = PJ_INVALID_SOCKET;
+                    return status;
+                }
+            }
+            return PJ_SUCCESS;
+        } else {
+            /* If error is not EWOULDBLOCK (or EAGAIN on Linux), report
+             * the error to caller.
+             */
+            if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_ERROR_VAL)) {
+                return status;
+            }
+        }
+    }
+
+    /*
+     * No connection is available immediately.
+     * Submit accept() operation to the kernel.
+     */
+    op->op = PJ_IOQUEUE_OP_ACCEPT;
+    op->accept_fd = new_sock;
+    op->rmt_addr = remote;
+    op->rmt_addrlen = addrlen;
+    op->local_addr = local;
+
+    pj_ioqueue_lock_key(key);
+    if (key->closing) {
+	op->op = PJ_IOQUEUE_OP_NONE;
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    pj_list_insert_before(&key->accept_list, op);
+    status = submit_op(key, op);
+    if (status != PJ_SUCCESS) {
+	pj_list_erase(op);
+	op->op = PJ_IOQUEUE_OP_NONE;
+    }
+    pj_ioqueue_unlock_key(key);
+
+    return status == PJ_SUCCESS ? PJ_EPENDING : status;
+}
+
+/*
+ * Initiate overlapped connect() operation (well, it's non-blocking actually,
+ * and the kernel tells us when the socket becomes writable).
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_connect( pj_ioqueue_key_t *key,
+					const pj_sockaddr_t *addr,
+					int addrlen )
+{
+    pj_status_t status;
+
+    /* check parameters. All must be specified! */
+    PJ_ASSERT_RETURN(key && addr && addrlen, PJ_EINVAL);
+
+    /* Check if key is closing. */
+    if (key->closing)
+	return PJ_ECANCELLED;
+
+    /* Check if socket has not been marked for connecting */
+    if (key->connecting != 0)
+        return PJ_EPENDING;
+
+    status = pj_sock_connect(key->fd, addr, addrlen);
+    if (status == PJ_SUCCESS) {
+	/* Connected! */
+	return PJ_SUCCESS;
+    } else if (status != PJ_STATUS_FROM_OS(PJ_BLOCKING_CONNECT_ERROR_VAL)) {
+	/* Error! */
+	return status;
+    }
+
+    /* Pending! */
+    pj_ioqueue_lock_key(key);
+    /* Check again. Handle may have been closed after the previous
+     * check in multithreaded app. See #913
+     */
+    if (key->closing) {
+	pj_ioqueue_unlock_key(key);
+	return PJ_ECANCELLED;
+    }
+    key->connecting = PJ_TRUE;
+    status = submit_op(key, &key->connect_op);
+    if (status != PJ_SUCCESS)
+	key->connecting = 0;
+    pj_ioqueue_unlock_key(key);
+
+    return status == PJ_SUCCESS ? PJ_EPENDING : status;
+}
+#endif	/* PJ_HAS_TCP */
+
+
+PJ_DEF(void) pj_ioqueue_op_key_init( pj_ioqueue_op_key_t *op_key,
+				     pj_size_t size )
+{
+    pj_bzero(op_key, size);
+}
+
+
+/*
+ * pj_ioqueue_is_pending()
+ */
+PJ_DEF(pj_bool_t) pj_ioqueue_is_pending( pj_ioqueue_key_t *key,
+                                         pj_ioqueue_op_key_t *op_key )
+{
+    struct uring_op *op_rec;
+
+    PJ_UNUSED_ARG(key);
+
+    op_rec = (struct uring_op*)op_key;
+    return op_rec->op != 0;
+}
+
+
+/*
+ * pj_ioqueue_post_completion()
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_post_completion( pj_ioqueue_key_t *key,
+                                                pj_ioqueue_op_key_t *op_key,
+                                                pj_ssize_t bytes_status )
+{
+    struct uring_op *lists[3];
+    unsigned i, cnt = 0;
+
+    lists[cnt++] = &key->read_list;
+    lists[cnt++] = &key->write_list;
+#if PJ_HAS_TCP
+    lists[cnt++] = &key->accept_list;
+#endif
+
+    /*
+     * Find the operation key in all pending operation list to
+     * really make sure that it's still there; then call the callback.
+     */
+    pj_ioqueue_lock_key(key);
+
+    for (i=0; i<cnt; ++i) {
+	struct uring_op *op = lists[i]->next;
+
+	while (op != lists[i] && op != (struct uring_op*)op_key)
+	    op = op->next;
+	if (op == lists[i])
+	    continue;
+
+	/* Take the operation back from the kernel first */
+	if (op->inflight) {
+	    cancel_op(key->ioqueue, op);
+	    wait_released(key, op);
+	}
+
+	pj_list_erase(op);
+	op->op = PJ_IOQUEUE_OP_NONE;
+
+	/* Start the next queued write on stream socket */
+	if (lists[i] == &key->write_list &&
+	    key->fd_type != pj_SOCK_DGRAM() &&
+	    !pj_list_empty(&key->write_list) &&
+	    !key->write_list.next->inflight && !key->closing)
+	{
+	    submit_op(key, key->write_list.next);
+	}
+	pj_ioqueue_unlock_key(key);
+
+	if (lists[i] == &key->read_list) {
+	    (*key->cb.on_read_complete)(key, op_key, bytes_status);
+	} else if (lists[i] == &key->write_list) {
+	    (*key->cb.on_write_complete)(key, op_key, bytes_status);
+	} else {
+	    (*key->cb.on_accept_complete)(key, op_key, PJ_INVALID_SOCKET,
+					  (pj_status_t)bytes_status);
+	}
+	return PJ_SUCCESS;
+    }
+
+    pj_ioqueue_unlock_key(key);
+
+    return PJ_EINVALIDOP;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_default_concurrency( pj_ioqueue_t *ioqueue,
+							pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(ioqueue != NULL, PJ_EINVAL);
+    ioqueue->default_concurrency = allow;
+    return PJ_SUCCESS;
+}
+
+
+PJ_DEF(pj_status_t) pj_ioqueue_set_concurrency(pj_ioqueue_key_t *key,
+					       pj_bool_t allow)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    key->allow_concurrent = allow;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Datagrams sent with PJ_IOQUEUE_BATCH_SEND from a completion callback
+ * are submitted together at the end of the poll.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_send_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    key->send_batch = max_cnt;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Pending reads are always submitted to the kernel and their completions
+ * are reaped in batches, so there is nothing to configure.
+ */
+PJ_DEF(pj_status_t) pj_ioqueue_set_recv_batch(pj_ioqueue_key_t *key,
+					      unsigned max_cnt)
+{
+    PJ_ASSERT_RETURN(key, PJ_EINVAL);
+    PJ_UNUSED_ARG(max_cnt);
+    return PJ_SUCCESS;
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_lock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+	return pj_grp_lock_acquire(key->grp_lock);
+    else
+	return pj_lock_acquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_trylock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+	return pj_grp_lock_tryacquire(key->grp_lock);
+    else
+	return pj_lock_tryacquire(key->lock);
+}
+
+PJ_DEF(pj_status_t) pj_ioqueue_unlock_key(pj_ioqueue_key_t *key)
+{
+    if (key->grp_lock)
+	return pj_grp_lock_release(key->grp_lock);
+    else
+	return pj_lock_release(key->lock);
+}
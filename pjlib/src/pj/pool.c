@@ -66,6 +66,9 @@ static pj_pool_block *pj_pool_create_block( pj_pool_t *pool, pj_size_t size)
 
     /* Add capacity. */
     pool->capacity += size;
+    if (pool->factory->on_pool_resize)
+	(*pool->factory->on_pool_resize)(pool->factory, pool,
+					 pool->capacity - size);
 
     /* Set start and end of buffer. */
     block->buf = ((unsigned char*)block) + sizeof(pj_pool_block);
@@ -236,6 +239,7 @@ PJ_DEF(pj_pool_t*) pj_pool_create_int( pj_pool_factory *f, const char *name,
 static void reset_pool(pj_pool_t *pool)
 {
     pj_pool_block *block;
+    pj_size_t old_capacity = pool->capacity;
 
     PJ_CHECK_STACK();
 
@@ -262,6 +266,9 @@ static void reset_pool(pj_pool_t *pool)
     block->cur = ALIGN_PTR(block->buf, PJ_POOL_ALIGNMENT);
 
     pool->capacity = block->end - (unsigned char*)pool;
+
+    if (pool->factory->on_pool_resize && pool->capacity != old_capacity)
+	(*pool->factory->on_pool_resize)(pool->factory, pool, old_capacity);
 }
 
 /*
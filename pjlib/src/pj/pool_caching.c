@@ -21,6 +21,8 @@
 #include <pj/log.h>
 #include <pj/string.h>
 #include <pj/assert.h>
+#include <pj/ctype.h>
+#include <pj/errno.h>
 #include <pj/lock.h>
 #include <pj/os.h>
 #include <pj/pool_buf.h>
@@ -36,6 +38,7 @@ static void cpool_release_pool(pj_pool_factory *pf, pj_pool_t *pool);
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail );
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz);
 static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz);
+static void cpool_release_thread(pj_pool_factory *f);
 
 
 static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] = 
@@ -49,6 +52,82 @@ static pj_size_t pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE] =
  */
 #define START_SIZE  5
 
+/* Counters which are updated outside the lock use atomic operations. */
+#if defined(__GNUC__) || defined(__clang__)
+#   define HAS_ATOMIC		1
+#   define ATOMIC_ADD(var, n)	__atomic_add_fetch(&(var), n, __ATOMIC_RELAXED)
+#   define ATOMIC_SUB(var, n)	__atomic_sub_fetch(&(var), n, __ATOMIC_RELAXED)
+#   define LOAD_ACQUIRE(var)	__atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#   define STORE_RELEASE(var, v) __atomic_store_n(&(var), v, __ATOMIC_RELEASE)
+#else
+#   define HAS_ATOMIC		0
+#   define ATOMIC_ADD(var, n)	((var) += (n))
+#   define ATOMIC_SUB(var, n)	((var) -= (n))
+#   define LOAD_ACQUIRE(var)	(var)
+#   define STORE_RELEASE(var, v) ((var) = (v))
+#endif
+
+/* Layout of factory_data of the pool: the index of the free list, flags,
+ * and the tag index plus one (zero if the pool is not tracked).
+ */
+#define POOL_IDX_MASK		0xFF
+#define TAG_SHIFT		16
+
+/* Per-thread pool caches (magazines), see PJ_CACHING_POOL_MAGAZINE_SIZE.
+ * They are only used for pools up to pool_sizes[MAG_MAX_IDX], and since
+ * pools are then created and released without the lock, the counters
+ * in the caching pool are updated with atomic operations.
+ */
+#if PJ_HAS_THREADS && PJ_CACHING_POOL_MAGAZINE_SIZE > 0 && HAS_ATOMIC
+#   define HAS_MAGAZINE		1
+#   define MAG_MAX_IDX		START_SIZE
+#   define MAG_SIZE		PJ_CACHING_POOL_MAGAZINE_SIZE
+#   define MAG_BATCH		((MAG_SIZE + 1) / 2)
+    /* Flag in factory_data of pools created from the magazine */
+#   define MAG_POOL_FLAG	0x100
+    /* Index of mag_used_list of the pool */
+#   define MAG_USED_IDX(pool)	((unsigned)(((pj_size_t)(pool) >> 6) % \
+					    PJ_CACHING_POOL_USED_LIST_CNT))
+
+typedef struct magazine
+{
+    PJ_DECL_LIST_MEMBER(struct magazine);
+    unsigned	count[MAG_MAX_IDX+1];
+    pj_pool_t  *pool[MAG_MAX_IDX+1][MAG_SIZE];
+} magazine;
+
+#else
+#   define HAS_MAGAZINE		0
+#endif
+
+/* Pool usage by tag, see PJ_CACHING_POOL_HAS_TAG_STAT. */
+#if PJ_CACHING_POOL_HAS_TAG_STAT && (HAS_ATOMIC || !PJ_HAS_THREADS)
+#   define HAS_TAG_STAT		1
+#   define OTHER_TAG		(PJ_CACHING_POOL_MAX_TAGS-1)
+
+static void cpool_on_pool_resize(pj_pool_factory *f, pj_pool_t *pool,
+				 pj_size_t old_capacity);
+#else
+#   define HAS_TAG_STAT		0
+#endif
+
+/* Update the high-water mark */
+static void update_peak(pj_size_t *peak, pj_size_t value)
+{
+#if HAS_ATOMIC
+    pj_size_t old = __atomic_load_n(peak, __ATOMIC_RELAXED);
+
+    while (value > old &&
+	   !__atomic_compare_exchange_n(peak, &old, value, PJ_TRUE,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+#else
+    if (value > *peak)
+	*peak = value;
+#endif
+}
+
 
 PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp, 
 				   const pj_pool_factory_policy *policy,
@@ -76,9 +155,24 @@ PJ_DEF(void) pj_caching_pool_init( pj_caching_pool *cp,
     cp->factory.dump_status = &cpool_dump_status;
     cp->factory.on_block_alloc = &cpool_on_block_alloc;
     cp->factory.on_block_free = &cpool_on_block_free;
+    cp->factory.release_thread = &cpool_release_thread;
 
     pool = pj_pool_create_on_buf("cachingpool", cp->pool_buf, sizeof(cp->pool_buf));
     pj_lock_create_simple_mutex(pool, "cachingpool", &cp->lock);
+
+    cp->tls_id = -1;
+    pj_list_init(&cp->magazine_list);
+    for (i=0; i<PJ_CACHING_POOL_USED_LIST_CNT; ++i)
+	pj_list_init(&cp->mag_used_list[i]);
+#if HAS_MAGAZINE
+    if (pj_thread_local_alloc(&cp->tls_id) != PJ_SUCCESS)
+	cp->tls_id = -1;
+#endif
+
+#if HAS_TAG_STAT
+    cp->factory.on_pool_resize = &cpool_on_pool_resize;
+    pj_ansi_strcpy(cp->tag_stat[OTHER_TAG].tag, "(other)");
+#endif
 }
 
 PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
@@ -88,6 +182,37 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
 
     PJ_CHECK_STACK();
 
+#if HAS_MAGAZINE
+    /* Delete all per-thread caches */
+    while (!pj_list_empty(&cp->magazine_list)) {
+	magazine *mag = (magazine*) cp->magazine_list.next;
+
+	pj_list_erase(mag);
+	for (i=0; i<=MAG_MAX_IDX; ++i) {
+	    while (mag->count[i])
+		pj_pool_destroy_int(mag->pool[i][--mag->count[i]]);
+	}
+	(*cp->factory.policy.block_free)(&cp->factory, mag, sizeof(magazine));
+    }
+    if (cp->tls_id != -1) {
+	pj_thread_local_free(cp->tls_id);
+	cp->tls_id = -1;
+    }
+
+    /* Delete pools created from the per-thread caches which are not
+     * released.
+     */
+    for (i=0; i < PJ_CACHING_POOL_USED_LIST_CNT; ++i) {
+	while (!pj_list_empty(&cp->mag_used_list[i])) {
+	    pool = (pj_pool_t*) cp->mag_used_list[i].next;
+	    pj_list_erase(pool);
+	    PJ_LOG(4,(pool->obj_name, 
+		      "Pool is not released by application, releasing now"));
+	    pj_pool_destroy_int(pool);
+	}
+    }
+#endif
+
     /* Delete all pool in free list */
     for (i=0; i < PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
 	pj_pool_t *next;
@@ -116,25 +241,11 @@ PJ_DEF(void) pj_caching_pool_destroy( pj_caching_pool *cp )
     }
 }
 
-static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
-					      const char *name, 
-					      pj_size_t initial_size, 
-					      pj_size_t increment_sz, 
-					      pj_pool_callback *callback)
+/* Get the index of the free list for the pool size. */
+static int get_size_idx(pj_size_t initial_size)
 {
-    pj_caching_pool *cp = (pj_caching_pool*)pf;
-    pj_pool_t *pool;
     int idx;
 
-    PJ_CHECK_STACK();
-
-    pj_lock_acquire(cp->lock);
-
-    /* Use pool factory's policy when callback is NULL */
-    if (callback == NULL) {
-	callback = pf->policy.callback;
-    }
-
     /* Search the suitable size for the pool. 
      * We'll just do linear search to the size array, as the array size itself
      * is only a few elements. Binary search I suspect will be less efficient
@@ -154,6 +265,281 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 	    ;
     }
 
+    return idx;
+}
+
+#if HAS_TAG_STAT
+/* Get the index of the tag of the pool name, adding it if necessary. */
+static unsigned get_tag(pj_caching_pool *cp, const char *name)
+{
+    char tag[PJ_POOL_TAG_LEN];
+    unsigned i, len, cnt;
+
+    for (len=0; name && name[len] && len < sizeof(tag)-1; ++len) {
+	if (name[len] == '%' || pj_isdigit(name[len]))
+	    break;
+	tag[len] = name[len];
+    }
+    if (len == 0) {
+	pj_ansi_strcpy(tag, "pool");
+    } else {
+	tag[len] = '\0';
+    }
+
+    /* Tags are only added, so they can be searched without the lock */
+    cnt = LOAD_ACQUIRE(cp->tag_cnt);
+    for (i=0; i<cnt; ++i) {
+	if (pj_ansi_strcmp(cp->tag_stat[i].tag, tag) == 0)
+	    return i;
+    }
+
+    pj_lock_acquire(cp->lock);
+
+    /* Search again, the tag may have been added by another thread */
+    for (; i<cp->tag_cnt; ++i) {
+	if (pj_ansi_strcmp(cp->tag_stat[i].tag, tag) == 0)
+	    break;
+    }
+    if (i == cp->tag_cnt) {
+	if (i < OTHER_TAG) {
+	    pj_ansi_strcpy(cp->tag_stat[i].tag, tag);
+	    STORE_RELEASE(cp->tag_cnt, i+1);
+	} else {
+	    i = OTHER_TAG;
+	}
+    }
+
+    pj_lock_release(cp->lock);
+
+    return i;
+}
+
+/* Account new pool to its tag. */
+static void tag_on_create(pj_caching_pool *cp, pj_pool_t *pool,
+			  const char *name)
+{
+    unsigned tag = get_tag(cp, name);
+    pj_pool_tag_stat *st = &cp->tag_stat[tag];
+    pj_ssize_t fd = (pj_ssize_t) pool->factory_data;
+
+    pool->factory_data = (void*) (fd | ((pj_ssize_t)(tag+1) << TAG_SHIFT));
+
+    ATOMIC_ADD(st->create_cnt, 1);
+    update_peak(&st->peak_pool_cnt, ATOMIC_ADD(st->pool_cnt, 1));
+    update_peak(&st->peak_capacity, ATOMIC_ADD(st->capacity, pool->capacity));
+}
+
+/* Account released pool to its tag. */
+static void tag_on_release(pj_caching_pool *cp, pj_pool_t *pool)
+{
+    pj_ssize_t fd = (pj_ssize_t) pool->factory_data;
+    unsigned tag = (unsigned) (fd >> TAG_SHIFT);
+    pj_pool_tag_stat *st;
+    pj_size_t capacity;
+
+    if (tag == 0)
+	return;
+
+    /* Stop tracking the pool, it may be reset or destroyed after this */
+    pool->factory_data = (void*) (fd & (((pj_ssize_t)1 << TAG_SHIFT) - 1));
+
+    st = &cp->tag_stat[tag-1];
+    capacity = pj_pool_get_capacity(pool);
+
+    ATOMIC_SUB(st->pool_cnt, 1);
+    ATOMIC_SUB(st->capacity, capacity);
+    ATOMIC_ADD(st->slack, capacity - pj_pool_get_used_size(pool));
+    update_peak(&st->max_pool_capacity, capacity);
+}
+
+/* Callback when pool has grown or has been reset. */
+static void cpool_on_pool_resize(pj_pool_factory *f, pj_pool_t *pool,
+				 pj_size_t old_capacity)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)f;
+    unsigned tag = (unsigned) ((pj_ssize_t)pool->factory_data >> TAG_SHIFT);
+    pj_pool_tag_stat *st;
+
+    if (tag == 0)
+	return;
+
+    st = &cp->tag_stat[tag-1];
+    if (pool->capacity > old_capacity) {
+	pj_size_t capacity;
+
+	ATOMIC_ADD(st->block_cnt, 1);
+	capacity = ATOMIC_ADD(st->capacity, pool->capacity - old_capacity);
+	update_peak(&st->peak_capacity, capacity);
+    } else {
+	ATOMIC_SUB(st->capacity, old_capacity - pool->capacity);
+    }
+}
+
+#else
+#   define tag_on_create(cp, pool, name)
+#   define tag_on_release(cp, pool)
+#endif	/* HAS_TAG_STAT */
+
+#if HAS_MAGAZINE
+/* Lock a list of mag_used_list. The lists are only held for a few list
+ * operations, and a mutex for each list would not fit in the internal
+ * pool, so they are protected with spinlocks.
+ */
+static void mag_used_lock(pj_caching_pool *cp, unsigned i)
+{
+    while (__atomic_exchange_n(&cp->mag_used_busy[i], 1, __ATOMIC_ACQUIRE))
+	pj_thread_sleep(0);
+}
+
+static void mag_used_unlock(pj_caching_pool *cp, unsigned i)
+{
+    __atomic_store_n(&cp->mag_used_busy[i], 0, __ATOMIC_RELEASE);
+}
+
+/* Get the pool cache of the calling thread. */
+static magazine *get_magazine(pj_caching_pool *cp)
+{
+    magazine *mag;
+
+    if (cp->tls_id == -1)
+	return NULL;
+
+    mag = (magazine*) pj_thread_local_get(cp->tls_id);
+    if (mag)
+	return mag;
+
+    /* First use in this thread */
+    mag = (magazine*) (*cp->factory.policy.block_alloc)(&cp->factory,
+							 sizeof(magazine));
+    if (!mag)
+	return NULL;
+    pj_bzero(mag, sizeof(*mag));
+
+    if (pj_thread_local_set(cp->tls_id, mag) != PJ_SUCCESS) {
+	(*cp->factory.policy.block_free)(&cp->factory, mag, sizeof(magazine));
+	return NULL;
+    }
+
+    pj_lock_acquire(cp->lock);
+    pj_list_push_back(&cp->magazine_list, mag);
+    pj_lock_release(cp->lock);
+
+    return mag;
+}
+
+/* Create pool from the pool cache of the calling thread. */
+static pj_pool_t* mag_create_pool(pj_caching_pool *cp, magazine *mag,
+				  int idx, const char *name,
+				  pj_size_t increment_sz,
+				  pj_pool_callback *callback)
+{
+    pj_pool_t *pool;
+    unsigned used_idx;
+
+    /* Refill the magazine from the shared free list. The pools stay
+     * counted in the capacity.
+     */
+    if (mag->count[idx] == 0) {
+	pj_lock_acquire(cp->lock);
+	while (mag->count[idx] < MAG_BATCH &&
+	       !pj_list_empty(&cp->free_list[idx]))
+	{
+	    pool = (pj_pool_t*) cp->free_list[idx].next;
+	    pj_list_erase(pool);
+	    mag->pool[idx][mag->count[idx]++] = pool;
+	}
+	pj_lock_release(cp->lock);
+    }
+
+    if (mag->count[idx]) {
+	pool = mag->pool[idx][--mag->count[idx]];
+	ATOMIC_SUB(cp->capacity, pj_pool_get_capacity(pool));
+	pj_pool_init_int(pool, name, increment_sz, callback);
+	PJ_LOG(6, (pool->obj_name, "pool reused, size=%u", pool->capacity));
+    } else {
+	pool = pj_pool_create_int(&cp->factory, name, pool_sizes[idx], 
+				  increment_sz, callback);
+	if (!pool)
+	    return NULL;
+    }
+
+    /* Put in used list. */
+    used_idx = MAG_USED_IDX(pool);
+    mag_used_lock(cp, used_idx);
+    pj_list_insert_before(&cp->mag_used_list[used_idx], pool);
+    mag_used_unlock(cp, used_idx);
+
+    pool->factory_data = (void*) (pj_ssize_t) (idx | MAG_POOL_FLAG);
+    tag_on_create(cp, pool, name);
+
+    ATOMIC_ADD(cp->used_count, 1);
+
+    return pool;
+}
+
+/* Put back pool to the pool cache of the calling thread. */
+static void mag_release_pool(pj_caching_pool *cp, magazine *mag,
+			     pj_pool_t *pool, int idx)
+{
+    pj_size_t pool_capacity;
+
+    ATOMIC_SUB(cp->used_count, 1);
+
+    PJ_LOG(6, (pool->obj_name, "recycle(): cap=%d, used=%d", 
+	       pj_pool_get_capacity(pool), pj_pool_get_used_size(pool)));
+    pj_pool_reset(pool);
+
+    /* Destroy the pool if it would exceed the maximum capacity */
+    pool_capacity = pj_pool_get_capacity(pool);
+    if (ATOMIC_ADD(cp->capacity, pool_capacity) > cp->max_capacity) {
+	ATOMIC_SUB(cp->capacity, pool_capacity);
+	pj_pool_destroy_int(pool);
+	return;
+    }
+
+    /* Move half of the magazine to the shared free list when it's full */
+    if (mag->count[idx] == MAG_SIZE) {
+	pj_lock_acquire(cp->lock);
+	while (mag->count[idx] > MAG_SIZE - MAG_BATCH) {
+	    pj_list_insert_after(&cp->free_list[idx],
+				 mag->pool[idx][--mag->count[idx]]);
+	}
+	pj_lock_release(cp->lock);
+    }
+
+    mag->pool[idx][mag->count[idx]++] = pool;
+}
+#endif	/* HAS_MAGAZINE */
+
+static pj_pool_t* cpool_create_pool(pj_pool_factory *pf, 
+					      const char *name, 
+					      pj_size_t initial_size, 
+					      pj_size_t increment_sz, 
+					      pj_pool_callback *callback)
+{
+    pj_caching_pool *cp = (pj_caching_pool*)pf;
+    pj_pool_t *pool;
+    int idx;
+
+    PJ_CHECK_STACK();
+
+    /* Use pool factory's policy when callback is NULL */
+    if (callback == NULL) {
+	callback = pf->policy.callback;
+    }
+
+    idx = get_size_idx(initial_size);
+
+#if HAS_MAGAZINE
+    if (idx <= MAG_MAX_IDX) {
+	magazine *mag = get_magazine(cp);
+	if (mag)
+	    return mag_create_pool(cp, mag, idx, name, increment_sz, callback);
+    }
+#endif
+
+    pj_lock_acquire(cp->lock);
+
     /* Check whether there's a pool in the list. */
     if (idx==PJ_CACHING_POOL_ARRAY_SIZE || pj_list_empty(&cp->free_list[idx])) {
 	/* No pool is available. */
@@ -178,11 +564,7 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
 	pj_pool_init_int(pool, name, increment_sz, callback);
 
 	/* Update pool manager's free capacity. */
-	if (cp->capacity > pj_pool_get_capacity(pool)) {
-	    cp->capacity -= pj_pool_get_capacity(pool);
-	} else {
-	    cp->capacity = 0;
-	}
+	ATOMIC_SUB(cp->capacity, pj_pool_get_capacity(pool));
 
 	PJ_LOG(6, (pool->obj_name, "pool reused, size=%u", pool->capacity));
     }
@@ -194,9 +576,11 @@ static pj_pool_t* cpool_create_pool(pj_pool_factory *pf,
     pool->factory_data = (void*) (pj_ssize_t) idx;
 
     /* Increment used count. */
-    ++cp->used_count;
+    ATOMIC_ADD(cp->used_count, 1);
 
     pj_lock_release(cp->lock);
+
+    tag_on_create(cp, pool, name);
     return pool;
 }
 
@@ -210,21 +594,55 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
 
     PJ_ASSERT_ON_FAIL(pf && pool, return);
 
-    pj_lock_acquire(cp->lock);
+    tag_on_release(cp, pool);
+
+    i = (unsigned) (unsigned long) (pj_ssize_t) pool->factory_data;
+
+#if HAS_MAGAZINE
+    if (i & MAG_POOL_FLAG) {
+	unsigned used_idx = MAG_USED_IDX(pool);
+	magazine *mag;
 
+	mag_used_lock(cp, used_idx);
 #if PJ_SAFE_POOL
-    /* Make sure pool is still in our used list */
-    if (pj_list_find_node(&cp->used_list, pool) != pool) {
-	pj_assert(!"Attempt to destroy pool that has been destroyed before");
-	return;
-    }
+	/* Make sure pool is still in our used list */
+	if (pj_list_find_node(&cp->mag_used_list[used_idx], pool) != pool) {
+	    mag_used_unlock(cp, used_idx);
+	    pj_assert(!"Attempt to destroy pool that has been destroyed before");
+	    return;
+	}
+#endif
+	pj_list_erase(pool);
+	mag_used_unlock(cp, used_idx);
+
+	mag = get_magazine(cp);
+	i &= POOL_IDX_MASK;
+	if (mag && i <= MAG_MAX_IDX) {
+	    mag_release_pool(cp, mag, pool, i);
+	    return;
+	}
+
+	/* Put it in the shared free list below. */
+	pj_lock_acquire(cp->lock);
+    } else
+#endif
+    {
+	pj_lock_acquire(cp->lock);
+
+#if PJ_SAFE_POOL
+	/* Make sure pool is still in our used list */
+	if (pj_list_find_node(&cp->used_list, pool) != pool) {
+	    pj_assert(!"Attempt to destroy pool that has been destroyed before");
+	    return;
+	}
 #endif
 
-    /* Erase from the used list. */
-    pj_list_erase(pool);
+	/* Erase from the used list. */
+	pj_list_erase(pool);
+    }
 
     /* Decrement used count. */
-    --cp->used_count;
+    ATOMIC_SUB(cp->used_count, 1);
 
     pool_capacity = pj_pool_get_capacity(pool);
 
@@ -233,7 +651,7 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
      * maximum capacity.
    . */
     if (pool_capacity > pool_sizes[PJ_CACHING_POOL_ARRAY_SIZE-1] ||
-	cp->capacity + pool_capacity > cp->max_capacity)
+	LOAD_ACQUIRE(cp->capacity) + pool_capacity > cp->max_capacity)
     {
 	pj_pool_destroy_int(pool);
 	pj_lock_release(cp->lock);
@@ -251,8 +669,6 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     /*
      * Otherwise put the pool in our recycle list.
      */
-    i = (unsigned) (unsigned long) (pj_ssize_t) pool->factory_data;
-
     pj_assert(i<PJ_CACHING_POOL_ARRAY_SIZE);
     if (i >= PJ_CACHING_POOL_ARRAY_SIZE ) {
 	/* Something has gone wrong with the pool. */
@@ -262,11 +678,67 @@ static void cpool_release_pool( pj_pool_factory *pf, pj_pool_t *pool)
     }
 
     pj_list_insert_after(&cp->free_list[i], pool);
-    cp->capacity += pool_capacity;
+    ATOMIC_ADD(cp->capacity, pool_capacity);
 
     pj_lock_release(cp->lock);
 }
 
+/* Move the pools in the cache of the calling thread to the shared free
+ * lists and delete the cache.
+ */
+static void cpool_release_thread(pj_pool_factory *pf)
+{
+#if HAS_MAGAZINE
+    pj_caching_pool *cp = (pj_caching_pool*)pf;
+    magazine *mag;
+    int i;
+
+    if (cp->tls_id == -1)
+	return;
+
+    mag = (magazine*) pj_thread_local_get(cp->tls_id);
+    if (!mag)
+	return;
+    pj_thread_local_set(cp->tls_id, NULL);
+
+    /* The pools are already counted in the capacity */
+    pj_lock_acquire(cp->lock);
+    pj_list_erase(mag);
+    for (i=0; i<=MAG_MAX_IDX; ++i) {
+	while (mag->count[i]) {
+	    pj_list_insert_after(&cp->free_list[i],
+				 mag->pool[i][--mag->count[i]]);
+	}
+    }
+    pj_lock_release(cp->lock);
+
+    (*cp->factory.policy.block_free)(&cp->factory, mag, sizeof(magazine));
+#else
+    PJ_UNUSED_ARG(pf);
+#endif
+}
+
+#if PJ_LOG_MAX_LEVEL >= 3
+/* Dump the pools in the list. */
+static void dump_pool_list(pj_list *list, pj_size_t *total_used,
+			   pj_size_t *total_capacity)
+{
+    pj_pool_t *pool = (pj_pool_t*) list->next;
+
+    while (pool != (void*)list) {
+	pj_size_t pool_capacity = pj_pool_get_capacity(pool);
+	PJ_LOG(3,("cachpool", "   %16s: %8d of %8d (%d%%) used", 
+			      pj_pool_getobjname(pool), 
+			      pj_pool_get_used_size(pool), 
+			      pool_capacity,
+			      pj_pool_get_used_size(pool)*100/pool_capacity));
+	*total_used += pj_pool_get_used_size(pool);
+	*total_capacity += pool_capacity;
+	pool = pool->next;
+    }
+}
+#endif
+
 static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
 {
 #if PJ_LOG_MAX_LEVEL >= 3
@@ -278,20 +750,21 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
     PJ_LOG(3,("cachpool", "   Capacity=%u, max_capacity=%u, used_cnt=%u", \
 			     cp->capacity, cp->max_capacity, cp->used_count));
     if (detail) {
-	pj_pool_t *pool = (pj_pool_t*) cp->used_list.next;
 	pj_size_t total_used = 0, total_capacity = 0;
         PJ_LOG(3,("cachpool", "  Dumping all active pools:"));
-	while (pool != (void*)&cp->used_list) {
-	    pj_size_t pool_capacity = pj_pool_get_capacity(pool);
-	    PJ_LOG(3,("cachpool", "   %16s: %8d of %8d (%d%%) used", 
-				  pj_pool_getobjname(pool), 
-				  pj_pool_get_used_size(pool), 
-				  pool_capacity,
-				  pj_pool_get_used_size(pool)*100/pool_capacity));
-	    total_used += pj_pool_get_used_size(pool);
-	    total_capacity += pool_capacity;
-	    pool = pool->next;
+	dump_pool_list(&cp->used_list, &total_used, &total_capacity);
+#if HAS_MAGAZINE
+	{
+	    unsigned i;
+
+	    for (i=0; i<PJ_CACHING_POOL_USED_LIST_CNT; ++i) {
+		mag_used_lock(cp, i);
+		dump_pool_list(&cp->mag_used_list[i], &total_used,
+			       &total_capacity);
+		mag_used_unlock(cp, i);
+	    }
 	}
+#endif
 	if (total_capacity) {
 	    PJ_LOG(3,("cachpool", "  Total %9d of %9d (%d %%) used!",
 				  total_used, total_capacity,
@@ -300,12 +773,79 @@ static void cpool_dump_status(pj_pool_factory *factory, pj_bool_t detail )
     }
 
     pj_lock_release(cp->lock);
+
+    if (detail)
+	pj_caching_pool_dump_tag_stat(cp);
 #else
     PJ_UNUSED_ARG(factory);
     PJ_UNUSED_ARG(detail);
 #endif
 }
 
+PJ_DEF(pj_status_t) pj_caching_pool_get_tag_stat(pj_caching_pool *cp,
+						 pj_pool_tag_stat stat[],
+						 unsigned *count)
+{
+#if HAS_TAG_STAT
+    unsigned i, cnt, n = 0;
+
+    PJ_ASSERT_RETURN(cp && stat && count, PJ_EINVAL);
+
+    cnt = LOAD_ACQUIRE(cp->tag_cnt);
+    for (i=0; i<cnt && n<*count; ++i)
+	stat[n++] = cp->tag_stat[i];
+
+    /* Only report the overflow tag when it has been used */
+    if (n < *count && cp->tag_stat[OTHER_TAG].create_cnt)
+	stat[n++] = cp->tag_stat[OTHER_TAG];
+
+    *count = n;
+    return PJ_SUCCESS;
+#else
+    PJ_UNUSED_ARG(cp);
+    PJ_UNUSED_ARG(stat);
+    *count = 0;
+    return PJ_ENOTSUP;
+#endif
+}
+
+PJ_DEF(void) pj_caching_pool_dump_tag_stat(pj_caching_pool *cp)
+{
+#if PJ_LOG_MAX_LEVEL >= 3
+    pj_pool_tag_stat stat[PJ_CACHING_POOL_MAX_TAGS];
+    unsigned i, count = PJ_ARRAY_SIZE(stat);
+
+    if (pj_caching_pool_get_tag_stat(cp, stat, &count) != PJ_SUCCESS) {
+	PJ_LOG(3,("cachpool", " Pool usage by tag is not available, rebuild "
+			      "with PJ_CACHING_POOL_HAS_TAG_STAT enabled"));
+	return;
+    }
+
+    PJ_LOG(3,("cachpool", " Dumping pool usage by tag:"));
+    PJ_LOG(3,("cachpool", "   %-15s %11s %19s %8s %7s %8s %8s",
+			  "tag", "pools/peak", "capacity/peak", "created",
+			  "blocks", "max", "slack"));
+    for (i=0; i<count; ++i) {
+	const pj_pool_tag_stat *st = &stat[i];
+	unsigned long released = (unsigned long)(st->create_cnt -
+						 st->pool_cnt);
+
+	PJ_LOG(3,("cachpool", "   %-15s %5lu/%-5lu %9lu/%-9lu %8lu %7lu %8lu %8lu",
+			      st->tag,
+			      (unsigned long)st->pool_cnt,
+			      (unsigned long)st->peak_pool_cnt,
+			      (unsigned long)st->capacity,
+			      (unsigned long)st->peak_capacity,
+			      (unsigned long)st->create_cnt,
+			      (unsigned long)st->block_cnt,
+			      (unsigned long)st->max_pool_capacity,
+			      released ? (unsigned long)st->slack/released : 0));
+    }
+#else
+    PJ_UNUSED_ARG(cp);
+#endif
+}
+
 
 static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz)
 {
@@ -314,9 +854,7 @@ static pj_bool_t cpool_on_block_alloc(pj_pool_factory *f, pj_size_t sz)
     //Can't lock because mutex is not recursive
     //if (cp->mutex) pj_mutex_lock(cp->mutex);
 
-    cp->used_size += sz;
-    if (cp->used_size > cp->peak_used_size)
-	cp->peak_used_size = cp->used_size;
+    update_peak(&cp->peak_used_size, ATOMIC_ADD(cp->used_size, sz));
 
     //if (cp->mutex) pj_mutex_unlock(cp->mutex);
 
@@ -329,7 +867,7 @@ static void cpool_on_block_free(pj_pool_factory *f, pj_size_t sz)
     pj_caching_pool *cp = (pj_caching_pool*)f;
 
     //pj_mutex_lock(cp->mutex);
-    cp->used_size -= sz;
+    ATOMIC_SUB(cp->used_size, sz);
     //pj_mutex_unlock(cp->mutex);
 }
 
@@ -17,6 +17,11 @@
  * along with this program; if not, write to the Free Software
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA 
  */
+
+/* Needed for accept4() */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
 #include <pj/sock.h>
 #include <pj/os.h>
 #include <pj/assert.h>
@@ -151,6 +156,11 @@ const pj_uint16_t PJ_SO_NOSIGPIPE = SO_NOSIGPIPE;
 #else
 const pj_uint16_t PJ_SO_NOSIGPIPE = 0xFFFF;
 #endif
+#ifdef SO_REUSEPORT
+const pj_uint16_t PJ_SO_REUSEPORT = SO_REUSEPORT;
+#else
+const pj_uint16_t PJ_SO_REUSEPORT = 0xFFFF;
+#endif
 #if defined(SO_PRIORITY)
 const pj_uint16_t PJ_SO_PRIORITY = SO_PRIORITY;
 #else
@@ -687,6 +697,81 @@ PJ_DEF(pj_status_t) pj_sock_send(pj_sock_t sock,
 }
 
 
+/*
+ * Send several buffers.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendv(pj_sock_t sock,
+				  const pj_sock_iovec iov[],
+				  unsigned iovcnt,
+				  pj_ssize_t *len,
+				  unsigned flags)
+{
+#if defined(PJ_SOCK_HAS_SENDMSG) && PJ_SOCK_HAS_SENDMSG!=0
+    struct iovec msg_iov[PJ_SOCK_MAX_IOV];
+    struct msghdr msg;
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(iov && iovcnt && len, PJ_EINVAL);
+
+    if (iovcnt > PJ_SOCK_MAX_IOV)
+	iovcnt = PJ_SOCK_MAX_IOV;
+
+    for (i = 0; i < iovcnt; ++i) {
+	msg_iov[i].iov_base = (void*)iov[i].buf;
+	msg_iov[i].iov_len = iov[i].len;
+    }
+
+    pj_bzero(&msg, sizeof(msg));
+    msg.msg_iov = msg_iov;
+    msg.msg_iovlen = iovcnt;
+
+#ifdef MSG_NOSIGNAL
+    /* Suppress SIGPIPE, as pj_sock_send() does */
+    flags |= MSG_NOSIGNAL;
+#endif
+
+    *len = sendmsg(sock, &msg, flags);
+
+    if (*len < 0)
+	return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+    else
+	return PJ_SUCCESS;
+#else
+    pj_ssize_t total = 0;
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(iov && iovcnt && len, PJ_EINVAL);
+
+    if (iovcnt > PJ_SOCK_MAX_IOV)
+	iovcnt = PJ_SOCK_MAX_IOV;
+
+    for (i = 0; i < iovcnt; ++i) {
+	pj_ssize_t size = (pj_ssize_t)iov[i].len;
+	pj_status_t status;
+
+	status = pj_sock_send(sock, iov[i].buf, &size, flags);
+	if (status != PJ_SUCCESS) {
+	    /* Only report error when nothing has been sent */
+	    if (total == 0) {
+		*len = -1;
+		return status;
+	    }
+	    break;
+	}
+
+	total += size;
+	if (size < (pj_ssize_t)iov[i].len)
+	    break;
+    }
+
+    *len = total;
+    return PJ_SUCCESS;
+#endif
+}
+
+
 /*
  * Send data.
  */
@@ -903,6 +988,60 @@ PJ_DEF(pj_status_t) pj_sock_accept( pj_sock_t serverfd,
 	return PJ_SUCCESS;
     }
 }
+
+/*
+ * Accept incoming connections and set the flags of the new socket.
+ */
+PJ_DEF(pj_status_t) pj_sock_accept2( pj_sock_t serverfd,
+				     pj_sock_t *newsock,
+				     pj_sockaddr_t *addr,
+				     int *addrlen,
+				     unsigned flags)
+{
+#if defined(PJ_SOCK_HAS_ACCEPT4) && PJ_SOCK_HAS_ACCEPT4!=0
+    int sflags = 0;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(newsock != NULL, PJ_EINVAL);
+
+    if (flags & PJ_SOCK_ACCEPT_NONBLOCK)
+	sflags |= SOCK_NONBLOCK;
+    if (flags & PJ_SOCK_ACCEPT_CLOEXEC)
+	sflags |= SOCK_CLOEXEC;
+
+    *newsock = accept4(serverfd, (struct sockaddr*)addr, (socklen_t*)addrlen,
+		       sflags);
+    if (*newsock==PJ_INVALID_SOCKET)
+	return PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+
+    return PJ_SUCCESS;
+#else
+    pj_status_t status;
+
+    status = pj_sock_accept(serverfd, newsock, addr, addrlen);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (flags & PJ_SOCK_ACCEPT_NONBLOCK) {
+#   if defined(PJ_WIN32) && PJ_WIN32!=0 || \
+       defined(PJ_WIN64) && PJ_WIN64 != 0 || \
+       defined(PJ_WIN32_WINCE) && PJ_WIN32_WINCE!=0
+	u_long value = 1;
+	if (ioctlsocket(*newsock, FIONBIO, &value)) {
+#   else
+	int value = 1;
+	if (ioctl(*newsock, FIONBIO, &value)) {
+#   endif
+	    status = PJ_RETURN_OS_ERROR(pj_get_native_netos_error());
+	    pj_sock_close(*newsock);
+	    *newsock = PJ_INVALID_SOCKET;
+	    return status;
+	}
+    }
+
+    return PJ_SUCCESS;
+#endif
+}
 #endif	/* PJ_HAS_TCP */
 
 
@@ -1327,6 +1327,11 @@ PJ_DEF(pj_uint16_t) pj_SO_NOSIGPIPE(void)
     return PJ_SO_NOSIGPIPE;
 }
 
+PJ_DEF(pj_uint16_t) pj_SO_REUSEPORT(void)
+{
+    return PJ_SO_REUSEPORT;
+}
+
 PJ_DEF(pj_uint16_t) pj_SO_PRIORITY(void)
 {
     return PJ_SO_PRIORITY;
@@ -54,6 +54,7 @@ const pj_uint16_t PJ_SOL_TCP	= 0xFFFF;
 const pj_uint16_t PJ_SOL_UDP	= 0xFFFF;
 const pj_uint16_t PJ_SOL_IPV6	= 0xFFFF;
 const pj_uint16_t PJ_SO_NOSIGPIPE = 0xFFFF;
+const pj_uint16_t PJ_SO_REUSEPORT = 0xFFFF;
 
 /* TOS */
 const pj_uint16_t PJ_IP_TOS		= 0;
@@ -672,6 +673,48 @@ PJ_DEF(pj_status_t) pj_sock_send(pj_sock_t sock,
 }
 
 
+/*
+ * Send several buffers, one by one.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendv(pj_sock_t sock,
+				  const pj_sock_iovec iov[],
+				  unsigned iovcnt,
+				  pj_ssize_t *len,
+				  unsigned flags)
+{
+    pj_ssize_t total = 0;
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(iov && iovcnt && len, PJ_EINVAL);
+
+    if (iovcnt > PJ_SOCK_MAX_IOV)
+	iovcnt = PJ_SOCK_MAX_IOV;
+
+    for (i = 0; i < iovcnt; ++i) {
+	pj_ssize_t size = (pj_ssize_t)iov[i].len;
+	pj_status_t status;
+
+	status = pj_sock_send(sock, iov[i].buf, &size, flags);
+	if (status != PJ_SUCCESS) {
+	    /* Only report error when nothing has been sent */
+	    if (total == 0) {
+		*len = -1;
+		return status;
+	    }
+	    break;
+	}
+
+	total += size;
+	if (size < (pj_ssize_t)iov[i].len)
+	    break;
+    }
+
+    *len = total;
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Send data.
  */
@@ -1016,6 +1059,20 @@ PJ_DEF(pj_status_t) pj_sock_accept( pj_sock_t serverfd,
 
     return PJ_SUCCESS;
 }
+
+/*
+ * Accept incoming connections and set the flags of the new socket.
+ */
+PJ_DEF(pj_status_t) pj_sock_accept2( pj_sock_t serverfd,
+				     pj_sock_t *newsock,
+				     pj_sockaddr_t *addr,
+				     int *addrlen,
+				     unsigned flags)
+{
+    /* Sockets are always managed asynchronously here */
+    PJ_UNUSED_ARG(flags);
+    return pj_sock_accept(serverfd, newsock, addr, addrlen);
+}
 #endif	/* PJ_HAS_TCP */
 
 
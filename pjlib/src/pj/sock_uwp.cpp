@@ -143,6 +143,11 @@ const pj_uint16_t PJ_SO_NOSIGPIPE = SO_NOSIGPIPE;
 #else
 const pj_uint16_t PJ_SO_NOSIGPIPE = 0xFFFF;
 #endif
+#ifdef SO_REUSEPORT
+const pj_uint16_t PJ_SO_REUSEPORT = SO_REUSEPORT;
+#else
+const pj_uint16_t PJ_SO_REUSEPORT = 0xFFFF;
+#endif
 #if defined(SO_PRIORITY)
 const pj_uint16_t PJ_SO_PRIORITY = SO_PRIORITY;
 #else
@@ -1295,6 +1300,48 @@ PJ_DEF(pj_status_t) pj_sock_send(pj_sock_t sock,
 }
 
 
+/*
+ * Send several buffers, one by one.
+ */
+PJ_DEF(pj_status_t) pj_sock_sendv(pj_sock_t sock,
+				  const pj_sock_iovec iov[],
+				  unsigned iovcnt,
+				  pj_ssize_t *len,
+				  unsigned flags)
+{
+    pj_ssize_t total = 0;
+    unsigned i;
+
+    PJ_CHECK_STACK();
+    PJ_ASSERT_RETURN(iov && iovcnt && len, PJ_EINVAL);
+
+    if (iovcnt > PJ_SOCK_MAX_IOV)
+	iovcnt = PJ_SOCK_MAX_IOV;
+
+    for (i = 0; i < iovcnt; ++i) {
+	pj_ssize_t size = (pj_ssize_t)iov[i].len;
+	pj_status_t status;
+
+	status = pj_sock_send(sock, iov[i].buf, &size, flags);
+	if (status != PJ_SUCCESS) {
+	    /* Only report error when nothing has been sent */
+	    if (total == 0) {
+		*len = -1;
+		return status;
+	    }
+	    break;
+	}
+
+	total += size;
+	if (size < (pj_ssize_t)iov[i].len)
+	    break;
+    }
+
+    *len = total;
+    return PJ_SUCCESS;
+}
+
+
 /*
  * Send data.
  */
@@ -1499,4 +1546,18 @@ PJ_DEF(pj_status_t) pj_sock_accept( pj_sock_t serverfd,
 
     return PJ_SUCCESS;
 }
+
+/*
+ * Accept incoming connections and set the flags of the new socket.
+ */
+PJ_DEF(pj_status_t) pj_sock_accept2( pj_sock_t serverfd,
+				     pj_sock_t *newsock,
+				     pj_sockaddr_t *addr,
+				     int *addrlen,
+				     unsigned flags)
+{
+    /* Sockets are always managed asynchronously here */
+    PJ_UNUSED_ARG(flags);
+    return pj_sock_accept(serverfd, newsock, addr, addrlen);
+}
 #endif	/* PJ_HAS_TCP */
@@ -49,10 +49,40 @@
 #include <openssl/bio.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
 #include <openssl/x509v3.h>
 #include <openssl/rand.h>
 #include <openssl/opensslconf.h>
 
+/* Kernel TLS send offload, OpenSSL passes the record keys to the write
+ * BIO, which installs them to the socket.
+ */
+#if PJ_SSL_SOCK_HAS_KTLS && OPENSSL_VERSION_NUMBER >= 0x30000000L && \
+    !defined(OPENSSL_NO_KTLS) && defined(SSL_OP_ENABLE_KTLS)
+#   define SSL_SOCK_USE_KTLS	1
+#   include <linux/tls.h>
+#   include <netinet/in.h>
+#   include <sys/socket.h>
+/* OpenSSL internal BIO controls, the values are reserved in bio.h */
+#   ifndef BIO_CTRL_SET_KTLS
+#	define BIO_CTRL_SET_KTLS			72
+#   endif
+#   ifndef BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG
+#	define BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG	74
+#   endif
+#   ifndef BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG
+#	define BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG		75
+#   endif
+#   ifndef SOL_TLS
+#	define SOL_TLS		282
+#   endif
+#   ifndef TCP_ULP
+#	define TCP_ULP		31
+#   endif
+#else
+#   define SSL_SOCK_USE_KTLS	0
+#endif
+
 #if !defined(OPENSSL_NO_EC) && OPENSSL_VERSION_NUMBER >= 0x1000200fL
 
 #   include <openssl/obj_mac.h>
@@ -195,27 +225,23 @@ typedef struct read_data_t
  */
 typedef struct write_data_t {
     PJ_DECL_LIST_MEMBER(struct write_data_t);
-    pj_ioqueue_op_key_t	 key;
-    pj_size_t 	 	 record_len;
     pj_ioqueue_op_key_t	*app_key;
     pj_size_t 	 	 plain_data_len;
-    pj_size_t 	 	 data_len;
     unsigned		 flags;
-    union {
-	char		 content[1];
-	const char	*ptr;
-    } data;
+    const void		*data;
 } write_data_t;
 
 /*
- * Structure of SSL socket write buffer (circular buffer).
+ * Structure of SSL socket write BIO. OpenSSL writes the secured data
+ * directly into the BIO memory, which is then detached from SSL and
+ * passed to the socket as is, so no copy is needed for sending.
  */
-typedef struct send_buf_t {
-    char		*buf;
-    pj_size_t		 max_len;    
-    char		*start;
-    pj_size_t		 len;
-} send_buf_t;
+typedef struct write_bio_t {
+    PJ_DECL_LIST_MEMBER(struct write_bio_t);
+    pj_ioqueue_op_key_t	 key;
+    BIO			*bio;
+    write_data_t	 app_data;	/* application data in the BIO	    */
+} write_bio_t;
 
 /*
  * Secure socket structure definition.
@@ -255,14 +281,20 @@ struct pj_ssl_sock_t
     write_data_t	  write_pending;/* list of pending write to OpenSSL */
     write_data_t	  write_pending_empty; /* cache for write_pending   */
     pj_bool_t		  flushing_write_pend; /* flag of flushing is ongoing*/
-    send_buf_t		  send_buf;
-    write_data_t	  send_pending;	/* list of pending write to network */
-    pj_lock_t		 *write_mutex;	/* protect write BIO and send_buf   */
+    pj_bool_t		  defer_flush;	/* more write pending is flushing   */
+    write_bio_t		 *write_bio;	/* write BIO currently used by SSL  */
+    write_bio_t		  send_pending;	/* list of pending write to network */
+    write_bio_t		  send_empty;	/* cache for write BIO		    */
+    pj_lock_t		 *write_mutex;	/* protect write BIO		    */
 
     SSL_CTX		 *ossl_ctx;
     SSL			 *ossl_ssl;
     BIO			 *ossl_rbio;
     BIO			 *ossl_wbio;
+
+    BIO			 *ktls_bio;	/* kTLS filter BIO on top of wbio   */
+    pj_bool_t		  ktls_send;	/* sending is offloaded to kernel   */
+    int			  ktls_ctrl_msg; /* record type of next write	    */
 };
 
 
@@ -279,8 +311,7 @@ struct pj_ssl_cert_t
 };
 
 
-static write_data_t* alloc_send_data(pj_ssl_sock_t *ssock, pj_size_t len);
-static void free_send_data(pj_ssl_sock_t *ssock, write_data_t *wdata);
+static write_bio_t* alloc_write_bio(pj_ssl_sock_t *ssock);
 static pj_status_t flush_delayed_send(pj_ssl_sock_t *ssock);
 
 /*
@@ -518,6 +549,216 @@ static struct openssl_curves_t {
 static int sslsock_idx;
 
 
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+/* Release shared SSL contexts */
+static void flush_ctx_cache(void);
+#endif
+
+#if SSL_SOCK_USE_KTLS
+/* kTLS filter BIO method */
+static BIO_METHOD *ktls_bio_meth;
+
+/* Send the data in the write BIO to the socket directly, as the kernel
+ * will encrypt any data sent after the send key is installed. The data is
+ * only sent with a single non-blocking send, like ioqueue would do, and
+ * the send key is not installed if the socket is busy, so sending simply
+ * stays in OpenSSL. Must be called with write mutex held.
+ */
+static pj_bool_t ktls_flush_write_bio(pj_ssl_sock_t *ssock)
+{
+    char *data;
+    pj_ssize_t len, sent;
+
+    /* Some data is being sent by ioqueue */
+    if (!pj_list_empty(&ssock->send_pending) ||
+	!pj_list_empty(&ssock->write_bio->app_data))
+    {
+	return PJ_FALSE;
+    }
+
+    len = BIO_get_mem_data(ssock->ossl_wbio, &data);
+    if (len == 0)
+	return PJ_TRUE;
+
+    sent = len;
+    if (pj_sock_send(ssock->sock, data, &sent, 0) != PJ_SUCCESS)
+	return PJ_FALSE;
+
+    if (sent == len) {
+	(void)BIO_reset(ssock->ossl_wbio);
+	return PJ_TRUE;
+    }
+
+    /* Partially sent, discard the sent data, the rest will be sent by
+     * ioqueue.
+     */
+    while (sent > 0) {
+	char buf[256];
+	int n;
+
+	n = BIO_read(ssock->ossl_wbio, buf,
+		     (int)PJ_MIN(sent, (pj_ssize_t)sizeof(buf)));
+	if (n <= 0)
+	    break;
+	sent -= n;
+    }
+
+    return PJ_FALSE;
+}
+
+/* Install the send key, given by OpenSSL, to the socket */
+static pj_bool_t ktls_start_send(pj_ssl_sock_t *ssock, void *crypto_info)
+{
+    struct tls_crypto_info *info = (struct tls_crypto_info*)crypto_info;
+    int len;
+    pj_status_t status;
+
+    switch (info->cipher_type) {
+#ifdef TLS_CIPHER_AES_GCM_128
+    case TLS_CIPHER_AES_GCM_128:
+	len = sizeof(struct tls12_crypto_info_aes_gcm_128);
+	break;
+#endif
+#ifdef TLS_CIPHER_AES_GCM_256
+    case TLS_CIPHER_AES_GCM_256:
+	len = sizeof(struct tls12_crypto_info_aes_gcm_256);
+	break;
+#endif
+#ifdef TLS_CIPHER_AES_CCM_128
+    case TLS_CIPHER_AES_CCM_128:
+	len = sizeof(struct tls12_crypto_info_aes_ccm_128);
+	break;
+#endif
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case TLS_CIPHER_CHACHA20_POLY1305:
+	len = sizeof(struct tls12_crypto_info_chacha20_poly1305);
+	break;
+#endif
+    default:
+	return PJ_FALSE;
+    }
+
+    status = pj_sock_setsockopt(ssock->sock, IPPROTO_TCP, TCP_ULP,
+				"tls", sizeof("tls"));
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(ssock->pool->obj_name, status,
+		     "Kernel TLS is not available"));
+	return PJ_FALSE;
+    }
+
+    if (!ktls_flush_write_bio(ssock))
+	return PJ_FALSE;
+
+    status = pj_sock_setsockopt(ssock->sock, SOL_TLS, TLS_TX, info, len);
+    if (status != PJ_SUCCESS) {
+	PJ_PERROR(4,(ssock->pool->obj_name, status,
+		     "Failed to set kernel TLS send key"));
+	return PJ_FALSE;
+    }
+
+    PJ_LOG(4,(ssock->pool->obj_name, "Sending is offloaded to kernel TLS"));
+    return PJ_TRUE;
+}
+
+/* Send TLS record other than application data, the record type is
+ * passed to the kernel in a control message. When the socket is busy,
+ * OpenSSL is asked to retry the write, which then fails with
+ * SSL_ERROR_WANT_WRITE and is retried after the data in the write BIO has
+ * been sent, see do_handshake() and ssl_write().
+ */
+static int ktls_send_ctrl_msg(pj_ssl_sock_t *ssock, BIO *b,
+			      const char *data, int len)
+{
+    char cbuf[CMSG_SPACE(sizeof(unsigned char))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+    struct iovec iov;
+    ssize_t sent;
+
+    /* The record must not be sent ahead of the data being sent */
+    if (!pj_list_empty(&ssock->send_pending) ||
+	BIO_pending(ssock->ossl_wbio))
+    {
+	BIO_set_retry_write(b);
+	return -1;
+    }
+
+    pj_bzero(&msg, sizeof(msg));
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_TLS;
+    cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+    *((unsigned char*)CMSG_DATA(cmsg)) = (unsigned char)ssock->ktls_ctrl_msg;
+    msg.msg_controllen = cmsg->cmsg_len;
+
+    iov.iov_base = (void*)data;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+    sent = sendmsg(ssock->sock, &msg, MSG_DONTWAIT);
+    if (sent < 0) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+	    BIO_set_retry_write(b);
+	return -1;
+    }
+
+    return (int)sent;
+}
+
+static int ktls_bio_write(BIO *b, const char *data, int len)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)BIO_get_data(b);
+
+    BIO_clear_retry_flags(b);
+
+    if (ssock->ktls_ctrl_msg) {
+	int ret = ktls_send_ctrl_msg(ssock, b, data, len);
+	ssock->ktls_ctrl_msg = 0;
+	return ret;
+    }
+
+    return BIO_write(BIO_next(b), data, len);
+}
+
+static long ktls_bio_ctrl(BIO *b, int cmd, long num, void *ptr)
+{
+    pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)BIO_get_data(b);
+
+    switch (cmd) {
+    case BIO_CTRL_SET_KTLS:
+	/* Only sending is offloaded, received data is still read by
+	 * ioqueue and decrypted by OpenSSL.
+	 */
+	if (!num || !ktls_start_send(ssock, ptr))
+	    return 0;
+	ssock->ktls_send = PJ_TRUE;
+	return 1;
+    case BIO_CTRL_GET_KTLS_SEND:
+	return ssock->ktls_send;
+    case BIO_CTRL_GET_KTLS_RECV:
+	return 0;
+    case BIO_CTRL_SET_KTLS_TX_SEND_CTRL_MSG:
+	ssock->ktls_ctrl_msg = (int)num;
+	return 1;
+    case BIO_CTRL_CLEAR_KTLS_TX_CTRL_MSG:
+	ssock->ktls_ctrl_msg = 0;
+	return 1;
+    default:
+	return BIO_ctrl(BIO_next(b), cmd, num, ptr);
+    }
+}
+
+static int ktls_bio_create(BIO *b)
+{
+    BIO_set_init(b, 1);
+    return 1;
+}
+#endif	/* SSL_SOCK_USE_KTLS */
+
 /* Initialize OpenSSL */
 static pj_status_t init_openssl(void)
 {
@@ -632,6 +873,22 @@ static pj_status_t init_openssl(void)
     /* Create OpenSSL application data index for SSL socket */
     sslsock_idx = SSL_get_ex_new_index(0, "SSL socket", NULL, NULL, NULL);
 
+#if SSL_SOCK_USE_KTLS
+    /* Create kTLS filter BIO method */
+    ktls_bio_meth = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_FILTER,
+				 "pj kTLS");
+    if (ktls_bio_meth) {
+	BIO_meth_set_write(ktls_bio_meth, &ktls_bio_write);
+	BIO_meth_set_ctrl(ktls_bio_meth, &ktls_bio_ctrl);
+	BIO_meth_set_create(ktls_bio_meth, &ktls_bio_create);
+    }
+#endif
+
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+    /* Release shared SSL contexts on library shutdown */
+    pj_atexit(&flush_ctx_cache);
+#endif
+
     return status;
 }
 
@@ -658,42 +915,29 @@ static int password_cb(char *buf, int num, int rwflag, void *user_data)
 }
 
 
-/* SSL password callback. */
-static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
+/* Map OpenSSL certificate verification error to pj_ssl_cert_verify_flag_t */
+static pj_uint32_t get_verify_status(int err)
 {
-    pj_ssl_sock_t *ssock;
-    SSL *ossl_ssl;
-    int err;
-
-    /* Get SSL instance */
-    ossl_ssl = X509_STORE_CTX_get_ex_data(x509_ctx, 
-				    SSL_get_ex_data_X509_STORE_CTX_idx());
-    pj_assert(ossl_ssl);
+    pj_uint32_t status = PJ_SSL_CERT_ESUCCESS;
 
-    /* Get SSL socket instance */
-    ssock = SSL_get_ex_data(ossl_ssl, sslsock_idx);
-    pj_assert(ssock);
-
-    /* Store verification status */
-    err = X509_STORE_CTX_get_error(x509_ctx);
     switch (err) {
     case X509_V_OK:
 	break;
 
     case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT:
-	ssock->verify_status |= PJ_SSL_CERT_EISSUER_NOT_FOUND;
+	status = PJ_SSL_CERT_EISSUER_NOT_FOUND;
 	break;
 
     case X509_V_ERR_ERROR_IN_CERT_NOT_BEFORE_FIELD:
     case X509_V_ERR_ERROR_IN_CERT_NOT_AFTER_FIELD:
     case X509_V_ERR_UNABLE_TO_DECRYPT_CERT_SIGNATURE:
     case X509_V_ERR_UNABLE_TO_DECODE_ISSUER_PUBLIC_KEY:
-	ssock->verify_status |= PJ_SSL_CERT_EINVALID_FORMAT;
+	status = PJ_SSL_CERT_EINVALID_FORMAT;
 	break;
 
     case X509_V_ERR_CERT_NOT_YET_VALID:
     case X509_V_ERR_CERT_HAS_EXPIRED:
-	ssock->verify_status |= PJ_SSL_CERT_EVALIDITY_PERIOD;
+	status = PJ_SSL_CERT_EVALIDITY_PERIOD;
 	break;
 
     case X509_V_ERR_UNABLE_TO_GET_CRL:
@@ -703,14 +947,14 @@ static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
     case X509_V_ERR_CRL_SIGNATURE_FAILURE:
     case X509_V_ERR_ERROR_IN_CRL_LAST_UPDATE_FIELD:
     case X509_V_ERR_ERROR_IN_CRL_NEXT_UPDATE_FIELD:
-	ssock->verify_status |= PJ_SSL_CERT_ECRL_FAILURE;
+	status = PJ_SSL_CERT_ECRL_FAILURE;
 	break;	
 
     case X509_V_ERR_DEPTH_ZERO_SELF_SIGNED_CERT:
     case X509_V_ERR_CERT_UNTRUSTED:
     case X509_V_ERR_SELF_SIGNED_CERT_IN_CHAIN:
     case X509_V_ERR_UNABLE_TO_GET_ISSUER_CERT_LOCALLY:
-	ssock->verify_status |= PJ_SSL_CERT_EUNTRUSTED;
+	status = PJ_SSL_CERT_EUNTRUSTED;
 	break;	
 
     case X509_V_ERR_CERT_SIGNATURE_FAILURE:
@@ -719,31 +963,55 @@ static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
     case X509_V_ERR_AKID_SKID_MISMATCH:
     case X509_V_ERR_AKID_ISSUER_SERIAL_MISMATCH:
     case X509_V_ERR_KEYUSAGE_NO_CERTSIGN:
-	ssock->verify_status |= PJ_SSL_CERT_EISSUER_MISMATCH;
+	status = PJ_SSL_CERT_EISSUER_MISMATCH;
 	break;
 
     case X509_V_ERR_CERT_REVOKED:
-	ssock->verify_status |= PJ_SSL_CERT_EREVOKED;
+	status = PJ_SSL_CERT_EREVOKED;
 	break;	
 
     case X509_V_ERR_INVALID_PURPOSE:
     case X509_V_ERR_CERT_REJECTED:
     case X509_V_ERR_INVALID_CA:
-	ssock->verify_status |= PJ_SSL_CERT_EINVALID_PURPOSE;
+	status = PJ_SSL_CERT_EINVALID_PURPOSE;
 	break;
 
     case X509_V_ERR_CERT_CHAIN_TOO_LONG: /* not really used */
     case X509_V_ERR_PATH_LENGTH_EXCEEDED:
-	ssock->verify_status |= PJ_SSL_CERT_ECHAIN_TOO_LONG;
+	status = PJ_SSL_CERT_ECHAIN_TOO_LONG;
 	break;
 
     /* Unknown errors */
     case X509_V_ERR_OUT_OF_MEM:
     default:
-	ssock->verify_status |= PJ_SSL_CERT_EUNKNOWN;
+	status = PJ_SSL_CERT_EUNKNOWN;
 	break;
     }
 
+    return status;
+}
+
+
+/* SSL password callback. */
+static int verify_cb(int preverify_ok, X509_STORE_CTX *x509_ctx)
+{
+    pj_ssl_sock_t *ssock;
+    SSL *ossl_ssl;
+    int err;
+
+    /* Get SSL instance */
+    ossl_ssl = X509_STORE_CTX_get_ex_data(x509_ctx, 
+				    SSL_get_ex_data_X509_STORE_CTX_idx());
+    pj_assert(ossl_ssl);
+
+    /* Get SSL socket instance */
+    ssock = SSL_get_ex_data(ossl_ssl, sslsock_idx);
+    pj_assert(ssock);
+
+    /* Store verification status */
+    err = X509_STORE_CTX_get_error(x509_ctx);
+    ssock->verify_status |= get_verify_status(err);
+
     /* When verification is not requested just return ok here, however
      * application can still get the verification status.
      */
@@ -762,8 +1030,9 @@ static pj_status_t set_sigalgs(pj_ssl_sock_t *ssock);
 /* Setting entropy for rng */
 static void set_entropy(pj_ssl_sock_t *ssock);
 
-/* Create and initialize new SSL context and instance */
-static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
+/* Initialize new SSL context: options and credentials */
+static pj_status_t init_ssl_ctx(pj_ssl_sock_t *ssock, SSL_CTX *ctx,
+				pj_uint32_t ssl_opt)
 {
     BIO *bio;
     DH *dh;
@@ -771,88 +1040,10 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 #if !defined(OPENSSL_NO_ECDH) && OPENSSL_VERSION_NUMBER >= 0x10000000L
     EC_KEY *ecdh;
 #endif
-    SSL_METHOD *ssl_method = NULL;
-    SSL_CTX *ctx;
-    pj_uint32_t ssl_opt = 0;
-    pj_ssl_cert_t *cert;
-    int mode, rc;
+    pj_ssl_cert_t *cert = ssock->cert;
+    int rc;
     pj_status_t status;
-        
-    pj_assert(ssock);
 
-    cert = ssock->cert;
-
-    /* Make sure OpenSSL library has been initialized */
-    init_openssl();
-
-    set_entropy(ssock);
-
-    if (ssock->param.proto == PJ_SSL_SOCK_PROTO_DEFAULT)
-	ssock->param.proto = PJ_SSL_SOCK_PROTO_SSL23;
-
-    /* Determine SSL method to use */
-#if OPENSSL_VERSION_NUMBER < 0x10100000L
-    switch (ssock->param.proto) {
-    case PJ_SSL_SOCK_PROTO_TLS1:
-	ssl_method = (SSL_METHOD*)TLSv1_method();
-	break;
-#ifndef OPENSSL_NO_SSL2
-    case PJ_SSL_SOCK_PROTO_SSL2:
-	ssl_method = (SSL_METHOD*)SSLv2_method();
-	break;
-#endif
-#ifndef OPENSSL_NO_SSL3_METHOD
-    case PJ_SSL_SOCK_PROTO_SSL3:
-	ssl_method = (SSL_METHOD*)SSLv3_method();
-#endif
-	break;
-    }
-#else
-    /* Specific version methods are deprecated in 1.1.0 */
-    ssl_method = (SSL_METHOD*)TLS_method();
-#endif
-
-    if (!ssl_method) {
-	ssl_method = (SSL_METHOD*)SSLv23_method();
-
-#ifdef SSL_OP_NO_SSLv2
-	/** Check if SSLv2 is enabled */
-	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_SSL2)==0)?
-		    SSL_OP_NO_SSLv2:0;
-#endif
-
-#ifdef SSL_OP_NO_SSLv3
-	/** Check if SSLv3 is enabled */
-	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_SSL3)==0)?
-		    SSL_OP_NO_SSLv3:0;
-#endif
-
-#ifdef SSL_OP_NO_TLSv1
-	/** Check if TLSv1 is enabled */
-	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1)==0)?
-		    SSL_OP_NO_TLSv1:0;
-#endif
-
-#ifdef SSL_OP_NO_TLSv1_1
-	/** Check if TLSv1_1 is enabled */
-	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1_1)==0)?
-		    SSL_OP_NO_TLSv1_1:0;
-#endif
-
-#ifdef SSL_OP_NO_TLSv1_2
-	/** Check if TLSv1_2 is enabled */
-	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1_2)==0)?
-		    SSL_OP_NO_TLSv1_2:0;
-
-#endif
-
-    }
-
-    /* Create SSL context */
-    ctx = SSL_CTX_new(ssl_method);
-    if (ctx == NULL) {
-	return GET_SSL_STATUS(ssock);
-    }
     if (ssl_opt)
 	SSL_CTX_set_options(ctx, ssl_opt);
 
@@ -878,7 +1069,6 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 			      "Error loading CA path '%s'",
 			      cert->CA_path.ptr));
 		}
-		SSL_CTX_free(ctx);
 		return status;
 	    }
 	}
@@ -900,7 +1090,6 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 		status = GET_SSL_STATUS(ssock);
 		PJ_LOG(1,(ssock->pool->obj_name, "Error loading certificate "
 			  "chain file '%s'", cert->cert_file.ptr));
-		SSL_CTX_free(ctx);
 		return status;
 	    }
 	}
@@ -916,7 +1105,6 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 		status = GET_SSL_STATUS(ssock);
 		PJ_LOG(1,(ssock->pool->obj_name, "Error adding private key "
 			  "from '%s'", cert->privkey_file.ptr));
-		SSL_CTX_free(ctx);
 		return status;
 	    }
 
@@ -987,39 +1175,500 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 	    pj_memcpy(p, "rsa", CERT_TYPE_LEN);
 	}
 
-    #ifndef SSL_CTRL_SET_ECDH_AUTO
-	#define SSL_CTRL_SET_ECDH_AUTO 94
-    #endif
+    #ifndef SSL_CTRL_SET_ECDH_AUTO
+	#define SSL_CTRL_SET_ECDH_AUTO 94
+    #endif
+
+	/* SSL_CTX_set_ecdh_auto(ctx,on) requires OpenSSL 1.0.2 which wraps: */
+	if (SSL_CTX_ctrl(ctx, SSL_CTRL_SET_ECDH_AUTO, 1, NULL)) {
+	    PJ_LOG(4,(ssock->pool->obj_name, "SSL ECDH initialized "
+		      "(automatic), faster PFS ciphers enabled"));
+    #if !defined(OPENSSL_NO_ECDH) && OPENSSL_VERSION_NUMBER >= 0x10000000L
+	} else {
+	    /* enables AES-128 ciphers, to get AES-256 use NID_secp384r1 */
+	    ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+	    if (ecdh != NULL) {
+		if (SSL_CTX_set_tmp_ecdh(ctx, ecdh)) {
+		    PJ_LOG(4,(ssock->pool->obj_name, "SSL ECDH initialized "
+			      "(secp256r1), faster PFS cipher-suites enabled"));
+		}
+		EC_KEY_free(ecdh);
+	    }
+    #endif
+	}
+    } else {
+	X509_STORE *pkix_validation_store = SSL_CTX_get_cert_store(ctx);
+	if (NULL != pkix_validation_store) {
+#if defined(X509_V_FLAG_TRUSTED_FIRST)
+	    X509_STORE_set_flags(pkix_validation_store, 
+				 X509_V_FLAG_TRUSTED_FIRST);
+#endif
+#if defined(X509_V_FLAG_PARTIAL_CHAIN)
+	    X509_STORE_set_flags(pkix_validation_store, 
+				 X509_V_FLAG_PARTIAL_CHAIN);
+#endif
+	}
+    }
+
+    /* The password is only needed while loading the private keys above,
+     * don't leave the (possibly shared) context pointing to the socket's
+     * credential.
+     */
+    if (cert && cert->privkey_pass.slen) {
+	SSL_CTX_set_default_passwd_cb(ctx, NULL);
+	SSL_CTX_set_default_passwd_cb_userdata(ctx, NULL);
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+
+/* Length of SSL context key (SHA-256 digest), this is also used as
+ * the session ID context, so it must not exceed SSL_MAX_SID_CTX_LENGTH.
+ */
+#define CTX_KEY_LEN	32
+
+/* Client session cache entry */
+typedef struct ssl_sess_entry
+{
+    char		 key[PJ_MAX_HOSTNAME + PJ_INET6_ADDRSTRLEN + 10];
+    SSL_SESSION		*sess;
+    pj_uint32_t		 last_used;
+} ssl_sess_entry;
+
+/* Shared SSL context entry */
+typedef struct ssl_ctx_entry
+{
+    unsigned char	 key[CTX_KEY_LEN];
+    SSL_CTX		*ctx;
+    pj_uint32_t		 last_used;
+#if PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+    ssl_sess_entry	 sess[PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE];
+#endif
+} ssl_ctx_entry;
+
+/* Shared SSL contexts, protected by pj_enter_critical_section() */
+static ssl_ctx_entry ctx_cache[PJ_SSL_SOCK_CTX_CACHE_SIZE];
+static pj_uint32_t   ctx_cache_clock;
+
+
+/* Add a string and, if it is a file name, the file time stamp & size
+ * into the SSL context key, so updated files get reloaded.
+ */
+static void ctx_key_add_str(EVP_MD_CTX *md, const pj_str_t *str,
+			    pj_bool_t is_file)
+{
+    pj_uint32_t len = (pj_uint32_t)str->slen;
+
+    EVP_DigestUpdate(md, &len, sizeof(len));
+    if (len == 0)
+	return;
+
+    EVP_DigestUpdate(md, str->ptr, len);
+    if (is_file) {
+	pj_file_stat st;
+
+	pj_bzero(&st, sizeof(st));
+	pj_file_getstat(str->ptr, &st);
+	EVP_DigestUpdate(md, &st.size, sizeof(st.size));
+	EVP_DigestUpdate(md, &st.mtime.sec, sizeof(st.mtime.sec));
+    }
+}
+
+/* Generate the key of SSL context from everything that is applied to
+ * the context, i.e: role, protocol and credentials.
+ */
+static void get_ctx_key(pj_ssl_sock_t *ssock, pj_uint32_t ssl_opt,
+			unsigned char key[CTX_KEY_LEN])
+{
+    EVP_MD_CTX *md;
+    pj_uint32_t val[4];
+    unsigned len = CTX_KEY_LEN;
+
+    val[0] = ssock->is_server;
+    val[1] = ssock->is_server && ssock->param.require_client_cert;
+    val[2] = ssock->param.proto;
+    val[3] = ssl_opt;
+
+    md = EVP_MD_CTX_create();
+    EVP_DigestInit_ex(md, EVP_sha256(), NULL);
+    EVP_DigestUpdate(md, val, sizeof(val));
+    if (ssock->cert) {
+	pj_ssl_cert_t *cert = ssock->cert;
+
+	ctx_key_add_str(md, &cert->CA_file, PJ_TRUE);
+	ctx_key_add_str(md, &cert->CA_path, PJ_TRUE);
+	ctx_key_add_str(md, &cert->cert_file, PJ_TRUE);
+	ctx_key_add_str(md, &cert->privkey_file, PJ_TRUE);
+	ctx_key_add_str(md, &cert->privkey_pass, PJ_FALSE);
+    }
+    EVP_DigestFinal_ex(md, key, &len);
+    EVP_MD_CTX_destroy(md);
+}
+
+/* Find shared SSL context entry, must be called inside critical section */
+static ssl_ctx_entry *find_ctx_entry(const unsigned char *key,
+				     const SSL_CTX *ctx)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+	ssl_ctx_entry *e = &ctx_cache[i];
+
+	if (e->ctx == NULL)
+	    continue;
+	if ((key && pj_memcmp(e->key, key, CTX_KEY_LEN) == 0) ||
+	    (ctx && e->ctx == ctx))
+	{
+	    return e;
+	}
+    }
+    return NULL;
+}
+
+/* Release shared SSL context entry, including its client sessions */
+static void free_ctx_entry(ssl_ctx_entry *e)
+{
+#if PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(e->sess); ++i) {
+	if (e->sess[i].sess)
+	    SSL_SESSION_free(e->sess[i].sess);
+    }
+#endif
+    SSL_CTX_free(e->ctx);
+    pj_bzero(e, sizeof(*e));
+}
+
+/* Get shared SSL context with the specified key. The returned context
+ * has its reference counter incremented.
+ */
+static SSL_CTX *get_cached_ctx(const unsigned char key[CTX_KEY_LEN])
+{
+    ssl_ctx_entry *e;
+    SSL_CTX *ctx = NULL;
+
+    pj_enter_critical_section();
+    e = find_ctx_entry(key, NULL);
+    if (e) {
+	ctx = e->ctx;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	SSL_CTX_up_ref(ctx);
+#else
+	CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#endif
+	e->last_used = ++ctx_cache_clock;
+    }
+    pj_leave_critical_section();
+
+    return ctx;
+}
+
+/* Add new SSL context to the cache, replacing the least recently used one
+ * when the cache is full. The cache holds its own context reference.
+ */
+static void put_cached_ctx(const unsigned char key[CTX_KEY_LEN],
+			   SSL_CTX *ctx)
+{
+    ssl_ctx_entry *e = NULL;
+    unsigned i;
+
+    pj_enter_critical_section();
+
+    /* Another socket may have just added the same credential */
+    if (find_ctx_entry(key, NULL)) {
+	pj_leave_critical_section();
+	return;
+    }
+
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+	if (ctx_cache[i].ctx == NULL) {
+	    e = &ctx_cache[i];
+	    break;
+	}
+	if (!e || ctx_cache[i].last_used < e->last_used)
+	    e = &ctx_cache[i];
+    }
+    if (e->ctx)
+	free_ctx_entry(e);
+
+    pj_memcpy(e->key, key, CTX_KEY_LEN);
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    SSL_CTX_up_ref(ctx);
+#else
+    CRYPTO_add(&ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#endif
+    e->ctx = ctx;
+    e->last_used = ++ctx_cache_clock;
+
+    pj_leave_critical_section();
+}
+
+/* Release all shared SSL contexts, sockets that are still using any of
+ * them keep their own reference.
+ */
+static void flush_ctx_cache(void)
+{
+    unsigned i;
+
+    pj_enter_critical_section();
+    for (i = 0; i < PJ_ARRAY_SIZE(ctx_cache); ++i) {
+	if (ctx_cache[i].ctx)
+	    free_ctx_entry(&ctx_cache[i]);
+    }
+    pj_leave_critical_section();
+}
+
+
+#if PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+/* Get client session key, i.e: the remote host */
+static void get_sess_key(pj_ssl_sock_t *ssock, char *buf, unsigned len)
+{
+    char addr[PJ_INET6_ADDRSTRLEN + 10];
+
+    pj_sockaddr_print(&ssock->rem_addr, addr, sizeof(addr), 3);
+    pj_ansi_snprintf(buf, len, "%.*s|%s",
+		     (int)ssock->param.server_name.slen,
+		     ssock->param.server_name.ptr, addr);
+}
+
+/* Find client session entry, must be called inside critical section */
+static ssl_sess_entry *find_sess_entry(ssl_ctx_entry *e, const char *key)
+{
+    unsigned i;
+
+    for (i = 0; i < PJ_ARRAY_SIZE(e->sess); ++i) {
+	if (e->sess[i].sess && pj_ansi_strcmp(e->sess[i].key, key) == 0)
+	    return &e->sess[i];
+    }
+    return NULL;
+}
+
+/* OpenSSL callback for a new client session, which can be a TLS 1.3
+ * session ticket received after the handshake.
+ */
+static int on_new_session(SSL *ossl_ssl, SSL_SESSION *sess)
+{
+    pj_ssl_sock_t *ssock;
+    ssl_ctx_entry *e;
+    ssl_sess_entry *se;
+    char key[sizeof(se->key)];
+    unsigned i;
+
+    ssock = SSL_get_ex_data(ossl_ssl, sslsock_idx);
+    if (!ssock || ssock->is_server)
+	return 0;
+
+    get_sess_key(ssock, key, sizeof(key));
+
+    pj_enter_critical_section();
+    e = find_ctx_entry(NULL, SSL_get_SSL_CTX(ossl_ssl));
+    if (!e) {
+	/* The context has been removed from the cache */
+	pj_leave_critical_section();
+	return 0;
+    }
+
+    se = find_sess_entry(e, key);
+    if (!se) {
+	/* Use an empty or the least recently used entry */
+	se = &e->sess[0];
+	for (i = 1; i < PJ_ARRAY_SIZE(e->sess) && se->sess; ++i) {
+	    if (!e->sess[i].sess || e->sess[i].last_used < se->last_used)
+		se = &e->sess[i];
+	}
+    }
+    if (se->sess)
+	SSL_SESSION_free(se->sess);
+
+    pj_ansi_strcpy(se->key, key);
+    se->sess = sess;
+    se->last_used = ++ctx_cache_clock;
+    pj_leave_critical_section();
+
+    /* Keep the session reference */
+    return 1;
+}
+
+/* Offer cached session of the remote host for resumption */
+static void set_client_session(pj_ssl_sock_t *ssock)
+{
+    ssl_ctx_entry *e;
+    ssl_sess_entry *se = NULL;
+    char key[sizeof(se->key)];
+
+    get_sess_key(ssock, key, sizeof(key));
+
+    pj_enter_critical_section();
+    e = find_ctx_entry(NULL, ssock->ossl_ctx);
+    if (e)
+	se = find_sess_entry(e, key);
+    if (se) {
+	/* Parenthesized to bypass the SSL_set_session() macro defined for
+	 * old OpenSSL above, the session reference must be taken here.
+	 */
+	(SSL_set_session)(ssock->ossl_ssl, se->sess);
+	se->last_used = ++ctx_cache_clock;
+    }
+    pj_leave_critical_section();
+}
+
+/* Drop cached session of the remote host, e.g: after handshake failure */
+static void clear_client_session(pj_ssl_sock_t *ssock)
+{
+    ssl_ctx_entry *e;
+    ssl_sess_entry *se = NULL;
+    char key[sizeof(se->key)];
+
+    if (!ssock->ossl_ctx)
+	return;
+
+    get_sess_key(ssock, key, sizeof(key));
+
+    pj_enter_critical_section();
+    e = find_ctx_entry(NULL, ssock->ossl_ctx);
+    if (e)
+	se = find_sess_entry(e, key);
+    if (se) {
+	SSL_SESSION_free(se->sess);
+	se->sess = NULL;
+    }
+    pj_leave_critical_section();
+}
+#endif	/* PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE */
+
+/* Setup session resumption on a newly created shared SSL context */
+static void init_ssl_ctx_sess(pj_ssl_sock_t *ssock, SSL_CTX *ctx,
+			      const unsigned char key[CTX_KEY_LEN])
+{
+    if (ssock->is_server) {
+	/* Session ID context is mandatory for resumption as peer
+	 * verification is always set, the context key is unique to
+	 * the credentials. Session tickets are enabled by default.
+	 */
+	SSL_CTX_set_session_id_context(ctx, key, CTX_KEY_LEN);
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, PJ_SSL_SOCK_SESS_CACHE_SIZE);
+	SSL_CTX_set_timeout(ctx, PJ_SSL_SOCK_SESS_TIMEOUT);
+    } else {
+#if PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+	/* Client sessions are stored per remote host by on_new_session() */
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+					    SSL_SESS_CACHE_NO_INTERNAL_STORE);
+	SSL_CTX_sess_set_new_cb(ctx, &on_new_session);
+#endif
+    }
+}
+
+#endif	/* PJ_SSL_SOCK_CTX_CACHE_SIZE */
+
+
+/* Create and initialize new SSL context and instance */
+static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
+{
+    SSL_METHOD *ssl_method = NULL;
+    SSL_CTX *ctx = NULL;
+    pj_uint32_t ssl_opt = 0;
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+    unsigned char ctx_key[CTX_KEY_LEN];
+#endif
+    int mode;
+    pj_status_t status;
+        
+    pj_assert(ssock);
+
+    /* Make sure OpenSSL library has been initialized */
+    init_openssl();
+
+    set_entropy(ssock);
+
+    if (ssock->param.proto == PJ_SSL_SOCK_PROTO_DEFAULT)
+	ssock->param.proto = PJ_SSL_SOCK_PROTO_SSL23;
+
+    /* Determine SSL method to use */
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    switch (ssock->param.proto) {
+    case PJ_SSL_SOCK_PROTO_TLS1:
+	ssl_method = (SSL_METHOD*)TLSv1_method();
+	break;
+#ifndef OPENSSL_NO_SSL2
+    case PJ_SSL_SOCK_PROTO_SSL2:
+	ssl_method = (SSL_METHOD*)SSLv2_method();
+	break;
+#endif
+#ifndef OPENSSL_NO_SSL3_METHOD
+    case PJ_SSL_SOCK_PROTO_SSL3:
+	ssl_method = (SSL_METHOD*)SSLv3_method();
+#endif
+	break;
+    }
+#else
+    /* Specific version methods are deprecated in 1.1.0 */
+    ssl_method = (SSL_METHOD*)TLS_method();
+#endif
+
+    if (!ssl_method) {
+	ssl_method = (SSL_METHOD*)SSLv23_method();
+
+#ifdef SSL_OP_NO_SSLv2
+	/** Check if SSLv2 is enabled */
+	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_SSL2)==0)?
+		    SSL_OP_NO_SSLv2:0;
+#endif
+
+#ifdef SSL_OP_NO_SSLv3
+	/** Check if SSLv3 is enabled */
+	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_SSL3)==0)?
+		    SSL_OP_NO_SSLv3:0;
+#endif
+
+#ifdef SSL_OP_NO_TLSv1
+	/** Check if TLSv1 is enabled */
+	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1)==0)?
+		    SSL_OP_NO_TLSv1:0;
+#endif
+
+#ifdef SSL_OP_NO_TLSv1_1
+	/** Check if TLSv1_1 is enabled */
+	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1_1)==0)?
+		    SSL_OP_NO_TLSv1_1:0;
+#endif
+
+#ifdef SSL_OP_NO_TLSv1_2
+	/** Check if TLSv1_2 is enabled */
+	ssl_opt |= ((ssock->param.proto & PJ_SSL_SOCK_PROTO_TLS1_2)==0)?
+		    SSL_OP_NO_TLSv1_2:0;
 
-	/* SSL_CTX_set_ecdh_auto(ctx,on) requires OpenSSL 1.0.2 which wraps: */
-	if (SSL_CTX_ctrl(ctx, SSL_CTRL_SET_ECDH_AUTO, 1, NULL)) {
-	    PJ_LOG(4,(ssock->pool->obj_name, "SSL ECDH initialized "
-		      "(automatic), faster PFS ciphers enabled"));
-    #if !defined(OPENSSL_NO_ECDH) && OPENSSL_VERSION_NUMBER >= 0x10000000L
-	} else {
-	    /* enables AES-128 ciphers, to get AES-256 use NID_secp384r1 */
-	    ecdh = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
-	    if (ecdh != NULL) {
-		if (SSL_CTX_set_tmp_ecdh(ctx, ecdh)) {
-		    PJ_LOG(4,(ssock->pool->obj_name, "SSL ECDH initialized "
-			      "(secp256r1), faster PFS cipher-suites enabled"));
-		}
-		EC_KEY_free(ecdh);
-	    }
-    #endif
-	}
-    } else {
-	X509_STORE *pkix_validation_store = SSL_CTX_get_cert_store(ctx);
-	if (NULL != pkix_validation_store) {
-#if defined(X509_V_FLAG_TRUSTED_FIRST)
-	    X509_STORE_set_flags(pkix_validation_store, 
-				 X509_V_FLAG_TRUSTED_FIRST);
 #endif
-#if defined(X509_V_FLAG_PARTIAL_CHAIN)
-	    X509_STORE_set_flags(pkix_validation_store, 
-				 X509_V_FLAG_PARTIAL_CHAIN);
+
+    }
+
+    /* Get shared SSL context with the same credentials */
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+    get_ctx_key(ssock, ssl_opt, ctx_key);
+    ctx = get_cached_ctx(ctx_key);
 #endif
+
+    /* Create SSL context */
+    if (ctx == NULL) {
+	ctx = SSL_CTX_new(ssl_method);
+	if (ctx == NULL) {
+	    return GET_SSL_STATUS(ssock);
+	}
+
+	status = init_ssl_ctx(ssock, ctx, ssl_opt);
+	if (status != PJ_SUCCESS) {
+	    SSL_CTX_free(ctx);
+	    return status;
 	}
+
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0
+	init_ssl_ctx_sess(ssock, ctx, ctx_key);
+	put_cached_ctx(ctx_key, ctx);
+#endif
     }
 
     /* Create SSL instance */
@@ -1055,10 +1704,31 @@ static pj_status_t create_ssl(pj_ssl_sock_t *ssock)
 	return status;
 
     /* Setup SSL BIOs */
+    ssock->write_bio = alloc_write_bio(ssock);
+    if (!ssock->write_bio)
+	return PJ_ENOMEM;
     ssock->ossl_rbio = BIO_new(BIO_s_mem());
-    ssock->ossl_wbio = BIO_new(BIO_s_mem());
+    ssock->ossl_wbio = ssock->write_bio->bio;
     (void)BIO_set_close(ssock->ossl_rbio, BIO_CLOSE);
-    (void)BIO_set_close(ssock->ossl_wbio, BIO_CLOSE);
+
+#if SSL_SOCK_USE_KTLS
+    /* Put kTLS filter BIO on top of the write BIO, to receive the send
+     * key from OpenSSL.
+     */
+    if (ssock->param.enable_ktls && ktls_bio_meth &&
+	ssock->param.sock_type == pj_SOCK_STREAM())
+    {
+	ssock->ktls_bio = BIO_new(ktls_bio_meth);
+	if (ssock->ktls_bio) {
+	    BIO_set_data(ssock->ktls_bio, ssock);
+	    BIO_push(ssock->ktls_bio, ssock->ossl_wbio);
+	    SSL_set_options(ssock->ossl_ssl, SSL_OP_ENABLE_KTLS);
+	    SSL_set_bio(ssock->ossl_ssl, ssock->ossl_rbio, ssock->ktls_bio);
+	    return PJ_SUCCESS;
+	}
+    }
+#endif
+
     SSL_set_bio(ssock->ossl_ssl, ssock->ossl_rbio, ssock->ossl_wbio);
 
     return PJ_SUCCESS;
@@ -1080,6 +1750,21 @@ static void destroy_ssl(pj_ssl_sock_t *ssock)
 	}   	
 	SSL_free(ssock->ossl_ssl); /* this will also close BIOs */
 	ssock->ossl_ssl = NULL;
+	ssock->write_bio = NULL;
+	ssock->ossl_wbio = NULL;
+	ssock->ktls_bio = NULL;
+    }
+
+    /* Destroy write BIOs which are not attached to SSL */
+    while (!pj_list_empty(&ssock->send_pending)) {
+	write_bio_t *wb = ssock->send_pending.next;
+	pj_list_erase(wb);
+	BIO_free(wb->bio);
+    }
+    while (!pj_list_empty(&ssock->send_empty)) {
+	write_bio_t *wb = ssock->send_empty.next;
+	pj_list_erase(wb);
+	BIO_free(wb->bio);
     }
 
     /* Destroy SSL context */
@@ -1240,17 +1925,12 @@ static pj_status_t set_curves_list(pj_ssl_sock_t *ssock)
 	curves[cnt] = get_nid_from_cid(ssock->param.curves[cnt]);
     }
 
-    if( SSL_is_server(ssock->ossl_ssl) ) {
-	ret = SSL_set1_curves(ssock->ossl_ssl, curves,
-			      ssock->param.curves_num);
-	if (ret < 1)
-	    return GET_SSL_STATUS(ssock);
-    } else {
-	ret = SSL_CTX_set1_curves(ssock->ossl_ctx, curves,
-				  ssock->param.curves_num);
-	if (ret < 1)
-	    return GET_SSL_STATUS(ssock);
-    }
+    /* Set on the SSL instance for both roles, as the SSL context may be
+     * shared with other sockets.
+     */
+    ret = SSL_set1_curves(ssock->ossl_ssl, curves, ssock->param.curves_num);
+    if (ret < 1)
+	return GET_SSL_STATUS(ssock);
 #else
     PJ_UNUSED_ARG(ssock);
 #endif
@@ -1573,9 +2253,20 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
     }
 
     /* Update certificates info on successful handshake */
-    if (status == PJ_SUCCESS)
+    if (status == PJ_SUCCESS) {
 	update_certs_info(ssock);
 
+	/* Peer certificate is not verified again when the session is
+	 * resumed, use the verification result stored in the session.
+	 */
+	if (SSL_session_reused(ssock->ossl_ssl) &&
+	    ssock->verify_status == PJ_SSL_CERT_ESUCCESS)
+	{
+	    ssock->verify_status = get_verify_status((int)
+				   SSL_get_verify_result(ssock->ossl_ssl));
+	}
+    }
+
     /* Accepting */
     if (ssock->is_server) {
 	if (status != PJ_SUCCESS) {
@@ -1652,6 +2343,10 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
 		if (err != SSL_ERROR_NONE)
 		    status = STATUS_FROM_SSL_ERR("connecting", ssock, err);
 	    }
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+	    /* Don't offer the same session again to this host */
+	    clear_client_session(ssock);
+#endif
 	    reset_ssl_sock_state(ssock);
 	}
 	if (ssock->param.cb.on_connect_complete) {
@@ -1665,258 +2360,287 @@ static pj_bool_t on_handshake_complete(pj_ssl_sock_t *ssock,
     return PJ_TRUE;
 }
 
-static write_data_t* alloc_send_data(pj_ssl_sock_t *ssock, pj_size_t len)
+/* Get a write BIO from the cache, or create a new one. Must be called
+ * with write mutex held.
+ */
+static write_bio_t* alloc_write_bio(pj_ssl_sock_t *ssock)
 {
-    send_buf_t *send_buf = &ssock->send_buf;
-    pj_size_t avail_len, skipped_len = 0;
-    char *reg1, *reg2;
-    pj_size_t reg1_len, reg2_len;
-    write_data_t *p;
+    write_bio_t *wb;
+
+    if (!pj_list_empty(&ssock->send_empty)) {
+	wb = ssock->send_empty.next;
+	pj_list_erase(wb);
+	return wb;
+    }
 
-    /* Check buffer availability */
-    avail_len = send_buf->max_len - send_buf->len;
-    if (avail_len < len)
+    wb = PJ_POOL_ZALLOC_T(ssock->pool, write_bio_t);
+    wb->bio = BIO_new(BIO_s_mem());
+    if (!wb->bio)
 	return NULL;
 
-    /* If buffer empty, reset start pointer and return it */
-    if (send_buf->len == 0) {
-	send_buf->start = send_buf->buf;
-	send_buf->len   = len;
-	p = (write_data_t*)send_buf->start;
-	goto init_send_data;
-    }
+    (void)BIO_set_close(wb->bio, BIO_CLOSE);
+    pj_list_init(wb);
+    pj_list_init(&wb->app_data);
 
-    /* Free space may be wrapped/splitted into two regions, so let's
-     * analyze them if any region can hold the write data.
-     */
-    reg1 = send_buf->start + send_buf->len;
-    if (reg1 >= send_buf->buf + send_buf->max_len)
-	reg1 -= send_buf->max_len;
-    reg1_len = send_buf->max_len - send_buf->len;
-    if (reg1 + reg1_len > send_buf->buf + send_buf->max_len) {
-	reg1_len = send_buf->buf + send_buf->max_len - reg1;
-	reg2 = send_buf->buf;
-	reg2_len = send_buf->start - send_buf->buf;
+    return wb;
+}
+
+/* Get a write data record from the cache, or allocate a new one. Must be
+ * called with write mutex held.
+ */
+static write_data_t* alloc_write_data(pj_ssl_sock_t *ssock)
+{
+    write_data_t *wdata;
+
+    if (!pj_list_empty(&ssock->write_pending_empty)) {
+	wdata = ssock->write_pending_empty.next;
+	pj_list_erase(wdata);
     } else {
-	reg2 = NULL;
-	reg2_len = 0;
+	wdata = PJ_POOL_ZALLOC_T(ssock->pool, write_data_t);
     }
 
-    /* More buffer availability check, note that the write data must be in
-     * a contigue buffer.
-     */
-    avail_len = PJ_MAX(reg1_len, reg2_len);
-    if (avail_len < len)
+    return wdata;
+}
+
+/* Detach the current write BIO from SSL and replace it with an empty one,
+ * so the BIO content can be sent while SSL keeps writing. Must be called
+ * with write mutex held.
+ */
+static write_bio_t* detach_write_bio(pj_ssl_sock_t *ssock)
+{
+    write_bio_t *wb = ssock->write_bio;
+    write_bio_t *new_wb;
+
+    new_wb = alloc_write_bio(ssock);
+    if (!new_wb)
 	return NULL;
 
-    /* Get the data slot */
-    if (reg1_len >= len) {
-	p = (write_data_t*)reg1;
-    } else {
-	p = (write_data_t*)reg2;
-	skipped_len = reg1_len;
+#if SSL_SOCK_USE_KTLS
+    /* The write BIO is below the kTLS filter BIO, just replace it */
+    if (ssock->ktls_bio) {
+	BIO_set_next(ssock->ktls_bio, new_wb->bio);
+	ssock->write_bio = new_wb;
+	ssock->ossl_wbio = new_wb->bio;
+	return wb;
     }
+#endif
 
-    /* Update buffer length */
-    send_buf->len += len + skipped_len;
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+    /* SSL_set0_wbio() takes over the ownership of the new BIO and releases
+     * the old one, so keep a reference to the old BIO.
+     */
+    BIO_up_ref(wb->bio);
+    SSL_set0_wbio(ssock->ossl_ssl, new_wb->bio);
+#else
+    /* Older OpenSSL has no API to replace only the write BIO, do what
+     * SSL_set0_wbio() does, i.e: keep the handshake buffering BIO on top.
+     */
+    {
+	SSL *ssl = ssock->ossl_ssl;
+
+	if (ssl->bbio != NULL)
+	    ssl->wbio = BIO_pop(ssl->wbio);
+	ssl->wbio = new_wb->bio;
+	if (ssl->bbio != NULL)
+	    ssl->wbio = BIO_push(ssl->bbio, ssl->wbio);
+    }
+#endif
 
-init_send_data:
-    /* Init the new send data */
-    pj_bzero(p, sizeof(*p));
-    pj_list_init(p);
-    pj_list_push_back(&ssock->send_pending, p);
+    ssock->write_bio = new_wb;
+    ssock->ossl_wbio = new_wb->bio;
 
-    return p;
+    return wb;
 }
 
-static void free_send_data(pj_ssl_sock_t *ssock, write_data_t *wdata)
+/* Send the content of a detached write BIO to the network socket. */
+static pj_status_t send_write_bio(pj_ssl_sock_t *ssock,
+				  write_bio_t *wb,
+				  unsigned flags,
+				  pj_ssize_t *sent)
 {
-    send_buf_t *buf = &ssock->send_buf;
-    write_data_t *spl = &ssock->send_pending;
+    char *data;
+    pj_ssize_t len;
+    pj_status_t status;
 
-    pj_assert(!pj_list_empty(&ssock->send_pending));
-    
-    /* Free slot from the buffer */
-    if (spl->next == wdata && spl->prev == wdata) {
-	/* This is the only data, reset the buffer */
-	buf->start = buf->buf;
-	buf->len = 0;
-    } else if (spl->next == wdata) {
-	/* This is the first data, shift start pointer of the buffer and
-	 * adjust the buffer length.
-	 */
-	buf->start = (char*)wdata->next;
-	if (wdata->next > wdata) {
-	    buf->len -= ((char*)wdata->next - buf->start);
-	} else {
-	    /* Overlapped */
-	    pj_size_t right_len, left_len;
-	    right_len = buf->buf + buf->max_len - (char*)wdata;
-	    left_len  = (char*)wdata->next - buf->buf;
-	    buf->len -= (right_len + left_len);
-	}
-    } else if (spl->prev == wdata) {
-	/* This is the last data, just adjust the buffer length */
-	if (wdata->prev < wdata) {
-	    pj_size_t jump_len;
-	    jump_len = (char*)wdata -
-		       ((char*)wdata->prev + wdata->prev->record_len);
-	    buf->len -= (wdata->record_len + jump_len);
-	} else {
-	    /* Overlapped */
-	    pj_size_t right_len, left_len;
-	    right_len = buf->buf + buf->max_len -
-			((char*)wdata->prev + wdata->prev->record_len);
-	    left_len  = (char*)wdata + wdata->record_len - buf->buf;
-	    buf->len -= (right_len + left_len);
-	}
+    len = BIO_get_mem_data(wb->bio, &data);
+
+    pj_ioqueue_op_key_init(&wb->key, sizeof(pj_ioqueue_op_key_t));
+    wb->key.user_data = wb;
+
+    if (ssock->param.sock_type == pj_SOCK_STREAM()) {
+	status = pj_activesock_send(ssock->asock, &wb->key, data, &len,
+				    flags);
+    } else {
+	status = pj_activesock_sendto(ssock->asock, &wb->key, data, &len,
+				      flags,
+				      (pj_sockaddr_t*)&ssock->rem_addr,
+				      ssock->addr_len);
     }
-    /* For data in the middle buffer, just do nothing on the buffer. The slot
-     * will be freed later when freeing the first/last data.
-     */
-    
-    /* Remove the data from send pending list */
-    pj_list_erase(wdata);
+
+    *sent = (status == PJ_SUCCESS)? len : -status;
+
+    return status;
 }
 
-#if 0
-/* Just for testing send buffer alloc/free */
-#include <pj/rand.h>
-pj_status_t pj_ssl_sock_ossl_test_send_buf(pj_pool_t *pool)
+/* Called when the content of a write BIO has been sent (or failed to be
+ * sent). This recycles the BIO, sends any data written to SSL while
+ * the socket was busy (or fails it when the sending has failed), and
+ * notifies application of the data sent, except for the data specified
+ * in 'own', which sending status is returned to application directly.
+ * Returns PJ_FALSE if application has destroyed the socket.
+ */
+static pj_bool_t on_write_bio_sent(pj_ssl_sock_t *ssock,
+				   write_bio_t *wb,
+				   pj_ssize_t sent,
+				   write_data_t *own)
 {
-    enum { MAX_CHUNK_NUM = 20 };
-    unsigned chunk_size, chunk_cnt, i;
-    write_data_t *wdata[MAX_CHUNK_NUM] = {0};
-    pj_time_val now;
-    pj_ssl_sock_t *ssock = NULL;
-    pj_ssl_sock_param param;
-    pj_status_t status;
+    while (wb) {
+	write_data_t app_data;
+	write_bio_t *next_wb = NULL;
 
-    pj_gettimeofday(&now);
-    pj_srand((unsigned)now.sec);
+	pj_lock_acquire(ssock->write_mutex);
 
-    pj_ssl_sock_param_default(&param);
-    status = pj_ssl_sock_create(pool, &param, &ssock);
-    if (status != PJ_SUCCESS) {
-	return status;
-    }
+	/* Take the application data records and recycle the BIO */
+	pj_list_init(&app_data);
+	pj_list_merge_last(&app_data, &wb->app_data);
+	pj_list_erase(wb);
+	(void)BIO_reset(wb->bio);
+	pj_list_push_back(&ssock->send_empty, wb);
 
-    if (ssock->send_buf.max_len == 0) {
-	ssock->send_buf.buf = (char*)
-			      pj_pool_alloc(ssock->pool, 
-					    ssock->param.send_buffer_size);
-	ssock->send_buf.max_len = ssock->param.send_buffer_size;
-	ssock->send_buf.start = ssock->send_buf.buf;
-	ssock->send_buf.len = 0;
-    }
+	/* The connection is broken, so the data written to SSL while the
+	 * socket was busy will never be sent, fail it with the same error.
+	 */
+	if (sent <= 0 && ssock->write_bio &&
+	    !pj_list_empty(&ssock->write_bio->app_data))
+	{
+	    pj_list_merge_last(&app_data, &ssock->write_bio->app_data);
+	    (void)BIO_reset(ssock->write_bio->bio);
+	}
 
-    chunk_size = ssock->param.send_buffer_size / MAX_CHUNK_NUM / 2;
-    chunk_cnt = 0;
-    for (i = 0; i < MAX_CHUNK_NUM; i++) {
-	wdata[i] = alloc_send_data(ssock, pj_rand() % chunk_size + 321);
-	if (wdata[i])
-	    chunk_cnt++;
-	else
-	    break;
-    }
+	/* Data has been written to SSL while the socket was busy, send
+	 * it all at once now.
+	 */
+	if (sent > 0 && ssock->param.sock_type == pj_SOCK_STREAM() &&
+	    ssock->write_bio && pj_list_empty(&ssock->send_pending) &&
+	    BIO_pending(ssock->ossl_wbio))
+	{
+	    next_wb = detach_write_bio(ssock);
+	    if (next_wb)
+		pj_list_push_back(&ssock->send_pending, next_wb);
+	}
+
+	pj_lock_release(ssock->write_mutex);
+
+	/* Notify application */
+	while (!pj_list_empty(&app_data)) {
+	    write_data_t *wdata = app_data.next;
+	    pj_ioqueue_op_key_t *app_key = wdata->app_key;
+	    pj_size_t plain_data_len = wdata->plain_data_len;
 
-    while (chunk_cnt) {
-	i = pj_rand() % MAX_CHUNK_NUM;
-	if (wdata[i]) {
-	    free_send_data(ssock, wdata[i]);
-	    wdata[i] = NULL;
-	    chunk_cnt--;
+	    pj_lock_acquire(ssock->write_mutex);
+	    pj_list_erase(wdata);
+	    pj_list_push_back(&ssock->write_pending_empty, wdata);
+	    pj_lock_release(ssock->write_mutex);
+
+	    if (wdata != own && ssock->param.cb.on_data_sent) {
+		pj_bool_t ret;
+		pj_ssize_t sent_len;
+
+		sent_len = (sent > 0)? (pj_ssize_t)plain_data_len : sent;
+		ret = (*ssock->param.cb.on_data_sent)(ssock, app_key,
+						      sent_len);
+		if (!ret) {
+		    /* We've been destroyed */
+		    return PJ_FALSE;
+		}
+	    }
 	}
-    }
+	own = NULL;
 
-    if (ssock->send_buf.len != 0)
-	status = PJ_EBUG;
+	/* Send the pending data */
+	wb = NULL;
+	if (next_wb) {
+	    if (send_write_bio(ssock, next_wb, 0, &sent) != PJ_EPENDING)
+		wb = next_wb;
+	}
+    }
 
-    pj_ssl_sock_close(ssock);
-    return status;
+    return PJ_TRUE;
 }
-#endif
-
 
 /* Flush write BIO to network socket. Note that any access to write BIO
  * MUST be serialized, so mutex protection must cover any call to OpenSSL
  * API (that possibly generate data for write BIO) along with the call to
  * this function (flushing all data in write BIO generated by above 
  * OpenSSL API call).
+ *
+ * For stream socket, when previous data is still being sent, the data is
+ * left in the write BIO, and all data accumulated will be sent at once
+ * when the previous sending completes.
  */
 static pj_status_t flush_write_bio(pj_ssl_sock_t *ssock, 
 				   pj_ioqueue_op_key_t *send_key,
 				   pj_size_t orig_len,
 				   unsigned flags)
 {
-    char *data;
-    pj_ssize_t len;
-    write_data_t *wdata;
-    pj_size_t needed_len;
+    write_bio_t *wb;
+    write_data_t *wdata = NULL;
+    pj_ssize_t sent;
     pj_status_t status;
 
     pj_lock_acquire(ssock->write_mutex);
 
     /* Check if there is data in write BIO, flush it if any */
-    if (!BIO_pending(ssock->ossl_wbio)) {
+    if (!ssock->write_bio || !BIO_pending(ssock->ossl_wbio)) {
 	pj_lock_release(ssock->write_mutex);
 	return PJ_SUCCESS;
     }
 
-    /* Get data and its length */
-    len = BIO_get_mem_data(ssock->ossl_wbio, &data);
-    if (len == 0) {
-	pj_lock_release(ssock->write_mutex);
-	return PJ_SUCCESS;
+    /* Keep application data info in the write BIO, for the sending
+     * notification.
+     */
+    if (send_key != &ssock->handshake_op_key) {
+	wdata = alloc_write_data(ssock);
+	wdata->app_key = send_key;
+	wdata->plain_data_len = orig_len;
+	wdata->flags = flags;
+	wdata->data = NULL;
+	pj_list_push_back(&ssock->write_bio->app_data, wdata);
     }
 
-    /* Calculate buffer size needed, and align it to 8 */
-    needed_len = len + sizeof(write_data_t);
-    needed_len = ((needed_len + 7) >> 3) << 3;
+    /* Previous data is still being sent, or more delayed data is going
+     * to be written, the data will be sent later at once.
+     */
+    if (ssock->param.sock_type == pj_SOCK_STREAM() &&
+	(!pj_list_empty(&ssock->send_pending) ||
+	 (ssock->defer_flush &&
+	  BIO_pending(ssock->ossl_wbio) <
+	      (int)ssock->param.send_buffer_size)))
+    {
+	pj_lock_release(ssock->write_mutex);
+	return PJ_EPENDING;
+    }
 
-    /* Allocate buffer for send data */
-    wdata = alloc_send_data(ssock, needed_len);
-    if (wdata == NULL) {
+    /* Take the write BIO out of SSL to be sent */
+    wb = detach_write_bio(ssock);
+    if (wb == NULL) {
+	if (wdata) {
+	    pj_list_erase(wdata);
+	    pj_list_push_back(&ssock->write_pending_empty, wdata);
+	}
 	pj_lock_release(ssock->write_mutex);
 	return PJ_ENOMEM;
     }
-
-    /* Copy the data and set its properties into the send data */
-    pj_ioqueue_op_key_init(&wdata->key, sizeof(pj_ioqueue_op_key_t));
-    wdata->key.user_data = wdata;
-    wdata->app_key = send_key;
-    wdata->record_len = needed_len;
-    wdata->data_len = len;
-    wdata->plain_data_len = orig_len;
-    wdata->flags = flags;
-    pj_memcpy(&wdata->data, data, len);
-
-    /* Reset write BIO */
-    (void)BIO_reset(ssock->ossl_wbio);
+    pj_list_push_back(&ssock->send_pending, wb);
 
     /* Ticket #1573: Don't hold mutex while calling PJLIB socket send(). */
     pj_lock_release(ssock->write_mutex);
 
     /* Send it */
-    if (ssock->param.sock_type == pj_SOCK_STREAM()) {
-	status = pj_activesock_send(ssock->asock, &wdata->key, 
-				    wdata->data.content, &len,
-				    flags);
-    } else {
-	status = pj_activesock_sendto(ssock->asock, &wdata->key, 
-				      wdata->data.content, &len,
-				      flags,
-				      (pj_sockaddr_t*)&ssock->rem_addr,
-				      ssock->addr_len);
-    }
-
+    status = send_write_bio(ssock, wb, flags, &sent);
     if (status != PJ_EPENDING) {
-	/* When the sending is not pending, remove the wdata from send
-	 * pending list.
-	 */
-	pj_lock_acquire(ssock->write_mutex);
-	free_send_data(ssock, wdata);
-	pj_lock_release(ssock->write_mutex);
+	/* When the sending is not pending, release the write BIO now */
+	on_write_bio_sent(ssock, wb, sent, wdata);
     }
 
     return status;
@@ -1953,29 +2677,39 @@ static void on_timer(pj_timer_heap_t *th, struct pj_timer_entry *te)
 static pj_status_t do_handshake(pj_ssl_sock_t *ssock)
 {
     pj_status_t status;
-    int err;
-
-    /* Perform SSL handshake */
-    pj_lock_acquire(ssock->write_mutex);
-    err = SSL_do_handshake(ssock->ossl_ssl);
-    pj_lock_release(ssock->write_mutex);
+    int err, err2 = SSL_ERROR_NONE;
+    pj_bool_t has_data;
 
-    /* SSL_do_handshake() may put some pending data into SSL write BIO, 
-     * flush it if any.
-     */
-    status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
-    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
-	return status;
-    }
+    do {
+	/* Perform SSL handshake */
+	pj_lock_acquire(ssock->write_mutex);
+	err = SSL_do_handshake(ssock->ossl_ssl);
+	if (err < 0)
+	    err2 = SSL_get_error(ssock->ossl_ssl, err);
+	has_data = (ssock->write_bio && BIO_pending(ssock->ossl_wbio));
+	pj_lock_release(ssock->write_mutex);
 
-    if (err < 0) {
-	int err2 = SSL_get_error(ssock->ossl_ssl, err);
-	if (err2 != SSL_ERROR_NONE && err2 != SSL_ERROR_WANT_READ)
-	{
-	    /* Handshake fails */
-	    status = STATUS_FROM_SSL_ERR2("Handshake", ssock, err, err2, 0);
+	/* SSL_do_handshake() may put some pending data into SSL write BIO, 
+	 * flush it if any.
+	 */
+	status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
+	if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 	    return status;
 	}
+
+	/* A kernel TLS control record waits for the data written before
+	 * it, retry now if the data has just been sent, otherwise the
+	 * handshake continues when the sending completes.
+	 */
+    } while (err < 0 && err2 == SSL_ERROR_WANT_WRITE &&
+	     status == PJ_SUCCESS && has_data);
+
+    if (err < 0 && err2 != SSL_ERROR_NONE && err2 != SSL_ERROR_WANT_READ &&
+	err2 != SSL_ERROR_WANT_WRITE)
+    {
+	/* Handshake fails */
+	status = STATUS_FROM_SSL_ERR2("Handshake", ssock, err, err2, 0);
+	return status;
     }
 
     /* Check if handshake has been completed */
@@ -2137,6 +2871,10 @@ static pj_bool_t asock_on_data_read (pj_activesock_t *asock,
 		    if (status == PJ_EBUSY)
 			status = PJ_SUCCESS;
 
+		    /* We've been destroyed */
+		    if (status == PJ_ECANCELLED)
+			return PJ_FALSE;
+
 		    if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 			PJ_PERROR(1,(ssock->pool->obj_name, status, 
 				     "Failed to flush delayed send"));
@@ -2181,8 +2919,13 @@ static pj_bool_t asock_on_data_sent (pj_activesock_t *asock,
     pj_ssl_sock_t *ssock = (pj_ssl_sock_t*)
 			   pj_activesock_get_user_data(asock);
 
-    PJ_UNUSED_ARG(send_key);
-    PJ_UNUSED_ARG(sent);
+    write_bio_t *wb = (write_bio_t*)send_key->user_data;
+
+    /* Release the write BIO, send data accumulated meanwhile, and notify
+     * application of the data sent.
+     */
+    if (!on_write_bio_sent(ssock, wb, sent, NULL))
+	return PJ_FALSE;
 
     if (ssock->ssl_state == SSL_STATE_HANDSHAKING) {
 	/* Initial handshaking */
@@ -2193,29 +2936,21 @@ static pj_bool_t asock_on_data_sent (pj_activesock_t *asock,
 	if (status != PJ_EPENDING)
 	    return on_handshake_complete(ssock, status);
 
-    } else if (send_key != &ssock->handshake_op_key) {
-	/* Some data has been sent, notify application */
-	write_data_t *wdata = (write_data_t*)send_key->user_data;
-	if (ssock->param.cb.on_data_sent) {
-	    pj_bool_t ret;
-	    pj_ssize_t sent_len;
+    } else if (ssock->ssl_state == SSL_STATE_ESTABLISHED &&
+	       !pj_list_empty(&ssock->write_pending))
+    {
+	/* Sending may have been delayed as the socket was busy */
+	pj_status_t status;
 
-	    sent_len = (sent > 0)? wdata->plain_data_len : sent;
-	    ret = (*ssock->param.cb.on_data_sent)(ssock, wdata->app_key, 
-						  sent_len);
-	    if (!ret) {
-		/* We've been destroyed */
-		return PJ_FALSE;
-	    }
+	status = flush_delayed_send(ssock);
+	if (status == PJ_ECANCELLED)
+	    return PJ_FALSE;
+	if (status != PJ_SUCCESS && status != PJ_EPENDING &&
+	    status != PJ_EBUSY)
+	{
+	    PJ_PERROR(1,(ssock->pool->obj_name, status, 
+			 "Failed to flush delayed send"));
 	}
-
-	/* Update write buffer state */
-	pj_lock_acquire(ssock->write_mutex);
-	free_send_data(ssock, wdata);
-	pj_lock_release(ssock->write_mutex);
-
-    } else {
-	/* SSL re-negotiation is on-progress, just do nothing */
     }
 
     return PJ_TRUE;
@@ -2343,15 +3078,6 @@ static pj_bool_t asock_on_accept_complete (pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
 	goto on_return;
 
-    /* Prepare write/send state */
-    pj_assert(ssock->send_buf.max_len == 0);
-    ssock->send_buf.buf = (char*)
-			  pj_pool_alloc(ssock->pool, 
-					ssock->param.send_buffer_size);
-    ssock->send_buf.max_len = ssock->param.send_buffer_size;
-    ssock->send_buf.start = ssock->send_buf.buf;
-    ssock->send_buf.len = 0;
-
     /* Start handshake timer */
     if (ssock->param.timer_heap && (ssock->param.timeout.sec != 0 ||
 	ssock->param.timeout.msec != 0))
@@ -2425,15 +3151,6 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     if (status != PJ_SUCCESS)
 	goto on_return;
 
-    /* Prepare write/send state */
-    pj_assert(ssock->send_buf.max_len == 0);
-    ssock->send_buf.buf = (char*)
-			     pj_pool_alloc(ssock->pool, 
-					   ssock->param.send_buffer_size);
-    ssock->send_buf.max_len = ssock->param.send_buffer_size;
-    ssock->send_buf.start = ssock->send_buf.buf;
-    ssock->send_buf.len = 0;
-
 #ifdef SSL_set_tlsext_host_name
     /* Set server name to connect */
     if (ssock->param.server_name.slen) {
@@ -2450,6 +3167,11 @@ static pj_bool_t asock_on_connect_complete (pj_activesock_t *asock,
     }
 #endif
 
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+    /* Try to resume previous session with the same remote host */
+    set_client_session(ssock);
+#endif
+
     /* Start SSL handshake */
     ssock->ssl_state = SSL_STATE_HANDSHAKING;
     SSL_set_connect_state(ssock->ossl_ssl);
@@ -2723,6 +3445,7 @@ PJ_DEF(pj_status_t) pj_ssl_sock_create (pj_pool_t *pool,
     pj_list_init(&ssock->write_pending);
     pj_list_init(&ssock->write_pending_empty);
     pj_list_init(&ssock->send_pending);
+    pj_list_init(&ssock->send_empty);
     pj_timer_entry_init(&ssock->timer, 0, ssock, &on_timer);
     pj_ioqueue_op_key_init(&ssock->handshake_op_key,
 			   sizeof(pj_ioqueue_op_key_t));
@@ -2848,6 +3571,13 @@ PJ_DEF(pj_status_t) pj_ssl_sock_get_info (pj_ssl_sock_t *ssock,
 
 	/* Verification status */
 	info->verify_status = ssock->verify_status;
+
+	/* Kernel TLS */
+	info->ktls_send = ssock->ktls_send;
+
+	/* Session resumption */
+	info->session_reused = SSL_session_reused(ssock->ossl_ssl) ? PJ_TRUE :
+								     PJ_FALSE;
     }
 
     /* Last known OpenSSL error code */
@@ -2985,6 +3715,19 @@ static pj_status_t ssl_write(pj_ssl_sock_t *ssock,
      * until re-negotiation is completed.
      */
     pj_lock_acquire(ssock->write_mutex);
+
+    /* The socket is busy and enough secured data is waiting to be sent,
+     * delay sending until the socket has sent the previous data.
+     */
+    if (ssock->param.sock_type == pj_SOCK_STREAM() &&
+	!pj_list_empty(&ssock->send_pending) &&
+	BIO_pending(ssock->ossl_wbio) + size >
+	    (pj_ssize_t)ssock->param.send_buffer_size)
+    {
+	pj_lock_release(ssock->write_mutex);
+	return PJ_EBUSY;
+    }
+
     nwritten = SSL_write(ssock->ossl_ssl, data, (int)size);
     pj_lock_release(ssock->write_mutex);
     
@@ -2997,8 +3740,12 @@ static pj_status_t ssl_write(pj_ssl_sock_t *ssock,
 	 */
 	int err;
 	err = SSL_get_error(ssock->ossl_ssl, nwritten);
-	if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_NONE) {
-	    /* Re-negotiation is on progress, flush re-negotiation data */
+	if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ||
+	    err == SSL_ERROR_NONE)
+	{
+	    /* Re-negotiation is on progress, or a kernel TLS control record
+	     * waits for the socket, flush the data written so far.
+	     */
 	    status = flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
 	    if (status == PJ_SUCCESS || status == PJ_EPENDING)
 		/* Just return PJ_EBUSY when re-negotiation is on progress */
@@ -3041,20 +3788,44 @@ static pj_status_t flush_delayed_send(pj_ssl_sock_t *ssock)
 
 	wp = ssock->write_pending.next;
 
+	/* Let the data accumulate in the write BIO while there is more
+	 * delayed data to write, so they can be sent at once.
+	 */
+	ssock->defer_flush = (wp->next != &ssock->write_pending);
+
 	/* Ticket #1573: Don't hold mutex while calling socket send. */
 	pj_lock_release(ssock->write_mutex);
 
-	status = ssl_write(ssock, &wp->key, wp->data.ptr, 
+	status = ssl_write(ssock, wp->app_key, wp->data, 
 			   wp->plain_data_len, wp->flags);
-	if (status != PJ_SUCCESS) {
+	if (status != PJ_SUCCESS && status != PJ_EPENDING) {
 	    /* Reset ongoing flush flag first. */
+	    ssock->defer_flush = PJ_FALSE;
 	    ssock->flushing_write_pend = PJ_FALSE;
+
+	    /* Send the data accumulated so far */
+	    flush_write_bio(ssock, &ssock->handshake_op_key, 0, 0);
 	    return status;
 	}
 
 	pj_lock_acquire(ssock->write_mutex);
 	pj_list_erase(wp);
 	pj_list_push_back(&ssock->write_pending_empty, wp);
+
+	/* Application has been told that the sending is pending, so notify
+	 * it when the data has been sent immediately.
+	 */
+	if (status == PJ_SUCCESS && ssock->param.cb.on_data_sent) {
+	    pj_ioqueue_op_key_t *app_key = wp->app_key;
+	    pj_ssize_t sent = (pj_ssize_t)wp->plain_data_len;
+
+	    pj_lock_release(ssock->write_mutex);
+	    if (!(*ssock->param.cb.on_data_sent)(ssock, app_key, sent)) {
+		/* We've been destroyed */
+		return PJ_ECANCELLED;
+	    }
+	    pj_lock_acquire(ssock->write_mutex);
+	}
     }
 
     /* Reset ongoing flush flag */
@@ -3077,16 +3848,11 @@ static pj_status_t delay_send (pj_ssl_sock_t *ssock,
     pj_lock_acquire(ssock->write_mutex);
 
     /* Init write pending instance */
-    if (!pj_list_empty(&ssock->write_pending_empty)) {
-	wp = ssock->write_pending_empty.next;
-	pj_list_erase(wp);
-    } else {
-	wp = PJ_POOL_ZALLOC_T(ssock->pool, write_data_t);
-    }
+    wp = alloc_write_data(ssock);
 
     wp->app_key = send_key;
     wp->plain_data_len = size;
-    wp->data.ptr = data;
+    wp->data = data;
     wp->flags = flags;
 
     pj_list_push_back(&ssock->write_pending, wp);
@@ -3131,8 +3897,21 @@ PJ_DEF(pj_status_t) pj_ssl_sock_send (pj_ssl_sock_t *ssock,
     /* Write data to SSL */
     status = ssl_write(ssock, send_key, data, *size, flags);
     if (status == PJ_EBUSY) {
-	/* Re-negotiation is on progress, delay sending */
+	pj_bool_t send_idle;
+
+	/* Re-negotiation is on progress or the socket is busy, delay
+	 * sending.
+	 */
 	status = delay_send(ssock, send_key, data, *size, flags);
+
+	/* The socket may have finished sending before the data got
+	 * queued, flush it so it won't wait for the next sending.
+	 */
+	pj_lock_acquire(ssock->write_mutex);
+	send_idle = pj_list_empty(&ssock->send_pending);
+	pj_lock_release(ssock->write_mutex);
+	if (send_idle)
+	    flush_delayed_send(ssock);
     }
 
 on_return:
@@ -3243,7 +4022,8 @@ pj_ssl_sock_start_accept2(pj_ssl_sock_t *ssock,
 	goto on_error;
 
     /* Start listening to the address */
-    status = pj_sock_listen(ssock->sock, PJ_SOMAXCONN);
+    status = pj_sock_listen(ssock->sock, ssock->param.backlog > 0 ?
+					 ssock->param.backlog : PJ_SOMAXCONN);
     if (status != PJ_SUCCESS)
 	goto on_error;
 
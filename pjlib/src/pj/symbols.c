@@ -77,6 +77,8 @@ PJ_EXPORT_SYMBOL(pj_create_unique_string)
  * hash.h
  */
 PJ_EXPORT_SYMBOL(pj_hash_calc)
+PJ_EXPORT_SYMBOL(pj_hash_calc_seeded)
+PJ_EXPORT_SYMBOL(pj_hash_calc_seeded_tolower)
 PJ_EXPORT_SYMBOL(pj_hash_create)
 PJ_EXPORT_SYMBOL(pj_hash_get)
 PJ_EXPORT_SYMBOL(pj_hash_set)
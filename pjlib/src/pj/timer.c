@@ -45,6 +45,14 @@
 
 #define DEFAULT_MAX_TIMED_OUT_PER_POLL  (64)
 
+/* Timing wheel geometry: WHEEL_LEVELS levels of WHEEL_SLOTS slots each,
+ * covering 2^32 ticks of PJ_TIMER_WHEEL_RESOLUTION msec.
+ */
+#define WHEEL_BITS	8
+#define WHEEL_SLOTS	(1 << WHEEL_BITS)
+#define WHEEL_MASK	(WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS	4
+
 enum
 {
     F_DONT_CALL = 1,
@@ -53,6 +61,34 @@ enum
 };
 
 
+/**
+ * Hierarchical timing wheel, used instead of the heap ordering when the
+ * timer heap is created with PJ_TIMER_HEAP_WHEEL.
+ *
+ * An entry is put in the lowest level whose slot range still contains
+ * the entry's expiration tick, so the entries in the lowest level expire
+ * within the current rotation. When the lowest level completes a
+ * rotation, the next slot of the level above is "cascaded", i.e. its
+ * entries are redistributed to the lower levels. Schedule and cancel
+ * are O(1), and all entries of a slot expire together.
+ */
+typedef struct timer_wheel
+{
+    /** The next tick to be processed. */
+    pj_uint64_t cur_tick;
+
+    /** Slot lists, WHEEL_SLOTS per level. Zero means empty. */
+    pj_timer_id_t head[WHEEL_LEVELS * WHEEL_SLOTS];
+
+    /** Number of entries in each level. */
+    pj_size_t level_cnt[WHEEL_LEVELS];
+
+    /** Links of the slot lists, indexed by timer id. */
+    pj_timer_id_t *next;
+    pj_timer_id_t *prev;
+
+} timer_wheel;
+
 /**
  * The implementation of timer heap.
  */
@@ -105,6 +141,25 @@ struct pj_timer_heap_t
     /** Callback to be called when a timer expires. */
     pj_timer_heap_callback *callback;
 
+    /**
+     * The timing wheel, or NULL if the binary heap is used. With the
+     * wheel, <heap> is indexed by timer id instead, and the <timer_ids>
+     * slot of an active entry contains the wheel slot of the entry.
+     */
+    timer_wheel *wheel;
+
+    /** Shards of a sharded timer heap, or NULL. */
+    pj_timer_heap_t **shards;
+
+    /** Number of shards, which is 1 if the timer heap is not sharded. */
+    unsigned shard_cnt;
+
+    /** Thread local index holding the (shard index + 1) of the thread. */
+    long thread_shard_id;
+
+    /** The sharded timer heap which owns this shard, or NULL. */
+    pj_timer_heap_t *parent;
+
 };
 
 
@@ -287,10 +342,169 @@ static void grow_heap(pj_timer_heap_t *ht)
     // And add the new elements to the end of the "freelist".
     for (i = ht->max_size; i < new_size; i++)
 	ht->timer_ids[i] = -((pj_timer_id_t) (i + 1));
+
+    // Grow the timing wheel links.
+    if (ht->wheel) {
+	timer_wheel *w = ht->wheel;
+	pj_timer_id_t *new_links;
+
+	new_links = (pj_timer_id_t*)
+		    pj_pool_alloc(ht->pool, new_size * sizeof(pj_timer_id_t));
+	memcpy(new_links, w->next, ht->max_size * sizeof(pj_timer_id_t));
+	w->next = new_links;
+
+	new_links = (pj_timer_id_t*)
+		    pj_pool_alloc(ht->pool, new_size * sizeof(pj_timer_id_t));
+	memcpy(new_links, w->prev, ht->max_size * sizeof(pj_timer_id_t));
+	w->prev = new_links;
+    }
     
     ht->max_size = new_size;
 }
 
+/* Convert absolute time to timing wheel tick, rounded up so that timers
+ * never expire early.
+ */
+static pj_uint64_t time_to_tick(const pj_time_val *t)
+{
+    pj_uint64_t msec = (pj_uint64_t)t->sec * 1000 + t->msec;
+    return (msec + PJ_TIMER_WHEEL_RESOLUTION - 1) / PJ_TIMER_WHEEL_RESOLUTION;
+}
+
+/* Put the entry with the specified timer id in its wheel slot. */
+static void wheel_link(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    timer_wheel *w = ht->wheel;
+    pj_uint64_t tick = time_to_tick(&ht->heap[id]->_timer_value);
+    pj_uint64_t diff;
+    unsigned level, slot;
+
+    // Entries which are already due go to the slot being processed.
+    if (tick < w->cur_tick)
+	tick = w->cur_tick;
+
+    // Find the lowest level where the tick shares the upper bits with
+    // the current tick.
+    diff = tick ^ w->cur_tick;
+    for (level = 0; level < WHEEL_LEVELS - 1; ++level) {
+	if ((diff >> (WHEEL_BITS * (level + 1))) == 0)
+	    break;
+    }
+
+    // Too far in the future: park it in the current slot of the top level,
+    // it will be cascaded (and linked again) after a full rotation.
+    if ((diff >> (WHEEL_BITS * WHEEL_LEVELS)) != 0)
+	tick = w->cur_tick;
+
+    slot = level * WHEEL_SLOTS +
+	   (unsigned)((tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+
+    w->prev[id] = 0;
+    w->next[id] = w->head[slot];
+    if (w->head[slot])
+	w->prev[w->head[slot]] = id;
+    w->head[slot] = id;
+
+    ht->timer_ids[id] = slot;
+    ++w->level_cnt[level];
+}
+
+/* Remove the entry with the specified timer id from its wheel slot. */
+static void wheel_unlink(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    timer_wheel *w = ht->wheel;
+    pj_timer_id_t slot = ht->timer_ids[id];
+
+    if (w->prev[id])
+	w->next[w->prev[id]] = w->next[id];
+    else
+	w->head[slot] = w->next[id];
+    if (w->next[id])
+	w->prev[w->next[id]] = w->prev[id];
+
+    --w->level_cnt[slot / WHEEL_SLOTS];
+}
+
+/* Advance the wheel by one tick, cascading the upper levels when the
+ * lower level completes a rotation.
+ */
+static void wheel_advance(pj_timer_heap_t *ht)
+{
+    timer_wheel *w = ht->wheel;
+    unsigned level, top;
+
+    ++w->cur_tick;
+
+    // Find the highest level which reaches a slot boundary.
+    for (top = 0; top < WHEEL_LEVELS - 1; ++top) {
+	pj_uint64_t mask = ((pj_uint64_t)1 << (WHEEL_BITS * (top + 1))) - 1;
+	if ((w->cur_tick & mask) != 0)
+	    break;
+    }
+
+    // Cascade from the top, so that entries moved down are cascaded
+    // again by the lower level.
+    for (level = top; level > 0; --level) {
+	unsigned slot = level * WHEEL_SLOTS +
+			(unsigned)((w->cur_tick >> (WHEEL_BITS * level)) &
+				   WHEEL_MASK);
+	pj_timer_id_t id = w->head[slot];
+
+	w->head[slot] = 0;
+	while (id) {
+	    pj_timer_id_t next = w->next[id];
+
+	    --w->level_cnt[level];
+	    wheel_link(ht, id);
+	    id = next;
+	}
+    }
+}
+
+/* Get the entry which expires first. */
+static pj_timer_entry *wheel_earliest(pj_timer_heap_t *ht)
+{
+    timer_wheel *w = ht->wheel;
+    unsigned level;
+
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+	unsigned start, i;
+
+	if (w->level_cnt[level] == 0)
+	    continue;
+
+	// Slots are ordered from the current position. The current slot of
+	// the upper levels only contains far future entries, so check it
+	// last.
+	start = (unsigned)((w->cur_tick >> (WHEEL_BITS * level)) & WHEEL_MASK);
+	for (i = (level ? 1 : 0); i <= WHEEL_SLOTS; ++i) {
+	    pj_timer_id_t id;
+	    pj_timer_entry *earliest = NULL;
+
+	    id = w->head[level * WHEEL_SLOTS + ((start + i) & WHEEL_MASK)];
+	    for (; id; id = w->next[id]) {
+		if (!earliest || PJ_TIME_VAL_LT(ht->heap[id]->_timer_value,
+						 earliest->_timer_value))
+		{
+		    earliest = ht->heap[id];
+		}
+	    }
+	    if (earliest)
+		return earliest;
+	}
+    }
+
+    return NULL;
+}
+
+/* Get the entry which expires first. */
+static pj_timer_entry *get_earliest(pj_timer_heap_t *ht)
+{
+    if (ht->cur_size == 0)
+	return NULL;
+    return ht->wheel ? wheel_earliest(ht) : ht->heap[0];
+}
+
 static void insert_node(pj_timer_heap_t *ht, pj_timer_entry *new_node)
 {
     if (ht->cur_size + 2 >= ht->max_size)
@@ -309,15 +523,37 @@ static pj_status_t schedule_entry( pj_timer_heap_t *ht,
     {
 	// Obtain the next unique sequence number.
 	// Set the entry
+	if (ht->wheel && ht->cur_size + 2 >= ht->max_size)
+	    grow_heap(ht);
 	entry->_timer_id = pop_freelist(ht);
 	entry->_timer_value = *future_time;
-	insert_node( ht, entry);
+	entry->_timer_heap = ht;
+	if (ht->wheel) {
+	    ht->heap[entry->_timer_id] = entry;
+	    wheel_link(ht, entry->_timer_id);
+	    ht->cur_size++;
+	} else {
+	    insert_node( ht, entry);
+	}
 	return 0;
     }
     else
 	return -1;
 }
 
+/* Remove the entry with the specified id from the timing wheel. */
+static pj_timer_entry *wheel_remove(pj_timer_heap_t *ht, pj_timer_id_t id)
+{
+    pj_timer_entry *removed_node = ht->heap[id];
+
+    wheel_unlink(ht, id);
+    push_freelist(ht, id);
+    ht->cur_size--;
+    removed_node->_timer_id = -1;
+
+    return removed_node;
+}
+
 
 static int cancel( pj_timer_heap_t *ht, 
 		   pj_timer_entry *entry, 
@@ -340,6 +576,10 @@ static int cancel( pj_timer_heap_t *ht,
     return 0;
   }
 
+  // With the timing wheel, the heap is indexed by timer id.
+  if (ht->wheel)
+    timer_node_slot = entry->_timer_id;
+
   if (entry != ht->heap[timer_node_slot])
     {
       if ((flags & F_DONT_ASSERT) == 0)
@@ -349,7 +589,10 @@ static int cancel( pj_timer_heap_t *ht,
     }
   else
     {
-      remove_node( ht, timer_node_slot);
+      if (ht->wheel)
+	wheel_remove( ht, entry->_timer_id);
+      else
+	remove_node( ht, timer_node_slot);
 
       if ((flags & F_DONT_CALL) == 0)
         // Call the close hook.
@@ -378,11 +621,27 @@ PJ_DEF(pj_size_t) pj_timer_heap_mem_size(pj_size_t count)
 PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
 					  pj_size_t size,
                                           pj_timer_heap_t **p_heap)
+{
+    return pj_timer_heap_create2(pool, size,
+				 PJ_TIMER_HEAP_USE_WHEEL ? PJ_TIMER_HEAP_WHEEL :
+							   PJ_TIMER_HEAP_BINARY,
+				 p_heap);
+}
+
+/*
+ * Create a new timer heap with the specified implementation.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					   pj_size_t size,
+					   pj_timer_heap_type type,
+					   pj_timer_heap_t **p_heap)
 {
     pj_timer_heap_t *ht;
     pj_size_t i;
 
     PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
+    PJ_ASSERT_RETURN(type == PJ_TIMER_HEAP_BINARY ||
+		     type == PJ_TIMER_HEAP_WHEEL, PJ_EINVAL);
 
     *p_heap = NULL;
 
@@ -423,12 +682,150 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     for (i=0; i<size; ++i)
 	ht->timer_ids[i] = -((pj_timer_id_t) (i + 1));
 
+    ht->shards = NULL;
+    ht->shard_cnt = 1;
+    ht->parent = NULL;
+
+    // Create the timing wheel.
+    ht->wheel = NULL;
+    if (type == PJ_TIMER_HEAP_WHEEL) {
+	pj_time_val now;
+
+	ht->wheel = PJ_POOL_ZALLOC_T(pool, timer_wheel);
+	ht->wheel->next = (pj_timer_id_t*)
+			  pj_pool_calloc(pool, size, sizeof(pj_timer_id_t));
+	ht->wheel->prev = (pj_timer_id_t*)
+			  pj_pool_calloc(pool, size, sizeof(pj_timer_id_t));
+	if (!ht->wheel->next || !ht->wheel->prev)
+	    return PJ_ENOMEM;
+
+	pj_gettickcount(&now);
+	ht->wheel->cur_tick = time_to_tick(&now);
+    }
+
+    *p_heap = ht;
+    return PJ_SUCCESS;
+}
+
+/*
+ * Create a sharded timer heap.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create_sharded( pj_pool_t *pool,
+						  pj_size_t size,
+						  unsigned shard_cnt,
+						  pj_timer_heap_t **p_heap)
+{
+    pj_timer_heap_t *ht;
+    unsigned i;
+    pj_status_t status;
+
+    if (shard_cnt <= 1)
+	return pj_timer_heap_create(pool, size, p_heap);
+
+    PJ_ASSERT_RETURN(pool && p_heap, PJ_EINVAL);
+
+    *p_heap = NULL;
+
+    // The sharded timer heap itself never holds any entry.
+    status = pj_timer_heap_create2(pool, 0, PJ_TIMER_HEAP_BINARY, &ht);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    ht->shards = (pj_timer_heap_t**)
+		 pj_pool_calloc(pool, shard_cnt, sizeof(pj_timer_heap_t*));
+    if (!ht->shards)
+	return PJ_ENOMEM;
+
+    status = pj_thread_local_alloc(&ht->thread_shard_id);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    ht->shard_cnt = shard_cnt;
+    size = (size + shard_cnt - 1) / shard_cnt;
+
+    for (i=0; i<shard_cnt; ++i) {
+	pj_timer_heap_t *shard;
+	pj_lock_t *lock;
+
+	status = pj_timer_heap_create(pool, size, &shard);
+	if (status == PJ_SUCCESS)
+	    status = pj_lock_create_recursive_mutex(pool, "tmrshard%p", &lock);
+	if (status != PJ_SUCCESS) {
+	    pj_timer_heap_destroy(ht);
+	    return status;
+	}
+
+	pj_timer_heap_set_lock(shard, lock, PJ_TRUE);
+	shard->parent = ht;
+	ht->shards[i] = shard;
+    }
+
     *p_heap = ht;
     return PJ_SUCCESS;
 }
 
+PJ_DEF(unsigned) pj_timer_heap_get_shard_count(pj_timer_heap_t *ht)
+{
+    PJ_ASSERT_RETURN(ht, 1);
+    return ht->shard_cnt;
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_set_thread_shard(pj_timer_heap_t *ht,
+						   int shard_hint)
+{
+    void *value;
+
+    PJ_ASSERT_RETURN(ht, PJ_EINVAL);
+
+    if (ht->shard_cnt == 1)
+	return PJ_SUCCESS;
+
+    if (shard_hint < 0)
+	value = NULL;
+    else
+	value = (void*)(pj_ssize_t)(shard_hint % ht->shard_cnt + 1);
+
+    return pj_thread_local_set(ht->thread_shard_id, value);
+}
+
+/* Get the shard where the calling thread schedules the entry. */
+static pj_timer_heap_t *get_schedule_shard(pj_timer_heap_t *ht,
+					   const pj_timer_entry *entry)
+{
+    void *thread_shard = pj_thread_local_get(ht->thread_shard_id);
+
+    if (thread_shard)
+	return ht->shards[(pj_ssize_t)thread_shard - 1];
+
+    // Spread the entries of unbound threads among the shards.
+    return ht->shards[((pj_size_t)entry >> 4) % ht->shard_cnt];
+}
+
+/* Get the shard where the entry is currently scheduled. */
+static pj_timer_heap_t *get_entry_shard(pj_timer_heap_t *ht,
+					const pj_timer_entry *entry)
+{
+    pj_timer_heap_t *shard = entry->_timer_heap;
+
+    if (entry->_timer_id >= 1 && shard && shard->parent == ht)
+	return shard;
+
+    return ht->shards[0];
+}
+
 PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
 {
+    if (ht->shards) {
+	unsigned i;
+
+	for (i=0; i<ht->shard_cnt; ++i) {
+	    if (ht->shards[i])
+		pj_timer_heap_destroy(ht->shards[i]);
+	}
+	pj_thread_local_free(ht->thread_shard_id);
+	ht->shards = NULL;
+    }
+
     if (ht->lock && ht->auto_delete_lock) {
         pj_lock_destroy(ht->lock);
         ht->lock = NULL;
@@ -450,8 +847,10 @@ PJ_DEF(void) pj_timer_heap_set_lock(  pj_timer_heap_t *ht,
 PJ_DEF(unsigned) pj_timer_heap_set_max_timed_out_per_poll(pj_timer_heap_t *ht,
                                                           unsigned count )
 {
-    unsigned old_count = ht->max_entries_per_poll;
+    unsigned i, old_count = ht->max_entries_per_poll;
     ht->max_entries_per_poll = count;
+    for (i=0; ht->shards && i<ht->shard_cnt; ++i)
+	ht->shards[i]->max_entries_per_poll = count;
     return old_count;
 }
 
@@ -467,6 +866,7 @@ PJ_DEF(pj_timer_entry*) pj_timer_entry_init( pj_timer_entry *entry,
     entry->user_data = user_data;
     entry->cb = cb;
     entry->_grp_lock = NULL;
+    entry->_timer_heap = NULL;
 
     return entry;
 }
@@ -509,6 +909,9 @@ static pj_status_t schedule_w_grp_lock(pj_timer_heap_t *ht,
 #endif
     pj_gettickcount(&expires);
     PJ_TIME_VAL_ADD(expires, *delay);
+
+    if (ht->shards)
+	ht = get_schedule_shard(ht, entry);
     
     lock_timer_heap(ht);
     status = schedule_entry(ht, entry, &expires);
@@ -577,7 +980,22 @@ static int cancel_timer(pj_timer_heap_t *ht,
 
     PJ_ASSERT_RETURN(ht && entry, PJ_EINVAL);
 
-    lock_timer_heap(ht);
+    if (ht->shards) {
+	pj_timer_heap_t *shard;
+
+	// Lock the shard owning the entry, retrying if the entry has been
+	// moved to another shard before the lock is acquired.
+	for (;;) {
+	    shard = get_entry_shard(ht, entry);
+	    lock_timer_heap(shard);
+	    if (shard == get_entry_shard(ht, entry))
+		break;
+	    unlock_timer_heap(shard);
+	}
+	ht = shard;
+    } else {
+	lock_timer_heap(ht);
+    }
     count = cancel(ht, entry, flags | F_DONT_CALL);
     if (flags & F_SET_ID) {
 	entry->id = id_val;
@@ -605,14 +1023,104 @@ PJ_DEF(int) pj_timer_heap_cancel_if_active(pj_timer_heap_t *ht,
     return cancel_timer(ht, entry, F_SET_ID | F_DONT_ASSERT, id_val);
 }
 
+/* Remove the next expired entry from the timing wheel, advancing the
+ * wheel up to the current time. Returns NULL if nothing has expired.
+ */
+static pj_timer_entry *wheel_pop_expired(pj_timer_heap_t *ht,
+					 const pj_time_val *now)
+{
+    timer_wheel *w = ht->wheel;
+    pj_uint64_t now_tick;
+
+    now_tick = ((pj_uint64_t)now->sec * 1000 + now->msec) /
+	       PJ_TIMER_WHEEL_RESOLUTION;
+
+    // Nothing to cascade, just jump to the current time.
+    if (ht->cur_size == 0) {
+	if (w->cur_tick < now_tick)
+	    w->cur_tick = now_tick;
+	return NULL;
+    }
+
+    for (;;) {
+	pj_timer_id_t id = w->head[w->cur_tick & WHEEL_MASK];
+
+	if (id) {
+	    if (w->cur_tick > now_tick)
+		return NULL;
+	    return wheel_remove(ht, id);
+	}
+
+	if (w->cur_tick >= now_tick)
+	    return NULL;
+
+	// Skip the empty slots of the lowest level up to the next cascade.
+	if (w->level_cnt[0] == 0) {
+	    pj_uint64_t last = w->cur_tick | WHEEL_MASK;
+	    if (last >= now_tick) {
+		w->cur_tick = now_tick;
+		return NULL;
+	    }
+	    w->cur_tick = last;
+	}
+	wheel_advance(ht);
+    }
+}
+
+/* Remove the next expired entry. */
+static pj_timer_entry *pop_expired(pj_timer_heap_t *ht,
+				   const pj_time_val *now)
+{
+    if (ht->wheel)
+	return wheel_pop_expired(ht, now);
+
+    if (ht->cur_size && PJ_TIME_VAL_LTE(ht->heap[0]->_timer_value, *now))
+	return remove_node(ht, 0);
+
+    return NULL;
+}
+
+/* Poll the shards of a sharded timer heap. */
+static unsigned poll_shards( pj_timer_heap_t *ht, pj_time_val *next_delay )
+{
+    void *thread_shard;
+    unsigned i, count;
+
+    /* Only poll the thread's own shard if it's bound to one */
+    thread_shard = pj_thread_local_get(ht->thread_shard_id);
+    if (thread_shard) {
+	unsigned shard = (unsigned)(pj_ssize_t)thread_shard - 1;
+	return pj_timer_heap_poll(ht->shards[shard], next_delay);
+    }
+
+    /* Otherwise poll all shards */
+    if (next_delay)
+	next_delay->sec = next_delay->msec = PJ_MAXINT32;
+
+    count = 0;
+    for (i=0; i<ht->shard_cnt; ++i) {
+	pj_time_val delay;
+
+	count += pj_timer_heap_poll(ht->shards[i], next_delay ? &delay : NULL);
+	if (next_delay && PJ_TIME_VAL_LT(delay, *next_delay))
+	    *next_delay = delay;
+    }
+
+    return count;
+}
+
 PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht, 
                                      pj_time_val *next_delay )
 {
     pj_time_val now;
+    pj_timer_entry *earliest;
     unsigned count;
 
     PJ_ASSERT_RETURN(ht, 0);
 
+    if (ht->shards)
+	return poll_shards(ht, next_delay);
+
     lock_timer_heap(ht);
     if (!ht->cur_size && next_delay) {
 	next_delay->sec = next_delay->msec = PJ_MAXINT32;
@@ -623,13 +1131,14 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
     count = 0;
     pj_gettickcount(&now);
 
-    while ( ht->cur_size && 
-	    PJ_TIME_VAL_LTE(ht->heap[0]->_timer_value, now) &&
-            count < ht->max_entries_per_poll ) 
+    while ( count < ht->max_entries_per_poll ) 
     {
-	pj_timer_entry *node = remove_node(ht, 0);
+	pj_timer_entry *node = pop_expired(ht, &now);
 	pj_grp_lock_t *grp_lock;
 
+	if (!node)
+	    break;
+
 	++count;
 
 	grp_lock = node->_grp_lock;
@@ -640,15 +1149,23 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 	PJ_RACE_ME(5);
 
 	if (node->cb)
-	    (*node->cb)(ht, node);
+	    (*node->cb)(ht->parent ? ht->parent : ht, node);
 
 	if (grp_lock)
 	    pj_grp_lock_dec_ref(grp_lock);
 
 	lock_timer_heap(ht);
     }
-    if (ht->cur_size && next_delay) {
-	*next_delay = ht->heap[0]->_timer_value;
+    earliest = next_delay ? get_earliest(ht) : NULL;
+    if (earliest) {
+	*next_delay = earliest->_timer_value;
+	if (ht->wheel) {
+	    // The entry expires at its tick boundary.
+	    pj_uint64_t msec = time_to_tick(next_delay) *
+			       PJ_TIMER_WHEEL_RESOLUTION;
+	    next_delay->sec = (long)(msec / 1000);
+	    next_delay->msec = (long)(msec % 1000);
+	}
 	PJ_TIME_VAL_SUB(*next_delay, now);
 	if (next_delay->sec < 0 || next_delay->msec < 0)
 	    next_delay->sec = next_delay->msec = 0;
@@ -662,28 +1179,71 @@ PJ_DEF(unsigned) pj_timer_heap_poll( pj_timer_heap_t *ht,
 
 PJ_DEF(pj_size_t) pj_timer_heap_count( pj_timer_heap_t *ht )
 {
+    pj_size_t count;
+    unsigned i;
+
     PJ_ASSERT_RETURN(ht, 0);
 
-    return ht->cur_size;
+    count = ht->cur_size;
+    for (i=0; ht->shards && i<ht->shard_cnt; ++i)
+	count += ht->shards[i]->cur_size;
+
+    return count;
 }
 
 PJ_DEF(pj_status_t) pj_timer_heap_earliest_time( pj_timer_heap_t * ht,
 					         pj_time_val *timeval)
 {
-    pj_assert(ht->cur_size != 0);
+    pj_timer_entry *earliest;
+
+    if (ht->shards) {
+	pj_status_t status = PJ_ENOTFOUND;
+	unsigned i;
+
+	for (i=0; i<ht->shard_cnt; ++i) {
+	    pj_timer_heap_t *shard = ht->shards[i];
+	    pj_time_val t;
+
+	    if (shard->cur_size == 0 ||
+		pj_timer_heap_earliest_time(shard, &t) != PJ_SUCCESS)
+	    {
+		continue;
+	    }
+	    if (status != PJ_SUCCESS || PJ_TIME_VAL_LT(t, *timeval))
+		*timeval = t;
+	    status = PJ_SUCCESS;
+	}
+	return status;
+    }
+
     if (ht->cur_size == 0)
         return PJ_ENOTFOUND;
 
+    /* Check again under the lock, since the heap may have been drained
+     * by another thread in the mean time.
+     */
     lock_timer_heap(ht);
-    *timeval = ht->heap[0]->_timer_value;
+    earliest = get_earliest(ht);
+    if (earliest)
+	*timeval = earliest->_timer_value;
     unlock_timer_heap(ht);
 
-    return PJ_SUCCESS;
+    return earliest ? PJ_SUCCESS : PJ_ENOTFOUND;
 }
 
 #if PJ_TIMER_DEBUG
 PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 {
+    if (ht->shards) {
+	unsigned i;
+
+	for (i=0; i<ht->shard_cnt; ++i) {
+	    PJ_LOG(3,(THIS_FILE, "Timer heap shard %d:", i));
+	    pj_timer_heap_dump(ht->shards[i]);
+	}
+	return;
+    }
+
     lock_timer_heap(ht);
 
     PJ_LOG(3,(THIS_FILE, "Dumping timer heap:"));
@@ -700,10 +1260,14 @@ PJ_DEF(void) pj_timer_heap_dump(pj_timer_heap_t *ht)
 
 	pj_gettickcount(&now);
 
-	for (i=0; i<(unsigned)ht->cur_size; ++i) {
+	for (i=0; i<(unsigned)(ht->wheel ? ht->max_size : ht->cur_size); ++i) {
 	    pj_timer_entry *e = ht->heap[i];
 	    pj_time_val delta;
 
+	    /* With the timing wheel, skip the unused timer ids */
+	    if (ht->wheel && (i == 0 || ht->timer_ids[i] < 0))
+		continue;
+
 	    if (PJ_TIME_VAL_LTE(e->_timer_value, now))
 		delta.sec = delta.msec = 0;
 	    else {
@@ -311,6 +311,46 @@ PJ_DEF(pj_status_t) pj_timer_heap_create( pj_pool_t *pool,
     return PJ_SUCCESS;
 }
 
+/*
+ * Create a new timer heap with the specified implementation.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create2( pj_pool_t *pool,
+					   pj_size_t size,
+					   pj_timer_heap_type type,
+					   pj_timer_heap_t **p_heap)
+{
+    /* Timers are always implemented with active objects */
+    PJ_UNUSED_ARG(type);
+    return pj_timer_heap_create(pool, size, p_heap);
+}
+
+/*
+ * Create a sharded timer heap.
+ */
+PJ_DEF(pj_status_t) pj_timer_heap_create_sharded( pj_pool_t *pool,
+						  pj_size_t size,
+						  unsigned shard_cnt,
+						  pj_timer_heap_t **p_heap)
+{
+    /* Not applicable, timers don't need polling */
+    PJ_UNUSED_ARG(shard_cnt);
+    return pj_timer_heap_create(pool, size, p_heap);
+}
+
+PJ_DEF(unsigned) pj_timer_heap_get_shard_count(pj_timer_heap_t *ht)
+{
+    PJ_UNUSED_ARG(ht);
+    return 1;
+}
+
+PJ_DEF(pj_status_t) pj_timer_heap_set_thread_shard(pj_timer_heap_t *ht,
+						   int shard_hint)
+{
+    PJ_UNUSED_ARG(ht);
+    PJ_UNUSED_ARG(shard_hint);
+    return PJ_SUCCESS;
+}
+
 PJ_DEF(void) pj_timer_heap_destroy( pj_timer_heap_t *ht )
 {
     /* Cancel and delete pending active objects */
@@ -21,6 +21,9 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/pool.h>
+#include <pj/os.h>
+#include <pj/string.h>
+#include <pj/ctype.h>
 #include "test.h"
 
 #if INCLUDE_HASH_TEST
@@ -130,6 +133,174 @@ static int hash_collision_test(pj_pool_t *pool)
 }
 
 
+static int hash_growable_test(pj_pool_t *pool)
+{
+    enum {
+	COUNT = HASH_COUNT * 256
+    };
+    pj_hash_table_t *ht;
+    pj_hash_iterator_t it_buf, *it;
+    unsigned *values;
+    unsigned i;
+
+    ht = pj_hash_create2(pool, HASH_COUNT, PJ_HASH_GROWABLE);
+    if (!ht)
+	return -300;
+
+    values = (unsigned*) pj_pool_alloc(pool, COUNT * sizeof(unsigned));
+
+    /* Insert while the table is resized several times, checking that
+     * both migrated and not yet migrated entries can be found.
+     */
+    for (i=0; i<COUNT; ++i) {
+	values[i] = i;
+	pj_hash_set(pool, ht, &values[i], sizeof(unsigned), 0, &values[i]);
+
+	if (pj_hash_get(ht, &values[i/2], sizeof(unsigned), NULL) !=
+	    &values[i/2])
+	{
+	    return -310;
+	}
+    }
+
+    if (pj_hash_count(ht) != COUNT)
+	return -320;
+
+    for (i=0; i<COUNT; ++i) {
+	if (pj_hash_get(ht, &i, sizeof(i), NULL) != &values[i])
+	    return -330;
+    }
+
+    /* Remove the odd entries while iterating */
+    i = 0;
+    it = pj_hash_first(ht, &it_buf);
+    while (it) {
+	unsigned *entry = (unsigned*) pj_hash_this(ht, it);
+
+	++i;
+	it = pj_hash_next(ht, it);
+	if (*entry & 1)
+	    pj_hash_set(NULL, ht, entry, sizeof(unsigned), 0, NULL);
+    }
+
+    if (i != COUNT || pj_hash_count(ht) != COUNT / 2)
+	return -340;
+
+    for (i=0; i<COUNT; ++i) {
+	void *entry = pj_hash_get(ht, &i, sizeof(i), NULL);
+	if ((i & 1) ? entry != NULL : entry != &values[i])
+	    return -350;
+    }
+
+    return 0;
+}
+
+
+/* Verify that the case-insensitive seeded hash matches the case-sensitive
+ * one on lowercased keys, for every key length around the word boundaries.
+ */
+static int hash_seeded_test(pj_pool_t *pool)
+{
+    const char *mixed = "Z9hG4bK-524287-1---77ba17085D60f141@10.0.0.1";
+    char lower[64], result[64];
+    pj_hash_table_t *ht;
+    pj_uint32_t hval;
+    unsigned len, i;
+    pj_str_t key;
+
+    for (len=0; len<=pj_ansi_strlen(mixed); ++len) {
+	pj_uint32_t h1, h2;
+
+	for (i=0; i<len; ++i)
+	    lower[i] = (char)pj_tolower(mixed[i]);
+
+	key.ptr = (char*)mixed;
+	key.slen = len;
+	pj_bzero(result, sizeof(result));
+	h1 = pj_hash_calc_seeded_tolower(result, &key);
+	h2 = pj_hash_calc_seeded(lower, len);
+
+	if (h1 != h2)
+	    return -400;
+	if (pj_memcmp(result, lower, len) != 0 || result[len] != '\0')
+	    return -410;
+	if (pj_hash_calc_seeded(mixed, len) !=
+	    pj_hash_calc_seeded(mixed, len))
+	{
+	    return -420;
+	}
+    }
+
+    /* Non-letters around 'A', 'Z', 'a', 'z' must not be changed */
+    key = pj_str("@AZ[`az{");
+    pj_hash_calc_seeded_tolower(result, &key);
+    if (pj_memcmp(result, "@az[`az{", 8) != 0)
+	return -430;
+
+    lower[0] = '\0';
+    if (pj_hash_calc_seeded(lower, PJ_HASH_KEY_STRING) !=
+	pj_hash_calc_seeded(lower, 0))
+    {
+	return -440;
+    }
+
+    /* Precomputed seeded values must be usable with the hash table */
+    ht = pj_hash_create(pool, HASH_COUNT);
+    key = pj_str((char*)mixed);
+    pj_hash_set_lower(pool, ht, mixed, (unsigned)key.slen, 0, ht);
+    if (pj_hash_get_lower(ht, mixed, (unsigned)key.slen, NULL) != ht)
+	return -450;
+
+    hval = pj_hash_calc_seeded_tolower(lower, &key);
+    if (pj_hash_get_lower(ht, lower, (unsigned)key.slen, &hval) != ht)
+	return -460;
+
+    return 0;
+}
+
+
+/* Compare the speed of the legacy and seeded hash functions on keys
+ * typical of SIP transaction and dialog lookups.
+ */
+static int hash_perf_test(void)
+{
+    enum { LOOP = 200000 };
+    static const char *keys[] = {
+	"tag=1928301774",
+	"z9hG4bK-524287-1---77ba17085d60f141",
+	"c$INVITE$z9hG4bKPj.ZZDfNxHzBNZ9Wc1nvvXEhGHZ0WV8VFBe$10.0.0.1:5060",
+    };
+    unsigned i, k;
+
+    for (k=0; k<PJ_ARRAY_SIZE(keys); ++k) {
+	pj_str_t key = pj_str((char*)keys[k]);
+	pj_timestamp t0, t1, t2, t3;
+	pj_uint32_t sum = 0;
+
+	pj_get_timestamp(&t0);
+	for (i=0; i<LOOP; ++i)
+	    sum += pj_hash_calc_tolower(0, NULL, &key);
+	pj_get_timestamp(&t1);
+	for (i=0; i<LOOP; ++i)
+	    sum += pj_hash_calc_seeded_tolower(NULL, &key);
+	pj_get_timestamp(&t2);
+	for (i=0; i<LOOP; ++i)
+	    sum += pj_hash_calc_seeded(key.ptr, (unsigned)key.slen);
+	pj_get_timestamp(&t3);
+
+	PJ_LOG(3,("hash_test", "...keylen %2d: legacy tolower=%u ns, "
+		  "seeded tolower=%u ns, seeded=%u ns (sum %x)",
+		  (int)key.slen,
+		  pj_elapsed_nanosec(&t0, &t1) / LOOP,
+		  pj_elapsed_nanosec(&t1, &t2) / LOOP,
+		  pj_elapsed_nanosec(&t2, &t3) / LOOP,
+		  sum));
+    }
+
+    return 0;
+}
+
+
 /*
  * Hash table test.
  */
@@ -155,6 +326,26 @@ int hash_test(void)
 	return rc;
     }
 
+    /* Growable table test */
+    rc = hash_growable_test(pool);
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
+    /* Seeded hash function test */
+    rc = hash_seeded_test(pool);
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
+    rc = hash_perf_test();
+    if (rc != 0) {
+	pj_pool_release(pool);
+	return rc;
+    }
+
     pj_pool_release(pool);
     return 0;
 }
@@ -544,6 +544,382 @@ static int ioqueue_perf_test_imp(pj_bool_t allow_concur)
     return 0;
 }
 
+/* Descriptor for the batched receive benchmark. */
+typedef struct batch_item
+{
+    pj_sock_t            server_fd,
+                         client_fd;
+    pj_ioqueue_key_t    *server_key;
+    pj_ioqueue_op_key_t  recv_op[PJ_IOQUEUE_MAX_RECV_BATCH];
+    char                 buffer[PJ_IOQUEUE_MAX_RECV_BATCH][512];
+    pj_sockaddr_in       src_addr[PJ_IOQUEUE_MAX_RECV_BATCH];
+    int                  src_addr_len[PJ_IOQUEUE_MAX_RECV_BATCH];
+    unsigned             pkt_recv;
+} batch_item;
+
+/* Callback when datagram has been read in the batched receive test.
+ * Count the packet and resubmit the read operation.
+ */
+static void on_batch_read_complete(pj_ioqueue_key_t *key, 
+                                   pj_ioqueue_op_key_t *op_key,
+                                   pj_ssize_t bytes_read)
+{
+    batch_item *item = (batch_item*)pj_ioqueue_get_user_data(key);
+    unsigned idx = (unsigned)(op_key - item->recv_op);
+    pj_ssize_t size;
+    pj_status_t rc;
+
+    if (thread_quit_flag)
+        return;
+
+    if (bytes_read > 0)
+        ++item->pkt_recv;
+
+    size = sizeof(item->buffer[idx]);
+    item->src_addr_len[idx] = sizeof(item->src_addr[idx]);
+    rc = pj_ioqueue_recvfrom(key, op_key, item->buffer[idx], &size,
+                             PJ_IOQUEUE_ALWAYS_ASYNC, &item->src_addr[idx],
+                             &item->src_addr_len[idx]);
+    if (rc != PJ_EPENDING && rc != last_error) {
+        last_error = rc;
+        app_perror("...error: recvfrom error", rc);
+    }
+}
+
+/* Measure the number of datagrams per second that can be received by
+ * a UDP key with several pending recvfrom() operations, with the 
+ * specified batched receive setting. The socket is repeatedly filled 
+ * with a burst of datagrams which are then drained by polling the 
+ * ioqueue, all in the same thread, so the sending cost is the same for
+ * all settings. Returns positive value if batched receive is not
+ * supported.
+ */
+static int perform_batch_test(unsigned batch_cnt, unsigned *p_pps)
+{
+    enum { MSEC_DURATION = 2000, PKT_SIZE = 160, BURST = 64 };
+    pj_pool_t *pool;
+    batch_item *item;
+    pj_ioqueue_t *ioqueue;
+    pj_ioqueue_callback cb;
+    char pkt[PKT_SIZE];
+    pj_timestamp start, stop;
+    pj_uint32_t elapsed_usec;
+    pj_highprec_t pps;
+    pj_status_t rc;
+    unsigned i;
+
+    thread_quit_flag = 0;
+
+    pool = pj_pool_create(mem, NULL, 4096, 4096, NULL);
+    if (!pool)
+        return -200;
+
+    item = PJ_POOL_ZALLOC_T(pool, batch_item);
+
+    rc = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: unable to create ioqueue", rc);
+        return -210;
+    }
+
+    rc = app_socketpair(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+                        &item->server_fd, &item->client_fd);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: unable to create socket pair", rc);
+        return -220;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &on_batch_read_complete;
+    rc = pj_ioqueue_register_sock(pool, ioqueue, item->server_fd, item,
+                                  &cb, &item->server_key);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: registering server socket to ioqueue", rc);
+        return -230;
+    }
+
+    if (batch_cnt > 0) {
+        rc = pj_ioqueue_set_recv_batch(item->server_key, batch_cnt);
+        if (rc == PJ_ENOTSUP) {
+            PJ_LOG(3,(THIS_FILE, "   (batched receive is not supported)"));
+            pj_ioqueue_unregister(item->server_key);
+            pj_sock_close(item->client_fd);
+            pj_ioqueue_destroy(ioqueue);
+            pj_pool_release(pool);
+            *p_pps = 0;
+            return 1;
+        } else if (rc != PJ_SUCCESS) {
+            app_perror("...error: pj_ioqueue_set_recv_batch()", rc);
+            return -240;
+        }
+    }
+
+    /* Submit one pending read operation for each batch slot */
+    for (i=0; i<PJ_IOQUEUE_MAX_RECV_BATCH; ++i) {
+        pj_ssize_t size = sizeof(item->buffer[i]);
+
+        pj_ioqueue_op_key_init(&item->recv_op[i], sizeof(item->recv_op[i]));
+        item->src_addr_len[i] = sizeof(item->src_addr[i]);
+        rc = pj_ioqueue_recvfrom(item->server_key, &item->recv_op[i],
+                                 item->buffer[i], &size,
+                                 PJ_IOQUEUE_ALWAYS_ASYNC,
+                                 &item->src_addr[i], &item->src_addr_len[i]);
+        if (rc != PJ_EPENDING) {
+            app_perror("...error: pj_ioqueue_recvfrom", rc);
+            return -250;
+        }
+    }
+
+    pj_create_random_string(pkt, sizeof(pkt));
+
+    pj_get_timestamp(&start);
+    do {
+        unsigned target = item->pkt_recv + BURST;
+
+        for (i=0; i<BURST; ++i) {
+            pj_ssize_t sent = sizeof(pkt);
+            pj_sock_send(item->client_fd, pkt, &sent, 0);
+        }
+
+        while (item->pkt_recv < target) {
+            const pj_time_val timeout = {0, 10};
+
+            if (pj_ioqueue_poll(ioqueue, &timeout) <= 0)
+                break;
+        }
+        pj_get_timestamp(&stop);
+
+    } while (pj_elapsed_msec(&start, &stop) < MSEC_DURATION);
+
+    thread_quit_flag = 1;
+
+    pj_ioqueue_unregister(item->server_key);
+    pj_sock_close(item->client_fd);
+    pj_ioqueue_destroy(ioqueue);
+
+    /* pps = pkt_recv*1000000/elapsed_usec */
+    elapsed_usec = pj_elapsed_usec(&start, &stop);
+    pps = item->pkt_recv;
+    pj_highprec_mul(pps, 1000000);
+    pj_highprec_div(pps, elapsed_usec);
+    *p_pps = (unsigned)pps;
+
+    PJ_LOG(3,(THIS_FILE, "   %5d      %8d pkt/s", batch_cnt, *p_pps));
+
+    pj_pool_release(pool);
+    return 0;
+}
+
+/* Compare UDP receive rate with and without batched receive. */
+static int ioqueue_recv_batch_perf_test(void)
+{
+    unsigned batch[] = { 0, 4, PJ_IOQUEUE_MAX_RECV_BATCH };
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "   Benchmarking %s ioqueue batched receive:",
+              pj_ioqueue_name()));
+    PJ_LOG(3,(THIS_FILE, "   ======================================="));
+    PJ_LOG(3,(THIS_FILE, "   Batch            Rate"));
+    PJ_LOG(3,(THIS_FILE, "   ======================================="));
+
+    for (i=0; i<PJ_ARRAY_SIZE(batch); ++i) {
+        unsigned pps;
+
+        rc = perform_batch_test(batch[i], &pps);
+        if (rc > 0)
+            break;
+        else if (rc != 0)
+            return rc;
+
+        pj_thread_sleep(500);
+    }
+
+    return 0;
+}
+
+/* Descriptor for the batched send benchmark. */
+typedef struct send_batch_item
+{
+    pj_sock_t            server_fd,
+                         client_fd;
+    pj_ioqueue_key_t    *client_key;
+    pj_ioqueue_op_key_t  send_op[PJ_IOQUEUE_MAX_SEND_BATCH];
+    char                 buffer[PJ_IOQUEUE_MAX_SEND_BATCH][512];
+    unsigned             pkt_sent;
+    unsigned             pending;
+} send_batch_item;
+
+/* Callback when queued datagram has been sent in the batched send test. */
+static void on_batch_write_complete(pj_ioqueue_key_t *key, 
+                                    pj_ioqueue_op_key_t *op_key,
+                                    pj_ssize_t bytes_sent)
+{
+    send_batch_item *item;
+
+    PJ_UNUSED_ARG(op_key);
+
+    item = (send_batch_item*)pj_ioqueue_get_user_data(key);
+    if (bytes_sent > 0)
+        ++item->pkt_sent;
+    else if (bytes_sent < 0 && (pj_status_t)-bytes_sent != last_error) {
+        last_error = (pj_status_t)-bytes_sent;
+        app_perror("...error: write completion error", last_error);
+    }
+    --item->pending;
+}
+
+/* Measure the number of datagrams per second that can be sent by a UDP
+ * key with the specified batched send setting. Bursts of datagrams are
+ * submitted with PJ_IOQUEUE_BATCH_SEND flag and the ioqueue is polled
+ * until all of them have been sent. Returns positive value if batched
+ * send is not supported.
+ */
+static int perform_send_batch_test(unsigned batch_cnt, unsigned *p_pps)
+{
+    enum { MSEC_DURATION = 2000, PKT_SIZE = 160 };
+    pj_pool_t *pool;
+    send_batch_item *item;
+    pj_ioqueue_t *ioqueue;
+    pj_ioqueue_callback cb;
+    pj_sockaddr_in dst_addr;
+    int addr_len;
+    pj_timestamp start, stop;
+    pj_uint32_t elapsed_usec;
+    pj_highprec_t pps;
+    pj_status_t rc;
+    unsigned i;
+
+    pool = pj_pool_create(mem, NULL, 4096, 4096, NULL);
+    if (!pool)
+        return -300;
+
+    item = PJ_POOL_ZALLOC_T(pool, send_batch_item);
+
+    rc = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: unable to create ioqueue", rc);
+        return -310;
+    }
+
+    rc = app_socketpair(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+                        &item->server_fd, &item->client_fd);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: unable to create socket pair", rc);
+        return -320;
+    }
+
+    addr_len = sizeof(dst_addr);
+    rc = pj_sock_getsockname(item->server_fd, &dst_addr, &addr_len);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: pj_sock_getsockname()", rc);
+        return -325;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_write_complete = &on_batch_write_complete;
+    rc = pj_ioqueue_register_sock(pool, ioqueue, item->client_fd, item,
+                                  &cb, &item->client_key);
+    if (rc != PJ_SUCCESS) {
+        app_perror("...error: registering client socket to ioqueue", rc);
+        return -330;
+    }
+
+    if (batch_cnt > 0) {
+        rc = pj_ioqueue_set_send_batch(item->client_key, batch_cnt);
+        if (rc == PJ_ENOTSUP) {
+            PJ_LOG(3,(THIS_FILE, "   (batched send is not supported)"));
+            pj_ioqueue_unregister(item->client_key);
+            pj_sock_close(item->server_fd);
+            pj_ioqueue_destroy(ioqueue);
+            pj_pool_release(pool);
+            *p_pps = 0;
+            return 1;
+        } else if (rc != PJ_SUCCESS) {
+            app_perror("...error: pj_ioqueue_set_send_batch()", rc);
+            return -340;
+        }
+    }
+
+    for (i=0; i<PJ_IOQUEUE_MAX_SEND_BATCH; ++i) {
+        pj_ioqueue_op_key_init(&item->send_op[i], sizeof(item->send_op[i]));
+        pj_create_random_string(item->buffer[i], PKT_SIZE);
+    }
+
+    pj_get_timestamp(&start);
+    do {
+        for (i=0; i<PJ_IOQUEUE_MAX_SEND_BATCH; ++i) {
+            pj_ssize_t sent = PKT_SIZE;
+
+            rc = pj_ioqueue_sendto(item->client_key, &item->send_op[i],
+                                   item->buffer[i], &sent,
+                                   PJ_IOQUEUE_BATCH_SEND,
+                                   &dst_addr, addr_len);
+            if (rc == PJ_SUCCESS) {
+                ++item->pkt_sent;
+            } else if (rc == PJ_EPENDING) {
+                ++item->pending;
+            } else if (rc != last_error) {
+                last_error = rc;
+                app_perror("...error: pj_ioqueue_sendto()", rc);
+            }
+        }
+
+        while (item->pending) {
+            const pj_time_val timeout = {0, 10};
+
+            if (pj_ioqueue_poll(ioqueue, &timeout) < 0)
+                break;
+        }
+        pj_get_timestamp(&stop);
+
+    } while (pj_elapsed_msec(&start, &stop) < MSEC_DURATION);
+
+    pj_ioqueue_unregister(item->client_key);
+    pj_sock_close(item->server_fd);
+    pj_ioqueue_destroy(ioqueue);
+
+    /* pps = pkt_sent*1000000/elapsed_usec */
+    elapsed_usec = pj_elapsed_usec(&start, &stop);
+    pps = item->pkt_sent;
+    pj_highprec_mul(pps, 1000000);
+    pj_highprec_div(pps, elapsed_usec);
+    *p_pps = (unsigned)pps;
+
+    PJ_LOG(3,(THIS_FILE, "   %5d      %8d pkt/s", batch_cnt, *p_pps));
+
+    pj_pool_release(pool);
+    return 0;
+}
+
+/* Compare UDP send rate with and without batched send. */
+static int ioqueue_send_batch_perf_test(void)
+{
+    unsigned batch[] = { 0, 4, PJ_IOQUEUE_MAX_SEND_BATCH };
+    unsigned i;
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "   Benchmarking %s ioqueue batched send:",
+              pj_ioqueue_name()));
+    PJ_LOG(3,(THIS_FILE, "   ======================================="));
+    PJ_LOG(3,(THIS_FILE, "   Batch            Rate"));
+    PJ_LOG(3,(THIS_FILE, "   ======================================="));
+
+    for (i=0; i<PJ_ARRAY_SIZE(batch); ++i) {
+        unsigned pps;
+
+        rc = perform_send_batch_test(batch[i], &pps);
+        if (rc > 0)
+            break;
+        else if (rc != 0)
+            return rc;
+
+        pj_thread_sleep(500);
+    }
+
+    return 0;
+}
+
 /*
  * main test entry.
  */
@@ -559,6 +935,14 @@ int ioqueue_perf_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = ioqueue_recv_batch_perf_test();
+    if (rc != 0)
+	return rc;
+
+    rc = ioqueue_send_batch_perf_test();
+    if (rc != 0)
+	return rc;
+
     return 0;
 }
 
@@ -615,6 +615,190 @@ static int many_handles_test(pj_bool_t allow_concur)
     return 0;
 }
 
+/*
+ * Sharded ioqueue test.
+ * Check that a thread bound to a shard only polls the handles of that
+ * shard, and that an unbound thread polls all shards.
+ */
+static unsigned shard_read_cnt[2];
+
+static void on_shard_read(pj_ioqueue_key_t *key, 
+                          pj_ioqueue_op_key_t *op_key,
+                          pj_ssize_t bytes_read)
+{
+    unsigned *cnt = (unsigned*)pj_ioqueue_get_user_data(key);
+
+    PJ_UNUSED_ARG(op_key);
+    if (bytes_read > 0)
+	++(*cnt);
+}
+
+/* Poll the ioqueue for a while, until the read counters reach the
+ * expected values.
+ */
+static int shard_poll(pj_ioqueue_t *ioqueue, unsigned cnt0, unsigned cnt1)
+{
+    pj_time_val timeout = { 0, 50 };
+    int i;
+
+    for (i=0; i<10; ++i) {
+	if (shard_read_cnt[0] == cnt0 && shard_read_cnt[1] == cnt1)
+	    break;
+	pj_ioqueue_poll(ioqueue, &timeout);
+    }
+
+    /* Poll once more to make sure nothing else is reported */
+    pj_ioqueue_poll(ioqueue, &timeout);
+
+    return (shard_read_cnt[0] == cnt0 && shard_read_cnt[1] == cnt1) ? 0 : -1;
+}
+
+/* Submit read on both keys and send a packet to both sockets */
+static int shard_send(pj_ioqueue_key_t *key[2],
+		      pj_ioqueue_op_key_t read_op[2],
+		      char recv_buf[2][64],
+		      pj_sock_t csock[2])
+{
+    int i;
+
+    for (i=0; i<2; ++i) {
+	pj_ssize_t bytes = 64;
+	pj_status_t status;
+
+	status = pj_ioqueue_recv(key[i], &read_op[i], recv_buf[i], &bytes,
+				 PJ_IOQUEUE_ALWAYS_ASYNC);
+	if (status != PJ_EPENDING) {
+	    app_perror("...error in pj_ioqueue_recv", status);
+	    return -1;
+	}
+
+	bytes = 4;
+	pj_sock_send(csock[i], "shrd", &bytes, 0);
+    }
+
+    return 0;
+}
+
+static int shard_test(void)
+{
+    pj_pool_t *pool;
+    pj_ioqueue_t *ioqueue;
+    pj_ioqueue_callback cb;
+    pj_sock_t ssock[2], csock[2];
+    pj_ioqueue_key_t *key[2];
+    pj_ioqueue_op_key_t read_op[2];
+    char recv_buf[2][64];
+    pj_status_t status;
+    int i, rc = 0;
+
+    PJ_LOG(3,(THIS_FILE,"...sharded ioqueue test"));
+
+    pool = pj_pool_create(mem, NULL, 4000, 4000, NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    status = pj_ioqueue_create_sharded(pool, 16, 2, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error in pj_ioqueue_create_sharded", status);
+	pj_pool_release(pool);
+	return -300;
+    }
+
+    if (pj_ioqueue_get_shard_count(ioqueue) < 2) {
+	PJ_LOG(3,(THIS_FILE,"....sharding is not supported by %s, skipped",
+		  pj_ioqueue_name()));
+	pj_ioqueue_destroy(ioqueue);
+	pj_pool_release(pool);
+	return 0;
+    }
+
+    pj_bzero(&cb, sizeof(cb));
+    cb.on_read_complete = &on_shard_read;
+    shard_read_cnt[0] = shard_read_cnt[1] = 0;
+
+    for (i=0; i<2; ++i) {
+	status = app_socketpair(pj_AF_INET(), pj_SOCK_DGRAM(), 0,
+				&ssock[i], &csock[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error: unable to create socket pair", status);
+	    return -310;
+	}
+
+	status = pj_ioqueue_register_sock(pool, ioqueue, ssock[i],
+					  &shard_read_cnt[i], &cb, &key[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error in pj_ioqueue_register_sock", status);
+	    return -320;
+	}
+
+	/* Put each key in its own shard */
+	status = pj_ioqueue_set_shard(key[i], i);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error in pj_ioqueue_set_shard", status);
+	    return -330;
+	}
+
+	pj_ioqueue_op_key_init(&read_op[i], sizeof(read_op[i]));
+    }
+
+    if (shard_send(key, read_op, recv_buf, csock) != 0) {
+	rc = -340; goto on_return;
+    }
+
+    /* Thread bound to shard 1 must only get the packet of the second key */
+    pj_ioqueue_set_thread_shard(ioqueue, 1);
+    if (shard_poll(ioqueue, 0, 1) != 0) {
+	PJ_LOG(3,(THIS_FILE,"....error: shard 1 polled wrong handle"));
+	rc = -350; goto on_return;
+    }
+
+    /* And then thread bound to shard 0 gets the first one */
+    pj_ioqueue_set_thread_shard(ioqueue, 0);
+    if (shard_poll(ioqueue, 1, 1) != 0) {
+	PJ_LOG(3,(THIS_FILE,"....error: shard 0 polled wrong handle"));
+	rc = -360; goto on_return;
+    }
+
+    /* Move the second key to shard 0, now both are polled by shard 0 */
+    status = pj_ioqueue_set_shard(key[1], 0);
+    if (status != PJ_SUCCESS) {
+	app_perror("...error in pj_ioqueue_set_shard", status);
+	rc = -370; goto on_return;
+    }
+    if (shard_send(key, read_op, recv_buf, csock) != 0) {
+	rc = -340; goto on_return;
+    }
+    if (shard_poll(ioqueue, 2, 2) != 0) {
+	PJ_LOG(3,(THIS_FILE,"....error: moved handle is not polled"));
+	rc = -380; goto on_return;
+    }
+
+    /* Unbound thread polls all shards */
+    pj_ioqueue_set_shard(key[1], 1);
+    pj_ioqueue_set_thread_shard(ioqueue, -1);
+    if (shard_send(key, read_op, recv_buf, csock) != 0) {
+	rc = -340; goto on_return;
+    }
+    if (shard_poll(ioqueue, 3, 3) != 0) {
+	PJ_LOG(3,(THIS_FILE,"....error: unbound thread doesn't poll all"));
+	rc = -390; goto on_return;
+    }
+
+on_return:
+    pj_ioqueue_set_thread_shard(ioqueue, -1);
+    for (i=0; i<2; ++i) {
+	pj_ioqueue_unregister(key[i]);
+	pj_sock_close(csock[i]);
+    }
+    pj_ioqueue_destroy(ioqueue);
+    pj_pool_release(pool);
+
+    if (rc == 0)
+	PJ_LOG(3,(THIS_FILE,"....shard_test() ok"));
+
+    return rc;
+}
+
 /*
  * Multi-operation test.
  */
@@ -895,6 +1079,10 @@ static int udp_ioqueue_test_imp(pj_bool_t allow_concur)
     if ((status=many_handles_test(allow_concur)) != 0) {
 	return status;
     }
+
+    if ((status=shard_test()) != 0) {
+	return status;
+    }
     
     //return 0;
 
@@ -22,6 +22,8 @@
 #include <pj/rand.h>
 #include <pj/log.h>
 #include <pj/except.h>
+#include <pj/errno.h>
+#include <pj/string.h>
 #include "test.h"
 
 /**
@@ -277,6 +279,145 @@ static int pool_buf_test(void)
     return 0;
 }
 
+/* Test the pool usage by tag in caching pool */
+static int tag_stat_test(void)
+{
+    enum { POOL_CNT = 4 };
+    pj_caching_pool cp;
+    pj_pool_t *pool[POOL_CNT];
+    pj_pool_tag_stat stat[PJ_CACHING_POOL_MAX_TAGS];
+    const pj_pool_tag_stat *st = NULL;
+    unsigned i, count = PJ_ARRAY_SIZE(stat);
+    pj_status_t status;
+    int rc = 0;
+
+    PJ_LOG(3,("test", "...tag_stat test"));
+
+    pj_caching_pool_init(&cp, NULL, 0);
+
+    for (i=0; i<POOL_CNT; ++i) {
+	pool[i] = pj_pool_create(&cp.factory, "tagtest%p", 512, 512, NULL);
+	if (!pool[i])
+	    return -500;
+    }
+
+    /* Make the first pool grow */
+    pj_pool_alloc(pool[0], 2048);
+
+    status = pj_caching_pool_get_tag_stat(&cp, stat, &count);
+    if (status == PJ_ENOTSUP) {
+	/* Tracking is disabled */
+	for (i=0; i<POOL_CNT; ++i)
+	    pj_pool_release(pool[i]);
+	pj_caching_pool_destroy(&cp);
+	return 0;
+    }
+    if (status != PJ_SUCCESS)
+	return -510;
+
+    for (i=0; i<count; ++i) {
+	if (pj_ansi_strcmp(stat[i].tag, "tagtest") == 0)
+	    st = &stat[i];
+    }
+    if (!st) {
+	rc = -520;
+    } else if (st->pool_cnt != POOL_CNT || st->create_cnt != POOL_CNT) {
+	rc = -530;
+    } else if (st->block_cnt != 1) {
+	rc = -540;
+    } else if (st->capacity < POOL_CNT * 512 + 2048) {
+	rc = -550;
+    }
+
+    for (i=0; i<POOL_CNT; ++i)
+	pj_pool_release(pool[i]);
+
+    if (rc == 0) {
+	count = PJ_ARRAY_SIZE(stat);
+	pj_caching_pool_get_tag_stat(&cp, stat, &count);
+	st = &stat[0];
+	if (count != 1 || pj_ansi_strcmp(st->tag, "tagtest") != 0) {
+	    rc = -560;
+	} else if (st->pool_cnt != 0 || st->capacity != 0) {
+	    /* All pools have been released */
+	    rc = -570;
+	} else if (st->peak_pool_cnt != POOL_CNT ||
+		   st->peak_capacity < POOL_CNT * 512 + 2048 ||
+		   st->max_pool_capacity < 512 + 2048)
+	{
+	    rc = -580;
+	}
+    }
+
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+
+/* Get the total capacity of the pools in the free lists of caching pool */
+static pj_size_t free_list_capacity(pj_caching_pool *cp)
+{
+    pj_size_t capacity = 0;
+    unsigned i;
+
+    for (i=0; i<PJ_CACHING_POOL_ARRAY_SIZE; ++i) {
+	pj_pool_t *p = (pj_pool_t*) cp->free_list[i].next;
+
+	for (; p != (void*)&cp->free_list[i]; p = p->next)
+	    capacity += pj_pool_get_capacity(p);
+    }
+    return capacity;
+}
+
+/* Test the accounting of the pools in the per-thread caches */
+static int thread_cache_test(void)
+{
+    enum { POOL_CNT = 8, MAX_CAPACITY = 4 * 1024 };
+    pj_caching_pool cp;
+    pj_pool_t *pool[POOL_CNT];
+    unsigned i;
+    int rc = 0;
+
+    PJ_LOG(3,("test", "...thread_cache test"));
+
+    pj_caching_pool_init(&cp, NULL, MAX_CAPACITY);
+
+    for (i=0; i<POOL_CNT; ++i) {
+	pool[i] = pj_pool_create(&cp.factory, "cachetest", 1000, 1000, NULL);
+	if (!pool[i])
+	    return -600;
+    }
+    if (cp.used_count != POOL_CNT)
+	rc = -610;
+
+    for (i=0; i<POOL_CNT; ++i)
+	pj_pool_release(pool[i]);
+
+    /* Cached pools must be limited by the maximum capacity */
+    if (rc == 0 && (cp.used_count != 0 || cp.capacity > MAX_CAPACITY ||
+		    cp.capacity == 0))
+    {
+	rc = -620;
+    }
+
+    /* Leave one pool unreleased, it must be released on destroy */
+    pool[0] = pj_pool_create(&cp.factory, "cachetest", 1000, 1000, NULL);
+    if (!pool[0])
+	return -630;
+
+    /* All cached pools must be in the free lists once the cache of this
+     * thread is released.
+     */
+    pj_pool_factory_release_thread(&cp.factory);
+    if (rc == 0 && cp.capacity != free_list_capacity(&cp))
+	rc = -640;
+
+    pj_caching_pool_destroy(&cp);
+    if (rc == 0 && cp.used_size != 0)
+	rc = -650;
+
+    return rc;
+}
+
 
 int pool_test(void)
 {
@@ -309,6 +450,14 @@ int pool_test(void)
     if (rc != 0)
 	return rc;
 
+    rc = tag_stat_test();
+    if (rc != 0)
+	return rc;
+
+    rc = thread_cache_test();
+    if (rc != 0)
+	return rc;
+
 
     return 0;
 }
@@ -118,6 +118,104 @@ static int pool_test_malloc_free()
 
 #endif /* PJ_SYMBIAN */
 
+#if PJ_HAS_THREADS
+/*
+ * Multi-threaded benchmark: each thread creates and releases pools from
+ * the same caching pool.
+ */
+#define MT_MAX_THREADS	8
+#define MT_POOL_COUNT	100000
+
+typedef struct mt_thread_data
+{
+    pj_pool_factory *pf;
+    pj_thread_t	    *thread;
+    int		     rc;
+} mt_thread_data;
+
+static int mt_pool_thread(void *arg)
+{
+    mt_thread_data *td = (mt_thread_data*)arg;
+    pj_pool_t *pools[4];
+    unsigned i, j;
+
+    for (i=0; i<MT_POOL_COUNT; i+=PJ_ARRAY_SIZE(pools)) {
+	for (j=0; j<PJ_ARRAY_SIZE(pools); ++j) {
+	    pools[j] = pj_pool_create(td->pf, "mt%p", 1000 + j*1000, 1000,
+				      NULL);
+	    if (!pools[j]) {
+		td->rc = -1;
+		while (j)
+		    pj_pool_release(pools[--j]);
+		return 0;
+	    }
+	    pj_pool_alloc(pools[j], 200);
+	}
+	for (j=0; j<PJ_ARRAY_SIZE(pools); ++j)
+	    pj_pool_release(pools[j]);
+    }
+
+    return 0;
+}
+
+static int pool_mt_perf(unsigned thread_cnt, unsigned *p_speed)
+{
+    pj_caching_pool cp;
+    mt_thread_data td[MT_MAX_THREADS];
+    pj_pool_t *pool;
+    pj_timestamp t1, t2, freq;
+    unsigned i;
+    int rc = 0;
+
+    pj_get_timestamp_freq(&freq);
+    pj_caching_pool_init(&cp, NULL, 1024*1024);
+
+    pool = pj_pool_create(mem, "poolmt", 4000, 4000, NULL);
+    if (!pool) {
+	pj_caching_pool_destroy(&cp);
+	return -20;
+    }
+
+    pj_bzero(td, sizeof(td));
+
+    pj_get_timestamp(&t1);
+    for (i=0; i<thread_cnt; ++i) {
+	td[i].pf = &cp.factory;
+	if (pj_thread_create(pool, "poolmt%p", &mt_pool_thread, &td[i],
+			     0, 0, &td[i].thread) != PJ_SUCCESS)
+	{
+	    rc = -30;
+	    break;
+	}
+    }
+    for (i=0; i<thread_cnt; ++i) {
+	if (td[i].thread) {
+	    pj_thread_join(td[i].thread);
+	    pj_thread_destroy(td[i].thread);
+	}
+	if (td[i].rc != 0 && rc == 0)
+	    rc = -40;
+    }
+    pj_get_timestamp(&t2);
+
+    /* All pools must have been released */
+    if (rc == 0 && cp.used_count != 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: %d pools not released",
+		  (int)cp.used_count));
+	rc = -50;
+    }
+
+    if (rc == 0) {
+	pj_sub_timestamp(&t2, &t1);
+	*p_speed = (unsigned)(freq.u64 * thread_cnt * MT_POOL_COUNT / t2.u64);
+    }
+
+    pj_pool_release(pool);
+    pj_caching_pool_destroy(&cp);
+    return rc;
+}
+#endif	/* PJ_HAS_THREADS */
+
 int pool_perf_test()
 {
     unsigned i;
@@ -186,6 +284,21 @@ int pool_perf_test()
     PJ_LOG(3, (THIS_FILE, "..pool speedup over malloc best=%dx, worst=%dx", 
 			  (int)(malloc_time/best),
 			  (int)(malloc_time/worst)));
+
+#if PJ_HAS_THREADS
+    PJ_LOG(3, (THIS_FILE, "Benchmarking pool create/release with threads.."));
+    for (i=1; i<=MT_MAX_THREADS; i*=2) {
+	unsigned speed;
+	int rc;
+
+	rc = pool_mt_perf(i, &speed);
+	if (rc != 0)
+	    return rc;
+
+	PJ_LOG(3, (THIS_FILE, "..%d thread(s): %u pools/sec", i, speed));
+    }
+#endif
+
     return 0;
 }
 
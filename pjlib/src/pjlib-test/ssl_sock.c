@@ -94,6 +94,9 @@ static void dump_ssl_info(const pj_ssl_sock_info *si)
 	tmp_st = "[Unknown]";
     PJ_LOG(3, ("", ".....Cipher: %s", tmp_st));
 
+    /* Print kernel TLS offload status */
+    PJ_LOG(3, ("", ".....Kernel TLS send: %s", si->ktls_send? "yes" : "no"));
+
     /* Print remote certificate info and verification result */
     if (si->remote_cert_info && si->remote_cert_info->subject.info.slen) 
     {
@@ -495,7 +498,8 @@ on_return:
 
 static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
 		     pj_ssl_cipher srv_cipher, pj_ssl_cipher cli_cipher,
-		     pj_bool_t req_client_cert, pj_bool_t client_provide_cert)
+		     pj_bool_t req_client_cert, pj_bool_t client_provide_cert,
+		     pj_bool_t enable_ktls)
 {
     pj_pool_t *pool = NULL;
     pj_ioqueue_t *ioqueue = NULL;
@@ -523,6 +527,7 @@ static int echo_test(pj_ssl_sock_proto srv_proto, pj_ssl_sock_proto cli_proto,
     param.cb.on_data_sent = &ssl_on_data_sent;
     param.ioqueue = ioqueue;
     param.ciphers = ciphers;
+    param.enable_ktls = enable_ktls;
 
     /* Init default bind address */
     {
@@ -1332,34 +1337,511 @@ on_return:
     return status;
 }
 
-#if 0 && (!defined(PJ_SYMBIAN) || PJ_SYMBIAN==0)
-pj_status_t pj_ssl_sock_ossl_test_send_buf(pj_pool_t *pool);
-static int ossl_test_send_buf()
+/* Burst send test: server sends many small messages back-to-back without
+ * waiting for the sending completion, so the socket gets busy and data
+ * written meanwhile has to be queued and sent later. Client verifies that
+ * all data is received in order. With kernel TLS requested, the backlog
+ * must not cause any error nor change the kernel TLS state.
+ */
+#define BURST_MSG_CNT		1024
+#define BURST_MSG_LEN		1000
+
+static pj_ioqueue_op_key_t *burst_keys;
+static pj_ssl_sock_t *burst_ssock;
+static unsigned burst_sent_cnt;
+static unsigned burst_pending_cnt;
+static pj_bool_t burst_ktls_send;
+
+static pj_bool_t burst_on_accept_complete(pj_ssl_sock_t *ssock,
+					  pj_ssl_sock_t *newsock,
+					  const pj_sockaddr_t *src_addr,
+					  int src_addr_len)
+{
+    struct test_state *st = (struct test_state*) 
+			    pj_ssl_sock_get_user_data(ssock);
+    unsigned i;
+
+    PJ_UNUSED_ARG(src_addr);
+    PJ_UNUSED_ARG(src_addr_len);
+
+    burst_ssock = newsock;
+    pj_ssl_sock_set_user_data(newsock, st);
+
+    /* Kernel TLS state before the backlog */
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(newsock, &info);
+	burst_ktls_send = info.ktls_send;
+    }
+
+    for (i = 0; i < BURST_MSG_CNT; ++i) {
+	pj_ssize_t size = BURST_MSG_LEN;
+	pj_status_t status;
+
+	status = pj_ssl_sock_send(newsock, &burst_keys[i],
+				  st->send_str + i * BURST_MSG_LEN, &size, 0);
+	if (status == PJ_SUCCESS) {
+	    st->sent += size;
+	    burst_sent_cnt++;
+	} else if (status == PJ_EPENDING) {
+	    burst_pending_cnt++;
+	} else {
+	    app_perror("...ERROR pj_ssl_sock_send()", status);
+	    st->err = status;
+	    break;
+	}
+    }
+
+    return PJ_TRUE;
+}
+
+static pj_bool_t burst_on_data_sent(pj_ssl_sock_t *ssock,
+				    pj_ioqueue_op_key_t *op_key,
+				    pj_ssize_t sent)
+{
+    struct test_state *st = (struct test_state*)
+			     pj_ssl_sock_get_user_data(ssock);
+    PJ_UNUSED_ARG(op_key);
+
+    if (sent < 0) {
+	st->err = (pj_status_t)-sent;
+    } else {
+	st->sent += sent;
+	burst_sent_cnt++;
+    }
+
+    return PJ_TRUE;
+}
+
+static int burst_send_test(pj_bool_t enable_ktls)
 {
-    pj_pool_t *pool;
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_t *ssock_cli = NULL;
+    pj_ssl_sock_param param;
+    struct test_state state_serv = { 0 };
+    struct test_state state_cli = { 0 };
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL;
+    pj_timestamp t1, t2;
     pj_status_t status;
 
-    pool = pj_pool_create(mem, "send_buf", 256, 256, NULL);
-    status = pj_ssl_sock_ossl_test_send_buf(pool);
-    pj_pool_release(pool);
+    burst_ssock = NULL;
+    burst_sent_cnt = burst_pending_cnt = 0;
+    burst_ktls_send = PJ_FALSE;
+
+    pool = pj_pool_create(mem, "ssl_burst", 256, 256, NULL);
+
+    status = pj_ioqueue_create(pool, 4, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    burst_keys = (pj_ioqueue_op_key_t*)
+		 pj_pool_calloc(pool, BURST_MSG_CNT,
+				sizeof(pj_ioqueue_op_key_t));
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &burst_on_accept_complete;
+    param.cb.on_connect_complete = &ssl_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &burst_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.enable_ktls = enable_ktls;
+
+    /* Init default bind address */
+    {
+	pj_str_t tmp_st;
+	pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+    }
+
+    /* Data to send */
+    {
+	unsigned i;
+
+	state_serv.send_str_len = BURST_MSG_CNT * BURST_MSG_LEN;
+	state_serv.send_str = (char*)pj_pool_alloc(pool,
+						   state_serv.send_str_len);
+	for (i = 0; i < state_serv.send_str_len; ++i)
+	    state_serv.send_str[i] = (char)(pj_rand() % 256);
+    }
+
+    /* === SERVER === */
+    param.user_data = &state_serv;
+    state_serv.pool = pool;
+    state_serv.is_server = PJ_TRUE;
+
+    /* Small socket send buffer, so the socket gets busy quickly */
+    {
+	static int sndbuf = 8192;
+
+	param.sockopt_params.cnt = 1;
+	param.sockopt_params.options[0].level = pj_SOL_SOCKET();
+	param.sockopt_params.options[0].optname = pj_SO_SNDBUF();
+	param.sockopt_params.options[0].optval = &sndbuf;
+	param.sockopt_params.options[0].optlen = sizeof(sndbuf);
+    }
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    /* Set server cert */
+    {
+	pj_str_t tmp1, tmp2, tmp3, tmp4;
+
+	status = pj_ssl_cert_load_from_files(pool, 
+					     pj_strset2(&tmp1, (char*)CERT_CA_FILE), 
+					     pj_strset2(&tmp2, (char*)CERT_FILE), 
+					     pj_strset2(&tmp3, (char*)CERT_PRIVKEY_FILE), 
+					     pj_strset2(&tmp4, (char*)CERT_PRIVKEY_PASS), 
+					     &cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+
+	status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr, pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    /* Get listener address */
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    /* === CLIENT === */
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.sockopt_params.cnt = 0;
+    param.user_data = &state_cli;
+
+    /* Client only verifies the received data, mark its data as sent */
+    state_cli.pool = pool;
+    state_cli.check_echo = PJ_TRUE;
+    state_cli.send_str = state_serv.send_str;
+    state_cli.send_str_len = state_serv.send_str_len;
+    state_cli.sent = state_cli.send_str_len;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    pj_get_timestamp(&t1);
+
+    status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr, &listen_addr, pj_sockaddr_get_len(&addr));
+    if (status == PJ_SUCCESS) {
+	ssl_on_connect_complete(ssock_cli, PJ_SUCCESS);
+    } else if (status == PJ_EPENDING) {
+	status = PJ_SUCCESS;
+    } else {
+	goto on_return;
+    }
+
+    /* Wait until everything has been received or error */
+    while (!state_serv.err && !state_cli.err && !state_cli.done)
+    {
+	pj_time_val delay = {0, 100};
+	pj_ioqueue_poll(ioqueue, &delay);
+    }
+
+    pj_get_timestamp(&t2);
+
+    /* Kernel TLS state must stay the same after the backlog */
+    if (burst_ssock && !state_serv.err && !state_cli.err) {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(burst_ssock, &info);
+	PJ_LOG(3, ("", ".....Kernel TLS send: %s",
+		   info.ktls_send? "yes" : "no"));
+	if (info.ktls_send != burst_ktls_send) {
+	    PJ_LOG(1, ("", "...ERROR: kernel TLS state changed"));
+	    status = PJ_EBUG;
+	    goto on_return;
+	}
+    }
+
+    /* Server socket doesn't read, close it before the client EOF arrives */
+    if (burst_ssock) {
+	pj_ssl_sock_close(burst_ssock);
+	burst_ssock = NULL;
+    }
+
+    /* Clean up sockets */
+    {
+	pj_time_val delay = {0, 100};
+	while (pj_ioqueue_poll(ioqueue, &delay) > 0);
+    }
+
+    if (state_serv.err || state_cli.err) {
+	if (state_serv.err != PJ_SUCCESS)
+	    status = state_serv.err;
+	else
+	    status = state_cli.err;
+
+	goto on_return;
+    }
+
+    /* Every send must have been completed */
+    if (burst_sent_cnt != BURST_MSG_CNT ||
+	state_serv.sent != state_serv.send_str_len)
+    {
+	PJ_LOG(1, ("", "...ERROR: only %u of %u messages (%u bytes) sent",
+		   burst_sent_cnt, BURST_MSG_CNT, (unsigned)state_serv.sent));
+	status = PJ_EBUG;
+	goto on_return;
+    }
+
+    PJ_LOG(3, ("", "...Done!"));
+    PJ_LOG(3, ("", ".....%u messages (%u pending) in %u usec",
+	       BURST_MSG_CNT, burst_pending_cnt,
+	       pj_elapsed_usec(&t1, &t2)));
+
+on_return:
+    if (burst_ssock)
+	pj_ssl_sock_close(burst_ssock);
+    if (ssock_serv)
+	pj_ssl_sock_close(ssock_serv);
+    if (ssock_cli && !state_cli.err && !state_cli.done) 
+	pj_ssl_sock_close(ssock_cli);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (pool)
+	pj_pool_release(pool);
+
     return status;
 }
-#else
-static int ossl_test_send_buf()
+
+
+/* Number of connections established with resumed TLS session */
+static unsigned hs_reused_cnt;
+
+static pj_bool_t hs_on_connect_complete(pj_ssl_sock_t *ssock,
+					pj_status_t status)
 {
-    return 0;
+    if (status == PJ_SUCCESS) {
+	pj_ssl_sock_info info;
+
+	if (pj_ssl_sock_get_info(ssock, &info) == PJ_SUCCESS &&
+	    info.session_reused)
+	{
+	    hs_reused_cnt++;
+	}
+    }
+
+    return ssl_on_connect_complete(ssock, status);
 }
+
+/* Test will perform sequential connections from a client to a single
+ * server, to measure the handshake rate. Each client sends a short echo
+ * so TLS 1.3 session tickets are received before the client is closed,
+ * subsequent connections should then resume the previous session. Note
+ * that closed sockets are not immediately returned to the ioqueue, so
+ * the number of connections is limited by the ioqueue capacity.
+ */
+static int handshake_perf_test(unsigned conn_cnt)
+{
+    pj_pool_t *pool = NULL;
+    pj_ioqueue_t *ioqueue = NULL;
+    pj_timer_heap_t *timer = NULL;
+    pj_ssl_sock_t *ssock_serv = NULL;
+    pj_ssl_sock_t *ssock_cli = NULL;
+    pj_ssl_sock_param param;
+    struct test_state state_serv = { 0 };
+    struct test_state state_cli;
+    pj_sockaddr addr, listen_addr;
+    pj_ssl_cert_t *cert = NULL;
+    char send_str[] = "handshake perf test";
+    pj_status_t status;
+    unsigned i;
+    int log_level;
+    pj_timestamp start, stop;
+
+    pool = pj_pool_create(mem, "ssl_hs_perf", 256, 256, NULL);
+
+    status = pj_ioqueue_create(pool, PJ_IOQUEUE_MAX_HANDLES, &ioqueue);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_timer_heap_create(pool, PJ_IOQUEUE_MAX_HANDLES, &timer);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    /* Set cert */
+    {
+	pj_str_t tmp1, tmp2, tmp3, tmp4;
+
+	status = pj_ssl_cert_load_from_files(pool, 
+					     pj_strset2(&tmp1, (char*)CERT_CA_FILE), 
+					     pj_strset2(&tmp2, (char*)CERT_FILE), 
+					     pj_strset2(&tmp3, (char*)CERT_PRIVKEY_FILE), 
+					     pj_strset2(&tmp4, (char*)CERT_PRIVKEY_PASS), 
+					     &cert);
+	if (status != PJ_SUCCESS) {
+	    goto on_return;
+	}
+    }
+
+    pj_ssl_sock_param_default(&param);
+    param.cb.on_accept_complete = &ssl_on_accept_complete;
+    param.cb.on_connect_complete = &hs_on_connect_complete;
+    param.cb.on_data_read = &ssl_on_data_read;
+    param.cb.on_data_sent = &ssl_on_data_sent;
+    param.ioqueue = ioqueue;
+    param.timer_heap = timer;
+
+    /* Init default bind address */
+    {
+	pj_str_t tmp_st;
+	pj_sockaddr_init(PJ_AF_INET, &addr, pj_strset2(&tmp_st, "127.0.0.1"), 0);
+    }
+
+    /* SERVER */
+    param.user_data = &state_serv;
+
+    state_serv.pool = pool;
+    state_serv.echo = PJ_TRUE;
+    state_serv.is_server = PJ_TRUE;
+
+    status = pj_ssl_sock_create(pool, &param, &ssock_serv);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_ssl_sock_set_certificate(ssock_serv, pool, cert);
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    status = pj_ssl_sock_start_accept(ssock_serv, pool, &addr, pj_sockaddr_get_len(&addr));
+    if (status != PJ_SUCCESS) {
+	goto on_return;
+    }
+
+    /* Get listening address for clients to connect to */
+    {
+	pj_ssl_sock_info info;
+
+	pj_ssl_sock_get_info(ssock_serv, &info);
+	pj_sockaddr_cp(&listen_addr, &info.local_addr);
+    }
+
+    /* Per connection logs would dominate the measurement */
+    log_level = pj_log_get_level();
+    pj_log_set_level(2);
+
+    hs_reused_cnt = 0;
+    pj_get_timestamp(&start);
+
+    /* CLIENTS, one connection at a time */
+    for (i = 0; i < conn_cnt; ++i) {
+	pj_bzero(&state_cli, sizeof(state_cli));
+	state_cli.pool = pool;
+	state_cli.check_echo = PJ_TRUE;
+	state_cli.send_str = send_str;
+	state_cli.send_str_len = sizeof(send_str) - 1;
+	param.user_data = &state_cli;
+
+	status = pj_ssl_sock_create(pool, &param, &ssock_cli);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...ERROR pj_ssl_sock_create()", status);
+	    break;
+	}
+
+	clients_num = 1;
+	status = pj_ssl_sock_start_connect(ssock_cli, pool, &addr, &listen_addr, pj_sockaddr_get_len(&addr));
+	if (status == PJ_SUCCESS) {
+	    hs_on_connect_complete(ssock_cli, PJ_SUCCESS);
+	} else if (status != PJ_EPENDING) {
+	    app_perror("...ERROR pj_ssl_sock_start_connect()", status);
+	    pj_ssl_sock_close(ssock_cli);
+	    break;
+	}
+
+	/* Wait until the echo has been received or error */
+	while (clients_num) {
+	    pj_time_val delay = {0, 100};
+	    pj_ioqueue_poll(ioqueue, &delay);
+	    pj_timer_heap_poll(timer, &delay);
+	}
+
+	status = state_cli.err;
+	if (status != PJ_SUCCESS)
+	    break;
+    }
+
+    pj_get_timestamp(&stop);
+    pj_log_set_level(log_level);
+
+    /* Clean up sockets */
+    {
+	pj_time_val delay = {0, 500};
+	while (pj_ioqueue_poll(ioqueue, &delay) > 0);
+    }
+
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
+    if (state_serv.err != PJ_SUCCESS) {
+	status = state_serv.err;
+	goto on_return;
+    }
+
+    PJ_LOG(3, ("", "...Done!"));
+
+    /* Handshake rate */
+    {
+	pj_uint32_t usec = pj_elapsed_usec(&start, &stop);
+
+	if (usec == 0)
+	    usec = 1;
+
+	PJ_LOG(3, ("", ".....%u connections in %u usec: %u handshakes/s",
+		   conn_cnt, usec,
+		   (unsigned)((pj_uint64_t)conn_cnt * 1000000 / usec)));
+	PJ_LOG(3, ("", ".....Resumed sessions: %u", hs_reused_cnt));
+    }
+
+#if PJ_SSL_SOCK_CTX_CACHE_SIZE > 0 && PJ_SSL_SOCK_CLIENT_SESS_CACHE_SIZE > 0
+    /* Only the first connection should need a full handshake */
+    if (hs_reused_cnt + 1 < conn_cnt) {
+	PJ_LOG(1, ("", "...ERROR expecting %u resumed sessions",
+		   conn_cnt - 1));
+	status = PJ_EBUG;
+    }
 #endif
 
+on_return:
+    if (ssock_serv) 
+	pj_ssl_sock_close(ssock_serv);
+    if (ioqueue)
+	pj_ioqueue_destroy(ioqueue);
+    if (timer)
+	pj_timer_heap_destroy(timer);
+    if (pool)
+	pj_pool_release(pool);
+
+    return status;
+}
+
 int ssl_sock_test(void)
 {
     int ret;
 
-    PJ_LOG(3,("", "..test ossl send buf"));
-    ret = ossl_test_send_buf();
-    if (ret != 0)
-	return ret;
-
     PJ_LOG(3,("", "..get cipher list test"));
     ret = get_cipher_list();
     if (ret != 0)
@@ -1381,42 +1863,48 @@ int ssl_sock_test(void)
     PJ_LOG(3,("", "..echo test w/ TLSv1 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_TLS1, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA, 
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
 	return ret;
 
     PJ_LOG(3,("", "..echo test w/ SSLv23 and PJ_TLS_RSA_WITH_AES_256_CBC_SHA cipher"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_SSL23, PJ_SSL_SOCK_PROTO_SSL23, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret != 0)
 	return ret;
 
     PJ_LOG(3,("", "..echo test w/ incompatible proto"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_TLS1, PJ_SSL_SOCK_PROTO_SSL3, 
 		    PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_DES_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ incompatible ciphers"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_DES_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_FALSE, PJ_FALSE);
+		    PJ_FALSE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ client cert required but not provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_TRUE, PJ_FALSE);
+		    PJ_TRUE, PJ_FALSE, PJ_FALSE);
     if (ret == 0)
 	return PJ_EBUG;
 
     PJ_LOG(3,("", "..echo test w/ client cert required and provided"));
     ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
 		    PJ_TLS_RSA_WITH_AES_256_CBC_SHA, PJ_TLS_RSA_WITH_AES_256_CBC_SHA,
-		    PJ_TRUE, PJ_TRUE);
+		    PJ_TRUE, PJ_TRUE, PJ_FALSE);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..echo test w/ kernel TLS enabled"));
+    ret = echo_test(PJ_SSL_SOCK_PROTO_DEFAULT, PJ_SSL_SOCK_PROTO_DEFAULT, 
+		    -1, -1, PJ_FALSE, PJ_FALSE, PJ_TRUE);
     if (ret != 0)
 	return ret;
 
@@ -1425,6 +1913,21 @@ int ssl_sock_test(void)
     if (ret != 0)
 	return ret;
 
+    PJ_LOG(3,("", "..burst send test"));
+    ret = burst_send_test(PJ_FALSE);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..burst send test w/ kernel TLS enabled"));
+    ret = burst_send_test(PJ_TRUE);
+    if (ret != 0)
+	return ret;
+
+    PJ_LOG(3,("", "..handshake performance test"));
+    ret = handshake_perf_test(PJ_IOQUEUE_MAX_HANDLES/2 - 2);
+    if (ret != 0)
+	return ret;
+
     PJ_LOG(3,("", "..client non-SSL (handshake timeout 5 secs)"));
     ret = client_non_ssl(5000);
     /* PJ_TIMEDOUT won't be returned as accepted socket is deleted silently */
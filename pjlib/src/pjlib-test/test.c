@@ -127,6 +127,10 @@ int test_inner(void)
     DO_TEST( timer_test() );
 #endif
 
+#if INCLUDE_TIMER_PERF_TEST
+    DO_TEST( timer_perf_test() );
+#endif
+
 #if INCLUDE_SLEEP_TEST
     DO_TEST( sleep_test() );
 #endif
@@ -44,6 +44,7 @@
 #define INCLUDE_FIFOBUF_TEST	    0	// GROUP_DATA_STRUCTURE
 #define INCLUDE_RBTREE_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_TIMER_TEST	    GROUP_DATA_STRUCTURE
+#define INCLUDE_TIMER_PERF_TEST	    GROUP_DATA_STRUCTURE
 #define INCLUDE_ATOMIC_TEST         GROUP_OS
 #define INCLUDE_MUTEX_TEST	    (PJ_HAS_THREADS && GROUP_OS)
 #define INCLUDE_SLEEP_TEST          GROUP_OS
@@ -85,6 +86,7 @@ extern int pool_perf_test(void);
 extern int string_test(void);
 extern int fifobuf_test(void);
 extern int timer_test(void);
+extern int timer_perf_test(void);
 extern int rbtree_test(void);
 extern int atomic_test(void);
 extern int mutex_test(void);
@@ -32,7 +32,7 @@
  */
 
 
-#if INCLUDE_TIMER_TEST
+#if INCLUDE_TIMER_TEST || INCLUDE_TIMER_PERF_TEST
 
 #include <pjlib.h>
 
@@ -51,7 +51,7 @@ static void timer_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
     PJ_UNUSED_ARG(e);
 }
 
-static int test_timer_heap(void)
+static int test_timer_heap(pj_timer_heap_type type)
 {
     int i, j;
     pj_timer_entry *entry;
@@ -78,7 +78,7 @@ static int test_timer_heap(void)
     for (i=0; i<MAX_COUNT; ++i) {
 	entry[i].cb = &timer_callback;
     }
-    status = pj_timer_heap_create(pool, MAX_COUNT, &timer);
+    status = pj_timer_heap_create2(pool, MAX_COUNT, type, &timer);
     if (status != PJ_SUCCESS) {
         app_perror("...error: unable to create timer heap", status);
 	return -30;
@@ -183,9 +183,294 @@ static int test_timer_heap(void)
 }
 
 
+/*
+ * Sharded timer heap: each thread is bound to a shard, schedules its own
+ * entries with a group lock and expires them, while the main thread
+ * (which is not bound to any shard) cancels random entries.
+ */
+#define SHARD_THREADS	4
+#define SHARD_ENTRIES	500
+
+static struct shard_test
+{
+    pj_timer_heap_t	*ht;
+    pj_grp_lock_t	*grp_lock;
+    pj_thread_t		*thread[SHARD_THREADS];
+    pj_timer_entry	 entry[SHARD_THREADS][SHARD_ENTRIES];
+    pj_atomic_t		*fired;
+    pj_bool_t		 quit;
+    int			 err;
+} st;
+
+static void shard_callback(pj_timer_heap_t *ht, pj_timer_entry *e)
+{
+    /* The callback gets the sharded heap, and is called by the thread
+     * bound to the shard where the entry was scheduled.
+     */
+    if (ht != st.ht)
+	st.err = -110;
+    else if (e->user_data != pj_thread_this())
+	st.err = -120;
+
+    pj_atomic_inc(st.fired);
+}
+
+static int shard_thread(void *arg)
+{
+    int idx = (int)(pj_ssize_t)arg;
+    pj_time_val delay;
+    unsigned i;
+
+    pj_timer_heap_set_thread_shard(st.ht, idx);
+
+    for (i=0; i<SHARD_ENTRIES; ++i) {
+	pj_timer_entry *e = &st.entry[idx][i];
+
+	pj_timer_entry_init(e, 0, pj_thread_this(), &shard_callback);
+	delay.sec = 0;
+	delay.msec = pj_rand() % 500;
+	if (pj_timer_heap_schedule_w_grp_lock(st.ht, e, &delay, 1,
+					      st.grp_lock) != PJ_SUCCESS)
+	{
+	    st.err = -130;
+	}
+    }
+
+    while (!st.quit) {
+	pj_timer_heap_poll(st.ht, NULL);
+	pj_thread_sleep(1);
+    }
+
+    return 0;
+}
+
+static int test_sharded_timer_heap(void)
+{
+    pj_pool_t *pool;
+    pj_time_val timeout, now;
+    int i, cancelled = 0, total = SHARD_THREADS * SHARD_ENTRIES;
+    pj_status_t status;
+
+    pj_bzero(&st, sizeof(st));
+
+    pool = pj_pool_create( mem, NULL, 4000, 4000, NULL);
+    status = pj_timer_heap_create_sharded(pool, 64, SHARD_THREADS, &st.ht);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error: unable to create timer heap", status);
+	pj_pool_release(pool);
+	return -10;
+    }
+    if (pj_timer_heap_get_shard_count(st.ht) != SHARD_THREADS) {
+	pj_pool_release(pool);
+	return -20;
+    }
+
+    pj_grp_lock_create(pool, NULL, &st.grp_lock);
+    pj_grp_lock_add_ref(st.grp_lock);
+    pj_atomic_create(pool, 0, &st.fired);
+
+    for (i=0; i<SHARD_THREADS; ++i) {
+	status = pj_thread_create(pool, "shard", &shard_thread,
+				  (void*)(pj_ssize_t)i, 0, 0, &st.thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("...error: unable to create thread", status);
+	    st.err = -30;
+	    break;
+	}
+    }
+
+    /* Cancel random entries from the main thread, until all entries have
+     * either expired or been cancelled.
+     */
+    pj_gettickcount(&timeout);
+    timeout.sec += 5;
+    do {
+	pj_timer_entry *e = &st.entry[pj_rand() % SHARD_THREADS]
+				     [pj_rand() % SHARD_ENTRIES];
+
+	cancelled += pj_timer_heap_cancel_if_active(st.ht, e, 0);
+	pj_thread_sleep(0);
+	pj_gettickcount(&now);
+    } while (st.err == 0 && PJ_TIME_VAL_LT(now, timeout) &&
+	     pj_atomic_get(st.fired) + cancelled < total);
+
+    st.quit = PJ_TRUE;
+    for (i=0; i<SHARD_THREADS && st.thread[i]; ++i) {
+	pj_thread_join(st.thread[i]);
+	pj_thread_destroy(st.thread[i]);
+    }
+
+    if (st.err == 0 && pj_atomic_get(st.fired) + cancelled != total) {
+	PJ_LOG(3,(THIS_FILE, "...error: fired=%d cancelled=%d total=%d",
+		  (int)pj_atomic_get(st.fired), cancelled, total));
+	st.err = -40;
+    }
+    if (st.err == 0 && pj_timer_heap_count(st.ht) != 0)
+	st.err = -50;
+    if (st.err == 0 && pj_grp_lock_get_ref(st.grp_lock) != 1)
+	st.err = -60;
+
+    PJ_LOG(4,(THIS_FILE, "...ok (fired:%d, cancelled:%d)",
+	      (int)pj_atomic_get(st.fired), cancelled));
+
+    pj_grp_lock_dec_ref(st.grp_lock);
+    pj_atomic_destroy(st.fired);
+    pj_timer_heap_destroy(st.ht);
+    pj_pool_release(pool);
+
+    return st.err;
+}
+
+
 int timer_test()
 {
-    return test_timer_heap();
+    int rc;
+
+    PJ_LOG(3,(THIS_FILE, "...binary heap"));
+    rc = test_timer_heap(PJ_TIMER_HEAP_BINARY);
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "...timing wheel"));
+    rc = test_timer_heap(PJ_TIMER_HEAP_WHEEL);
+    if (rc != 0)
+	return rc;
+
+    PJ_LOG(3,(THIS_FILE, "...sharded timer heap"));
+    return test_sharded_timer_heap();
+}
+
+
+/*
+ * Benchmark: schedule many timers with long delays, cancel most of them
+ * (as SIP transaction and dialog timers usually are), poll while nothing
+ * expires, then measure the expiration of due entries.
+ */
+#define BENCH_CANCEL_PCT	90
+#define BENCH_POLL_CNT		1000
+
+static unsigned per_entry_nsec(const pj_timestamp *t1,
+			       const pj_timestamp *t2,
+			       unsigned count)
+{
+    pj_uint32_t usec = pj_elapsed_usec(t1, t2);
+    return (unsigned)(((pj_uint64_t)usec * 1000) / (count ? count : 1));
+}
+
+static int timer_bench(pj_timer_heap_type type, unsigned count)
+{
+    pj_pool_t *pool;
+    pj_timer_heap_t *timer;
+    pj_timer_entry *entry;
+    pj_timestamp t1, t2;
+    pj_time_val delay;
+    unsigned i, cancelled = 0;
+    unsigned t_sched, t_cancel, t_poll, t_expire;
+    pj_status_t status;
+
+    pool = pj_pool_create(mem, NULL, pj_timer_heap_mem_size(count) +
+				     count * sizeof(pj_timer_entry), 
+			  4000, NULL);
+    if (!pool)
+	return -100;
+
+    entry = (pj_timer_entry*)pj_pool_calloc(pool, count, sizeof(*entry));
+    if (!entry) {
+	pj_pool_release(pool);
+	return -110;
+    }
+    for (i=0; i<count; ++i)
+	pj_timer_entry_init(&entry[i], 0, NULL, &timer_callback);
+
+    status = pj_timer_heap_create2(pool, count, type, &timer);
+    if (status != PJ_SUCCESS) {
+        app_perror("...error: unable to create timer heap", status);
+	pj_pool_release(pool);
+	return -120;
+    }
+    pj_timer_heap_set_max_timed_out_per_poll(timer, count);
+
+    /* Schedule with delays between 1 and 120 seconds */
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+	delay.sec = 1 + pj_rand() % 120;
+	delay.msec = pj_rand() % 1000;
+	if (pj_timer_heap_schedule(timer, &entry[i], &delay) != PJ_SUCCESS) {
+	    pj_pool_release(pool);
+	    return -130;
+	}
+    }
+    pj_get_timestamp(&t2);
+    t_sched = per_entry_nsec(&t1, &t2, count);
+
+    /* Cancel most of them */
+    pj_get_timestamp(&t1);
+    for (i=0; i<count; ++i) {
+	if (i % 100 < BENCH_CANCEL_PCT)
+	    cancelled += pj_timer_heap_cancel(timer, &entry[i]);
+    }
+    pj_get_timestamp(&t2);
+    t_cancel = per_entry_nsec(&t1, &t2, cancelled);
+
+    /* Poll while nothing has expired */
+    pj_get_timestamp(&t1);
+    for (i=0; i<BENCH_POLL_CNT; ++i) {
+	pj_time_val next_delay;
+	pj_timer_heap_poll(timer, &next_delay);
+    }
+    pj_get_timestamp(&t2);
+    t_poll = per_entry_nsec(&t1, &t2, BENCH_POLL_CNT);
+
+    /* Reschedule everything as due, and expire them */
+    for (i=0; i<count; ++i)
+	pj_timer_heap_cancel(timer, &entry[i]);
+
+    delay.sec = delay.msec = 0;
+    for (i=0; i<count; ++i)
+	pj_timer_heap_schedule(timer, &entry[i], &delay);
+
+    pj_get_timestamp(&t1);
+    while (pj_timer_heap_count(timer) > 0)
+	pj_timer_heap_poll(timer, NULL);
+    pj_get_timestamp(&t2);
+    t_expire = per_entry_nsec(&t1, &t2, count);
+
+    PJ_LOG(3,(THIS_FILE, "    %-6s %8u   %8u   %8u   %8u   %8u",
+	      (type == PJ_TIMER_HEAP_WHEEL ? "wheel" : "heap"), count,
+	      t_sched, t_cancel, t_poll, t_expire));
+
+    pj_timer_heap_destroy(timer);
+    pj_pool_release(pool);
+    return 0;
+}
+
+int timer_perf_test()
+{
+    static const unsigned counts[] = { 10000, 100000, 1000000 };
+    unsigned i;
+
+    PJ_LOG(3,(THIS_FILE, "...Benchmarking timer heap implementations "
+	      "(%d%% cancelled):", BENCH_CANCEL_PCT));
+    PJ_LOG(3,(THIS_FILE, "    ==========================================="
+			 "============="));
+    PJ_LOG(3,(THIS_FILE, "    Type    Entries  Sched(ns) Cancel(ns)   "
+			 "Poll(ns) Expire(ns)"));
+    PJ_LOG(3,(THIS_FILE, "    ==========================================="
+			 "============="));
+
+    for (i=0; i<PJ_ARRAY_SIZE(counts); ++i) {
+	int rc;
+
+	rc = timer_bench(PJ_TIMER_HEAP_BINARY, counts[i]);
+	if (rc != 0)
+	    return rc;
+
+	rc = timer_bench(PJ_TIMER_HEAP_WHEEL, counts[i]);
+	if (rc != 0)
+	    return rc;
+    }
+
+    return 0;
 }
 
 #else
@@ -193,6 +478,6 @@ int timer_test()
  * when this test is disabled. 
  */
 int dummy_timer_test;
-#endif	/* INCLUDE_TIMER_TEST */
+#endif	/* INCLUDE_TIMER_TEST || INCLUDE_TIMER_PERF_TEST */
 
 
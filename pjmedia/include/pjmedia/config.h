@@ -385,6 +385,22 @@
 #endif
 
 
+/**
+ * Shard the media endpoint's internal ioqueue, with one shard per worker
+ * thread (up to PJ_IOQUEUE_MAX_SHARDS, the remaining threads are spread
+ * among the shards). When enabled, each worker thread only polls its
+ * own shard, so the media transports are spread among the worker threads
+ * and each transport is always serviced by the same thread. This only applies
+ * when the media endpoint creates its own ioqueue with more than one
+ * worker thread. See #pj_ioqueue_create_sharded().
+ *
+ * Default: 0 (all worker threads poll the whole ioqueue)
+ */
+#ifndef PJMEDIA_ENDPT_SHARD_IOQUEUE
+#  define PJMEDIA_ENDPT_SHARD_IOQUEUE		0
+#endif
+
+
 /**
  * Max packet size for transmitting direction.
  */
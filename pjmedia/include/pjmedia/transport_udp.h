@@ -56,7 +56,20 @@ enum pjmedia_transport_udp_options
      * received.
      * Specifying this option will disable this feature.
      */
-    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1
+    PJMEDIA_UDP_NO_SRC_ADDR_CHECKING = 1,
+
+    /**
+     * Queue outgoing RTP packets in the ioqueue and send them in batches
+     * (with sendmmsg()) when the ioqueue is polled, instead of sending each
+     * packet right away. This reduces the number of system calls when
+     * the transport is used to send many streams, at the expense of
+     * slightly increased latency. Up to PJ_IOQUEUE_MAX_SEND_BATCH more
+     * packets may be queued than without this option; sending more
+     * packets before the ioqueue is polled fails with PJ_EBUSY. The
+     * option is silently ignored when batched send is not supported by
+     * the ioqueue.
+     */
+    PJMEDIA_UDP_BATCH_SEND = 2
 };
 
 
@@ -153,11 +153,20 @@ PJ_DEF(pj_status_t) pjmedia_endpt_create2(pj_pool_factory *pf,
 
     /* Create ioqueue if none is specified. */
     if (endpt->ioqueue == NULL) {
-	
+	unsigned shard_cnt = 1;
+
 	endpt->own_ioqueue = PJ_TRUE;
 
-	status = pj_ioqueue_create( endpt->pool, PJ_IOQUEUE_MAX_HANDLES,
-				    &endpt->ioqueue);
+	/* One shard per worker thread, the extra threads share them */
+	if (PJMEDIA_ENDPT_SHARD_IOQUEUE) {
+	    shard_cnt = worker_cnt;
+	    if (shard_cnt > PJ_IOQUEUE_MAX_SHARDS)
+		shard_cnt = PJ_IOQUEUE_MAX_SHARDS;
+	}
+
+	status = pj_ioqueue_create_sharded( endpt->pool,
+					    PJ_IOQUEUE_MAX_HANDLES,
+					    shard_cnt, &endpt->ioqueue);
 	if (status != PJ_SUCCESS)
 	    goto on_error;
 
@@ -167,13 +176,19 @@ PJ_DEF(pj_status_t) pjmedia_endpt_create2(pj_pool_factory *pf,
 	}
     }
 
-    /* Create worker threads if asked. */
+    /* Create worker threads if asked. The threads are started after
+     * all of them have been created, so that each of them can find its
+     * index (and hence its ioqueue shard) in the thread array.
+     */
     for (i=0; i<worker_cnt; ++i) {
 	status = pj_thread_create( endpt->pool, "media", &worker_proc,
-				   endpt, 0, 0, &endpt->thread[i]);
+				   endpt, 0, PJ_THREAD_SUSPENDED,
+				   &endpt->thread[i]);
 	if (status != PJ_SUCCESS)
 	    goto on_error;
     }
+    for (i=0; i<worker_cnt; ++i)
+	pj_thread_resume(endpt->thread[i]);
 
 
     *p_endpt = endpt;
@@ -334,6 +349,20 @@ static int PJ_THREAD_FUNC worker_proc(void *arg)
 {
     pjmedia_endpt *endpt = (pjmedia_endpt*) arg;
 
+    /* Only poll our own shard when the ioqueue is sharded */
+    if (endpt->own_ioqueue && pj_ioqueue_get_shard_count(endpt->ioqueue) > 1) {
+	pj_thread_t *this_thread = pj_thread_this();
+	unsigned shard_cnt = pj_ioqueue_get_shard_count(endpt->ioqueue);
+	unsigned i;
+
+	for (i=0; i<endpt->thread_cnt; ++i) {
+	    if (endpt->thread[i] == this_thread) {
+		pj_ioqueue_set_thread_shard(endpt->ioqueue, i % shard_cnt);
+		break;
+	    }
+	}
+    }
+
     while (!endpt->quit_flag) {
 	pj_time_val timeout = { 0, 500 };
 	pj_ioqueue_poll(endpt->ioqueue, &timeout);
@@ -37,6 +37,12 @@
 /* Maximum pending write operations */
 #define MAX_PENDING 4
 
+/* Maximum pending write operations when batched send is enabled, since
+ * up to PJ_IOQUEUE_MAX_SEND_BATCH datagrams may stay queued in the
+ * ioqueue until it is polled.
+ */
+#define MAX_PENDING_BATCH   (MAX_PENDING + PJ_IOQUEUE_MAX_SEND_BATCH)
+
 static const pj_str_t ID_RTP_AVP  = { "RTP/AVP", 7 };
 
 /* Pending write buffer */
@@ -75,7 +81,8 @@ struct transport_udp
     pj_ioqueue_key_t   *rtp_key;	/**< RTP socket key in ioqueue	    */
     pj_ioqueue_op_key_t	rtp_read_op;	/**< Pending read operation	    */
     unsigned		rtp_write_op_id;/**< Next write_op to use	    */
-    pending_write	rtp_pending_write[MAX_PENDING];  /**< Pending write */
+    unsigned		rtp_write_op_cnt;/**< Number of write_op	    */
+    pending_write      *rtp_pending_write;  /**< Pending write		    */
     pj_sockaddr		rtp_src_addr;	/**< Actual packet src addr.	    */
     unsigned		rtp_src_cnt;	/**< How many pkt from this addr.   */
     int			rtp_addrlen;	/**< Address length.		    */
@@ -345,8 +352,22 @@ PJ_DEF(pj_status_t) pjmedia_transport_udp_attach( pjmedia_endpt *endpt,
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    /* Enable batched send if requested */
+    if (tp->options & PJMEDIA_UDP_BATCH_SEND) {
+	status = pj_ioqueue_set_send_batch(tp->rtp_key,
+					   PJ_IOQUEUE_MAX_SEND_BATCH);
+	if (status != PJ_SUCCESS)
+	    tp->options &= ~PJMEDIA_UDP_BATCH_SEND;
+    }
+
+    tp->rtp_write_op_cnt = (tp->options & PJMEDIA_UDP_BATCH_SEND) ?
+			   MAX_PENDING_BATCH : MAX_PENDING;
+    tp->rtp_pending_write = (pending_write*)
+			    pj_pool_calloc(pool, tp->rtp_write_op_cnt,
+					   sizeof(pending_write));
+
     pj_ioqueue_op_key_init(&tp->rtp_read_op, sizeof(tp->rtp_read_op));
-    for (i=0; i<PJ_ARRAY_SIZE(tp->rtp_pending_write); ++i)
+    for (i=0; i<tp->rtp_write_op_cnt; ++i)
 	pj_ioqueue_op_key_init(&tp->rtp_pending_write[i].op_key, 
 			       sizeof(tp->rtp_pending_write[i].op_key));
 
@@ -806,7 +827,7 @@ static void transport_detach( pjmedia_transport *tp,
 	udp->user_data = NULL;
 
 	/* Cancel any outstanding send */
-	for (i=0; i<PJ_ARRAY_SIZE(udp->rtp_pending_write); ++i) {
+	for (i=0; i<udp->rtp_write_op_cnt; ++i) {
 	    pj_ioqueue_post_completion(udp->rtp_key,
 				       &udp->rtp_pending_write[i].op_key, 0);
 	}
@@ -826,8 +847,9 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
 {
     struct transport_udp *udp = (struct transport_udp*)tp;
     pj_ssize_t sent;
-    unsigned id;
+    unsigned i, id;
     struct pending_write *pw;
+    pj_uint32_t flags = 0;
     pj_status_t status;
 
     /* Must be attached */
@@ -847,7 +869,27 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
     }
 
 
+    /* Find a write slot which is not pending. Datagrams queued for
+     * batched send stay pending until the ioqueue is polled, so the
+     * slot after the last one used may still be in use.
+     */
     id = udp->rtp_write_op_id;
+    for (i=0; i<udp->rtp_write_op_cnt; ++i) {
+	if (!pj_ioqueue_is_pending(udp->rtp_key,
+				   &udp->rtp_pending_write[id].op_key))
+	{
+	    break;
+	}
+	id = (id + 1) % udp->rtp_write_op_cnt;
+    }
+
+    if (i == udp->rtp_write_op_cnt) {
+	PJ_LOG(5,(udp->base.name, 
+		  "TX RTP packet dropped because all write slots are "
+		  "pending"));
+	return PJ_EBUSY;
+    }
+
     pw = &udp->rtp_pending_write[id];
 
     /* We need to copy packet to our buffer because when the
@@ -856,15 +898,16 @@ static pj_status_t transport_send_rtp( pjmedia_transport *tp,
      */
     pj_memcpy(pw->buffer, pkt, size);
 
+    if (udp->options & PJMEDIA_UDP_BATCH_SEND)
+	flags = PJ_IOQUEUE_BATCH_SEND;
+
     sent = size;
-    status = pj_ioqueue_sendto( udp->rtp_key, 
-				&udp->rtp_pending_write[id].op_key,
-				pw->buffer, &sent, 0,
+    status = pj_ioqueue_sendto( udp->rtp_key, &pw->op_key,
+				pw->buffer, &sent, flags,
 				&udp->rem_rtp_addr, 
 				udp->addr_len);
 
-    udp->rtp_write_op_id = (udp->rtp_write_op_id + 1) %
-			   PJ_ARRAY_SIZE(udp->rtp_pending_write);
+    udp->rtp_write_op_id = (id + 1) % udp->rtp_write_op_cnt;
 
     if (status==PJ_SUCCESS || status==PJ_EPENDING)
 	return PJ_SUCCESS;
@@ -93,6 +93,7 @@
 #define CMD_CONFIG_DUMP_DETAIL	    ((CMD_CONFIG*10)+2)
 #define CMD_CONFIG_DUMP_CONF	    ((CMD_CONFIG*10)+3)
 #define CMD_CONFIG_WRITE_SETTING    ((CMD_CONFIG*10)+4)
+#define CMD_CONFIG_DUMP_POOL	    ((CMD_CONFIG*10)+5)
 
 /* video level 2 command */
 #define CMD_VIDEO_ENABLE	    ((CMD_VIDEO*10)+1)
@@ -1459,6 +1460,10 @@ pj_status_t cmd_config_handler(pj_cli_cmd_val *cval)
     case CMD_CONFIG_WRITE_SETTING:
 	status = cmd_write_config(cval);
 	break;
+    case CMD_CONFIG_DUMP_POOL:
+	pj_caching_pool_dump_tag_stat(
+			    (pj_caching_pool*)pjsua_get_pool_factory());
+	break;
     }
 
     return status;
@@ -2905,6 +2910,9 @@ static pj_status_t add_config_command(pj_cli_t *c)
 	"   desc='Write current configuration file'>"
 	"    <ARG name='output_file' type='string' desc='Output filename'/>"
 	"  </CMD>"
+	"  <CMD name='dump_pool' id='5005' sc='dp' "
+	"   desc='Dump memory pool usage by tag (needs "
+	"PJ_CACHING_POOL_HAS_TAG_STAT enabled at build time)'/>"
 	"</CMD>";
 
     pj_str_t xml = pj_str(config_command);
@@ -49,7 +49,25 @@
  *    Also for every call, server will limit the call duration to
  *    10 seconds, on which the call will be terminated if the client
  *    doesn't hangup the call.
- *    
+ *  - URL with "3" as the user part is handled like "2", but the server
+ *    first sends an extra 180/Ringing response with a different To tag,
+ *    as if the INVITE had been forked by a proxy to two UAS.
+ *
+ * The client can run one of the predefined scenarios (see \a --scenario),
+ * or all of them in sequence. When no URL is given, the scenarios run
+ * entirely on the loopback interface against the server part of the
+ * same program, so the results are reproducible from build to build:
+ *
+ \verbatim
+   pjsip-perf --scenario=all --json=perf.json
+   pjsip-perf --scenario=all --json=perf.json --use-tcp
+   pjsip-perf --scenario=call --thread-count=4 --count=50000
+ \endverbatim
+ *
+ * Besides the request and response rate, the client reports the
+ * distribution of the response latency (p50/p99/p999 and a histogram)
+ * and the CPU time used per job. With \a --json, the results of each
+ * run are appended to the file as one JSON object per line.
  *
  *
  * This file is pjsip-apps/src/samples/pjsip-perf.c
@@ -66,6 +84,8 @@
 #include <pjlib-util.h>
 #include <pjlib.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
 
 #if (defined(PJ_WIN32) && PJ_WIN32!=0) || (defined(PJ_WIN64) && PJ_WIN64!=0)
 #  include <windows.h>
@@ -75,6 +95,8 @@
 #define DEFAULT_COUNT	    (pjsip_cfg()->tsx.max_count/2>10000?10000:pjsip_cfg()->tsx.max_count/2)
 #define JOB_WINDOW	    1000
 #define TERMINATE_TSX(x,c)
+#define NO_LATENCY	    ((pj_uint32_t)-1)
+#define LATENCY_BUCKETS	    32
 
 
 #ifndef CACHING_POOL_SIZE
@@ -110,6 +132,33 @@ static pj_str_t mime_application = { "application", 11};
 static pj_str_t mime_sdp = {"sdp", 3};
 
 
+/* Predefined client scenarios. The user part selects how the request
+ * is handled by the server (see the description above).
+ */
+typedef struct scenario
+{
+    const char	*name;
+    const char	*method;
+    pj_bool_t	 stateless;
+    const char	*user;
+    const char	*desc;
+} scenario;
+
+static const scenario scenarios[] =
+{
+    { "options-stateless", "OPTIONS",  PJ_TRUE,  "0",
+      "stateless OPTIONS requests" },
+    { "options",	   "OPTIONS",  PJ_FALSE, "1",
+      "stateful OPTIONS requests" },
+    { "register",	   "REGISTER", PJ_FALSE, "1",
+      "stateful REGISTER requests" },
+    { "call",		   "INVITE",   PJ_FALSE, "2",
+      "INVITE/ACK/BYE calls" },
+    { "call-fork",	   "INVITE",   PJ_FALSE, "3",
+      "INVITE/ACK/BYE calls with forked 180" },
+};
+
+
 struct srv_state
 {
     unsigned	    stateless_cnt;
@@ -123,6 +172,10 @@ struct app
     pj_caching_pool	 cp;
     pj_pool_t		*pool;
     pj_bool_t		 use_tcp;
+    pj_bool_t		 use_tls;
+    pj_str_t		 tls_cert;
+    pj_str_t		 tls_key;
+    const char		*tp_name;
     pj_str_t		 local_addr;
     int			 local_port;
     pjsip_endpoint	*sip_endpt;
@@ -156,6 +209,16 @@ struct app
 	pj_time_val	     last_completion;
 	unsigned	     total_responses;
 	unsigned	     response_codes[800];
+
+	pj_mutex_t	    *mutex;
+	const scenario	    *scen[PJ_ARRAY_SIZE(scenarios)];
+	unsigned	     scen_cnt;
+	pj_bool_t	     loopback;
+	const char	    *json_file;
+	pj_timestamp	    *send_ts;
+	pj_uint32_t	    *latency;
+	clock_t		     cpu_start,
+			     cpu_end;
     } client;
 
     struct {
@@ -173,6 +236,7 @@ struct call
 {
     pjsip_inv_session	*inv;
     pj_timer_entry	 ans_timer;
+    unsigned		 job_id;
 };
 
 
@@ -403,9 +467,34 @@ static void answer_timer_cb(pj_timer_heap_t *h, pj_timer_entry *entry)
     send_response(call->inv, NULL, 200, &has_initial);
 }
 
+/* Send 180/Ringing with a different To tag, as if the INVITE had been
+ * forked to another UAS.
+ */
+static void send_forked_ringing(pjsip_rx_data *rdata)
+{
+    const pj_str_t hname = { "Contact", 7 };
+    pjsip_tx_data *tdata;
+    pjsip_to_hdr *to;
+    pj_status_t status;
+
+    status = pjsip_endpt_create_response(app.sip_endpt, rdata, 180, NULL,
+					 &tdata);
+    if (status != PJ_SUCCESS)
+	return;
+
+    to = PJSIP_MSG_TO_HDR(tdata->msg);
+    pj_create_unique_string(tdata->pool, &to->tag);
+    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+		      pjsip_generic_string_hdr_create(tdata->pool, &hname,
+						      &app.local_contact));
+
+    pjsip_endpt_send_response2(app.sip_endpt, rdata, tdata, NULL, NULL);
+}
+
 static pj_bool_t mod_call_on_rx_request(pjsip_rx_data *rdata)
 {
     const pj_str_t call_user = { "2", 1 };
+    const pj_str_t fork_user = { "3", 1 };
     pjsip_uri *uri;
     pjsip_sip_uri *sip_uri;
     struct call *call;
@@ -474,6 +563,10 @@ static pj_bool_t mod_call_on_rx_request(pjsip_rx_data *rdata)
 	} 
     }
 
+    /* Simulate forking */
+    if (pj_strcmp(&sip_uri->user, &fork_user) == 0)
+	send_forked_ringing(rdata);
+
     /* Create UAS dialog */
     status = pjsip_dlg_create_uas_and_inc_lock( pjsip_ua_instance(), rdata,
 						&app.local_contact, &dlg);
@@ -698,11 +791,66 @@ static pjsip_module mod_test =
 
 static void report_completion(int status_code)
 {
+    pj_mutex_lock(app.client.mutex);
     app.client.job_finished++;
     if (status_code >= 200 && status_code < 800)
 	app.client.response_codes[status_code]++;
     app.client.total_responses++;
     pj_gettimeofday(&app.client.last_completion);
+    pj_mutex_unlock(app.client.mutex);
+}
+
+
+/* Get the id of the next job to submit. Returns PJ_FALSE when all jobs
+ * have been submitted.
+ */
+static pj_bool_t start_job(unsigned *job_id)
+{
+    pj_bool_t started = PJ_FALSE;
+
+    pj_mutex_lock(app.client.mutex);
+    if (app.client.job_submitted < app.client.job_count) {
+	*job_id = app.client.job_submitted++;
+	pj_get_timestamp(&app.client.send_ts[*job_id]);
+	started = PJ_TRUE;
+    }
+    pj_mutex_unlock(app.client.mutex);
+
+    return started;
+}
+
+
+/* Record the response latency of the job, only the first time. */
+static void record_latency(unsigned job_id)
+{
+    pj_timestamp now;
+
+    if (job_id >= app.client.job_count)
+	return;
+
+    pj_get_timestamp(&now);
+
+    pj_mutex_lock(app.client.mutex);
+    if (app.client.latency[job_id] == NO_LATENCY) {
+	app.client.latency[job_id] = 
+	    pj_elapsed_usec(&app.client.send_ts[job_id], &now);
+    }
+    pj_mutex_unlock(app.client.mutex);
+}
+
+
+/* The job id of stateless requests is carried in the Call-ID. */
+static pj_bool_t get_job_id(const pj_str_t *call_id, unsigned *job_id)
+{
+    pj_str_t id;
+
+    if (call_id->slen < 6 || pj_ansi_strncmp(call_id->ptr, "perf-", 5))
+	return PJ_FALSE;
+
+    id.ptr = call_id->ptr + 5;
+    id.slen = call_id->slen - 5;
+    *job_id = (unsigned) pj_strtoul(&id);
+    return PJ_TRUE;
 }
 
 
@@ -710,6 +858,10 @@ static void report_completion(int status_code)
 static pj_bool_t mod_test_on_rx_response(pjsip_rx_data *rdata)
 {
     if (pjsip_rdata_get_tsx(rdata) == NULL) {
+	unsigned job_id;
+
+	if (get_job_id(&rdata->msg_info.cid->id, &job_id))
+	    record_latency(job_id);
 	report_completion(rdata->msg_info.msg->line.status.code);
     }
 
@@ -741,6 +893,10 @@ static pj_status_t create_app(void)
     /* Create application pool for misc. */
     app.pool = pj_pool_create(&app.cp.factory, "app", 1000, 1000, NULL);
 
+    /* Protects the client statistics */
+    status = pj_mutex_create_simple(app.pool, "client", &app.client.mutex);
+    PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
+
     /* Create the endpoint: */
     status = pjsip_endpt_create(&app.cp.factory, pj_gethostname()->ptr, 
 				&app.sip_endpt);
@@ -777,13 +933,36 @@ static pj_status_t init_sip()
 	    addrname.port = app.local_port;
 
 	if (0) {
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+	} else if (app.use_tls) {
+	    pj_sockaddr_in local_addr;
+	    pjsip_tls_setting tls_opt;
+	    pjsip_tpfactory *tpfactory;
+
+	    transport_type = "tls";
+	    pjsip_tls_setting_default(&tls_opt);
+	    tls_opt.cert_file = app.tls_cert;
+	    tls_opt.privkey_file = app.tls_key;
+	    pj_sockaddr_in_init(&local_addr, 
+				(app.local_addr.slen ? &app.local_addr : NULL),
+				(pj_uint16_t)app.local_port);
+	    status = pjsip_tls_transport_start(app.sip_endpt, &tls_opt,
+					       &local_addr, NULL,
+					       app.thread_count, &tpfactory);
+	    if (status == PJ_SUCCESS) {
+		app.local_addr = tpfactory->addr_name.host;
+		app.local_port = tpfactory->addr_name.port;
+	    }
+#endif
 #if defined(PJ_HAS_TCP) && PJ_HAS_TCP!=0
 	} else if (app.use_tcp) {
 	    pj_sockaddr_in local_addr;
 	    pjsip_tpfactory *tpfactory;
 	    
 	    transport_type = "tcp";
-	    pj_sockaddr_in_init(&local_addr, 0, (pj_uint16_t)app.local_port);
+	    pj_sockaddr_in_init(&local_addr, 
+				(app.local_addr.slen ? &app.local_addr : NULL),
+				(pj_uint16_t)app.local_port);
 	    status = pjsip_tcp_transport_start(app.sip_endpt, &local_addr,
 					       app.thread_count, &tpfactory);
 	    if (status == PJ_SUCCESS) {
@@ -818,6 +997,7 @@ static pj_status_t init_sip()
 					     transport_type);
 
 	app.local_contact = app.local_uri;
+	app.tp_name = transport_type;
     }
 
     /* 
@@ -899,6 +1079,11 @@ static void destroy_app()
 	app.sip_endpt = NULL;
     }
 
+    if (app.client.mutex) {
+	pj_mutex_destroy(app.client.mutex);
+	app.client.mutex = NULL;
+    }
+
     if (app.pool) {
 	pj_pool_release(app.pool);
 	app.pool = NULL;
@@ -987,6 +1172,8 @@ static void call_on_media_update( pjsip_inv_session *inv,
 static void call_on_state_changed( pjsip_inv_session *inv, 
 				   pjsip_event *e)
 {
+    struct call *call;
+
     PJ_UNUSED_ARG(e);
 
     /* Bail out if the session has been counted before */
@@ -997,10 +1184,15 @@ static void call_on_state_changed( pjsip_inv_session *inv,
     if (inv->role != PJSIP_UAC_ROLE)
 	return;
 
+    call = (struct call*) inv->dlg->mod_data[mod_test.id];
+
     if (inv->state == PJSIP_INV_STATE_CONFIRMED) {
 	pjsip_tx_data *tdata;
 	pj_status_t status;
 
+	if (call)
+	    record_latency(call->job_id);
+
 	//report_completion(200);
 	//inv->mod_data[mod_test.id] = (void*)1;
 
@@ -1009,6 +1201,8 @@ static void call_on_state_changed( pjsip_inv_session *inv,
 	    status = pjsip_inv_send_msg(inv, tdata);
 
     } else if (inv->state == PJSIP_INV_STATE_DISCONNECTED) {
+	if (call)
+	    record_latency(call->job_id);
 	report_completion(inv->cause);
 	inv->mod_data[mod_test.id] = (void*)(pj_ssize_t)1;
     }
@@ -1027,7 +1221,7 @@ static void call_on_forked(pjsip_inv_session *inv, pjsip_event *e)
 /*
  * Make outgoing call.
  */
-static pj_status_t make_call(const pj_str_t *dst_uri)
+static pj_status_t make_call(const pj_str_t *dst_uri, unsigned job_id)
 {
     struct call *call;
     pjsip_dialog *dlg;
@@ -1049,6 +1243,8 @@ static pj_status_t make_call(const pj_str_t *dst_uri)
 
     /* Create call */
     call = pj_pool_zalloc(dlg->pool, sizeof(struct call));
+    call->job_id = job_id;
+    dlg->mod_data[mod_test.id] = call;
 
     /* Create SDP */
     if (app.real_sdp) {
@@ -1119,15 +1315,24 @@ static pj_status_t verify_sip_url(const char *c_url)
 
 static void usage(void)
 {
+    unsigned i;
+
     printf(
 	"Usage:\n"
 	"   pjsip-perf [OPTIONS]        -- to start as server\n"
 	"   pjsip-perf [OPTIONS] URL    -- to call server (possibly itself)\n"
+	"   pjsip-perf --scenario=NAME [OPTIONS]\n"
+	"                               -- to run scenario against itself\n"
 	"\n"
 	"where:\n"
 	"   URL                     The SIP URL to be contacted.\n"
 	"\n"
 	"Client options:\n"
+	"   --scenario=NAME         Run predefined scenario (see below), or \"all\"\n"
+	"                           to run all of them. Without URL, the scenario\n"
+	"                           runs on loopback against the built-in server\n"
+	"   --json=FILE             Append results as JSON line to FILE (\"-\" for\n"
+	"                           stdout)\n"
 	"   --method=METHOD, -m     Set test method (set to INVITE for call benchmark)\n"
         "                           [default: OPTIONS]\n"
 	"   --count=N, -n           Set total number of requests to initiate\n"
@@ -1146,7 +1351,11 @@ static void usage(void)
 	"   --use-tcp, -T           Use TCP instead of UDP. Note that when started as\n"
 	"                           client, you must add ;transport=tcp parameter to URL\n"
 	"                           [default: no]\n"
-	"   --thread-count=N        Set number of worker threads [default=1]\n"
+	"   --use-tls               Use TLS instead of UDP [default: no]\n"
+	"   --tls-cert=FILE         TLS certificate file (server)\n"
+	"   --tls-key=FILE          TLS private key file (server)\n"
+	"   --thread-count=N        Set number of worker threads, also the number of\n"
+	"                           client threads submitting jobs [default=1]\n"
 	"   --trying                Send 100/Trying response (server, default no)\n"
 	"   --ringing               Send 180/Ringing response (server, default no)\n"
 	"   --delay=MS, -d          Delay answering call by MS (server, default no)\n"
@@ -1158,8 +1367,16 @@ static void usage(void)
 	"When started as server, pjsip-perf can be contacted on the following URIs:\n"
 	"   - sip:0@server-addr     To handle requests statelessly.\n"
 	"   - sip:1@server-addr     To handle requests statefully.\n"
-	"   - sip:2@server-addr     To handle INVITE call.\n",
+	"   - sip:2@server-addr     To handle INVITE call.\n"
+	"   - sip:3@server-addr     To handle INVITE call with forked 180.\n"
+	"\n"
+	"Scenarios:\n",
 	DEFAULT_COUNT, JOB_WINDOW);
+
+    for (i=0; i<PJ_ARRAY_SIZE(scenarios); ++i) {
+	printf("   %-23s %s to sip:%s@server-addr\n", scenarios[i].name,
+	       scenarios[i].desc, scenarios[i].user);
+    }
 }
 
 
@@ -1172,7 +1389,8 @@ static int my_atoi(const char *s)
 
 static pj_status_t init_options(int argc, char *argv[])
 {
-    enum { OPT_THREAD_COUNT = 1, OPT_REAL_SDP, OPT_TRYING, OPT_RINGING };
+    enum { OPT_THREAD_COUNT = 1, OPT_REAL_SDP, OPT_TRYING, OPT_RINGING,
+	   OPT_SCENARIO, OPT_JSON, OPT_USE_TLS, OPT_TLS_CERT, OPT_TLS_KEY };
     struct pj_getopt_option long_options[] = {
 	{ "local-port",	    1, 0, 'p' },
 	{ "count",	    1, 0, 'c' },
@@ -1188,6 +1406,11 @@ static pj_status_t init_options(int argc, char *argv[])
 	{ "delay",	    1, 0, 'd' },
 	{ "trying",	    0, 0, OPT_TRYING},
 	{ "ringing",	    0, 0, OPT_RINGING},
+	{ "scenario",	    1, 0, OPT_SCENARIO},
+	{ "json",	    1, 0, OPT_JSON},
+	{ "use-tls",	    0, 0, OPT_USE_TLS},
+	{ "tls-cert",	    1, 0, OPT_TLS_CERT},
+	{ "tls-key",	    1, 0, OPT_TLS_KEY},
 	{ NULL, 0, 0, 0 },
     };
     int c;
@@ -1294,6 +1517,46 @@ static pj_status_t init_options(int argc, char *argv[])
 	    app.server.send_ringing = 1;
 	    break;
 
+	case OPT_SCENARIO:
+	    {
+		unsigned i;
+
+		app.client.scen_cnt = 0;
+		for (i=0; i<PJ_ARRAY_SIZE(scenarios); ++i) {
+		    if (pj_ansi_strcmp(pj_optarg, "all") == 0 ||
+			pj_ansi_strcmp(pj_optarg, scenarios[i].name) == 0)
+		    {
+			app.client.scen[app.client.scen_cnt++] = &scenarios[i];
+		    }
+		}
+		if (app.client.scen_cnt == 0) {
+		    PJ_LOG(1,(THIS_FILE, "Invalid --scenario %s", pj_optarg));
+		    return -1;
+		}
+	    }
+	    break;
+
+	case OPT_JSON:
+	    app.client.json_file = pj_optarg;
+	    break;
+
+	case OPT_USE_TLS:
+#if defined(PJSIP_HAS_TLS_TRANSPORT) && PJSIP_HAS_TLS_TRANSPORT!=0
+	    app.use_tls = PJ_TRUE;
+	    break;
+#else
+	    PJ_LOG(1,(THIS_FILE, "Error: TLS is not supported in this build"));
+	    return -1;
+#endif
+
+	case OPT_TLS_CERT:
+	    app.tls_cert = pj_str(pj_optarg);
+	    break;
+
+	case OPT_TLS_KEY:
+	    app.tls_key = pj_str(pj_optarg);
+	    break;
+
 	default:
 	    PJ_LOG(1,(THIS_FILE, 
 		      "Invalid argument. Use --help to see help"));
@@ -1318,20 +1581,52 @@ static pj_status_t init_options(int argc, char *argv[])
 	return -1;
     }
 
+    /* Without URL, scenarios are run against ourselves on loopback */
+    if (app.client.scen_cnt && app.client.dst_uri.slen == 0) {
+	app.client.loopback = PJ_TRUE;
+	app.local_addr = pj_str("127.0.0.1");
+    }
+
     return 0;
 }
 
 
-/* Send one stateless request */
-static pj_status_t submit_stateless_job(void)
+/* Create the request of the job */
+static pj_status_t create_job_request(unsigned job_id, pjsip_tx_data **p_tdata)
 {
-    pjsip_tx_data *tdata;
+    char call_id_buf[48];
+    pj_str_t call_id;
     pj_status_t status;
 
+    /* Call-ID must be unique across runs, and it carries the job id */
+    call_id.ptr = call_id_buf;
+    call_id.slen = pj_ansi_snprintf(call_id_buf, sizeof(call_id_buf),
+				    "perf-%u-%08x%08x", job_id,
+				    pj_rand(), pj_rand());
+
     status = pjsip_endpt_create_request(app.sip_endpt, &app.client.method, 
 					&app.client.dst_uri, &app.local_uri,
 					&app.client.dst_uri, &app.local_contact,
-					NULL, -1, NULL, &tdata);
+					&call_id, -1, NULL, p_tdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    if (app.client.method.id == PJSIP_REGISTER_METHOD) {
+	pjsip_msg_add_hdr((*p_tdata)->msg, (pjsip_hdr*)
+			  pjsip_expires_hdr_create((*p_tdata)->pool, 300));
+    }
+
+    return PJ_SUCCESS;
+}
+
+
+/* Send one stateless request */
+static pj_status_t submit_stateless_job(unsigned job_id)
+{
+    pjsip_tx_data *tdata;
+    pj_status_t status;
+
+    status = create_job_request(job_id, &tdata);
     if (status != PJ_SUCCESS) {
 	app_perror(THIS_FILE, "Error creating request", status);
 	report_completion(701);
@@ -1356,8 +1651,6 @@ static void tsx_completion_cb(void *token, pjsip_event *event)
 {
     pjsip_transaction *tsx;
 
-    PJ_UNUSED_ARG(token);
-
     if (event->type != PJSIP_EVENT_TSX_STATE)
 	return;
 
@@ -1369,17 +1662,20 @@ static void tsx_completion_cb(void *token, pjsip_event *event)
     }
 
     if (tsx->state==PJSIP_TSX_STATE_TERMINATED) {
+	record_latency((unsigned)(pj_ssize_t)token);
 	report_completion(tsx->status_code);
 	tsx->mod_data[mod_test.id] = (void*)(pj_ssize_t)1;
     }
     else if (tsx->method.id == PJSIP_INVITE_METHOD &&
 	     tsx->state == PJSIP_TSX_STATE_CONFIRMED) {
 
+	record_latency((unsigned)(pj_ssize_t)token);
 	report_completion(tsx->status_code);
 	tsx->mod_data[mod_test.id] = (void*)(pj_ssize_t)1;
 	
     } else if (tsx->state == PJSIP_TSX_STATE_COMPLETED) {
 
+	record_latency((unsigned)(pj_ssize_t)token);
 	report_completion(tsx->status_code);
 	tsx->mod_data[mod_test.id] = (void*)(pj_ssize_t)1;
 
@@ -1389,22 +1685,20 @@ static void tsx_completion_cb(void *token, pjsip_event *event)
 
 
 /* Send one stateful request */
-static pj_status_t submit_job(void)
+static pj_status_t submit_job(unsigned job_id)
 {
     pjsip_tx_data *tdata;
     pj_status_t status;
 
-    status = pjsip_endpt_create_request(app.sip_endpt, &app.client.method, 
-					&app.client.dst_uri, &app.local_uri,
-					&app.client.dst_uri, &app.local_contact,
-					NULL, -1, NULL, &tdata);
+    status = create_job_request(job_id, &tdata);
     if (status != PJ_SUCCESS) {
 	app_perror(THIS_FILE, "Error creating request", status);
 	report_completion(701);
 	return status;
     }
 
-    status = pjsip_endpt_send_request(app.sip_endpt, tdata, -1, NULL, 
+    status = pjsip_endpt_send_request(app.sip_endpt, tdata, -1, 
+				      (void*)(pj_ssize_t)job_id,
 				      &tsx_completion_cb);
     if (status != PJ_SUCCESS) {
 	app_perror(THIS_FILE, "Error sending stateful request", status);
@@ -1438,7 +1732,7 @@ static int client_thread(void *arg)
     /* Submit all jobs */
     while (app.client.job_submitted < app.client.job_count && !app.thread_quit){
 	pj_time_val timeout = { 0, 1 };
-	unsigned i;
+	unsigned i, job_id;
 	int outstanding;
 	pj_status_t status;
 
@@ -1468,16 +1762,18 @@ static int client_thread(void *arg)
 
 
 	/* Submit one job */
+	if (!start_job(&job_id))
+	    break;
+
 	if (app.client.method.id == PJSIP_INVITE_METHOD) {
-	    status = make_call(&app.client.dst_uri);
+	    status = make_call(&app.client.dst_uri, job_id);
 	} else if (app.client.stateless) {
-	    status = submit_stateless_job();
+	    status = submit_stateless_job(job_id);
 	} else {
-	    status = submit_job();
+	    status = submit_job(job_id);
 	}
 	PJ_UNUSED_ARG(status);
 
-	++app.client.job_submitted;
 	++cycle;
 
 	/* Handle event */
@@ -1534,6 +1830,9 @@ static int client_thread(void *arg)
 	pj_gettimeofday(&now);
     }
 
+    if (thread_index == 0)
+	app.client.cpu_end = clock();
+
     /* Wait couple of seconds to let jobs completes (e.g. ACKs to be sent)  */
     pj_gettimeofday(&now);
     end_time = now;
@@ -1647,10 +1946,329 @@ static void write_report(const char *msg)
 }
 
 
-int main(int argc, char *argv[])
+/* Latency distribution of the completed jobs */
+typedef struct latency_stat
+{
+    unsigned	    cnt;
+    pj_uint32_t	    min, max, avg;
+    pj_uint32_t	    p50, p99, p999;
+    unsigned	    hist[LATENCY_BUCKETS];
+} latency_stat;
+
+static int cmp_latency(const void *a, const void *b)
+{
+    pj_uint32_t la = *(const pj_uint32_t*)a;
+    pj_uint32_t lb = *(const pj_uint32_t*)b;
+
+    return (la < lb) ? -1 : (la > lb ? 1 : 0);
+}
+
+/* Calculate the latency distribution. This compacts and sorts the
+ * latency array, so it must only be called after the run.
+ */
+static void calc_latency(latency_stat *st)
+{
+    pj_uint32_t *lat = app.client.latency;
+    pj_uint64_t total = 0;
+    unsigned i, cnt = 0;
+
+    pj_bzero(st, sizeof(*st));
+
+    /* Skip jobs that have not completed */
+    for (i=0; i<app.client.job_submitted; ++i) {
+	if (lat[i] != NO_LATENCY)
+	    lat[cnt++] = lat[i];
+    }
+    if (cnt == 0)
+	return;
+
+    qsort(lat, cnt, sizeof(lat[0]), &cmp_latency);
+
+    /* Bucket i holds latencies below 2^(i+1) usec */
+    for (i=0; i<cnt; ++i) {
+	unsigned b = 0;
+
+	while (b < LATENCY_BUCKETS-1 && (lat[i] >> (b+1)) != 0)
+	    ++b;
+	st->hist[b]++;
+	total += lat[i];
+    }
+
+    st->cnt = cnt;
+    st->min = lat[0];
+    st->max = lat[cnt-1];
+    st->avg = (pj_uint32_t)(total / cnt);
+    st->p50 = lat[(pj_uint64_t)cnt * 500 / 1000];
+    st->p99 = lat[(pj_uint64_t)cnt * 990 / 1000];
+    st->p999 = lat[(pj_uint64_t)cnt * 999 / 1000];
+}
+
+/* Append the result of the run to the JSON file, one object per line. */
+static void write_json(const scenario *scen, unsigned msec_res,
+		       const latency_stat *lat, unsigned cpu_usec)
+{
+    pj_time_val now;
+    FILE *f;
+    unsigned i;
+    const char *sep;
+
+    if (!app.client.json_file)
+	return;
+
+    if (pj_ansi_strcmp(app.client.json_file, "-") == 0) {
+	f = stdout;
+    } else {
+	f = fopen(app.client.json_file, "a");
+	if (!f) {
+	    PJ_LOG(1,(THIS_FILE, "Unable to open %s", app.client.json_file));
+	    return;
+	}
+    }
+
+    pj_gettimeofday(&now);
+
+    fprintf(f, "{\"tool\":\"pjsip-perf\",\"version\":\"%s\",\"time\":%ld,"
+	       "\"scenario\":\"%s\",\"method\":\"%.*s\",\"stateless\":%s,"
+	       "\"transport\":\"%s\",\"threads\":%u,\"window\":%u,"
+	       "\"count\":%u,\"submitted\":%u,\"completed\":%u,"
+	       "\"duration_ms\":%u,\"rate\":%u,\"cpu_usec_per_job\":%u,",
+	    PJ_VERSION, (long)now.sec,
+	    (scen ? scen->name : "custom"),
+	    (int)app.client.method.name.slen, app.client.method.name.ptr,
+	    (app.client.stateless ? "true" : "false"),
+	    app.tp_name, app.thread_count, app.client.job_window,
+	    app.client.job_count, app.client.job_submitted,
+	    app.client.job_finished, msec_res,
+	    (unsigned)((pj_uint64_t)app.client.total_responses*1000/msec_res),
+	    cpu_usec);
+
+    fprintf(f, "\"responses\":{");
+    for (i=0, sep=""; i<PJ_ARRAY_SIZE(app.client.response_codes); ++i) {
+	if (app.client.response_codes[i] == 0)
+	    continue;
+	fprintf(f, "%s\"%u\":%u", sep, i, app.client.response_codes[i]);
+	sep = ",";
+    }
+
+    fprintf(f, "},\"latency_usec\":{\"count\":%u,\"min\":%u,\"avg\":%u,"
+	       "\"p50\":%u,\"p99\":%u,\"p999\":%u,\"max\":%u},",
+	    lat->cnt, lat->min, lat->avg, lat->p50, lat->p99, lat->p999,
+	    lat->max);
+
+    fprintf(f, "\"histogram\":[");
+    for (i=0, sep=""; i<LATENCY_BUCKETS; ++i) {
+	if (lat->hist[i] == 0)
+	    continue;
+	fprintf(f, "%s[%lu,%u]", sep, (unsigned long)2 << i, lat->hist[i]);
+	sep = ",";
+    }
+    fprintf(f, "]}\n");
+
+    if (f == stdout)
+	fflush(f);
+    else
+	fclose(f);
+}
+
+/* Reset the client state before a run */
+static void reset_client(void)
+{
+    unsigned i;
+
+    app.client.job_submitted = 0;
+    app.client.job_finished = 0;
+    app.client.stat_max_window = 0;
+    app.client.total_responses = 0;
+    pj_bzero(&app.client.first_request, sizeof(pj_time_val));
+    pj_bzero(&app.client.requests_sent, sizeof(pj_time_val));
+    pj_bzero(&app.client.last_completion, sizeof(pj_time_val));
+    pj_bzero(app.client.response_codes, sizeof(app.client.response_codes));
+
+    for (i=0; i<app.client.job_count; ++i)
+	app.client.latency[i] = NO_LATENCY;
+
+    app.client.cpu_start = app.client.cpu_end = clock();
+}
+
+/* Set up the client to run the scenario */
+static void setup_scenario(const scenario *scen)
+{
+    pj_str_t method = pj_str((char*)scen->method);
+
+    pjsip_method_init_np(&app.client.method, &method);
+    app.client.stateless = scen->stateless;
+
+    if (app.client.loopback) {
+	enum { URI_LEN = 128 };
+	char *uri = (char*) pj_pool_alloc(app.pool, URI_LEN);
+
+	app.client.dst_uri.ptr = uri;
+	app.client.dst_uri.slen = pj_ansi_snprintf(uri, URI_LEN,
+					"sip:%s@%.*s:%d;transport=%s",
+					scen->user,
+					(int)app.local_addr.slen,
+					app.local_addr.ptr,
+					app.local_port, app.tp_name);
+    }
+}
+
+/* Run the client and print the report */
+static int run_client(const scenario *scen)
 {
     static char report[1024];
+    char test_type[64];
+    unsigned msec_req, msec_res, cpu_usec;
+    latency_stat lat;
+    pj_status_t status;
+    unsigned i;
+
+    reset_client();
+
+    /* Get the job name */
+    if (app.client.method.id == PJSIP_INVITE_METHOD) {
+	pj_ansi_strcpy(test_type, "INVITE calls");
+    } else if (app.client.stateless) {
+	pj_ansi_sprintf(test_type, "stateless %.*s requests",
+			(int)app.client.method.name.slen,
+			app.client.method.name.ptr);
+    } else {
+	pj_ansi_sprintf(test_type, "stateful %.*s requests",
+			(int)app.client.method.name.slen,
+			app.client.method.name.ptr);
+    }
+
+    if (scen) {
+	printf("Running scenario %s: %s\n", scen->name, scen->desc);
+    }
+
+    printf("Sending %d %s to '%.*s' with %d maximum outstanding jobs, please wait..\n", 
+	      app.client.job_count, test_type,
+	      (int)app.client.dst_uri.slen, app.client.dst_uri.ptr,
+	      app.client.job_window);
+
+    for (i=0; i<app.thread_count; ++i) {
+	status = pj_thread_create(app.pool, NULL, &client_thread, 
+				  (void*)(pj_ssize_t)i, 0, 0, 
+				  &app.thread[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror(THIS_FILE, "Unable to create thread", status);
+	    return 1;
+	}
+    }
+
+    for (i=0; i<app.thread_count; ++i) {
+	pj_thread_join(app.thread[i]);
+	pj_thread_destroy(app.thread[i]);
+	app.thread[i] = NULL;
+    }
+
+    if (app.client.last_completion.sec) {
+	pj_time_val duration;
+	duration = app.client.last_completion;
+	PJ_TIME_VAL_SUB(duration, app.client.first_request);
+	msec_res = PJ_TIME_VAL_MSEC(duration);
+    } else {
+	msec_res = app.client.timeout * 1000;
+    }
+
+    if (msec_res == 0) msec_res = 1;
+
+    if (app.client.requests_sent.sec) {
+	pj_time_val duration;
+	duration = app.client.requests_sent;
+	PJ_TIME_VAL_SUB(duration, app.client.first_request);
+	msec_req = PJ_TIME_VAL_MSEC(duration);
+    } else {
+	msec_req = app.client.timeout * 1000;
+    }
+
+    if (msec_req == 0) msec_req = 1;
+
+    if (app.client.job_submitted < app.client.job_count)
+	puts("\ntimed-out!\n");
+    else
+	puts("\ndone.\n");
+
+    pj_ansi_snprintf(
+	report, sizeof(report),
+	"Total %d %s sent in %d ms at rate of %d/sec\n"
+	"Total %d responses receieved in %d ms at rate of %d/sec:",
+	app.client.job_submitted, test_type, msec_req, 
+	app.client.job_submitted * 1000 / msec_req,
+	app.client.total_responses, msec_res,
+	app.client.total_responses*1000/msec_res);
+    write_report(report);
+
+    /* Print detailed response code received */
+    pj_ansi_sprintf(report, "\nDetailed responses received:");
+    write_report(report);
 
+    for (i=0; i<PJ_ARRAY_SIZE(app.client.response_codes); ++i) {
+	const pj_str_t *reason;
+
+	if (app.client.response_codes[i] == 0)
+	    continue;
+
+	reason = pjsip_get_status_text(i);
+	pj_ansi_snprintf( report, sizeof(report),
+			  " - %d responses:  %7d     (%.*s)",
+			  i, app.client.response_codes[i],
+			  (int)reason->slen, reason->ptr);
+	write_report(report);
+    }
+
+    /* Total responses and rate */
+    pj_ansi_snprintf( report, sizeof(report),
+	"                    ------\n"
+	" TOTAL responses:  %7d (rate=%d/sec)\n",
+	app.client.total_responses, 
+	app.client.total_responses*1000/msec_res);
+
+    write_report(report);
+
+    pj_ansi_sprintf(report, "Maximum outstanding job: %d", 
+		    app.client.stat_max_window);
+    write_report(report);
+
+    /* Response latency */
+    calc_latency(&lat);
+    pj_ansi_snprintf(report, sizeof(report),
+		     "Response latency (usec): min=%u avg=%u p50=%u p99=%u "
+		     "p999=%u max=%u",
+		     lat.min, lat.avg, lat.p50, lat.p99, lat.p999, lat.max);
+    write_report(report);
+
+    for (i=0; i<LATENCY_BUCKETS; ++i) {
+	if (lat.hist[i] == 0)
+	    continue;
+	pj_ansi_snprintf(report, sizeof(report),
+			 " - below %10lu usec: %7u (%u%%)",
+			 (unsigned long)2 << i, lat.hist[i],
+			 (unsigned)((pj_uint64_t)lat.hist[i] * 100 / lat.cnt));
+	write_report(report);
+    }
+
+    /* CPU time of the whole process, including the server part when
+     * running on loopback.
+     */
+    cpu_usec = 0;
+    if (app.client.job_finished) {
+	cpu_usec = (unsigned)((double)(app.client.cpu_end - 
+				       app.client.cpu_start) * 1000000 /
+			      CLOCKS_PER_SEC / app.client.job_finished);
+    }
+    pj_ansi_snprintf(report, sizeof(report), "CPU time per job: %u usec\n",
+		     cpu_usec);
+    write_report(report);
+
+    write_json(scen, msec_res, &lat, cpu_usec);
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
     printf("PJSIP Performance Measurement Tool v%s\n"
            "(c)2006 pjsip.org\n\n",
 	   PJ_VERSION);
@@ -1688,116 +2306,28 @@ int main(int argc, char *argv[])
 
 
 
-    if (app.client.dst_uri.slen) {
+    if (app.client.dst_uri.slen || app.client.scen_cnt) {
 	/* Client mode */
-	pj_status_t status;
-	char test_type[64];
-	unsigned msec_req, msec_res;
 	unsigned i;
 
-	/* Get the job name */
-	if (app.client.method.id == PJSIP_INVITE_METHOD) {
-	    pj_ansi_strcpy(test_type, "INVITE calls");
-	} else if (app.client.stateless) {
-	    pj_ansi_sprintf(test_type, "stateless %.*s requests",
-			    (int)app.client.method.name.slen,
-			    app.client.method.name.ptr);
-	} else {
-	    pj_ansi_sprintf(test_type, "stateful %.*s requests",
-			    (int)app.client.method.name.slen,
-			    app.client.method.name.ptr);
-	}
-	
-
-	printf("Sending %d %s to '%.*s' with %d maximum outstanding jobs, please wait..\n", 
-		  app.client.job_count, test_type,
-		  (int)app.client.dst_uri.slen, app.client.dst_uri.ptr,
-		  app.client.job_window);
+	app.client.send_ts = (pj_timestamp*)
+	    pj_pool_calloc(app.pool, app.client.job_count, 
+			   sizeof(pj_timestamp));
+	app.client.latency = (pj_uint32_t*)
+	    pj_pool_calloc(app.pool, app.client.job_count, 
+			   sizeof(pj_uint32_t));
 
-	for (i=0; i<app.thread_count; ++i) {
-	    status = pj_thread_create(app.pool, NULL, &client_thread, 
-				      (void*)(pj_ssize_t)i, 0, 0, 
-				      &app.thread[i]);
-	    if (status != PJ_SUCCESS) {
-		app_perror(THIS_FILE, "Unable to create thread", status);
+	if (app.client.scen_cnt == 0) {
+	    if (run_client(NULL) != 0)
 		return 1;
-	    }
-	}
-
-	for (i=0; i<app.thread_count; ++i) {
-	    pj_thread_join(app.thread[i]);
-	    app.thread[i] = NULL;
 	}
 
-	if (app.client.last_completion.sec) {
-	    pj_time_val duration;
-	    duration = app.client.last_completion;
-	    PJ_TIME_VAL_SUB(duration, app.client.first_request);
-	    msec_res = PJ_TIME_VAL_MSEC(duration);
-	} else {
-	    msec_res = app.client.timeout * 1000;
-	}
-
-	if (msec_res == 0) msec_res = 1;
-
-	if (app.client.requests_sent.sec) {
-	    pj_time_val duration;
-	    duration = app.client.requests_sent;
-	    PJ_TIME_VAL_SUB(duration, app.client.first_request);
-	    msec_req = PJ_TIME_VAL_MSEC(duration);
-	} else {
-	    msec_req = app.client.timeout * 1000;
-	}
-
-	if (msec_req == 0) msec_req = 1;
-
-	if (app.client.job_submitted < app.client.job_count)
-	    puts("\ntimed-out!\n");
-	else
-	    puts("\ndone.\n");
-
-	pj_ansi_snprintf(
-	    report, sizeof(report),
-	    "Total %d %s sent in %d ms at rate of %d/sec\n"
-	    "Total %d responses receieved in %d ms at rate of %d/sec:",
-	    app.client.job_submitted, test_type, msec_req, 
-	    app.client.job_submitted * 1000 / msec_req,
-	    app.client.total_responses, msec_res,
-	    app.client.total_responses*1000/msec_res);
-	write_report(report);
-
-	/* Print detailed response code received */
-	pj_ansi_sprintf(report, "\nDetailed responses received:");
-	write_report(report);
-
-	for (i=0; i<PJ_ARRAY_SIZE(app.client.response_codes); ++i) {
-	    const pj_str_t *reason;
-
-	    if (app.client.response_codes[i] == 0)
-		continue;
-
-	    reason = pjsip_get_status_text(i);
-	    pj_ansi_snprintf( report, sizeof(report),
-			      " - %d responses:  %7d     (%.*s)",
-			      i, app.client.response_codes[i],
-			      (int)reason->slen, reason->ptr);
-	    write_report(report);
+	for (i=0; i<app.client.scen_cnt; ++i) {
+	    setup_scenario(app.client.scen[i]);
+	    if (run_client(app.client.scen[i]) != 0)
+		return 1;
 	}
 
-	/* Total responses and rate */
-	pj_ansi_snprintf( report, sizeof(report),
-	    "                    ------\n"
-	    " TOTAL responses:  %7d (rate=%d/sec)\n",
-	    app.client.total_responses, 
-	    app.client.total_responses*1000/msec_res);
-
-	write_report(report);
-
-	pj_ansi_sprintf(report, "Maximum outstanding job: %d", 
-			app.client.stat_max_window);
-	write_report(report);
-
-
     } else {
 	/* Server mode */
 	char s[10], *unused;
@@ -1807,21 +2337,26 @@ int main(int argc, char *argv[])
 	puts("pjsip-perf started in server-mode");
 
 	printf("Receiving requests on the following URIs:\n"
-	       "  sip:0@%.*s:%d%s    for stateless handling\n"
-	       "  sip:1@%.*s:%d%s    for stateful handling\n"
-	       "  sip:2@%.*s:%d%s    for call handling\n",
+	       "  sip:0@%.*s:%d;transport=%s    for stateless handling\n"
+	       "  sip:1@%.*s:%d;transport=%s    for stateful handling\n"
+	       "  sip:2@%.*s:%d;transport=%s    for call handling\n"
+	       "  sip:3@%.*s:%d;transport=%s    for forked call handling\n",
+	       (int)app.local_addr.slen,
+	       app.local_addr.ptr,
+	       app.local_port,
+	       app.tp_name,
 	       (int)app.local_addr.slen,
 	       app.local_addr.ptr,
 	       app.local_port,
-	       (app.use_tcp ? ";transport=tcp" : ""),
+	       app.tp_name,
 	       (int)app.local_addr.slen,
 	       app.local_addr.ptr,
 	       app.local_port,
-	       (app.use_tcp ? ";transport=tcp" : ""),
+	       app.tp_name,
 	       (int)app.local_addr.slen,
 	       app.local_addr.ptr,
 	       app.local_port,
-	       (app.use_tcp ? ";transport=tcp" : ""));
+	       app.tp_name);
 	printf("INVITE with non-matching user part will be handled call-statefully\n");
 
 	for (i=0; i<app.thread_count; ++i) {
@@ -157,13 +157,43 @@ typedef struct pjsip_cfg_t
 	 */
 	pj_bool_t disable_secure_dlg_check;
 
+	/**
+	 * Number of worker threads to run the module callbacks for incoming
+	 * messages. When this is non-zero, the thread that reads a message
+	 * from the transport only parses it and queues it, and the message
+	 * is processed by the modules in one of the worker threads, so slow
+	 * application callbacks don't stall reading from the sockets.
+	 * Messages with the same Call-ID are always processed by the same
+	 * worker, in the order they were received. When this is zero, the
+	 * message is processed by the thread that reads it.
+	 *
+	 * This setting is read when the endpoint is created, use
+	 * #pjsip_endpt_set_rx_worker_cnt() to change it afterwards.
+	 *
+	 * Default is PJSIP_RX_WORKER_CNT.
+	 */
+	unsigned rx_worker_cnt;
+
+	/**
+	 * Parse incoming messages in lazy mode, where only the headers that
+	 * the stack needs for every message (such as Via, From, To, Call-ID,
+	 * CSeq, Route and Record-Route) are parsed when the message is
+	 * received, and the other headers are parsed when they are first
+	 * looked up with #pjsip_msg_find_hdr() and friends. This saves
+	 * parsing time for proxies and B2BUAs that only look at few headers
+	 * of each message. See #pjsip_lazy_hdr for more info.
+	 *
+	 * Default is PJSIP_LAZY_HDR_PARSE.
+	 */
+	pj_bool_t lazy_hdr_parse;
+
     } endpt;
 
     /** Transaction layer settings. */
     struct {
 
-	/** Maximum number of transactions. The value is initialized with
-	 *  PJSIP_MAX_TSX_COUNT
+	/** Initial number of buckets of the transaction table, which grows
+	 *  as needed. The value is initialized with PJSIP_MAX_TSX_COUNT
 	 */
 	unsigned max_count;
 
@@ -272,9 +302,10 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 
 
 /**
- * Specify maximum transaction count in transaction hash table.
- * For efficiency, the value should be 2^n-1 since it will be
- * rounded up to 2^n.
+ * Specify the initial number of buckets of the transaction hash table.
+ * The table grows as needed when there are more transactions, so this
+ * is not a hard limit. For efficiency, the value should be 2^n-1 since
+ * it will be rounded up to 2^n.
  *
  * Default value is 1023
  */
@@ -283,9 +314,24 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 /**
- * Specify maximum number of dialogs in the dialog hash table.
- * For efficiency, the value should be 2^n-1 since it will be
- * rounded up to 2^n.
+ * Specify the number of lock stripes of the transaction hash table. The
+ * table is split into this many independent hash tables, each protected
+ * by its own mutex and selected by the hash value of the transaction key,
+ * so that transaction lookup, registration, and unregistration in
+ * different threads don't contend on a single mutex. Set to 1 to use a
+ * single table.
+ *
+ * Default value is 16
+ */
+#ifndef PJSIP_TSX_LAYER_LOCK_STRIPES
+#   define PJSIP_TSX_LAYER_LOCK_STRIPES	16
+#endif
+
+/**
+ * Specify the initial number of buckets of the dialog hash table. The
+ * table grows as needed when there are more dialogs, so this is not a
+ * hard limit. For efficiency, the value should be 2^n-1 since it will
+ * be rounded up to 2^n.
  *
  * Default value is 511.
  */
@@ -304,6 +350,75 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the number of shards of the endpoint's ioqueue. When this is
+ * greater than one, the transports are spread among the shards, and
+ * threads calling #pjsip_endpt_handle_events() can be bound to a shard
+ * with #pj_ioqueue_set_thread_shard() so that each transport is always
+ * serviced by the same thread. Threads which are not bound to any shard
+ * poll all shards. See #pj_ioqueue_create_sharded().
+ *
+ * Default value is 1 (no sharding).
+ */
+#ifndef PJSIP_IOQUEUE_SHARD_CNT
+#   define PJSIP_IOQUEUE_SHARD_CNT	1
+#endif
+
+
+/**
+ * Specify the number of shards of the endpoint's timer heap. When this is
+ * greater than one, each shard has its own lock, and threads calling
+ * #pjsip_endpt_handle_events() can be bound to a shard with
+ * #pj_timer_heap_set_thread_shard() so that they only schedule and expire
+ * the timers of their own shard, instead of contending on a single timer
+ * heap lock. Threads which are not bound to any shard poll all shards.
+ * See #pj_timer_heap_create_sharded().
+ *
+ * Default value is 1 (no sharding).
+ */
+#ifndef PJSIP_TIMER_HEAP_SHARD_CNT
+#   define PJSIP_TIMER_HEAP_SHARD_CNT	1
+#endif
+
+
+/**
+ * Specify the default number of worker threads that run the module
+ * callbacks for incoming messages. See \a rx_worker_cnt in
+ * #pjsip_cfg_t.
+ *
+ * Default value is 0 (messages are processed by the receiving thread).
+ */
+#ifndef PJSIP_RX_WORKER_CNT
+#   define PJSIP_RX_WORKER_CNT		0
+#endif
+
+
+/**
+ * Specify the maximum number of incoming messages that may be waiting in
+ * the queue of each rx worker thread (see \a rx_worker_cnt in
+ * #pjsip_cfg_t). When the queue is full, further messages for the worker
+ * are dropped, relying on the retransmission of the sender.
+ *
+ * Default value is 1024.
+ */
+#ifndef PJSIP_RX_WORKER_MAX_QUEUE
+#   define PJSIP_RX_WORKER_MAX_QUEUE	1024
+#endif
+
+
+/**
+ * Parse incoming messages in lazy mode, where headers that are not needed
+ * by the stack for every message are only parsed when they are looked up.
+ * This option can also be controlled at run-time by the \a lazy_hdr_parse
+ * setting in pjsip_cfg_t.
+ *
+ * Default value is 0 (no).
+ */
+#ifndef PJSIP_LAZY_HDR_PARSE
+#   define PJSIP_LAZY_HDR_PARSE		0
+#endif
+
+
 /**
  * Transport manager hash table size (must be 2^n-1). 
  * See also PJSIP_MAX_TRANSPORTS
@@ -339,6 +454,29 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Enable print cache in transmit data. When enabled, the transmit data
+ * remembers where each header was printed in its buffer, so that when
+ * only some headers are invalidated with #pjsip_tx_data_invalidate_hdr()
+ * (for example the Via header when a forked request is sent), only those
+ * headers are printed again and the text of the other headers is copied.
+ * The message is still printed completely when a stateless request is
+ * retried to the next address, since the application callback may have
+ * modified it. #pjsip_tx_data_clone() also reuses the printed
+ * text of the original.
+ *
+ * Note that with this enabled, modules that modify an already printed
+ * message in their on_tx_request() or on_tx_response() callback must
+ * invalidate the changed part, rather than assuming that the message
+ * will be printed again completely.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_TX_DATA_PRINT_CACHE
+#   define PJSIP_TX_DATA_PRINT_CACHE	1
+#endif
+
+
 /**
  * RFC 3261 section 18.1.1:
  * If a request is within 200 bytes of the path MTU, or if it is larger
@@ -445,6 +583,22 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the maximum number of outgoing SIP messages to be sent with a
+ * single system call by the UDP transport. When this is greater than 1,
+ * outgoing messages are queued in the ioqueue and sent in batches (with
+ * sendmmsg()) when the ioqueue is polled, which reduces system call
+ * overhead on busy servers at the expense of slightly increased latency.
+ * The setting is ignored when batched send is not supported by the
+ * ioqueue backend.
+ *
+ * Default is 0 (send each message immediately)
+ */
+#ifndef PJSIP_UDP_SEND_BATCH
+#   define PJSIP_UDP_SEND_BATCH	0
+#endif
+
+
 /**
  * Encode SIP headers in their short forms to reduce size. By default,
  * SIP headers in outgoing messages will be encoded in their full names. 
@@ -554,6 +708,27 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify whether SIP parser reports syntax errors with exception
+ * (PJ_THROW, which is setjmp/longjmp based). If zero, the parser records
+ * the first syntax error in the scanner (see pj_scan_set_error()) and
+ * returns early instead, so a syntax error doesn't unwind the parser with
+ * longjmp(). The parse results are the same in both modes.
+ *
+ * Custom header and URI parsers must report errors with
+ * pj_scan_syntax_err() rather than with PJ_THROW if this is disabled.
+ * Pool allocation failure during parsing is reported by the pool's
+ * callback, which throws PJSIP_EX_NO_MEMORY for pools created by the
+ * endpoint. The parser entry points catch it and fail the parse in both
+ * modes.
+ *
+ * Default: 1
+ */
+#ifndef PJSIP_PARSER_USE_EXCEPTION
+#   define PJSIP_PARSER_USE_EXCEPTION	1
+#endif
+
+
 /**
  * Specify port number should be allowed to appear in To and From
  * header. Note that RFC 3261 disallow this, see Table 1 in section
@@ -638,14 +813,19 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 
 
 /**
- * The TCP incoming connection backlog number to be set in accept().
+ * The TCP incoming connection backlog number to be set in listen(). This
+ * constant will be used as the default value for the "backlog" field in
+ * the pjsip_tcp_transport_cfg structure. A small backlog makes the kernel
+ * drop connection attempts when many clients (re)connect at the same time,
+ * e.g: after a network outage. The operating system may clip the value
+ * (on Linux, to net.core.somaxconn).
  *
- * Default: 5
+ * Default: 1024
  *
  * @see PJSIP_TLS_TRANSPORT_BACKLOG
  */
 #ifndef PJSIP_TCP_TRANSPORT_BACKLOG
-#   define PJSIP_TCP_TRANSPORT_BACKLOG	5
+#   define PJSIP_TCP_TRANSPORT_BACKLOG	1024
 #endif
 
 
@@ -733,6 +913,21 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #endif
 
 
+/**
+ * Specify the maximum number of outgoing SIP messages that TCP transport
+ * gathers into a single send operation. TCP transport submits only one
+ * send operation to the ioqueue at a time; messages sent while it is in
+ * progress are queued and sent together, without copying, with a single
+ * vectored send (see pj_sock_sendv()) once it completes. Set this to 1 to
+ * send the queued messages one by one.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_TCP_SEND_COALESCE
+#   define PJSIP_TCP_SEND_COALESCE	    16
+#endif
+
+
 /**
  * Set the interval to send keep-alive packet for TLS transports.
  * If the value is zero, keep-alive will be disabled for TLS.
@@ -810,14 +1005,16 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 
 
 /**
- * The TLS pending incoming connection backlog number to be set in accept().
+ * The TLS incoming connection backlog number to be set in listen(). This
+ * constant will be used as the default value for the "backlog" field in
+ * the pjsip_tls_setting structure.
  *
- * Default: 5
+ * Default: PJSIP_TCP_TRANSPORT_BACKLOG
  *
  * @see PJSIP_TCP_TRANSPORT_BACKLOG
  */
 #ifndef PJSIP_TLS_TRANSPORT_BACKLOG
-#   define PJSIP_TLS_TRANSPORT_BACKLOG	    5
+#   define PJSIP_TLS_TRANSPORT_BACKLOG	    PJSIP_TCP_TRANSPORT_BACKLOG
 #endif
 
 
@@ -875,6 +1072,31 @@ PJ_INLINE(pjsip_cfg_t*) pjsip_cfg(void)
 #define PJSIP_POOL_LEN_TRANSPORT	512
 #define PJSIP_POOL_INC_TRANSPORT	512
 
+/**
+ * Maximum number of pools which each thread keeps in its free list for
+ * each pool type of #pjsip_endpt_acquire_pool(), i.e. for transmit data,
+ * transactions and dialogs. Reusing the pools avoids the lock of the pool
+ * factory when these objects are created and destroyed. Set to zero to
+ * disable the free lists.
+ *
+ * Default: 16
+ */
+#ifndef PJSIP_POOL_FREE_LIST_SIZE
+#   define PJSIP_POOL_FREE_LIST_SIZE	16
+#endif
+
+/**
+ * Maximum number of threads which can have a pool free list at a time,
+ * see #PJSIP_POOL_FREE_LIST_SIZE. A free list is given back when its
+ * thread calls #pjsip_endpt_release_thread_pools(), so this bounds the
+ * memory kept by threads which quit without calling it.
+ *
+ * Default: 64
+ */
+#ifndef PJSIP_POOL_FREE_LIST_MAX_THREADS
+#   define PJSIP_POOL_FREE_LIST_MAX_THREADS	64
+#endif
+
 /**
  * Initial memory block size for tdata.
  */
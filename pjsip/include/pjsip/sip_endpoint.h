@@ -138,6 +138,28 @@ PJ_DECL(pj_status_t) pjsip_endpt_handle_events( pjsip_endpoint *endpt,
 PJ_DECL(pj_status_t) pjsip_endpt_handle_events2(pjsip_endpoint *endpt,
 					        const pj_time_val *max_timeout,
 					        unsigned *count);
+
+/**
+ * Change the number of worker threads that run the module callbacks for
+ * incoming messages, which is initially taken from \a rx_worker_cnt
+ * setting in #pjsip_cfg_t. With zero workers, incoming messages are
+ * processed by the thread that receives them. The messages that are
+ * already queued to the current workers are processed before the workers
+ * are stopped.
+ *
+ * This function may be called while other threads are polling the
+ * endpoint: messages received while the workers are being replaced are
+ * processed by the receiving thread. It must not be called from an rx
+ * worker, i.e. from a module callback when rx workers are enabled.
+ *
+ * @param endpt		The endpoint.
+ * @param cnt		Number of rx workers.
+ *
+ * @return		PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_set_rx_worker_cnt(pjsip_endpoint *endpt,
+						   unsigned cnt);
+
 /**
  * Schedule timer to endpoint's timer heap. Application must poll the endpoint
  * periodically (by calling #pjsip_endpt_handle_events) to ensure that the
@@ -314,6 +336,117 @@ PJ_DECL(pj_pool_t*) pjsip_endpt_create_pool( pjsip_endpoint *endpt,
 PJ_DECL(void) pjsip_endpt_release_pool( pjsip_endpoint *endpt,
 					pj_pool_t *pool );
 
+/**
+ * Types of objects whose pools are kept for reuse by the endpoint, see
+ * #pjsip_endpt_acquire_pool().
+ */
+typedef enum pjsip_endpt_pool_type
+{
+    /** Pool of transmit data (pjsip_tx_data). */
+    PJSIP_ENDPT_POOL_TDATA,
+
+    /** Pool of transaction (pjsip_transaction). */
+    PJSIP_ENDPT_POOL_TSX,
+
+    /** Pool of dialog (pjsip_dialog). */
+    PJSIP_ENDPT_POOL_DIALOG,
+
+    /** Number of pool types. */
+    PJSIP_ENDPT_POOL_TYPE_COUNT
+
+} pjsip_endpt_pool_type;
+
+/**
+ * Statistics of the pools kept for reuse by the endpoint, see
+ * #pjsip_endpt_get_pool_stat().
+ */
+typedef struct pjsip_endpt_pool_stat
+{
+    /** Number of pools taken from the free lists. */
+    pj_uint32_t	    hit;
+
+    /** Number of pools created because the free list was empty. */
+    pj_uint32_t	    miss;
+
+    /** Number of pools put back to the free lists. */
+    pj_uint32_t	    recycled;
+
+    /** Number of pools released to the pool factory because the free
+     *  list was full. */
+    pj_uint32_t	    released;
+
+    /** Number of pools currently in the free lists. */
+    pj_uint32_t	    cached;
+
+} pjsip_endpt_pool_stat;
+
+/**
+ * Get a pool for the specified object type. Each thread keeps a free list
+ * of pools which have been returned with #pjsip_endpt_recycle_pool(), so
+ * the pool is normally taken from the free list of the calling thread
+ * without any locking, and is only created from the pool factory when the
+ * free list is empty. The size of the pool follows the setting of the
+ * object type, e.g. PJSIP_POOL_LEN_TDATA and PJSIP_POOL_INC_TDATA for
+ * transmit data.
+ *
+ * Threads which poll the endpoint and then quit before the endpoint is
+ * destroyed should call #pjsip_endpt_release_thread_pools() before they
+ * quit, otherwise the pools in their free lists are only released when the
+ * endpoint is destroyed. At most PJSIP_POOL_FREE_LIST_MAX_THREADS threads
+ * can have a free list at a time, other threads always create the pool
+ * from the pool factory.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param type		The object type.
+ * @param pool_name	Name to be assigned to the pool.
+ *
+ * @return		Memory pool, or NULL on failure.
+ *
+ * @see PJSIP_POOL_FREE_LIST_SIZE
+ */
+PJ_DECL(pj_pool_t*) pjsip_endpt_acquire_pool( pjsip_endpoint *endpt,
+					      pjsip_endpt_pool_type type,
+					      const char *pool_name );
+
+/**
+ * Return back a pool which was acquired with #pjsip_endpt_acquire_pool().
+ * The pool is reset and put in the free list of the calling thread, or
+ * released back to the pool factory if the free list is full.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param type		The object type, which must be the same as the type
+ *			when the pool was acquired.
+ * @param pool		The pool.
+ */
+PJ_DECL(void) pjsip_endpt_recycle_pool( pjsip_endpoint *endpt,
+					pjsip_endpt_pool_type type,
+					pj_pool_t *pool );
+
+/**
+ * Release the pools in the free list of the calling thread and give the
+ * free list back to the endpoint, so that it can be used by other threads.
+ * This also calls #pj_pool_factory_release_thread() for the pool factory
+ * of the endpoint.
+ * This should be called by threads which have called
+ * #pjsip_endpt_acquire_pool() or #pjsip_endpt_recycle_pool(), directly or
+ * by handling events, before the thread quits.
+ *
+ * @param endpt		The SIP endpoint.
+ */
+PJ_DECL(void) pjsip_endpt_release_thread_pools( pjsip_endpoint *endpt );
+
+/**
+ * Get the statistics of the pools of the specified object type, summed
+ * over the free lists of all threads.
+ *
+ * @param endpt		The SIP endpoint.
+ * @param type		The object type.
+ * @param stat		To receive the statistics.
+ */
+PJ_DECL(void) pjsip_endpt_get_pool_stat( pjsip_endpoint *endpt,
+					 pjsip_endpt_pool_type type,
+					 pjsip_endpt_pool_stat *stat );
+
 /**
  * Find transaction in endpoint's transaction table by the transaction's key.
  * This function normally is only used by modules. The key for a transaction
@@ -892,6 +892,18 @@ PJ_DECL(void*)  pjsip_msg_find_hdr_by_names(const pjsip_msg *msg,
 PJ_DECL(void*)  pjsip_msg_find_remove_hdr( pjsip_msg *msg, 
 					   pjsip_hdr_e hdr, void *start);
 
+/**
+ * Parse all headers in the message that have not been parsed yet because
+ * the message was parsed in lazy mode (see #pjsip_lazy_hdr). Code that
+ * walks the header list of a received message directly and checks the
+ * header type, instead of using #pjsip_msg_find_hdr() and friends, should
+ * call this function first. The headers that fail to parse are left in
+ * the message as generic string headers.
+ *
+ * @param msg	    The message.
+ */
+PJ_DECL(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg );
+
 /** 
  * Add a header to the message, putting it last in the header list.
  *
@@ -933,6 +945,39 @@ PJ_INLINE(void) pjsip_msg_insert_first_hdr( pjsip_msg *msg, pjsip_hdr *hdr )
 PJ_DECL(pj_ssize_t) pjsip_msg_print(const pjsip_msg *msg, 
 				    char *buf, pj_size_t size);
 
+/**
+ * Print the request line or the status line of the message, including the
+ * terminating CRLF. This is the part of #pjsip_msg_print() output before
+ * the first header.
+ *
+ * @param msg	The message to print.
+ * @param buf	The buffer
+ * @param size	The size of the buffer.
+ *
+ * @return	The length of the printed characters (in bytes), or NEGATIVE
+ *		value if the buffer is too small.
+ */
+PJ_DECL(pj_ssize_t) pjsip_msg_print_start_line(const pjsip_msg *msg,
+					       char *buf, pj_size_t size);
+
+/**
+ * Print the part of the message after the header list, that is the
+ * Content-Type and Content-Length headers generated from the message body,
+ * the blank line, and the body itself. This is the part of
+ * #pjsip_msg_print() output after the last header, and it is NULL
+ * terminated likewise.
+ *
+ * @param msg	The message to print.
+ * @param buf	The buffer
+ * @param size	The size of the buffer.
+ *
+ * @return	The length of the printed characters (in bytes), excluding
+ *		the NULL terminator, or NEGATIVE value if the buffer is
+ *		too small.
+ */
+PJ_DECL(pj_ssize_t) pjsip_msg_print_body_part(const pjsip_msg *msg,
+					      char *buf, pj_size_t size);
+
 
 /*
  * Some usefull macros to find common headers.
@@ -1058,6 +1103,66 @@ PJ_DECL(void) pjsip_generic_string_hdr_init2(pjsip_generic_string_hdr *h,
 					     pj_str_t *hvalue);
 
 
+/* **************************************************************************/
+
+struct pjsip_parse_ctx;
+
+/**
+ * Header which value has not been parsed yet. When a message is parsed in
+ * lazy mode (see #pjsip_parse_msg2()), the parser only splits the headers
+ * that have a registered parser into name and value and stores them as
+ * this header, except for the headers that the stack needs for every
+ * message (such as Via, From, To, Call-ID, CSeq, and Route) and the
+ * headers registered with #pjsip_register_eager_hdr().
+ *
+ * The header is parsed into its real type the first time it is looked up
+ * with #pjsip_msg_find_hdr() and the other header search functions, which
+ * replace it in the message with the parsed header(s). Until then, its
+ * type is PJSIP_H_OTHER and it has the same layout as
+ * #pjsip_generic_string_hdr, so code that walks the header list sees it
+ * as a generic header containing the raw value. It is printed as is.
+ *
+ * Because parsing allocates from the pool of the message, a message with
+ * lazy headers must not be searched by multiple threads at the same time.
+ * Call #pjsip_msg_parse_lazy_hdrs() before sharing such a message with
+ * other threads. #pjsip_rx_data_clone() does this for shared clones.
+ */
+typedef struct pjsip_lazy_hdr
+{
+    /** Standard header field. */
+    PJSIP_DECL_HDR_MEMBER(struct pjsip_lazy_hdr);
+    /** The unparsed header value. */
+    pj_str_t	    hvalue;
+    /** Type of the header once parsed. */
+    pjsip_hdr_e	    parsed_type;
+    /** The pool to allocate the parsed header from. */
+    pj_pool_t	   *pool;
+    /** The function to parse the header value. */
+    pjsip_hdr*	  (*parse)(struct pjsip_parse_ctx *ctx);
+} pjsip_lazy_hdr;
+
+
+/**
+ * Create a lazy header. This function is normally only called by the
+ * parser, which fills in the rest of the header fields.
+ *
+ * @param pool	    The pool, which will also be used to parse the header.
+ *
+ * @return	    The header instance.
+ */
+PJ_DECL(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool);
+
+
+/**
+ * Check whether the header is a lazy header that has not been parsed yet.
+ *
+ * @param hdr	    The header.
+ *
+ * @return	    PJ_TRUE if the header is a #pjsip_lazy_hdr.
+ */
+PJ_DECL(pj_bool_t) pjsip_hdr_is_lazy(const pjsip_hdr *hdr);
+
+
 /* **************************************************************************/
 
 /**
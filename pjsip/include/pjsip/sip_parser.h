@@ -94,9 +94,10 @@ typedef struct pjsip_parse_ctx
  *   - It must not modify the input text.
  *   - The hname and HCOLON has been parsed prior to invoking the handler.
  *   - It returns the header instance on success.
- *   - For error reporting, it must throw PJSIP_SYN_ERR_EXCEPTION exception 
- *     instead of just returning NULL. 
- *     When exception is thrown, the return value is ignored.
+ *   - For error reporting, it must call pj_scan_syntax_err() (which throws
+ *     PJSIP_SYN_ERR_EXCEPTION exception, unless PJSIP_PARSER_USE_EXCEPTION
+ *     is disabled) instead of just returning NULL, and return immediately
+ *     afterwards. The return value is ignored on error.
  *   - It must read the header separator after finished reading the header
  *     body. The separator types are described below, and if they don't exist,
  *     exception must be thrown. Header separator can be a:
@@ -130,6 +131,42 @@ PJ_DECL(pj_status_t) pjsip_register_hdr_parser( const char *hname,
 						const char *hshortname,
 						pjsip_parse_hdr_func *fptr);
 
+/**
+ * Register header parser handler, specifying the type of the header that
+ * the handler produces. This behaves like #pjsip_register_hdr_parser(),
+ * which assumes PJSIP_H_OTHER as the type. The type is needed for headers
+ * of standard types to be found with #pjsip_msg_find_hdr() when the
+ * message is parsed in lazy mode.
+ *
+ * @param hname		The header name.
+ * @param hshortname	The short header name or NULL.
+ * @param type		The type of the header produced by the handler.
+ * @param fptr		The pointer to function to parser the header.
+ *
+ * @return		PJ_SUCCESS if success, or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_register_hdr_parser2( const char *hname,
+						 const char *hshortname,
+						 pjsip_hdr_e type,
+						 pjsip_parse_hdr_func *fptr);
+
+/**
+ * Request the header to be always parsed fully when the message is parsed,
+ * even in lazy mode (see #pjsip_lazy_hdr). Modules that need a header in
+ * every message, or that walk the header list directly instead of using
+ * #pjsip_msg_find_hdr() and friends, may call this function when they
+ * are registered. The headers that the core needs for every message, such
+ * as Via, From, To, Call-ID, CSeq, Route and Record-Route are always
+ * parsed fully.
+ *
+ * @param hname		The header name or short name, which parser must
+ *			have been registered.
+ *
+ * @return		PJ_SUCCESS if success, or PJ_ENOTFOUND if no parser
+ *			is registered for the header.
+ */
+PJ_DECL(pj_status_t) pjsip_register_eager_hdr( const char *hname );
+
 /**
  * Unregister previously registered header parser handler.
  * All the arguments MUST exactly equal to the value specified upon 
@@ -222,12 +259,44 @@ PJ_DECL(pjsip_msg *) pjsip_parse_msg( pj_pool_t *pool,
 				      char *buf, pj_size_t size,
 				      pjsip_parser_err_report *err_list);
 
+/**
+ * Options for #pjsip_parse_msg2().
+ */
+typedef enum pjsip_parse_msg_option
+{
+    /**
+     * Parse the message in lazy mode, where only the headers that the
+     * core needs are parsed fully, and the other headers are parsed
+     * on their first lookup. See #pjsip_lazy_hdr for more info.
+     */
+    PJSIP_PARSE_MSG_LAZY_HDR = 1
+
+} pjsip_parse_msg_option;
+
+/**
+ * Variant of #pjsip_parse_msg() with additional options.
+ *
+ * @param pool		The pool to allocate memory.
+ * @param buf		The input buffer, which MUST be NULL terminated.
+ * @param size		The length of the string (not counting NULL terminator).
+ * @param options	Bitmask combination of #pjsip_parse_msg_option.
+ * @param err_list	If this parameter is not NULL, then the parser will
+ *			put error messages during parsing in this list.
+ *
+ * @return		The message or NULL when failed.
+ */
+PJ_DECL(pjsip_msg *) pjsip_parse_msg2( pj_pool_t *pool, 
+				       char *buf, pj_size_t size,
+				       unsigned options,
+				       pjsip_parser_err_report *err_list);
+
 
 /**
  * Parse a packet buffer and build a rdata. The resulting message will be
  * stored in \c msg field in the \c rdata. This behaves pretty much like
  * #pjsip_parse_msg(), except that it will also initialize the header fields
- * in the \c rdata.
+ * in the \c rdata. The message is parsed in lazy mode if \a lazy_hdr_parse
+ * setting in #pjsip_cfg_t is enabled.
  *
  * This function is normally called by the transport layer.
  *
@@ -241,6 +310,20 @@ PJ_DECL(pjsip_msg *) pjsip_parse_msg( pj_pool_t *pool,
 PJ_DECL(pjsip_msg *) pjsip_parse_rdata( char *buf, pj_size_t size,
                                         pjsip_rx_data *rdata );
 
+/**
+ * Parse the value of a lazy header. The header is not modified, and the
+ * resulting header(s) are allocated from the pool of the lazy header.
+ * Application normally doesn't need to call this function, since lazy
+ * headers are parsed by #pjsip_msg_find_hdr() and friends.
+ *
+ * @param hdr		The lazy header.
+ *
+ * @return		The parsed header (which may be a list of headers,
+ *			e.g. for Contact header containing multiple URIs),
+ *			or NULL on syntax error.
+ */
+PJ_DECL(pjsip_hdr*) pjsip_parse_lazy_hdr( pjsip_lazy_hdr *hdr );
+
 /**
  * Check incoming packet to see if a (probably) valid SIP message has been 
  * received.
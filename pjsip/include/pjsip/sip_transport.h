@@ -271,6 +271,59 @@ typedef struct pjsip_rx_data_op_key
 } pjsip_rx_data_op_key;
 
 
+/**
+ * Flags for the receive buffer, kept in \a tp_info.buf_flag of
+ * #pjsip_rx_data.
+ */
+typedef enum pjsip_rx_data_buf_flag
+{
+    /**
+     * Set by transports that call #pjsip_rx_data_detach_buffer() after
+     * each received packet has been processed. Buffers of such transports
+     * can be shared by cloned rdata without copying the packet.
+     */
+    PJSIP_RX_DATA_BUF_DETACHABLE = 1,
+
+    /**
+     * The buffer has been given up by its original owner, and it will be
+     * destroyed when the last shared clone referring to it is freed.
+     */
+    PJSIP_RX_DATA_BUF_DETACHED = 2,
+
+    /**
+     * The buffer belongs to an rdata created by #pjsip_rx_data_clone().
+     */
+    PJSIP_RX_DATA_BUF_CLONED = 4
+
+} pjsip_rx_data_buf_flag;
+
+
+/**
+ * Flags for #pjsip_rx_data_clone().
+ */
+typedef enum pjsip_rx_data_clone_flag
+{
+    /**
+     * Share the packet buffer and the parsed message with the source
+     * rdata instead of parsing or cloning the message again. The clone
+     * gets its own pool, \a endpt_info and a copy of the received bytes
+     * in \a pkt_info, while \a msg_info points to the shared buffer, and
+     * holds a reference to the buffer that keeps it alive after the
+     * transport has finished with it. Since the parsed message is shared,
+     * it must be treated as read-only by all clones. Headers that have
+     * not been parsed yet in lazy mode are parsed before the message is
+     * shared.
+     *
+     * If the source rdata comes from a transport whose buffer can't be
+     * detached (such as stream transports, whose buffer also contains the
+     * next message), the first clone is a deep clone, and clones of that
+     * clone share its buffer.
+     */
+    PJSIP_RX_DATA_CLONE_SHARED = 1
+
+} pjsip_rx_data_clone_flag;
+
+
 /**
  * Incoming message buffer.
  * This structure keep all the information regarding the received message. This
@@ -299,6 +352,18 @@ struct pjsip_rx_data
 	/** Ioqueue key. */
 	pjsip_rx_data_op_key	 op_key;
 
+	/** For rdata cloned with PJSIP_RX_DATA_CLONE_SHARED, this points
+	 *  to the buffer that holds the packet and the parsed message,
+	 *  otherwise NULL.
+	 */
+	pjsip_rx_data		*buf_owner;
+
+	/** Number of shared clones that refer to this buffer. */
+	unsigned		 buf_ref_cnt;
+
+	/** Buffer flags, bitmask combination of #pjsip_rx_data_buf_flag. */
+	unsigned		 buf_flag;
+
     } tp_info;
 
 
@@ -436,10 +501,13 @@ PJ_DECL(char*) pjsip_rx_data_get_info(pjsip_rx_data *rdata);
  * By default (if flags is set to zero), this function copies the
  * transport pointer in \a tp_info, duplicates the \a pkt_info,
  * perform deep clone of the \a msg_info parts of the rdata, and
- * fills the \a endpt_info (i.e. the \a mod_data) with zeros.
+ * fills the \a endpt_info (i.e. the \a mod_data) with zeros. With
+ * PJSIP_RX_DATA_CLONE_SHARED flag, the packet and the \a msg_info parts
+ * are shared with the source instead.
  *
  * @param src	    The source to be cloned.
- * @param flags	    Optional flags. Must be zero for now.
+ * @param flags	    Optional flags, bitmask combination of
+ *		    #pjsip_rx_data_clone_flag.
  * @param p_rdata   Pointer to receive the cloned rdata.
  *
  * @return	    PJ_SUCCESS on success or the appropriate error.
@@ -463,6 +531,23 @@ PJ_DECL(pj_status_t) pjsip_rx_data_clone(const pjsip_rx_data *src,
  */
 PJ_DECL(pj_status_t) pjsip_rx_data_free_cloned(pjsip_rx_data *rdata);
 
+/**
+ * This function is called by transports that set
+ * PJSIP_RX_DATA_BUF_DETACHABLE flag in their receive buffer, once the
+ * packet in the buffer has been processed. If the buffer is still shared
+ * by clones created with PJSIP_RX_DATA_CLONE_SHARED flag, the buffer is
+ * detached from the transport and will be destroyed (by releasing its
+ * pool) when the last clone is freed, and the transport must allocate a
+ * new buffer for the next packet.
+ *
+ * @param rdata	    The transport's receive buffer.
+ *
+ * @return	    PJ_TRUE if the buffer has been detached and must not be
+ *		    reused by the transport, or PJ_FALSE if the transport
+ *		    may reuse the buffer.
+ */
+PJ_DECL(pj_bool_t) pjsip_rx_data_detach_buffer(pjsip_rx_data *rdata);
+
 
 /*****************************************************************************
  *
@@ -554,6 +639,13 @@ struct pjsip_tx_data
      */
     pjsip_buffer	 buf;
 
+    /** Where each part of the message is printed in the buffer, used to
+     *  print only the parts invalidated by #pjsip_tx_data_invalidate_hdr()
+     *  (see PJSIP_TX_DATA_PRINT_CACHE). This is internal to the transport
+     *  manager.
+     */
+    struct pjsip_tx_data_print_cache *print_cache;
+
     /** Reference counter. */
     pj_atomic_t		*ref_cnt;
 
@@ -697,6 +789,43 @@ PJ_DECL(pj_bool_t) pjsip_tx_data_is_valid( pjsip_tx_data *tdata );
  */
 PJ_DECL(void) pjsip_tx_data_invalidate_msg( pjsip_tx_data *tdata );
 
+/**
+ * Invalidate only the part of the print buffer where the specified header
+ * or the request/status line was printed. Call this instead of
+ * #pjsip_tx_data_invalidate_msg() when only that header or line has been
+ * changed in place, so that the next print only needs to print that part
+ * again (see PJSIP_TX_DATA_PRINT_CACHE). Headers that are added to or
+ * removed from the message are detected when the message is printed, it
+ * is enough to pass the added or removed header here. Changes to the
+ * message body need a full invalidation with
+ * #pjsip_tx_data_invalidate_msg().
+ *
+ * @param tdata	    The transmit buffer.
+ * @param hdr	    The header that has been changed, or NULL if the
+ *		    request line or status line has been changed.
+ */
+PJ_DECL(void) pjsip_tx_data_invalidate_hdr( pjsip_tx_data *tdata,
+					    const void *hdr );
+
+/**
+ * Create a new transmit buffer with a copy of the message in the source
+ * transmit buffer. If the source message has been printed, the new buffer
+ * reuses the printed text, so that after changing some headers and
+ * invalidating them with #pjsip_tx_data_invalidate_hdr(), only those
+ * headers need to be printed again. This is useful for example to fork a
+ * request to several targets. The reference counter of the new transmit
+ * buffer is set to one.
+ *
+ * @param src	    The source transmit buffer.
+ * @param flags	    Currently must be zero.
+ * @param p_tdata   Pointer to receive the new transmit buffer.
+ *
+ * @return	    PJ_SUCCESS on success or the appropriate error code.
+ */
+PJ_DECL(pj_status_t) pjsip_tx_data_clone(const pjsip_tx_data *src,
+					 unsigned flags,
+					 pjsip_tx_data **p_tdata);
+
 /**
  * Get short printable info about the transmit data. This will normally return
  * short information about the message.
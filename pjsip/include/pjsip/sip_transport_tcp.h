@@ -86,6 +86,26 @@ typedef struct pjsip_tcp_transport_cfg
      */
     unsigned	       async_cnt;
 
+    /**
+     * The maximum length of the queue of incoming connections which have
+     * not been accepted yet, to be set in listen().
+     *
+     * Default: PJSIP_TCP_TRANSPORT_BACKLOG
+     */
+    int			backlog;
+
+    /**
+     * Number of listening sockets to be bound to the same address with
+     * SO_REUSEPORT, so that the kernel spreads incoming connections among
+     * them. The sockets are placed on different shards of the endpoint's
+     * ioqueue (see PJSIP_IOQUEUE_SHARD_CNT), so that connections are
+     * accepted in parallel by the worker threads polling the shards.
+     * When SO_REUSEPORT is not supported, only one socket is created.
+     *
+     * Default: 1
+     */
+    unsigned		listener_cnt;
+
     /**
      * QoS traffic type to be set on this transport. When application wants
      * to apply QoS tagging to the transport, it's preferable to set this
@@ -243,6 +243,13 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t reuse_addr;
 
+    /**
+     * The incoming connection backlog number to be set in listen() of the
+     * listener socket.
+     * Default value is PJSIP_TLS_TRANSPORT_BACKLOG.
+     */
+    int backlog;
+
     /**
      * QoS traffic type to be set on this transport. When application wants
      * to apply QoS tagging to the transport, it's preferable to set this
@@ -286,6 +293,17 @@ typedef struct pjsip_tls_setting
      */
     pj_bool_t sockopt_ignore_error;
 
+    /**
+     * Specify whether encryption of outgoing TLS records should be
+     * offloaded to the kernel (kTLS) once the handshake completes. The
+     * transport silently falls back to user space TLS when the kernel,
+     * the SSL backend, or the negotiated cipher does not support it.
+     * See \a enable_ktls in #pj_ssl_sock_param for more info.
+     *
+     * Default: PJ_FALSE
+     */
+    pj_bool_t enable_ktls;
+
 } pjsip_tls_setting;
 
 
@@ -313,6 +331,7 @@ PJ_INLINE(void) pjsip_tls_setting_default(pjsip_tls_setting *tls_opt)
 {
     pj_memset(tls_opt, 0, sizeof(*tls_opt));
     tls_opt->reuse_addr = PJSIP_TLS_TRANSPORT_REUSEADDR;
+    tls_opt->backlog = PJSIP_TLS_TRANSPORT_BACKLOG;
     tls_opt->qos_type = PJ_QOS_TYPE_BEST_EFFORT;
     tls_opt->qos_ignore_error = PJ_TRUE;
     tls_opt->sockopt_ignore_error = PJ_TRUE;
@@ -834,6 +834,32 @@ PJ_DECL(pj_status_t) pjsip_endpt_create_request_fwd(pjsip_endpoint *endpt,
 
 
 
+/**
+ * Create another copy of a request that was created with
+ * #pjsip_endpt_create_request_fwd(), to forward the request to another
+ * target when forking. Since the new request is created with
+ * #pjsip_tx_data_clone(), the headers that are not changed are not
+ * printed again if the source request has been sent.
+ *
+ * @param endpt	    The endpoint instance.
+ * @param src	    The request to be copied.
+ * @param uri	    Optional new Request-URI. If it is NULL, the
+ *		    Request-URI of the source request is used.
+ * @param branch    Optional branch parameter for the top-most Via header.
+ *		    If it is NULL, the branch parameter is cleared so that
+ *		    a unique one is generated when the request is sent.
+ * @param tdata	    The result.
+ *
+ * @return	    PJ_SUCCESS on success.
+ */
+PJ_DECL(pj_status_t) pjsip_endpt_clone_request_fwd(pjsip_endpoint *endpt,
+						   const pjsip_tx_data *src,
+						   const pjsip_uri *uri,
+						   const pj_str_t *branch,
+						   pjsip_tx_data **tdata);
+
+
+
 /**
  * Create new response message to be forwarded downstream by the proxy from 
  * the response message found in rdata. Note that this function practically 
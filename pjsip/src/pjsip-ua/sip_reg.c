@@ -904,13 +904,12 @@ static pj_int32_t calculate_response_expiration(const pjsip_regc *regc,
 
     /* Enumerate all Contact headers in the response */
     *contact_cnt = 0;
-    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
-	if (hdr->type == PJSIP_H_CONTACT && 
-	    *contact_cnt < max_contact) 
-	{
-	    contacts[*contact_cnt] = (pjsip_contact_hdr*)hdr;
-	    ++(*contact_cnt);
-	}
+    hdr = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+    while (hdr && *contact_cnt < max_contact) {
+	contacts[*contact_cnt] = (pjsip_contact_hdr*)hdr;
+	++(*contact_cnt);
+	hdr = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT,
+						    hdr->next);
     }
 
     if (regc->current_op == REGC_REGISTERING) {
@@ -1148,6 +1148,11 @@ PJ_DEF(pj_status_t) pjsip_auth_clt_reinit_req(	pjsip_auth_clt_sess *sess,
     tdata = old_request;
     tdata->auth_retry = PJ_FALSE;
 
+    /* The challenges are found by walking the header list, so parse the
+     * headers that haven't been parsed in lazy parsing mode.
+     */
+    pjsip_msg_parse_lazy_hdrs(rdata->msg_info.msg);
+
     /*
      * Respond to each authentication challenge.
      */
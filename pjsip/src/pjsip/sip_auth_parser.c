@@ -128,7 +128,7 @@ static void parse_pgp_credential( pj_scanner *scanner, pj_pool_t *pool,
     PJ_UNUSED_ARG(pool);
     PJ_UNUSED_ARG(cred);
 
-    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+    pj_scan_syntax_err(scanner);
 }
 
 static void parse_digest_challenge( pj_scanner *scanner, pj_pool_t *pool, 
@@ -197,7 +197,7 @@ static void parse_pgp_challenge( pj_scanner *scanner, pj_pool_t *pool,
     PJ_UNUSED_ARG(pool);
     PJ_UNUSED_ARG(chal);
 
-    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+    pj_scan_syntax_err(scanner);
 }
 
 static void int_parse_hdr_authorization( pj_scanner *scanner, pj_pool_t *pool,
@@ -222,7 +222,8 @@ static void int_parse_hdr_authorization( pj_scanner *scanner, pj_pool_t *pool,
 	parse_pgp_credential( scanner, pool, &hdr->credential.pgp);
 
     } else {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	pj_scan_syntax_err(scanner);
+	return;
     }
 
     pjsip_parse_end_hdr_imp( scanner );
@@ -250,7 +251,8 @@ static void int_parse_hdr_authenticate( pj_scanner *scanner, pj_pool_t *pool,
 	parse_pgp_challenge(scanner, pool, &hdr->challenge.pgp);
 
     } else {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	pj_scan_syntax_err(scanner);
+	return;
     }
 
     pjsip_parse_end_hdr_imp( scanner );
@@ -293,17 +295,21 @@ PJ_DEF(pj_status_t) pjsip_auth_init_parser()
 {
     pj_status_t status;
 
-    status = pjsip_register_hdr_parser( "Authorization", NULL, 
-                                        &parse_hdr_authorization);
+    status = pjsip_register_hdr_parser2( "Authorization", NULL, 
+                                         PJSIP_H_AUTHORIZATION,
+                                         &parse_hdr_authorization);
     PJ_ASSERT_RETURN(status==PJ_SUCCESS, status);
-    status = pjsip_register_hdr_parser( "Proxy-Authorization", NULL, 
-                                        &parse_hdr_proxy_authorization);
+    status = pjsip_register_hdr_parser2( "Proxy-Authorization", NULL, 
+                                         PJSIP_H_PROXY_AUTHORIZATION,
+                                         &parse_hdr_proxy_authorization);
     PJ_ASSERT_RETURN(status==PJ_SUCCESS, status);
-    status = pjsip_register_hdr_parser( "WWW-Authenticate", NULL, 
-                                        &parse_hdr_www_authenticate);
+    status = pjsip_register_hdr_parser2( "WWW-Authenticate", NULL, 
+                                         PJSIP_H_WWW_AUTHENTICATE,
+                                         &parse_hdr_www_authenticate);
     PJ_ASSERT_RETURN(status==PJ_SUCCESS, status);
-    status = pjsip_register_hdr_parser( "Proxy-Authenticate", NULL, 
-                                        &parse_hdr_proxy_authenticate);
+    status = pjsip_register_hdr_parser2( "Proxy-Authenticate", NULL, 
+                                         PJSIP_H_PROXY_AUTHENTICATE,
+                                         &parse_hdr_proxy_authenticate);
     PJ_ASSERT_RETURN(status==PJ_SUCCESS, status);
 
     return PJ_SUCCESS;
@@ -73,9 +73,7 @@ static pj_status_t create_dialog( pjsip_user_agent *ua,
     if (!endpt)
 	return PJ_EINVALIDOP;
 
-    pool = pjsip_endpt_create_pool(endpt, "dlg%p",
-				   PJSIP_POOL_LEN_DIALOG,
-				   PJSIP_POOL_INC_DIALOG);
+    pool = pjsip_endpt_acquire_pool(endpt, PJSIP_ENDPT_POOL_DIALOG, "dlg%p");
     if (!pool)
 	return PJ_ENOMEM;
 
@@ -126,7 +124,7 @@ static void destroy_dialog( pjsip_dialog *dlg, pj_bool_t unlock_mutex )
 	pj_bzero(&dlg->tp_sel, sizeof(pjsip_tpselector));
     }
     pjsip_auth_clt_deinit(&dlg->auth_sess);
-    pjsip_endpt_release_pool(dlg->endpt, dlg->pool);
+    pjsip_endpt_recycle_pool(dlg->endpt, PJSIP_ENDPT_POOL_DIALOG, dlg->pool);
 }
 
 
@@ -216,8 +214,8 @@ PJ_DEF(pj_status_t) pjsip_dlg_create_uac( pjsip_user_agent *ua,
     pj_create_unique_string(dlg->pool, &dlg->local.info->tag);
 
     /* Calculate hash value of local tag. */
-    dlg->local.tag_hval = pj_hash_calc_tolower(0, NULL,
-                                               &dlg->local.info->tag);
+    dlg->local.tag_hval = pj_hash_calc_seeded_tolower(NULL,
+                                                        &dlg->local.info->tag);
 
     /* Randomize local CSeq. */
     dlg->local.first_cseq = pj_rand() & 0x7FFF;
@@ -379,7 +377,8 @@ pj_status_t create_uas_dialog( pjsip_user_agent *ua,
     pj_strdup(dlg->pool, &dlg->local.info_str, &tmp);
 
     /* Calculate hash value of local tag. */
-    dlg->local.tag_hval = pj_hash_calc_tolower(0, NULL, &dlg->local.info->tag);
+    dlg->local.tag_hval = pj_hash_calc_seeded_tolower(NULL,
+							&dlg->local.info->tag);
 
 
     /* Randomize local cseq */
@@ -526,7 +525,8 @@ pj_status_t create_uas_dialog( pjsip_user_agent *ua,
     ++dlg->tsx_count;
 
     /* Calculate hash value of remote tag. */
-    dlg->remote.tag_hval = pj_hash_calc_tolower(0, NULL, &dlg->remote.info->tag);
+    dlg->remote.tag_hval = pj_hash_calc_seeded_tolower(NULL,
+							 &dlg->remote.info->tag);
 
     /* Update remote capabilities info */
     pjsip_dlg_update_remote_cap(dlg, rdata->msg_info.msg, PJ_TRUE);
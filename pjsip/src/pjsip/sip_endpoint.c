@@ -49,6 +49,59 @@ typedef struct exit_cb
 } exit_cb;
 
 
+/* Incoming message queued to rx worker. */
+typedef struct rx_job
+{
+    PJ_DECL_LIST_MEMBER		    (struct rx_job);
+    pjsip_rx_data		   *rdata;
+} rx_job;
+
+
+/* Worker thread that runs the module callbacks for incoming messages. */
+typedef struct rx_worker
+{
+    pjsip_endpoint		   *endpt;
+    pj_thread_t			   *thread;
+    pj_mutex_t			   *mutex;
+    pj_sem_t			   *sem;
+    pj_bool_t			    quit;
+    unsigned			    queue_len;
+    rx_job			    queue;
+} rx_worker;
+
+
+/* Pools kept for reuse by a thread, see pjsip_endpt_acquire_pool(). The
+ * free lists are only modified by the owner thread, so no lock is needed.
+ * The counters are read by pjsip_endpt_get_pool_stat() from other threads,
+ * hence they are accessed with STAT_LOAD()/STAT_STORE(). A list is given
+ * back with pjsip_endpt_release_thread_pools() and reused by the next
+ * thread.
+ */
+typedef struct pool_free_list
+{
+    PJ_DECL_LIST_MEMBER			    (struct pool_free_list);
+    pj_bool_t				    in_use;
+    struct {
+#if PJSIP_POOL_FREE_LIST_SIZE
+	pj_pool_t		   *pool[PJSIP_POOL_FREE_LIST_SIZE];
+#endif
+	unsigned		    count;
+	pjsip_endpt_pool_stat	    stat;
+    } type[PJSIP_ENDPT_POOL_TYPE_COUNT];
+} pool_free_list;
+
+#if defined(__GNUC__)
+#   define STAT_LOAD(var)	__atomic_load_n(&(var), __ATOMIC_RELAXED)
+#   define STAT_STORE(var, v)	__atomic_store_n(&(var), v, __ATOMIC_RELAXED)
+#else
+#   define STAT_LOAD(var)	(var)
+#   define STAT_STORE(var, v)	((var) = (v))
+#endif
+
+/* Increment a counter which is only written by the owner thread. */
+#define STAT_INC(var)		STAT_STORE(var, STAT_LOAD(var) + 1)
+
+
 /**
  * The SIP endpoint.
  */
@@ -98,6 +151,32 @@ struct pjsip_endpoint
 
     /** List of exit callback. */
     exit_cb		 exit_cb_list;
+
+    /** Number of rx workers, zero when messages are processed by the
+     *  receiving thread. Only changed with rx_worker_lock write-locked.
+     */
+    unsigned		 rx_worker_cnt;
+
+    /** Rx workers, see rx_worker_cnt setting in pjsip_cfg_t. */
+    rx_worker		*rx_workers;
+
+    /** Pool of the rx workers, released when the workers are stopped. */
+    pj_pool_t		*rx_worker_pool;
+
+    /** Lock to dispatch messages to rx workers while they are changed. */
+    pj_rwmutex_t	*rx_worker_lock;
+
+    /** Thread local storage index of the pool free list of each thread. */
+    long		 pool_tls_id;
+
+    /** Pool free lists of all threads, also used as the thread local
+     *  value of threads which could not get a free list. Protected by
+     *  mutex.
+     */
+    pool_free_list	 pool_free_lists;
+
+    /** Number of entries in pool_free_lists. */
+    unsigned		 pool_free_list_cnt;
 };
 
 
@@ -120,6 +199,10 @@ static pj_status_t endpt_on_tx_msg( pjsip_endpoint *endpt,
 				    pjsip_tx_data *tdata );
 static pj_status_t unload_module(pjsip_endpoint *endpt,
 				 pjsip_module *mod);
+static pj_status_t start_rx_workers(pjsip_endpoint *endpt, unsigned cnt);
+static void stop_rx_workers(pjsip_endpoint *endpt);
+static void process_rx_msg(pjsip_endpoint *endpt, pjsip_rx_data *rdata);
+static void release_pool_free_lists(pjsip_endpoint *endpt);
 
 /* Defined in sip_parser.c */
 void init_sip_parser(void);
@@ -134,6 +217,8 @@ pj_status_t pjsip_tel_uri_subsys_init(void);
  * are created by the endpoint (by default, all pools ARE allocated by 
  * endpoint). The error is handled by throwing exception, and hopefully,
  * the exception will be handled by the application (or this library).
+ * The SIP parser catches it even when PJSIP_PARSER_USE_EXCEPTION is
+ * disabled, and fails the parse.
  */
 static void pool_callback( pj_pool_t *pool, pj_size_t size )
 {
@@ -466,6 +551,10 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     if (status != PJ_SUCCESS)
 	goto on_error;
 
+    status = pj_rwmutex_create(endpt->pool, "rxw%p", &endpt->rx_worker_lock);
+    if (status != PJ_SUCCESS)
+	goto on_error;
+
     /* Init parser. */
     init_sip_parser();
 
@@ -486,9 +575,19 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
 	goto on_error;
     }
 
+    /* Thread local storage for the pool free lists. */
+    pj_list_init(&endpt->pool_free_lists);
+    endpt->pool_tls_id = -1;
+    status = pj_thread_local_alloc(&endpt->pool_tls_id);
+    if (status != PJ_SUCCESS) {
+	endpt->pool_tls_id = -1;
+	goto on_error;
+    }
+
     /* Create timer heap to manage all timers within this endpoint. */
-    status = pj_timer_heap_create( endpt->pool, PJSIP_MAX_TIMER_COUNT, 
-                                   &endpt->timer_heap);
+    status = pj_timer_heap_create_sharded( endpt->pool, PJSIP_MAX_TIMER_COUNT,
+					   PJSIP_TIMER_HEAP_SHARD_CNT,
+					   &endpt->timer_heap);
     if (status != PJ_SUCCESS) {
 	goto on_error;
     }
@@ -505,7 +604,9 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
 					     PJSIP_MAX_TIMED_OUT_ENTRIES);
 
     /* Create ioqueue. */
-    status = pj_ioqueue_create( endpt->pool, PJSIP_MAX_TRANSPORTS, &endpt->ioqueue);
+    status = pj_ioqueue_create_sharded( endpt->pool, PJSIP_MAX_TRANSPORTS,
+					PJSIP_IOQUEUE_SHARD_CNT,
+					&endpt->ioqueue);
     if (status != PJ_SUCCESS) {
 	goto on_error;
     }
@@ -537,12 +638,19 @@ PJ_DEF(pj_status_t) pjsip_endpt_create(pj_pool_factory *pf,
     /* Initialize capability header list. */
     pj_list_init(&endpt->cap_hdr);
 
+    /* Start rx workers, if configured. */
+    status = start_rx_workers(endpt, pjsip_cfg()->endpt.rx_worker_cnt);
+    if (status != PJ_SUCCESS) {
+	goto on_error;
+    }
+
 
     /* Done. */
     *p_endpt = endpt;
     return status;
 
 on_error:
+    stop_rx_workers(endpt);
     if (endpt->transport_mgr) {
 	pjsip_tpmgr_destroy(endpt->transport_mgr);
 	endpt->transport_mgr = NULL;
@@ -555,6 +663,10 @@ on_error:
 	pj_timer_heap_destroy(endpt->timer_heap);
 	endpt->timer_heap = NULL;
     }
+    if (endpt->pool_tls_id != -1) {
+	pj_thread_local_free(endpt->pool_tls_id);
+	endpt->pool_tls_id = -1;
+    }
     if (endpt->mutex) {
 	pj_mutex_destroy(endpt->mutex);
 	endpt->mutex = NULL;
@@ -564,6 +676,10 @@ on_error:
 	pj_rwmutex_destroy(endpt->mod_mutex);
 	endpt->mod_mutex = NULL;
     }
+    if (endpt->rx_worker_lock) {
+	pj_rwmutex_destroy(endpt->rx_worker_lock);
+	endpt->rx_worker_lock = NULL;
+    }
     pj_pool_release( endpt->pool );
 
     PJ_LOG(4, (THIS_FILE, "Error creating endpoint"));
@@ -580,6 +696,9 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 
     PJ_LOG(5, (THIS_FILE, "Destroying endpoing instance.."));
 
+    /* Stop rx workers first, since they call the modules. */
+    stop_rx_workers(endpt);
+
     /* Phase 1: stop all modules */
     mod = endpt->module_list.prev;
     while (mod != &endpt->module_list) {
@@ -620,6 +739,10 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 	ecb = ecb->next;
     }
 
+    /* Release the pools kept in the free lists */
+    release_pool_free_lists(endpt);
+    pj_thread_local_free(endpt->pool_tls_id);
+
     /* Delete endpoint mutex. */
     pj_mutex_destroy(endpt->mutex);
 
@@ -628,6 +751,7 @@ PJ_DEF(void) pjsip_endpt_destroy(pjsip_endpoint *endpt)
 
     /* Delete module's mutex */
     pj_rwmutex_destroy(endpt->mod_mutex);
+    pj_rwmutex_destroy(endpt->rx_worker_lock);
 
     /* Finally destroy pool. */
     pj_pool_release(endpt->pool);
@@ -912,6 +1036,243 @@ on_return:
     return status;
 }
 
+/* Rx worker thread. */
+static int rx_worker_thread(void *arg)
+{
+    rx_worker *w = (rx_worker*) arg;
+
+    for (;;) {
+	rx_job *job;
+
+	pj_sem_wait(w->sem);
+
+	pj_mutex_lock(w->mutex);
+	if (pj_list_empty(&w->queue)) {
+	    pj_bool_t quit = w->quit;
+	    pj_mutex_unlock(w->mutex);
+	    if (quit)
+		break;
+	    continue;
+	}
+	job = w->queue.next;
+	pj_list_erase(job);
+	--w->queue_len;
+	pj_mutex_unlock(w->mutex);
+
+	process_rx_msg(w->endpt, job->rdata);
+
+	/* The job is allocated from the pool of the cloned rdata */
+	pjsip_rx_data_free_cloned(job->rdata);
+    }
+
+    pjsip_endpt_release_thread_pools(w->endpt);
+    return 0;
+}
+
+/* Stop the threads of the rx workers, and release their resources. The
+ * workers must not be reachable by the receiving threads anymore.
+ */
+static void destroy_rx_workers(pjsip_endpoint *endpt, rx_worker *workers,
+			       unsigned cnt, pj_pool_t *pool)
+{
+    unsigned i;
+
+    for (i=0; i<cnt; ++i) {
+	rx_worker *w = &workers[i];
+
+	pj_mutex_lock(w->mutex);
+	w->quit = PJ_TRUE;
+	pj_mutex_unlock(w->mutex);
+	pj_sem_post(w->sem);
+    }
+
+    for (i=0; i<cnt; ++i) {
+	rx_worker *w = &workers[i];
+
+	pj_thread_join(w->thread);
+	pj_thread_destroy(w->thread);
+	pj_sem_destroy(w->sem);
+	pj_mutex_destroy(w->mutex);
+    }
+
+    pjsip_endpt_release_pool(endpt, pool);
+}
+
+/* Create and start rx workers. */
+static pj_status_t start_rx_workers(pjsip_endpoint *endpt, unsigned cnt)
+{
+    pj_pool_t *pool;
+    rx_worker *workers;
+    unsigned i, started = 0;
+    pj_status_t status = PJ_SUCCESS;
+
+    if (cnt == 0)
+	return PJ_SUCCESS;
+
+    /* The workers are allocated from their own pool, which is released
+     * when they are stopped, so changing the number of workers doesn't
+     * leak memory.
+     */
+    pool = pjsip_endpt_create_pool(endpt, "rxw%p", 512, 512);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    workers = (rx_worker*) pj_pool_calloc(pool, cnt, sizeof(rx_worker));
+
+    for (i=0; i<cnt; ++i) {
+	rx_worker *w = &workers[i];
+
+	w->endpt = endpt;
+	pj_list_init(&w->queue);
+
+	status = pj_mutex_create_simple(pool, "rxw%p", &w->mutex);
+	if (status != PJ_SUCCESS)
+	    break;
+
+	status = pj_sem_create(pool, "rxw%p", 0,
+			       PJSIP_RX_WORKER_MAX_QUEUE + 1, &w->sem);
+	if (status != PJ_SUCCESS) {
+	    pj_mutex_destroy(w->mutex);
+	    break;
+	}
+
+	status = pj_thread_create(pool, "rxw%p", &rx_worker_thread,
+				  w, 0, 0, &w->thread);
+	if (status != PJ_SUCCESS) {
+	    pj_sem_destroy(w->sem);
+	    pj_mutex_destroy(w->mutex);
+	    break;
+	}
+
+	++started;
+    }
+
+    if (status != PJ_SUCCESS) {
+	/* Only started workers are destroyed */
+	destroy_rx_workers(endpt, workers, started, pool);
+	return status;
+    }
+
+    /* Make the workers visible to the receiving threads */
+    pj_rwmutex_lock_write(endpt->rx_worker_lock);
+    endpt->rx_workers = workers;
+    endpt->rx_worker_pool = pool;
+    endpt->rx_worker_cnt = cnt;
+    pj_rwmutex_unlock_write(endpt->rx_worker_lock);
+
+    PJ_LOG(4, (THIS_FILE, "Started %d rx worker(s)", cnt));
+
+    return PJ_SUCCESS;
+}
+
+/* Stop rx workers after they have processed their queues. */
+static void stop_rx_workers(pjsip_endpoint *endpt)
+{
+    rx_worker *workers;
+    pj_pool_t *pool;
+    unsigned cnt;
+
+    if (endpt->rx_worker_lock == NULL)
+	return;
+
+    /* Block new dispatch first, so that new messages are processed by
+     * the receiving thread. Once the write lock is acquired, no receiving
+     * thread is queueing to the workers anymore.
+     */
+    pj_rwmutex_lock_write(endpt->rx_worker_lock);
+    workers = endpt->rx_workers;
+    pool = endpt->rx_worker_pool;
+    cnt = endpt->rx_worker_cnt;
+    endpt->rx_workers = NULL;
+    endpt->rx_worker_pool = NULL;
+    endpt->rx_worker_cnt = 0;
+    pj_rwmutex_unlock_write(endpt->rx_worker_lock);
+
+    if (workers == NULL)
+	return;
+
+    destroy_rx_workers(endpt, workers, cnt, pool);
+}
+
+/*
+ * Change the number of rx workers.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_set_rx_worker_cnt(pjsip_endpoint *endpt,
+						  unsigned cnt)
+{
+    PJ_ASSERT_RETURN(endpt, PJ_EINVAL);
+
+    stop_rx_workers(endpt);
+    return start_rx_workers(endpt, cnt);
+}
+
+/* Queue incoming message to the rx worker of its Call-ID. Returns PJ_FALSE
+ * if the message must be processed by the calling thread instead.
+ */
+static pj_bool_t queue_rx_msg(pjsip_endpoint *endpt, pjsip_rx_data *rdata)
+{
+    const pj_str_t *call_id = &rdata->msg_info.cid->id;
+    rx_worker *w;
+    pjsip_rx_data *clone;
+    rx_job *job;
+    unsigned cnt;
+    pj_bool_t queued = PJ_FALSE;
+    pj_bool_t full = PJ_FALSE;
+
+    /* Clone the rdata, since transport will reuse the buffer as soon as
+     * we return.
+     */
+    if (pjsip_rx_data_clone(rdata, PJSIP_RX_DATA_CLONE_SHARED,
+			    &clone) != PJ_SUCCESS)
+    {
+	return PJ_FALSE;
+    }
+
+    job = PJ_POOL_ALLOC_T(clone->tp_info.pool, rx_job);
+    job->rdata = clone;
+
+    /* The workers can't be stopped while the read lock is held */
+    pj_rwmutex_lock_read(endpt->rx_worker_lock);
+
+    cnt = endpt->rx_worker_cnt;
+    if (cnt) {
+	/* Messages with the same Call-ID always go to the same worker so
+	 * that they are processed in order.
+	 */
+	w = &endpt->rx_workers[pj_hash_calc_seeded(call_id->ptr,
+						   (unsigned)call_id->slen) %
+			       cnt];
+
+	pj_mutex_lock(w->mutex);
+	full = (w->queue_len >= PJSIP_RX_WORKER_MAX_QUEUE);
+	if (!w->quit && !full) {
+	    pj_list_push_back(&w->queue, job);
+	    ++w->queue_len;
+	    queued = PJ_TRUE;
+	}
+	pj_mutex_unlock(w->mutex);
+
+	if (queued)
+	    pj_sem_post(w->sem);
+    }
+
+    pj_rwmutex_unlock_read(endpt->rx_worker_lock);
+
+    if (queued)
+	return PJ_TRUE;
+
+    pjsip_rx_data_free_cloned(clone);
+
+    if (full) {
+	PJ_LOG(2, (THIS_FILE, "Dropping %s from %s:%d: rx worker queue is "
+		   "full", pjsip_rx_data_get_info(rdata),
+		   rdata->pkt_info.src_name, rdata->pkt_info.src_port));
+	return PJ_TRUE;
+    }
+
+    return PJ_FALSE;
+}
+
 /*
  * This is the callback that is called by the transport manager when it 
  * receives a message from the network.
@@ -920,12 +1281,6 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
 			     pj_status_t status,
 			     pjsip_rx_data *rdata )
 {
-    pjsip_msg *msg = rdata->msg_info.msg;
-    pjsip_process_rdata_param proc_prm;
-    pj_bool_t handled = PJ_FALSE;
-
-    PJ_UNUSED_ARG(msg);
-
     if (status != PJ_SUCCESS) {
 	char info[30];
 	char errmsg[PJ_ERR_MSG_SIZE];
@@ -967,6 +1322,27 @@ static void endpt_on_rx_msg( pjsip_endpoint *endpt,
 	return;
     }
 
+    /* Let rx worker process the message, if enabled. The unlocked check
+     * only avoids cloning when there are no workers; queue_rx_msg() checks
+     * again under the lock.
+     */
+    if (endpt->rx_worker_cnt && queue_rx_msg(endpt, rdata))
+	return;
+
+    process_rx_msg(endpt, rdata);
+}
+
+/*
+ * Distribute the incoming message to modules.
+ */
+static void process_rx_msg( pjsip_endpoint *endpt, pjsip_rx_data *rdata )
+{
+    pjsip_msg *msg = rdata->msg_info.msg;
+    pjsip_process_rdata_param proc_prm;
+    pj_bool_t handled = PJ_FALSE;
+
+    PJ_UNUSED_ARG(msg);
+
     PJ_LOG(5, (THIS_FILE, "Processing incoming message: %s", 
 	       pjsip_rx_data_get_info(rdata)));
     pj_log_push_indent();
@@ -1253,6 +1629,225 @@ PJ_DEF(void) pjsip_endpt_log_error(  pjsip_endpoint *endpt,
 }
 
 
+/* Sizes of the pools of pjsip_endpt_pool_type. */
+static const struct
+{
+    pj_size_t	initial;
+    pj_size_t	increment;
+} pool_sizes[PJSIP_ENDPT_POOL_TYPE_COUNT] =
+{
+    { PJSIP_POOL_LEN_TDATA, PJSIP_POOL_INC_TDATA },
+    { PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC },
+    { PJSIP_POOL_LEN_DIALOG, PJSIP_POOL_INC_DIALOG }
+};
+
+/* Get the pool free list of the calling thread. */
+static pool_free_list *get_pool_free_list(pjsip_endpoint *endpt)
+{
+    pool_free_list *fl;
+
+    fl = (pool_free_list*) pj_thread_local_get(endpt->pool_tls_id);
+    if (fl)
+	return (fl == &endpt->pool_free_lists) ? NULL : fl;
+
+    /* First use in this thread, take an unused free list or create a new
+     * one as long as the limit has not been reached.
+     */
+    pj_mutex_lock(endpt->mutex);
+    for (fl=endpt->pool_free_lists.next; fl!=&endpt->pool_free_lists;
+	 fl=fl->next)
+    {
+	if (!fl->in_use)
+	    break;
+    }
+    if (fl == &endpt->pool_free_lists) {
+	if (endpt->pool_free_list_cnt < PJSIP_POOL_FREE_LIST_MAX_THREADS) {
+	    fl = PJ_POOL_ZALLOC_T(endpt->pool, pool_free_list);
+	    pj_list_push_back(&endpt->pool_free_lists, fl);
+	    ++endpt->pool_free_list_cnt;
+	} else {
+	    fl = NULL;
+	}
+    }
+    if (fl)
+	fl->in_use = PJ_TRUE;
+    pj_mutex_unlock(endpt->mutex);
+
+    /* Without a free list, remember it too so that the lookup above is
+     * not repeated for every pool.
+     */
+    if (pj_thread_local_set(endpt->pool_tls_id,
+			    fl ? fl : &endpt->pool_free_lists) != PJ_SUCCESS)
+    {
+	if (fl) {
+	    pj_mutex_lock(endpt->mutex);
+	    fl->in_use = PJ_FALSE;
+	    pj_mutex_unlock(endpt->mutex);
+	}
+	return NULL;
+    }
+
+    return fl;
+}
+
+/* Release the pools in a free list. */
+static void flush_pool_free_list(pool_free_list *fl)
+{
+#if PJSIP_POOL_FREE_LIST_SIZE
+    unsigned i;
+
+    for (i=0; i<PJSIP_ENDPT_POOL_TYPE_COUNT; ++i) {
+	unsigned count = fl->type[i].count;
+
+	while (count)
+	    pj_pool_release(fl->type[i].pool[--count]);
+	STAT_STORE(fl->type[i].count, 0);
+    }
+#else
+    PJ_UNUSED_ARG(fl);
+#endif
+}
+
+/* Release all pools in the free lists, called when endpoint is destroyed. */
+static void release_pool_free_lists(pjsip_endpoint *endpt)
+{
+    pool_free_list *fl;
+
+    for (fl=endpt->pool_free_lists.next; fl!=&endpt->pool_free_lists;
+	 fl=fl->next)
+    {
+	flush_pool_free_list(fl);
+    }
+}
+
+/*
+ * Release the pool free list of the calling thread.
+ */
+PJ_DEF(void) pjsip_endpt_release_thread_pools( pjsip_endpoint *endpt )
+{
+    pool_free_list *fl;
+
+    PJ_ASSERT_ON_FAIL(endpt, return);
+
+    fl = (pool_free_list*) pj_thread_local_get(endpt->pool_tls_id);
+    if (fl) {
+	pj_thread_local_set(endpt->pool_tls_id, NULL);
+	if (fl != &endpt->pool_free_lists) {
+	    flush_pool_free_list(fl);
+
+	    pj_mutex_lock(endpt->mutex);
+	    fl->in_use = PJ_FALSE;
+	    pj_mutex_unlock(endpt->mutex);
+	}
+    }
+
+    /* Also give back the pools cached by the pool factory */
+    pj_pool_factory_release_thread(endpt->pf);
+}
+
+/*
+ * Get a pool from the free list of the calling thread.
+ */
+PJ_DEF(pj_pool_t*) pjsip_endpt_acquire_pool( pjsip_endpoint *endpt,
+					     pjsip_endpt_pool_type type,
+					     const char *pool_name )
+{
+    pool_free_list *fl;
+
+    PJ_ASSERT_RETURN(endpt && type < PJSIP_ENDPT_POOL_TYPE_COUNT, NULL);
+
+    fl = get_pool_free_list(endpt);
+    if (!fl) {
+	return pjsip_endpt_create_pool(endpt, pool_name,
+				       pool_sizes[type].initial,
+				       pool_sizes[type].increment);
+    }
+
+#if PJSIP_POOL_FREE_LIST_SIZE
+    if (fl->type[type].count) {
+	unsigned count = fl->type[type].count - 1;
+	pj_pool_t *pool = fl->type[type].pool[count];
+
+	STAT_STORE(fl->type[type].count, count);
+	STAT_INC(fl->type[type].stat.hit);
+	if (pool_name) {
+	    if (pj_ansi_strchr(pool_name, '%'))
+		pj_ansi_snprintf(pool->obj_name, sizeof(pool->obj_name),
+				 pool_name, pool);
+	    else
+		pj_ansi_strncpy(pool->obj_name, pool_name,
+				sizeof(pool->obj_name)-1);
+	}
+	return pool;
+    }
+#endif
+
+    STAT_INC(fl->type[type].stat.miss);
+    return pjsip_endpt_create_pool(endpt, pool_name,
+				   pool_sizes[type].initial,
+				   pool_sizes[type].increment);
+}
+
+/*
+ * Put back the pool to the free list of the calling thread.
+ */
+PJ_DEF(void) pjsip_endpt_recycle_pool( pjsip_endpoint *endpt,
+				       pjsip_endpt_pool_type type,
+				       pj_pool_t *pool )
+{
+    pool_free_list *fl;
+
+    PJ_ASSERT_ON_FAIL(endpt && type < PJSIP_ENDPT_POOL_TYPE_COUNT && pool,
+		      return);
+
+    fl = get_pool_free_list(endpt);
+    if (!fl) {
+	pjsip_endpt_release_pool(endpt, pool);
+	return;
+    }
+
+#if PJSIP_POOL_FREE_LIST_SIZE
+    if (fl->type[type].count < PJSIP_POOL_FREE_LIST_SIZE) {
+	pj_pool_reset(pool);
+	fl->type[type].pool[fl->type[type].count] = pool;
+	STAT_STORE(fl->type[type].count, fl->type[type].count + 1);
+	STAT_INC(fl->type[type].stat.recycled);
+	return;
+    }
+#endif
+
+    STAT_INC(fl->type[type].stat.released);
+    pjsip_endpt_release_pool(endpt, pool);
+}
+
+/*
+ * Get statistics of the pool free lists.
+ */
+PJ_DEF(void) pjsip_endpt_get_pool_stat( pjsip_endpoint *endpt,
+					pjsip_endpt_pool_type type,
+					pjsip_endpt_pool_stat *stat )
+{
+    pool_free_list *fl;
+
+    PJ_ASSERT_ON_FAIL(endpt && type < PJSIP_ENDPT_POOL_TYPE_COUNT && stat,
+		      return);
+
+    pj_bzero(stat, sizeof(*stat));
+
+    pj_mutex_lock(endpt->mutex);
+    for (fl=endpt->pool_free_lists.next; fl!=&endpt->pool_free_lists;
+	 fl=fl->next)
+    {
+	stat->hit += STAT_LOAD(fl->type[type].stat.hit);
+	stat->miss += STAT_LOAD(fl->type[type].stat.miss);
+	stat->recycled += STAT_LOAD(fl->type[type].stat.recycled);
+	stat->released += STAT_LOAD(fl->type[type].stat.released);
+	stat->cached += STAT_LOAD(fl->type[type].count);
+    }
+    pj_mutex_unlock(endpt->mutex);
+}
+
+
 /*
  * Dump endpoint.
  */
@@ -1274,6 +1869,22 @@ PJ_DEF(void) pjsip_endpt_dump( pjsip_endpoint *endpt, pj_bool_t detail )
 	       pj_pool_get_capacity(endpt->pool),
 	       pj_pool_get_used_size(endpt->pool)));
 
+    /* Pool free lists. */
+    {
+	static const char *type_names[] = { "tdata", "tsx", "dialog" };
+	unsigned i;
+
+	for (i=0; i<PJSIP_ENDPT_POOL_TYPE_COUNT; ++i) {
+	    pjsip_endpt_pool_stat stat;
+
+	    pjsip_endpt_get_pool_stat(endpt, (pjsip_endpt_pool_type)i, &stat);
+	    PJ_LOG(3, (THIS_FILE," Free list of %s pools: hit=%u, miss=%u, "
+		       "recycled=%u, released=%u, cached=%u",
+		       type_names[i], stat.hit, stat.miss, stat.recycled,
+		       stat.released, stat.cached));
+	}
+    }
+
     /* Resolver */
 #if PJSIP_HAS_RESOLVER
     if (pjsip_endpt_get_resolver(endpt)) {
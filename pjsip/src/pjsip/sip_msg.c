@@ -293,6 +293,9 @@ PJ_DEF(int) pjsip_method_cmp( const pjsip_method *m1, const pjsip_method *m2)
  * Message.
  */
 
+static pjsip_hdr_vptr generic_hdr_vptr;
+static pjsip_hdr_vptr lazy_hdr_vptr;
+
 PJ_DEF(pjsip_msg*) pjsip_msg_create( pj_pool_t *pool, pjsip_msg_type_e type)
 {
     pjsip_msg *msg = PJ_POOL_ALLOC_T(pool, pjsip_msg);
@@ -335,6 +338,25 @@ PJ_DEF(pjsip_msg*) pjsip_msg_clone( pj_pool_t *pool, const pjsip_msg *src)
     return dst;
 }
 
+/* Parse a lazy header and replace it in the header list with the parsed
+ * header(s). Returns NULL if the header can't be parsed, in which case it
+ * is left in the list as a generic string header.
+ */
+static pjsip_hdr* parse_lazy_hdr(pjsip_hdr *hdr)
+{
+    pjsip_hdr *parsed;
+
+    parsed = (pjsip_hdr*) pjsip_parse_lazy_hdr((pjsip_lazy_hdr*)hdr);
+    if (parsed == NULL) {
+	hdr->vptr = &generic_hdr_vptr;
+	return NULL;
+    }
+
+    pj_list_insert_nodes_before(hdr, parsed);
+    pj_list_erase(hdr);
+    return parsed;
+}
+
 PJ_DEF(void*)  pjsip_msg_find_hdr( const pjsip_msg *msg, 
 				   pjsip_hdr_e hdr_type, const void *start)
 {
@@ -346,6 +368,13 @@ PJ_DEF(void*)  pjsip_msg_find_hdr( const pjsip_msg *msg,
     for (; hdr!=end; hdr = hdr->next) {
 	if (hdr->type == hdr_type)
 	    return (void*)hdr;
+	if (hdr->vptr == &lazy_hdr_vptr &&
+	    ((const pjsip_lazy_hdr*)hdr)->parsed_type == hdr_type)
+	{
+	    pjsip_hdr *parsed = parse_lazy_hdr((pjsip_hdr*)hdr);
+	    if (parsed)
+		return parsed;
+	}
     }
     return NULL;
 }
@@ -360,8 +389,15 @@ PJ_DEF(void*)  pjsip_msg_find_hdr_by_name( const pjsip_msg *msg,
 	hdr = msg->hdr.next;
     }
     for (; hdr!=end; hdr = hdr->next) {
-	if (pj_stricmp(&hdr->name, name) == 0)
-	    return (void*)hdr;
+	if (pj_stricmp(&hdr->name, name) == 0) {
+	    if (hdr->vptr != &lazy_hdr_vptr)
+		return (void*)hdr;
+	    else {
+		pjsip_hdr *parsed = parse_lazy_hdr((pjsip_hdr*)hdr);
+		if (parsed)
+		    return parsed;
+	    }
+	}
     }
     return NULL;
 }
@@ -377,10 +413,17 @@ PJ_DEF(void*)  pjsip_msg_find_hdr_by_names( const pjsip_msg *msg,
 	hdr = msg->hdr.next;
     }
     for (; hdr!=end; hdr = hdr->next) {
-	if (pj_stricmp(&hdr->name, name) == 0)
-	    return (void*)hdr;
-	if (pj_stricmp(&hdr->name, sname) == 0)
-	    return (void*)hdr;
+	if (pj_stricmp(&hdr->name, name) == 0 ||
+	    pj_stricmp(&hdr->name, sname) == 0)
+	{
+	    if (hdr->vptr != &lazy_hdr_vptr)
+		return (void*)hdr;
+	    else {
+		pjsip_hdr *parsed = parse_lazy_hdr((pjsip_hdr*)hdr);
+		if (parsed)
+		    return parsed;
+	    }
+	}
     }
     return NULL;
 }
@@ -395,24 +438,24 @@ PJ_DEF(void*) pjsip_msg_find_remove_hdr( pjsip_msg *msg,
     return hdr;
 }
 
-PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg, 
-				    char *buf, pj_size_t size)
+PJ_DEF(void) pjsip_msg_parse_lazy_hdrs( pjsip_msg *msg )
 {
-    char *p=buf, *end=buf+size;
-    pj_ssize_t len;
-    pjsip_hdr *hdr;
-    pj_str_t clen_hdr =  { "Content-Length: ", 16};
+    pjsip_hdr *hdr = msg->hdr.next;
 
-    if (pjsip_use_compact_form) {
-	clen_hdr.ptr = "l: ";
-	clen_hdr.slen = 3;
+    while (hdr != &msg->hdr) {
+	pjsip_hdr *next = hdr->next;
+
+	if (hdr->vptr == &lazy_hdr_vptr)
+	    parse_lazy_hdr(hdr);
+	hdr = next;
     }
+}
 
-    /* Get a wild guess on how many bytes are typically needed.
-     * We'll check this later in detail, but this serves as a quick check.
-     */
-    if (size < 256)
-	return -1;
+PJ_DEF(pj_ssize_t) pjsip_msg_print_start_line( const pjsip_msg *msg,
+					       char *buf, pj_size_t size)
+{
+    char *p=buf, *end=buf+size;
+    pj_ssize_t len;
 
     /* Print request line or status line depending on message type */
     if (msg->type == PJSIP_REQUEST_MSG) {
@@ -420,6 +463,8 @@ PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg,
 
 	/* Add method. */
 	len = msg->line.req.method.name.slen;
+	if (end-p < len+1)
+	    return -1;
 	pj_memcpy(p, msg->line.req.method.name.ptr, len);
 	p += len;
 	*p++ = ' ';
@@ -439,39 +484,39 @@ PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg,
 
     } else {
 
-	/* Add 'SIP/2.0 ' */
+	/* Add 'SIP/2.0 ', status code, reason text, and newline. */
+	len = msg->line.status.reason.slen;
+	if (end-p < 8 + 12 + len + 2)
+	    return -1;
+
 	pj_memcpy(p, "SIP/2.0 ", 8);
 	p += 8;
 
-	/* Add status code. */
 	len = pj_utoa(msg->line.status.code, p);
 	p += len;
 	*p++ = ' ';
 
-	/* Add reason text. */
 	len = msg->line.status.reason.slen;
 	pj_memcpy(p, msg->line.status.reason.ptr, len );
 	p += len;
 
-	/* Add newline. */
 	*p++ = '\r';
 	*p++ = '\n';
     }
 
-    /* Print each of the headers. */
-    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
-	len = pjsip_hdr_print_on(hdr, p, end-p);
-	if (len < 0)
-	    return -1;
+    return p-buf;
+}
 
-	if (len > 0) {
-	    p += len;
-	    if (p+3 >= end)
-		return -1;
+PJ_DEF(pj_ssize_t) pjsip_msg_print_body_part( const pjsip_msg *msg,
+					      char *buf, pj_size_t size)
+{
+    char *p=buf, *end=buf+size;
+    pj_ssize_t len;
+    pj_str_t clen_hdr =  { "Content-Length: ", 16};
 
-	    *p++ = '\r';
-	    *p++ = '\n';
-	}
+    if (pjsip_use_compact_form) {
+	clen_hdr.ptr = "l: ";
+	clen_hdr.slen = 3;
     }
 
     /* Process message body. */
@@ -520,6 +565,9 @@ PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg,
 	}
 	
 	/* Add blank newline. */
+	if ((end-p) < 3) {
+	    return -1;
+	}
 	*p++ = '\r';
 	*p++ = '\n';
 
@@ -557,10 +605,57 @@ PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg,
 	*p++ = '\n';
     }
 
+    if (p == end)
+	return -1;
+
     *p = '\0';
     return p-buf;
 }
 
+PJ_DEF(pj_ssize_t) pjsip_msg_print( const pjsip_msg *msg, 
+				    char *buf, pj_size_t size)
+{
+    char *p=buf, *end=buf+size;
+    pj_ssize_t len;
+    pjsip_hdr *hdr;
+
+    /* Get a wild guess on how many bytes are typically needed.
+     * We'll check this later in detail, but this serves as a quick check.
+     */
+    if (size < 256)
+	return -1;
+
+    /* Print request line or status line depending on message type */
+    len = pjsip_msg_print_start_line(msg, p, end-p);
+    if (len < 0)
+	return -1;
+    p += len;
+
+    /* Print each of the headers. */
+    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next) {
+	len = pjsip_hdr_print_on(hdr, p, end-p);
+	if (len < 0)
+	    return -1;
+
+	if (len > 0) {
+	    p += len;
+	    if (p+3 >= end)
+		return -1;
+
+	    *p++ = '\r';
+	    *p++ = '\n';
+	}
+    }
+
+    /* Process message body, and the headers generated from it. */
+    len = pjsip_msg_print_body_part(msg, p, end-p);
+    if (len < 0)
+	return -1;
+    p += len;
+
+    return p-buf;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 PJ_DEF(void*) pjsip_hdr_clone( pj_pool_t *pool, const void *hdr_ptr )
 {
@@ -694,6 +789,18 @@ static pjsip_hdr_vptr generic_hdr_vptr =
     (pjsip_hdr_print_fptr) &pjsip_generic_string_hdr_print,
 };
 
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool,
+					     const pjsip_lazy_hdr *hdr);
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+						     const pjsip_lazy_hdr *hdr);
+
+static pjsip_hdr_vptr lazy_hdr_vptr = 
+{
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_clone,
+    (pjsip_hdr_clone_fptr) &pjsip_lazy_hdr_shallow_clone,
+    (pjsip_hdr_print_fptr) &pjsip_generic_string_hdr_print,
+};
+
 
 PJ_DEF(void) pjsip_generic_string_hdr_init2(pjsip_generic_string_hdr *hdr,
 					    pj_str_t *hname,
@@ -785,6 +892,48 @@ static pjsip_generic_string_hdr* pjsip_generic_string_hdr_shallow_clone( pj_pool
     return hdr;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+/*
+ * Lazy header.
+ */
+
+PJ_DEF(pjsip_lazy_hdr*) pjsip_lazy_hdr_create(pj_pool_t *pool)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ZALLOC_T(pool, pjsip_lazy_hdr);
+
+    init_hdr(hdr, PJSIP_H_OTHER, &lazy_hdr_vptr);
+    hdr->parsed_type = PJSIP_H_OTHER;
+    hdr->pool = pool;
+    return hdr;
+}
+
+PJ_DEF(pj_bool_t) pjsip_hdr_is_lazy(const pjsip_hdr *hdr)
+{
+    return hdr->vptr == &lazy_hdr_vptr;
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_clone( pj_pool_t *pool,
+					     const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = pjsip_lazy_hdr_create(pool);
+
+    pj_strdup(pool, &hdr->name, &rhs->name);
+    pj_strdup(pool, &hdr->sname, &rhs->sname);
+    pj_strdup(pool, &hdr->hvalue, &rhs->hvalue);
+    hdr->parsed_type = rhs->parsed_type;
+    hdr->parse = rhs->parse;
+    return hdr;
+}
+
+static pjsip_lazy_hdr* pjsip_lazy_hdr_shallow_clone( pj_pool_t *pool,
+						     const pjsip_lazy_hdr *rhs)
+{
+    pjsip_lazy_hdr *hdr = PJ_POOL_ALLOC_T(pool, pjsip_lazy_hdr);
+    pj_memcpy(hdr, rhs, sizeof(*hdr));
+    hdr->pool = pool;
+    return hdr;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 /*
  * Generic pjsip_hdr_names/integer value header.
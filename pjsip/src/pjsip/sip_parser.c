@@ -57,11 +57,54 @@
  */
 #define GENERIC_URI_CHARS   "#?;:@&=+-_.!~*'()%$,/" "%"
 
-#define UNREACHED(expr)
-
 #define IS_NEWLINE(c)	((c)=='\r' || (c)=='\n')
 #define IS_SPACE(c)	((c)==' ' || (c)=='\t')
 
+/* Error handling of the parser entry points. Without exception, syntax
+ * error is recorded in the scanner by on_syntax_error(), the parser
+ * functions return early when PARSE_FAILED(), and the "catch" block is
+ * run if the scanner has recorded an error. The entry points still catch
+ * exception thrown by the pool callback on allocation failure (such as
+ * the endpoint's), which is recorded in the scanner as well, since the
+ * parser can't continue with NULL allocation.
+ */
+#if PJSIP_PARSER_USE_EXCEPTION
+#   define PARSE_USE_EXCEPTION	    PJ_USE_EXCEPTION
+#   define PARSE_TRY(scanner)	    PJ_TRY
+#   define PARSE_CATCH(scanner)	    PJ_CATCH_ANY
+#   define PARSE_END		    PJ_END
+#   define PARSE_EXCEPTION	    PJ_GET_EXCEPTION()
+#   define PARSE_FAILED(scanner)    0
+#else
+#   define PARSE_USE_EXCEPTION	    PJ_USE_EXCEPTION; int parse_except_code
+#   define PARSE_TRY(scanner)	    parse_except_code = 0; PJ_TRY
+#   define PARSE_CATCH(scanner)	    PJ_CATCH_ANY { \
+					parse_except_code = PJ_GET_EXCEPTION(); \
+					pj_scan_set_error(scanner); \
+				    } \
+				    PJ_END \
+				    if (pj_scan_clear_error(scanner))
+#   define PARSE_END		    PJ_UNUSED_ARG(parse_except_code)
+#   define PARSE_EXCEPTION	    (parse_except_code ? parse_except_code : \
+				     PJSIP_SYN_ERR_EXCEPTION)
+#   define PARSE_FAILED(scanner)    pj_scan_has_error(scanner)
+#endif
+
+/*
+ * Registered header info, one for each header parser registration.
+ */
+typedef struct hdr_info
+{
+    char		  buf[2*(PJSIP_MAX_HNAME_LEN+1)];
+    pj_str_t		  name;	    /* Header name.			    */
+    pj_str_t		  sname;    /* Short name, or name if none.	    */
+    pjsip_hdr_e		  type;	    /* Type of the parsed header.	    */
+    pj_bool_t		  eager;    /* Always parse, even in lazy mode.	    */
+} hdr_info;
+
+static hdr_info hinfo[PJSIP_MAX_HEADER_TYPES];
+static unsigned hinfo_count;
+
 /*
  * Header parser records.
  */
@@ -71,10 +114,46 @@ typedef struct handler_rec
     pj_size_t		  hname_len;
     pj_uint32_t		  hname_hash;
     pjsip_parse_hdr_func *handler;
+    hdr_info		 *info;
 } handler_rec;
 
 static handler_rec handler[PJSIP_MAX_HEADER_TYPES];
 static unsigned handler_count;
+
+/*
+ * Built-in headers, which names are recognized by builtin_hdr_id() without
+ * hashing or searching the handler table.
+ */
+enum builtin_hdr_id
+{
+    BH_ACCEPT,
+    BH_ALLOW,
+    BH_AUTHORIZATION,
+    BH_CALL_ID,
+    BH_CONTACT,
+    BH_CONTENT_LENGTH,
+    BH_CONTENT_TYPE,
+    BH_CSEQ,
+    BH_EXPIRES,
+    BH_FROM,
+    BH_MAX_FORWARDS,
+    BH_MIN_EXPIRES,
+    BH_PROXY_AUTHENTICATE,
+    BH_PROXY_AUTHORIZATION,
+    BH_RECORD_ROUTE,
+    BH_REQUIRE,
+    BH_RETRY_AFTER,
+    BH_ROUTE,
+    BH_SUPPORTED,
+    BH_TO,
+    BH_UNSUPPORTED,
+    BH_VIA,
+    BH_WWW_AUTHENTICATE,
+
+    BH_COUNT
+};
+
+static handler_rec builtin_handler[BH_COUNT];
 static int parser_is_initialized;
 
 /*
@@ -121,7 +200,13 @@ static pj_cis_buf_t cis_buf;
 /*
  * Forward decl.
  */
+static pj_status_t  register_parser( const char *hname,
+				     const char *hshortname,
+				     pjsip_hdr_e type,
+				     pj_bool_t eager,
+				     pjsip_parse_hdr_func *fptr);
 static pjsip_msg *  int_parse_msg( pjsip_parse_ctx *ctx, 
+				   pj_bool_t lazy,
 				   pjsip_parser_err_report *err_list);
 static void	    int_parse_param( pj_scanner *scanner, 
 				     pj_pool_t *pool,
@@ -184,6 +269,8 @@ static pjsip_hdr*   parse_hdr_to( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_unsupported( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_via( pjsip_parse_ctx *ctx );
 static pjsip_hdr*   parse_hdr_generic_string( pjsip_parse_ctx *ctx);
+static pjsip_hdr*   parse_hdr_lazy( pjsip_parse_ctx *ctx,
+				    const handler_rec *rec);
 
 /* Convert non NULL terminated string to integer. */
 static unsigned long pj_strtoul_mindigit(const pj_str_t *str, 
@@ -228,8 +315,12 @@ PJ_INLINE(void) parser_get_and_unescape(pj_scanner *scanner, pj_pool_t *pool,
 /* Syntax error handler for parser. */
 static void on_syntax_error(pj_scanner *scanner)
 {
+#if PJSIP_PARSER_USE_EXCEPTION
     PJ_UNUSED_ARG(scanner);
     PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+#else
+    pj_scan_set_error(scanner);
+#endif
 }
 
 /* Get parser constants. */
@@ -405,68 +496,83 @@ static pj_status_t init_parser()
      * Register header parsers.
      */
 
-    status = pjsip_register_hdr_parser( "Accept", NULL, &parse_hdr_accept);
+    /* The headers that are needed for every message (these are the ones
+     * stored in rdata's msg_info) are always parsed, even in lazy mode.
+     */
+    status = register_parser( "Accept", NULL, PJSIP_H_ACCEPT,
+                              PJ_FALSE, &parse_hdr_accept);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Allow", NULL, &parse_hdr_allow);
+    status = register_parser( "Allow", NULL, PJSIP_H_ALLOW,
+                              PJ_FALSE, &parse_hdr_allow);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Call-ID", "i", &parse_hdr_call_id);
+    status = register_parser( "Call-ID", "i", PJSIP_H_CALL_ID,
+                              PJ_TRUE, &parse_hdr_call_id);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Contact", "m", &parse_hdr_contact);
+    status = register_parser( "Contact", "m", PJSIP_H_CONTACT,
+                              PJ_FALSE, &parse_hdr_contact);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Content-Length", "l", 
-                                        &parse_hdr_content_len);
+    status = register_parser( "Content-Length", "l", PJSIP_H_CONTENT_LENGTH,
+                              PJ_TRUE, &parse_hdr_content_len);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Content-Type", "c", 
-                                        &parse_hdr_content_type);
+    status = register_parser( "Content-Type", "c", PJSIP_H_CONTENT_TYPE,
+                              PJ_TRUE, &parse_hdr_content_type);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "CSeq", NULL, &parse_hdr_cseq);
+    status = register_parser( "CSeq", NULL, PJSIP_H_CSEQ,
+                              PJ_TRUE, &parse_hdr_cseq);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Expires", NULL, &parse_hdr_expires);
+    status = register_parser( "Expires", NULL, PJSIP_H_EXPIRES,
+                              PJ_FALSE, &parse_hdr_expires);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "From", "f", &parse_hdr_from);
+    status = register_parser( "From", "f", PJSIP_H_FROM,
+                              PJ_TRUE, &parse_hdr_from);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Max-Forwards", NULL, 
-                                        &parse_hdr_max_forwards);
+    status = register_parser( "Max-Forwards", NULL, PJSIP_H_MAX_FORWARDS,
+                              PJ_TRUE, &parse_hdr_max_forwards);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Min-Expires", NULL, 
-                                        &parse_hdr_min_expires);
+    status = register_parser( "Min-Expires", NULL, PJSIP_H_MIN_EXPIRES,
+                              PJ_FALSE, &parse_hdr_min_expires);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Record-Route", NULL, &parse_hdr_rr);
+    status = register_parser( "Record-Route", NULL, PJSIP_H_RECORD_ROUTE,
+                              PJ_TRUE, &parse_hdr_rr);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Route", NULL, &parse_hdr_route);
+    status = register_parser( "Route", NULL, PJSIP_H_ROUTE,
+                              PJ_TRUE, &parse_hdr_route);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Require", NULL, &parse_hdr_require);
+    status = register_parser( "Require", NULL, PJSIP_H_REQUIRE,
+                              PJ_TRUE, &parse_hdr_require);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Retry-After", NULL, 
-                                        &parse_hdr_retry_after);
+    status = register_parser( "Retry-After", NULL, PJSIP_H_RETRY_AFTER,
+                              PJ_FALSE, &parse_hdr_retry_after);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Supported", "k", 
-                                        &parse_hdr_supported);
+    status = register_parser( "Supported", "k", PJSIP_H_SUPPORTED,
+                              PJ_TRUE, &parse_hdr_supported);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "To", "t", &parse_hdr_to);
+    status = register_parser( "To", "t", PJSIP_H_TO,
+                              PJ_TRUE, &parse_hdr_to);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Unsupported", NULL, 
-                                        &parse_hdr_unsupported);
+    status = register_parser( "Unsupported", NULL, PJSIP_H_UNSUPPORTED,
+                              PJ_FALSE, &parse_hdr_unsupported);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
-    status = pjsip_register_hdr_parser( "Via", "v", &parse_hdr_via);
+    status = register_parser( "Via", "v", PJSIP_H_VIA,
+                              PJ_TRUE, &parse_hdr_via);
     PJ_ASSERT_RETURN(status == PJ_SUCCESS, status);
 
     /* 
@@ -494,6 +600,12 @@ void deinit_sip_parser(void)
 	/* Clear header handlers */
 	pj_bzero(handler, sizeof(handler));
 	handler_count = 0;
+	pj_bzero(builtin_handler, sizeof(builtin_handler));
+
+	/* The names in header info may still be referenced by lazy headers,
+	 * so just reset the count.
+	 */
+	hinfo_count = 0;
 
 	/* Clear URI handlers */
 	pj_bzero(uri_handler, sizeof(uri_handler));
@@ -538,7 +650,8 @@ PJ_INLINE(int) compare_handler( const handler_rec *r1,
 
 /* Register one handler for one header name. */
 static pj_status_t int_register_parser( const char *name, 
-                                        pjsip_parse_hdr_func *fptr )
+                                        pjsip_parse_hdr_func *fptr,
+					hdr_info *info )
 {
     unsigned	pos;
     handler_rec rec;
@@ -550,6 +663,7 @@ static pj_status_t int_register_parser( const char *name,
 
     /* Initialize temporary handler. */
     rec.handler = fptr;
+    rec.info = info;
     rec.hname_len = strlen(name);
     if (rec.hname_len >= sizeof(rec.hname)) {
 	pj_assert(!"Header name is too long!");
@@ -560,7 +674,7 @@ static pj_status_t int_register_parser( const char *name,
     rec.hname[rec.hname_len] = '\0';
 
     /* Calculate hash value. */
-    rec.hname_hash = pj_hash_calc(0, rec.hname, (unsigned)rec.hname_len);
+    rec.hname_hash = pj_hash_calc_seeded(rec.hname, (unsigned)rec.hname_len);
 
     /* Get the pos to insert the new handler. */
     for (pos=0; pos < handler_count; ++pos) {
@@ -588,30 +702,174 @@ static pj_status_t int_register_parser( const char *name,
     return PJ_SUCCESS;
 }
 
+/* Match header name case-insensitively against lowercase built-in name. */
+PJ_INLINE(pj_bool_t) builtin_hdr_match( const char *name, const char *lname,
+					pj_ssize_t len )
+{
+    pj_ssize_t i;
+
+    for (i=0; i<len; ++i) {
+	/* Setting the case bit folds uppercase letters to lowercase. Apart
+	 * from letters, only CR would fold to '-', and it can't appear in
+	 * header names.
+	 */
+	if ((name[i] | 0x20) != lname[i])
+	    return PJ_FALSE;
+    }
+    return PJ_TRUE;
+}
+
+/* Get the built-in header id of the header name, or -1. The header name is
+ * matched case-insensitively, and compact forms are recognized too. The
+ * switch on the length and first letter leaves at most two candidates.
+ */
+static int builtin_hdr_id( const char *name, pj_ssize_t len )
+{
+#define BH_MATCH(lname, id) \
+    if (builtin_hdr_match(name, lname, len)) return id
+
+    switch (len) {
+    case 1:
+	switch (name[0] | 0x20) {
+	case 'c': return BH_CONTENT_TYPE;
+	case 'f': return BH_FROM;
+	case 'i': return BH_CALL_ID;
+	case 'k': return BH_SUPPORTED;
+	case 'l': return BH_CONTENT_LENGTH;
+	case 'm': return BH_CONTACT;
+	case 't': return BH_TO;
+	case 'v': return BH_VIA;
+	}
+	break;
+    case 2:
+	BH_MATCH("to", BH_TO);
+	break;
+    case 3:
+	BH_MATCH("via", BH_VIA);
+	break;
+    case 4:
+	switch (name[0] | 0x20) {
+	case 'c': BH_MATCH("cseq", BH_CSEQ); break;
+	case 'f': BH_MATCH("from", BH_FROM); break;
+	}
+	break;
+    case 5:
+	switch (name[0] | 0x20) {
+	case 'a': BH_MATCH("allow", BH_ALLOW); break;
+	case 'r': BH_MATCH("route", BH_ROUTE); break;
+	}
+	break;
+    case 6:
+	BH_MATCH("accept", BH_ACCEPT);
+	break;
+    case 7:
+	switch (name[0] | 0x20) {
+	case 'c':
+	    BH_MATCH("call-id", BH_CALL_ID);
+	    BH_MATCH("contact", BH_CONTACT);
+	    break;
+	case 'e': BH_MATCH("expires", BH_EXPIRES); break;
+	case 'r': BH_MATCH("require", BH_REQUIRE); break;
+	}
+	break;
+    case 9:
+	BH_MATCH("supported", BH_SUPPORTED);
+	break;
+    case 11:
+	switch (name[0] | 0x20) {
+	case 'm': BH_MATCH("min-expires", BH_MIN_EXPIRES); break;
+	case 'r': BH_MATCH("retry-after", BH_RETRY_AFTER); break;
+	case 'u': BH_MATCH("unsupported", BH_UNSUPPORTED); break;
+	}
+	break;
+    case 12:
+	switch (name[0] | 0x20) {
+	case 'c': BH_MATCH("content-type", BH_CONTENT_TYPE); break;
+	case 'm': BH_MATCH("max-forwards", BH_MAX_FORWARDS); break;
+	case 'r': BH_MATCH("record-route", BH_RECORD_ROUTE); break;
+	}
+	break;
+    case 13:
+	BH_MATCH("authorization", BH_AUTHORIZATION);
+	break;
+    case 14:
+	BH_MATCH("content-length", BH_CONTENT_LENGTH);
+	break;
+    case 16:
+	BH_MATCH("www-authenticate", BH_WWW_AUTHENTICATE);
+	break;
+    case 18:
+	BH_MATCH("proxy-authenticate", BH_PROXY_AUTHENTICATE);
+	break;
+    case 19:
+	BH_MATCH("proxy-authorization", BH_PROXY_AUTHORIZATION);
+	break;
+    }
+    return -1;
+
+#undef BH_MATCH
+}
+
 /* Register parser handler. If both header name and short name are valid,
  * then two instances of handler will be registered.
  */
-PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
-					       const char *hshortname,
-					       pjsip_parse_hdr_func *fptr)
+static pj_status_t register_parser( const char *hname,
+				    const char *hshortname,
+				    pjsip_hdr_e type,
+				    pj_bool_t eager,
+				    pjsip_parse_hdr_func *fptr)
 {
     unsigned i;
-    pj_size_t len;
+    pj_size_t len, slen = 0;
     char hname_lcase[PJSIP_MAX_HNAME_LEN+1];
+    hdr_info *info;
+    int bh_id;
     pj_status_t status;
 
     /* Check that name is not too long */
     len = pj_ansi_strlen(hname);
-    if (len > PJSIP_MAX_HNAME_LEN) {
+    if (hshortname)
+	slen = pj_ansi_strlen(hshortname);
+    if (len > PJSIP_MAX_HNAME_LEN || slen > PJSIP_MAX_HNAME_LEN) {
 	pj_assert(!"Header name is too long!");
 	return PJ_ENAMETOOLONG;
     }
 
+    if (hinfo_count >= PJ_ARRAY_SIZE(hinfo)) {
+	pj_assert(!"Too many handlers!");
+	return PJ_ETOOMANY;
+    }
+
+    /* Init header info, which the header names of lazy headers point to */
+    info = &hinfo[hinfo_count];
+    pj_memcpy(info->buf, hname, len);
+    info->buf[len] = '\0';
+    info->name.ptr = info->buf;
+    info->name.slen = len;
+    if (hshortname) {
+	pj_memcpy(info->buf+len+1, hshortname, slen);
+	info->buf[len+1+slen] = '\0';
+	info->sname.ptr = info->buf+len+1;
+	info->sname.slen = slen;
+    } else {
+	info->sname = info->name;
+    }
+    info->type = type;
+    info->eager = eager;
+
     /* Register the normal Mixed-Case name */
-    status = int_register_parser(hname, fptr);
+    status = int_register_parser(hname, fptr, info);
     if (status != PJ_SUCCESS) {
 	return status;
     }
+    ++hinfo_count;
+
+    /* Built-in headers are also dispatched directly by find_handler() */
+    bh_id = builtin_hdr_id(hname, len);
+    if (bh_id >= 0) {
+	builtin_handler[bh_id].handler = fptr;
+	builtin_handler[bh_id].info = info;
+    }
 
     /* Get the lower-case name */
     for (i=0; i<len; ++i) {
@@ -620,7 +878,7 @@ PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
     hname_lcase[len] = '\0';
 
     /* Register the lower-case version of the name */
-    status = int_register_parser(hname_lcase, fptr);
+    status = int_register_parser(hname_lcase, fptr, info);
     if (status != PJ_SUCCESS) {
 	return status;
     }
@@ -628,17 +886,32 @@ PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
 
     /* Register the shortname version of the name */
     if (hshortname) {
-        status = int_register_parser(hshortname, fptr);
+        status = int_register_parser(hshortname, fptr, info);
         if (status != PJ_SUCCESS) 
 	    return status;
     }
     return PJ_SUCCESS;
 }
 
+PJ_DEF(pj_status_t) pjsip_register_hdr_parser( const char *hname,
+					       const char *hshortname,
+					       pjsip_parse_hdr_func *fptr)
+{
+    return register_parser(hname, hshortname, PJSIP_H_OTHER, PJ_FALSE, fptr);
+}
+
+PJ_DEF(pj_status_t) pjsip_register_hdr_parser2( const char *hname,
+						const char *hshortname,
+						pjsip_hdr_e type,
+						pjsip_parse_hdr_func *fptr)
+{
+    return register_parser(hname, hshortname, type, PJ_FALSE, fptr);
+}
+
 
 /* Find handler to parse the header name. */
-static pjsip_parse_hdr_func * find_handler_imp(pj_uint32_t  hash, 
-					       const pj_str_t *hname)
+static handler_rec* find_handler_imp(pj_uint32_t  hash, 
+				     const pj_str_t *hname)
 {
     handler_rec *first;
     int		 comp;
@@ -664,40 +937,62 @@ static pjsip_parse_hdr_func * find_handler_imp(pj_uint32_t  hash,
 	}
     }
 
-    return comp==0 ? first->handler : NULL;
+    return comp==0 ? first : NULL;
 }
 
 
 /* Find handler to parse the header name. */
-static pjsip_parse_hdr_func* find_handler(const pj_str_t *hname)
+static handler_rec* find_handler(const pj_str_t *hname)
 {
     pj_uint32_t hash;
     char hname_copy[PJSIP_MAX_HNAME_LEN];
     pj_str_t tmp;
-    pjsip_parse_hdr_func *func;
+    handler_rec *rec;
+    int bh_id;
 
     if (hname->slen >= PJSIP_MAX_HNAME_LEN) {
 	/* Guaranteed not to be able to find handler. */
         return NULL;
     }
 
-    /* First, common case, try to find handler with exact name */
-    hash = pj_hash_calc(0, hname->ptr, (unsigned)hname->slen);
-    func = find_handler_imp(hash, hname);
-    if (func)
-	return func;
+    /* Most headers are built-in ones, which can be found in one pass */
+    bh_id = builtin_hdr_id(hname->ptr, hname->slen);
+    if (bh_id >= 0 && builtin_handler[bh_id].handler)
+	return &builtin_handler[bh_id];
+
+    /* Otherwise try to find handler with exact name */
+    hash = pj_hash_calc_seeded(hname->ptr, (unsigned)hname->slen);
+    rec = find_handler_imp(hash, hname);
+    if (rec)
+	return rec;
 
 
     /* If not found, try converting the header name to lowercase and
      * search again.
      */
-    hash = pj_hash_calc_tolower(0, hname_copy, hname);
+    hash = pj_hash_calc_seeded_tolower(hname_copy, hname);
     tmp.ptr = hname_copy;
     tmp.slen = hname->slen;
     return find_handler_imp(hash, &tmp);
 }
 
 
+/* Request the header to be parsed fully even in lazy mode. */
+PJ_DEF(pj_status_t) pjsip_register_eager_hdr( const char *hname )
+{
+    handler_rec *rec;
+    pj_str_t name;
+
+    name = pj_str((char*)hname);
+    rec = find_handler(&name);
+    if (!rec)
+	return PJ_ENOTFOUND;
+
+    rec->info->eager = PJ_TRUE;
+    return PJ_SUCCESS;
+}
+
+
 /* Find URI handler. */
 static pjsip_parse_uri_func* find_uri_handler(const pj_str_t *scheme)
 {
@@ -727,6 +1022,15 @@ PJ_DEF(pj_status_t) pjsip_register_uri_parser( char *scheme,
 PJ_DEF(pjsip_msg*) pjsip_parse_msg( pj_pool_t *pool, 
                                     char *buf, pj_size_t size,
 				    pjsip_parser_err_report *err_list)
+{
+    return pjsip_parse_msg2(pool, buf, size, 0, err_list);
+}
+
+/* Public function to parse SIP message with options. */
+PJ_DEF(pjsip_msg*) pjsip_parse_msg2( pj_pool_t *pool, 
+                                     char *buf, pj_size_t size,
+				     unsigned options,
+				     pjsip_parser_err_report *err_list)
 {
     pjsip_msg *msg = NULL;
     pj_scanner scanner;
@@ -739,7 +1043,8 @@ PJ_DEF(pjsip_msg*) pjsip_parse_msg( pj_pool_t *pool,
     context.pool = pool;
     context.rdata = NULL;
 
-    msg = int_parse_msg(&context, err_list);
+    msg = int_parse_msg(&context, (options & PJSIP_PARSE_MSG_LAZY_HDR) != 0,
+			err_list);
 
     pj_scan_fini(&scanner);
     return msg;
@@ -759,7 +1064,9 @@ PJ_DEF(pjsip_msg *) pjsip_parse_rdata( char *buf, pj_size_t size,
     context.pool = rdata->tp_info.pool;
     context.rdata = rdata;
 
-    rdata->msg_info.msg = int_parse_msg(&context, &rdata->msg_info.parse_err);
+    rdata->msg_info.msg = int_parse_msg(&context,
+					pjsip_cfg()->endpt.lazy_hdr_parse,
+					&rdata->msg_info.parse_err);
 
     pj_scan_fini(&scanner);
     return rdata->msg_info.msg;
@@ -810,12 +1117,12 @@ PJ_DEF(pj_bool_t) pjsip_find_msg( const char *buf, pj_size_t size,
 	{
 	    /* Try to parse the header. */
 	    pj_scanner scanner;
-	    PJ_USE_EXCEPTION;
+	    PARSE_USE_EXCEPTION;
 
 	    pj_scan_init(&scanner, (char*)line, hdr_end-line, 
 			 PJ_SCAN_AUTOSKIP_WS_HEADER, &on_syntax_error);
 
-	    PJ_TRY {
+	    PARSE_TRY(&scanner) {
 		pj_str_t str_clen;
 
 		/* Get "Content-Length" or "L" name */
@@ -826,7 +1133,7 @@ PJ_DEF(pj_bool_t) pjsip_find_msg( const char *buf, pj_size_t size,
 
 		/* Get colon */
 		if (pj_scan_get_char(&scanner) != ':') {
-		    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+		    on_syntax_error(&scanner);
 		}
 
 		/* Get number */
@@ -838,10 +1145,10 @@ PJ_DEF(pj_bool_t) pjsip_find_msg( const char *buf, pj_size_t size,
 		/* Found a valid Content-Length header. */
 		content_length = pj_strtoul(&str_clen);
 	    }
-	    PJ_CATCH_ANY {
+	    PARSE_CATCH(&scanner) {
 		content_length = -1;
 	    }
-	    PJ_END
+	    PARSE_END;
 
 	    pj_scan_fini(&scanner);
 	}
@@ -879,18 +1186,18 @@ PJ_DEF(pjsip_uri*) pjsip_parse_uri( pj_pool_t *pool,
 {
     pj_scanner scanner;
     pjsip_uri *uri = NULL;
-    PJ_USE_EXCEPTION;
+    PARSE_USE_EXCEPTION;
 
     pj_scan_init(&scanner, buf, size, 0, &on_syntax_error);
 
     
-    PJ_TRY {
+    PARSE_TRY(&scanner) {
 	uri = int_parse_uri_or_name_addr(&scanner, pool, option);
     }
-    PJ_CATCH_ANY {
+    PARSE_CATCH(&scanner) {
 	uri = NULL;
     }
-    PJ_END;
+    PARSE_END;
 
     /* Must have exhausted all inputs. */
     if (pj_scan_is_eof(&scanner) || IS_NEWLINE(*scanner.curptr)) {
@@ -936,20 +1243,24 @@ static pj_bool_t is_next_sip_version(pj_scanner *scanner)
 
 /* Internal function to parse SIP message */
 static pjsip_msg *int_parse_msg( pjsip_parse_ctx *ctx,
+				 pj_bool_t lazy,
 				 pjsip_parser_err_report *err_list)
 {
-    pj_bool_t parsing_headers;
-    pjsip_msg *msg = NULL;
+    /* These are modified inside PJ_TRY and used after an exception, so
+     * they must be volatile to survive longjmp().
+     */
+    volatile pj_bool_t parsing_headers;
+    pjsip_msg *volatile msg = NULL;
+    pjsip_ctype_hdr *volatile ctype_hdr = NULL;
     pj_str_t hname;
-    pjsip_ctype_hdr *ctype_hdr = NULL;
     pj_scanner *scanner = ctx->scanner;
     pj_pool_t *pool = ctx->pool;
-    PJ_USE_EXCEPTION;
+    PARSE_USE_EXCEPTION;
 
     parsing_headers = PJ_FALSE;
 
 retry_parse:
-    PJ_TRY 
+    PARSE_TRY(scanner)
     {
 	if (parsing_headers)
 	    goto parse_headers;
@@ -964,7 +1275,7 @@ retry_parse:
 	 * NAT bindings open.
 	 */
 	if (pj_scan_is_eof(scanner))
-	    return NULL;
+	    goto on_error;
 
 	/* Parse request or status line */
 	if (is_next_sip_version(scanner)) {
@@ -975,12 +1286,15 @@ retry_parse:
 	    int_parse_req_line(scanner, pool, &msg->line.req );
 	}
 
+	if (PARSE_FAILED(scanner))
+	    goto on_error;
+
 	parsing_headers = PJ_TRUE;
 
 parse_headers:
 	/* Parse headers. */
 	do {
-	    pjsip_parse_hdr_func * func;
+	    handler_rec *rec;
 	    pjsip_hdr *hdr = NULL;
 
 	    /* Init hname just in case parsing fails.
@@ -991,18 +1305,23 @@ parse_headers:
 	    /* Get hname. */
 	    pj_scan_get( scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
 	    if (pj_scan_get_char( scanner ) != ':') {
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+		on_syntax_error(scanner);
+		goto on_error;
 	    }
 	    
 	    /* Find handler. */
-	    func = find_handler(&hname);
+	    rec = find_handler(&hname);
 	    
-	    /* Call the handler if found.
+	    /* Call the handler if found, unless the header can be parsed
+	     * later in lazy mode.
 	     * If no handler is found, then treat the header as generic
 	     * hname/hvalue pair.
 	     */
-	    if (func) {
-		hdr = (*func)(ctx);
+	    if (rec && lazy && !rec->info->eager) {
+		hdr = parse_hdr_lazy(ctx, rec);
+
+	    } else if (rec) {
+		hdr = (*rec->handler)(ctx);
 
 		/* Note:
 		 *  hdr MAY BE NULL, if parsing does not yield a new header
@@ -1010,19 +1329,22 @@ parse_headers:
 		 *  header. See http://trac.pjsip.org/repos/ticket/940
 		 */
 
-		/* Check if we've just parsed a Content-Type header. 
-		 * We will check for a message body if we've got Content-Type 
-		 * header.
-		 */
-		if (hdr && hdr->type == PJSIP_H_CONTENT_TYPE) {
-		    ctype_hdr = (pjsip_ctype_hdr*)hdr;
-		}
-
 	    } else {
 		hdr = parse_hdr_generic_string(ctx);
 		hdr->name = hdr->sname = hname;
 	    }
-	    
+
+	    if (PARSE_FAILED(scanner))
+		goto on_error;
+
+	    /* Check if we've just parsed a Content-Type header. 
+	     * We will check for a message body if we've got Content-Type 
+	     * header.
+	     */
+	    if (hdr && hdr->type == PJSIP_H_CONTENT_TYPE) {
+		ctype_hdr = (pjsip_ctype_hdr*)hdr;
+	    }
+	
 	
 	    /* Single parse of header line can produce multiple headers.
 	     * For example, if one Contact: header contains Contact list
@@ -1072,8 +1394,12 @@ parse_headers:
 
 	    msg->body = body;
 	}
+
+on_error:
+	/* Syntax error without exception ends up here */
+	;
     }
-    PJ_CATCH_ANY 
+    PARSE_CATCH(scanner)
     {
 	/* Exception was thrown during parsing. 
 	 * Skip until newline, and parse next header. 
@@ -1082,7 +1408,7 @@ parse_headers:
 	    pjsip_parser_err_report *err_info;
 	    
 	    err_info = PJ_POOL_ALLOC_T(pool, pjsip_parser_err_report);
-	    err_info->except_code = PJ_GET_EXCEPTION();
+	    err_info->except_code = PARSE_EXCEPTION;
 	    err_info->line = scanner->line;
 	    /* Scanner's column is zero based, so add 1 */
 	    err_info->col = pj_scan_get_col(scanner) + 1;
@@ -1119,7 +1445,7 @@ parse_headers:
 
 	msg = NULL;
     }
-    PJ_END;
+    PARSE_END;
 
     return msg;
 }
@@ -1334,7 +1660,8 @@ static pjsip_uri *int_parse_uri_or_name_addr( pj_scanner *scanner, pj_pool_t *po
 
 	    if (func == NULL) {
 		/* Unsupported URI scheme */
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+		on_syntax_error(scanner);
+		return NULL;
 	    }
 
 	    uri = (pjsip_uri*)
@@ -1382,7 +1709,8 @@ static pjsip_uri *int_parse_uri(pj_scanner *scanner, pj_pool_t *pool,
 	/* Get scheme. */
 	colon = pj_scan_peek(scanner, &pconst.pjsip_TOKEN_SPEC, &scheme);
 	if (colon != ':') {
-	    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	    on_syntax_error(scanner);
+	    return NULL;
 	}
 
 	func = find_uri_handler(&scheme);
@@ -1391,8 +1719,8 @@ static pjsip_uri *int_parse_uri(pj_scanner *scanner, pj_pool_t *pool,
 
 	} else {
 	    /* Unsupported URI scheme */
-	    PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	    UNREACHED({ return NULL; /* Not reached. */ })
+	    on_syntax_error(scanner);
+	    return NULL;
 	}
 
     /*
@@ -1416,7 +1744,8 @@ static void* int_parse_sip_url( pj_scanner *scanner,
     pj_scan_get(scanner, &pconst.pjsip_TOKEN_SPEC, &scheme);
     colon = pj_scan_get_char(scanner);
     if (colon != ':') {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	on_syntax_error(scanner);
+	return NULL;
     }
 
     if (parser_stricmp(scheme, pconst.pjsip_SIP_STR)==0) {
@@ -1426,12 +1755,8 @@ static void* int_parse_sip_url( pj_scanner *scanner,
 	url = pjsip_sip_uri_create(pool, 1);
 
     } else {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-	/* should not reach here */
-	UNREACHED({
-	    pj_assert(0);
-	    return 0;
-	})
+	on_syntax_error(scanner);
+	return NULL;
     }
 
     if (int_is_next_user(scanner)) {
@@ -1534,12 +1859,13 @@ static pjsip_name_addr *int_parse_name_addr( pj_scanner *scanner,
 	 * Allowing (invalid) name-addr to pass URI verification will
 	 * cause us to send invalid URI to the wire.
 	 */
-	PJ_THROW( PJSIP_SYN_ERR_EXCEPTION);
+	on_syntax_error(scanner);
+	return name_addr;
     }
     name_addr->uri = int_parse_uri( scanner, pool, PJ_TRUE );
     if (has_bracket) {
 	if (pj_scan_get_char(scanner) != '>')
-	    PJ_THROW( PJSIP_SYN_ERR_EXCEPTION);
+	    on_syntax_error(scanner);
     }
 
     return name_addr;
@@ -1563,7 +1889,8 @@ static void* int_parse_other_uri(pj_scanner *scanner,
     
     pj_scan_get(scanner, &pc->pjsip_TOKEN_SPEC, &uri->scheme);
     if (pj_scan_get_char(scanner) != ':') {
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+	on_syntax_error(scanner);
+	return NULL;
     }
     
     pj_scan_get(scanner, &pc->pjsip_OTHER_URI_CONTENT, &uri->content);
@@ -1611,23 +1938,23 @@ PJ_DEF(pj_status_t) pjsip_parse_status_line( char *buf, pj_size_t size,
 					     pjsip_status_line *status_line)
 {
     pj_scanner scanner;
-    PJ_USE_EXCEPTION;
+    PARSE_USE_EXCEPTION;
 
     pj_bzero(status_line, sizeof(*status_line));
     pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
 		 &on_syntax_error);
 
-    PJ_TRY {
+    PARSE_TRY(&scanner) {
 	int_parse_status_line(&scanner, status_line);
     } 
-    PJ_CATCH_ANY {
+    PARSE_CATCH(&scanner) {
 	/* Tolerate the error if it is caused only by missing newline */
 	if (status_line->code == 0 && status_line->reason.slen == 0) {
 	    pj_scan_fini(&scanner);
 	    return PJSIP_EINVALIDMSG;
 	}
     }
-    PJ_END;
+    PARSE_END;
 
     pj_scan_fini(&scanner);
     return PJ_SUCCESS;
@@ -1673,6 +2000,8 @@ static void parse_generic_array_hdr( pjsip_generic_array_hdr *hdr,
 
     pj_scan_get( scanner, &pconst.pjsip_NOT_COMMA_OR_NEWLINE, 
 		 &hdr->values[hdr->count]);
+    if (PARSE_FAILED(scanner))
+	return;
     hdr->count++;
 
     while ((hdr->count < PJSIP_GENERIC_ARRAY_MAX_COUNT) &&
@@ -1681,6 +2010,8 @@ static void parse_generic_array_hdr( pjsip_generic_array_hdr *hdr,
 	pj_scan_get_char(scanner);
 	pj_scan_get( scanner, &pconst.pjsip_NOT_COMMA_OR_NEWLINE, 
 		     &hdr->values[hdr->count]);
+	if (PARSE_FAILED(scanner))
+	    return;
 	hdr->count++;
     }
 
@@ -1762,7 +2093,7 @@ static pjsip_hdr* parse_hdr_call_id(pjsip_parse_ctx *ctx)
     pj_scan_get( ctx->scanner, &pconst.pjsip_NOT_NEWLINE, &hdr->id);
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.cid = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1852,7 +2183,7 @@ static pjsip_hdr* parse_hdr_content_len( pjsip_parse_ctx *ctx )
     hdr->len = pj_strtoul(&digit);
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.clen = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1880,7 +2211,7 @@ static pjsip_hdr* parse_hdr_content_type( pjsip_parse_ctx *ctx )
 
     parse_hdr_end(ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.ctype = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1901,7 +2232,7 @@ static pjsip_hdr* parse_hdr_cseq( pjsip_parse_ctx *ctx )
 
     parse_hdr_end( ctx->scanner );
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.cseq = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -1948,7 +2279,7 @@ static pjsip_hdr* parse_hdr_from( pjsip_parse_ctx *ctx )
 {
     pjsip_from_hdr *hdr = pjsip_from_hdr_create(ctx->pool);
     parse_hdr_fromto(ctx->scanner, ctx->pool, hdr);
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.from = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -2032,7 +2363,7 @@ static pjsip_hdr* parse_hdr_to( pjsip_parse_ctx *ctx )
     pjsip_to_hdr *hdr = pjsip_to_hdr_create(ctx->pool);
     parse_hdr_fromto(ctx->scanner, ctx->pool, hdr);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.to = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -2102,7 +2433,7 @@ static pjsip_hdr* parse_hdr_max_forwards( pjsip_parse_ctx *ctx )
     hdr = pjsip_max_fwd_hdr_create(ctx->pool, 0);
     parse_generic_int_hdr(hdr, ctx->scanner);
 
-    if (ctx->rdata)
+    if (ctx->rdata && !PARSE_FAILED(ctx->scanner))
         ctx->rdata->msg_info.max_fwd = hdr;
 
     return (pjsip_hdr*)hdr;
@@ -2155,7 +2486,8 @@ static pjsip_hdr* parse_hdr_rr( pjsip_parse_ctx *ctx)
     } while (1);
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.record_route==NULL)
+    if (ctx->rdata && !PARSE_FAILED(scanner) &&
+	ctx->rdata->msg_info.record_route == NULL)
         ctx->rdata->msg_info.record_route = first;
 
     return (pjsip_hdr*)first;
@@ -2183,7 +2515,8 @@ static pjsip_hdr* parse_hdr_route( pjsip_parse_ctx *ctx )
     } while (1);
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.route==NULL)
+    if (ctx->rdata && !PARSE_FAILED(scanner) &&
+	ctx->rdata->msg_info.route == NULL)
         ctx->rdata->msg_info.route = first;
 
     return (pjsip_hdr*)first;
@@ -2233,7 +2566,8 @@ static pjsip_hdr* parse_hdr_via( pjsip_parse_ctx *ctx )
 
     parse_hdr_end(scanner);
 
-    if (ctx->rdata && ctx->rdata->msg_info.via == NULL)
+    if (ctx->rdata && !PARSE_FAILED(scanner) &&
+	ctx->rdata->msg_info.via == NULL)
         ctx->rdata->msg_info.via = first;
 
     return (pjsip_hdr*)first;
@@ -2250,6 +2584,70 @@ static pjsip_hdr* parse_hdr_generic_string( pjsip_parse_ctx *ctx )
 
 }
 
+/* Split lazy header into name and value, to be parsed when needed. The
+ * value is the raw text up to the end of the header, including any line
+ * folding, which the header parser handles later.
+ */
+static pjsip_hdr* parse_hdr_lazy( pjsip_parse_ctx *ctx,
+				  const handler_rec *rec)
+{
+    pj_scanner *scanner = ctx->scanner;
+    pjsip_lazy_hdr *hdr;
+    char *start, *end;
+
+    hdr = pjsip_lazy_hdr_create(ctx->pool);
+    hdr->name = rec->info->name;
+    hdr->sname = rec->info->sname;
+    hdr->parsed_type = rec->info->type;
+    hdr->parse = rec->handler;
+
+    start = end = scanner->curptr;
+    while (pj_cis_match(&pconst.pjsip_NOT_NEWLINE, *scanner->curptr)) {
+	pj_str_t frag;
+
+	pj_scan_get( scanner, &pconst.pjsip_NOT_NEWLINE, &frag);
+	end = frag.ptr + frag.slen;
+    }
+    hdr->hvalue.ptr = start;
+    hdr->hvalue.slen = end - start;
+
+    parse_hdr_end(scanner);
+    return (pjsip_hdr*)hdr;
+}
+
+/* Parse the value of lazy header. */
+PJ_DEF(pjsip_hdr*) pjsip_parse_lazy_hdr( pjsip_lazy_hdr *lhdr )
+{
+    pj_scanner scanner;
+    pjsip_parse_ctx context;
+    pjsip_hdr *hdr = NULL;
+    pj_str_t value;
+    PARSE_USE_EXCEPTION;
+
+    PJ_ASSERT_RETURN(lhdr && lhdr->parse, NULL);
+
+    /* The scanner needs NULL terminated input */
+    pj_strdup_with_null(lhdr->pool, &value, &lhdr->hvalue);
+
+    pj_scan_init(&scanner, value.ptr, value.slen, PJ_SCAN_AUTOSKIP_WS_HEADER,
+                 &on_syntax_error);
+
+    context.scanner = &scanner;
+    context.pool = lhdr->pool;
+    context.rdata = NULL;
+
+    PARSE_TRY(&scanner) {
+	hdr = (*lhdr->parse)(&context);
+    }
+    PARSE_CATCH(&scanner) {
+	hdr = NULL;
+    }
+    PARSE_END;
+
+    pj_scan_fini(&scanner);
+    return hdr;
+}
+
 /* Public function to parse a header value. */
 PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
 			       char *buf, pj_size_t size, int *parsed_len )
@@ -2257,7 +2655,7 @@ PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
     pj_scanner scanner;
     pjsip_hdr *hdr = NULL;
     pjsip_parse_ctx context;
-    PJ_USE_EXCEPTION;
+    PARSE_USE_EXCEPTION;
 
     pj_scan_init(&scanner, buf, size, PJ_SCAN_AUTOSKIP_WS_HEADER, 
                  &on_syntax_error);
@@ -2266,10 +2664,10 @@ PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
     context.pool = pool;
     context.rdata = NULL;
 
-    PJ_TRY {
-	pjsip_parse_hdr_func *func = find_handler(hname);
-	if (func) {
-	    hdr = (*func)(&context);
+    PARSE_TRY(&scanner) {
+	handler_rec *rec = find_handler(hname);
+	if (rec) {
+	    hdr = (*rec->handler)(&context);
 	} else {
 	    hdr = parse_hdr_generic_string(&context);
 	    hdr->type = PJSIP_H_OTHER;
@@ -2278,10 +2676,10 @@ PJ_DEF(void*) pjsip_parse_hdr( pj_pool_t *pool, const pj_str_t *hname,
 	}
 
     } 
-    PJ_CATCH_ANY {
+    PARSE_CATCH(&scanner) {
 	hdr = NULL;
     }
-    PJ_END
+    PARSE_END;
 
     if (parsed_len) {
 	*parsed_len = (unsigned)(scanner.curptr - scanner.begin);
@@ -2301,7 +2699,7 @@ PJ_DEF(pj_status_t) pjsip_parse_headers( pj_pool_t *pool, char *input,
     pj_scanner scanner;
     pjsip_parse_ctx ctx;
     pj_str_t hname;
-    PJ_USE_EXCEPTION;
+    PARSE_USE_EXCEPTION;
 
     pj_scan_init(&scanner, input, size, PJ_SCAN_AUTOSKIP_WS_HEADER,
                  &on_syntax_error);
@@ -2311,11 +2709,11 @@ PJ_DEF(pj_status_t) pjsip_parse_headers( pj_pool_t *pool, char *input,
     ctx.pool = pool;
 
 retry_parse:
-    PJ_TRY
+    PARSE_TRY(&scanner)
     {
 	/* Parse headers. */
 	do {
-	    pjsip_parse_hdr_func * func;
+	    handler_rec *rec;
 	    pjsip_hdr *hdr = NULL;
 
 	    /* Init hname just in case parsing fails.
@@ -2326,23 +2724,27 @@ retry_parse:
 	    /* Get hname. */
 	    pj_scan_get( &scanner, &pconst.pjsip_TOKEN_SPEC, &hname);
 	    if (pj_scan_get_char( &scanner ) != ':') {
-		PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+		on_syntax_error(&scanner);
+		break;
 	    }
 
 	    /* Find handler. */
-	    func = find_handler(&hname);
+	    rec = find_handler(&hname);
 
 	    /* Call the handler if found.
 	     * If no handler is found, then treat the header as generic
 	     * hname/hvalue pair.
 	     */
-	    if (func) {
-		hdr = (*func)(&ctx);
+	    if (rec) {
+		hdr = (*rec->handler)(&ctx);
 	    } else {
 		hdr = parse_hdr_generic_string(&ctx);
 		hdr->name = hdr->sname = hname;
 	    }
 
+	    if (PARSE_FAILED(&scanner))
+		break;
+
 	    /* Single parse of header line can produce multiple headers.
 	     * For example, if one Contact: header contains Contact list
 	     * separated by comma, then these Contacts will be split into
@@ -2362,7 +2764,7 @@ retry_parse:
 	    }
 	}
     }
-    PJ_CATCH_ANY
+    PARSE_CATCH(&scanner)
     {
 	PJ_LOG(4,(THIS_FILE, "Error parsing header: '%.*s' line %d col %d",
 		  (int)hname.slen, hname.ptr, scanner.line,
@@ -2393,7 +2795,7 @@ retry_parse:
 	}
 
     }
-    PJ_END;
+    PARSE_END;
 
     return PJ_SUCCESS;
 }
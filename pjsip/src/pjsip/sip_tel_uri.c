@@ -380,10 +380,12 @@ static void* tel_uri_parse( pj_scanner *scanner, pj_pool_t *pool,
 
     /* Parse scheme. */
     pj_scan_get(scanner, &pc->pjsip_TOKEN_SPEC, &token);
-    if (pj_scan_get_char(scanner) != ':')
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
-    if (pj_stricmp_alnum(&token, &pc->pjsip_TEL_STR) != 0)
-	PJ_THROW(PJSIP_SYN_ERR_EXCEPTION);
+    if (pj_scan_get_char(scanner) != ':' ||
+	pj_stricmp_alnum(&token, &pc->pjsip_TEL_STR) != 0)
+    {
+	pj_scan_syntax_err(scanner);
+	return NULL;
+    }
 
     /* Create URI */
     uri = pjsip_tel_uri_create(pool);
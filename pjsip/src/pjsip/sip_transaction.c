@@ -67,14 +67,24 @@ static pj_status_t mod_tsx_layer_unload(void);
 static pj_bool_t   mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata);
 static pj_bool_t   mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata);
 
+/* A stripe of the transaction table, see PJSIP_TSX_LAYER_LOCK_STRIPES.
+ * Each stripe has its own pool, since the hash table allocates bigger
+ * bucket arrays from it while only the stripe's mutex is held.
+ */
+typedef struct tsx_stripe
+{
+    pj_pool_t		*pool;
+    pj_mutex_t		*mutex;
+    pj_hash_table_t	*htable;
+} tsx_stripe;
+
 /* Transaction layer module definition. */
 static struct mod_tsx_layer
 {
     struct pjsip_module  mod;
     pj_pool_t		*pool;
     pjsip_endpoint	*endpt;
-    pj_mutex_t		*mutex;
-    pj_hash_table_t	*htable;
+    tsx_stripe		 stripe[PJSIP_TSX_LAYER_LOCK_STRIPES];
 } mod_tsx_layer = 
 {   {
 	NULL, NULL,			/* List's prev and next.    */
@@ -426,12 +436,56 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_key( pj_pool_t *pool, pj_str_t *key,
  **
  *****************************************************************************
  **/
+/*
+ * Get the stripe of the transaction table for the specified hash value of
+ * the (lowercase) transaction key. The low bits of the hash value select
+ * the bucket within the stripe's hash table, so mix all bits to select
+ * the stripe.
+ */
+static tsx_stripe *get_stripe(pj_uint32_t hval)
+{
+    return &mod_tsx_layer.stripe[((hval * 2654435761U) >> 16) %
+				 PJSIP_TSX_LAYER_LOCK_STRIPES];
+}
+
+/* Destroy the mutexes and pools of the transaction table stripes. */
+static void destroy_stripes(void)
+{
+    unsigned i;
+
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i) {
+	tsx_stripe *stripe = &mod_tsx_layer.stripe[i];
+
+	if (stripe->mutex) {
+	    pj_mutex_destroy(stripe->mutex);
+	    stripe->mutex = NULL;
+	}
+	stripe->htable = NULL;
+	if (stripe->pool) {
+	    pjsip_endpt_release_pool(mod_tsx_layer.endpt, stripe->pool);
+	    stripe->pool = NULL;
+	}
+    }
+}
+
+/* Get the number of transactions in the table, without locking. */
+static unsigned get_tsx_count(void)
+{
+    unsigned i, count = 0;
+
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i)
+	count += pj_hash_count(mod_tsx_layer.stripe[i].htable);
+
+    return count;
+}
+
 /*
  * Create transaction layer module and registers it to the endpoint.
  */
 PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
 {
     pj_pool_t *pool;
+    unsigned i;
     pj_status_t status;
 
 
@@ -470,18 +524,40 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
     mod_tsx_layer.endpt = endpt;
 
 
-    /* Create hash table. */
-    mod_tsx_layer.htable = pj_hash_create( pool, pjsip_cfg()->tsx.max_count );
-    if (!mod_tsx_layer.htable) {
-	pjsip_endpt_release_pool(endpt, pool);
-	return PJ_ENOMEM;
-    }
+    /* Create the hash table and mutex of each stripe. */
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i) {
+	tsx_stripe *stripe = &mod_tsx_layer.stripe[i];
 
-    /* Create group lock. */
-    status = pj_mutex_create_recursive(pool, "tsxlayer", &mod_tsx_layer.mutex);
-    if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool(endpt, pool);
-	return status;
+	/* The retired bucket arrays stay in the stripe's pool, but as
+	 * the table doubles each time they never add up to more than the
+	 * current bucket array.
+	 */
+	stripe->pool = pjsip_endpt_create_pool(endpt, "tsxstripe",
+					       PJSIP_POOL_TSX_LAYER_LEN,
+					       PJSIP_POOL_TSX_LAYER_INC);
+	if (!stripe->pool) {
+	    destroy_stripes();
+	    pjsip_endpt_release_pool(endpt, pool);
+	    return PJ_ENOMEM;
+	}
+
+	stripe->htable = pj_hash_create2(stripe->pool,
+					 pjsip_cfg()->tsx.max_count /
+					     PJSIP_TSX_LAYER_LOCK_STRIPES,
+					 PJ_HASH_GROWABLE);
+	if (!stripe->htable) {
+	    destroy_stripes();
+	    pjsip_endpt_release_pool(endpt, pool);
+	    return PJ_ENOMEM;
+	}
+
+	status = pj_mutex_create_recursive(stripe->pool, "tsxlayer",
+					   &stripe->mutex);
+	if (status != PJ_SUCCESS) {
+	    destroy_stripes();
+	    pjsip_endpt_release_pool(endpt, pool);
+	    return status;
+	}
     }
 
     /*
@@ -489,7 +565,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_init_module(pjsip_endpoint *endpt)
      */
     status = pjsip_endpt_register_module( endpt, &mod_tsx_layer.mod );
     if (status != PJ_SUCCESS) {
-	pj_mutex_destroy(mod_tsx_layer.mutex);
+	destroy_stripes();
 	pjsip_endpt_release_pool(endpt, pool);
 	return status;
     }
@@ -534,21 +610,29 @@ PJ_DEF(pj_status_t) pjsip_tsx_layer_destroy(void)
  */
 static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 {
+    tsx_stripe *stripe;
+
     pj_assert(tsx->transaction_key.slen != 0);
 
     /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+#ifdef PRECALC_HASH
+    stripe = get_stripe(tsx->hashed_key);
+#else
+    stripe = get_stripe(pj_hash_calc_seeded_tolower(NULL,
+						    &tsx->transaction_key));
+#endif
+    pj_mutex_lock(stripe->mutex);
 
     /* Check if no transaction with the same key exists. 
      * Do not use PJ_ASSERT_RETURN since it evaluates the expression
      * twice!
      */
-    if(pj_hash_get_lower(mod_tsx_layer.htable, 
+    if(pj_hash_get_lower(stripe->htable, 
 		         tsx->transaction_key.ptr,
 		         (unsigned)tsx->transaction_key.slen, 
 		         NULL))
     {
-	pj_mutex_unlock(mod_tsx_layer.mutex);
+	pj_mutex_unlock(stripe->mutex);
 	PJ_LOG(2,(THIS_FILE, 
 		  "Unable to register %.*s transaction (key exists)",
 		  (int)tsx->method.name.slen,
@@ -563,18 +647,18 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
 
     /* Register the transaction to the hash table. */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
+    pj_hash_set_lower( tsx->pool, stripe->htable,
                        tsx->transaction_key.ptr,
     		       (unsigned)tsx->transaction_key.slen, 
 		       tsx->hashed_key, tsx);
 #else
-    pj_hash_set_lower( tsx->pool, mod_tsx_layer.htable,
+    pj_hash_set_lower( tsx->pool, stripe->htable,
                        tsx->transaction_key.ptr,
     		       tsx->transaction_key.slen, 0, tsx);
 #endif
 
     /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(stripe->mutex);
 
     return PJ_SUCCESS;
 }
@@ -585,6 +669,8 @@ static pj_status_t mod_tsx_layer_register_tsx( pjsip_transaction *tsx)
  */
 static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 {
+    tsx_stripe *stripe;
+
     if (mod_tsx_layer.mod.id == -1) {
 	/* The transaction layer has been unregistered. This could happen
 	 * if the transaction was pending on transport and the application
@@ -598,15 +684,21 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
     //pj_assert(tsx->state != PJSIP_TSX_STATE_NULL);
 
     /* Lock hash table mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+#ifdef PRECALC_HASH
+    stripe = get_stripe(tsx->hashed_key);
+#else
+    stripe = get_stripe(pj_hash_calc_seeded_tolower(NULL,
+						    &tsx->transaction_key));
+#endif
+    pj_mutex_lock(stripe->mutex);
 
     /* Register the transaction to the hash table. */
 #ifdef PRECALC_HASH
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    pj_hash_set_lower( NULL, stripe->htable, tsx->transaction_key.ptr,
     		       (unsigned)tsx->transaction_key.slen, tsx->hashed_key, 
 		       NULL);
 #else
-    pj_hash_set_lower( NULL, mod_tsx_layer.htable, tsx->transaction_key.ptr,
+    pj_hash_set_lower( NULL, stripe->htable, tsx->transaction_key.ptr,
     		       tsx->transaction_key.slen, 0, NULL);
 #endif
 
@@ -616,7 +708,7 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
 		tsx->transaction_key.ptr));
 
     /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(stripe->mutex);
 }
 
 
@@ -626,14 +718,18 @@ static void mod_tsx_layer_unregister_tsx( pjsip_transaction *tsx)
  */
 PJ_DEF(unsigned) pjsip_tsx_layer_get_tsx_count(void)
 {
-    unsigned count;
+    unsigned i, count = 0;
 
     /* Are we registered? */
     PJ_ASSERT_RETURN(mod_tsx_layer.endpt!=NULL, 0);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
-    count = pj_hash_count(mod_tsx_layer.htable);
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i) {
+	tsx_stripe *stripe = &mod_tsx_layer.stripe[i];
+
+	pj_mutex_lock(stripe->mutex);
+	count += pj_hash_count(stripe->htable);
+	pj_mutex_unlock(stripe->mutex);
+    }
 
     return count;
 }
@@ -646,11 +742,12 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
 				    pj_bool_t add_ref )
 {
     pjsip_transaction *tsx;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval = pj_hash_calc_seeded_tolower(NULL, key);
+    tsx_stripe *stripe = get_stripe(hval);
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    pj_mutex_lock(stripe->mutex);
     tsx = (pjsip_transaction*)
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key->ptr, 
+    	  pj_hash_get_lower( stripe->htable, key->ptr, 
 			     (unsigned)key->slen, &hval );
     
     /* Prevent the transaction to get deleted before we have chance to lock it.
@@ -658,7 +755,7 @@ static pjsip_transaction* find_tsx( const pj_str_t *key, pj_bool_t lock,
     if (tsx)
         pj_grp_lock_add_ref(tsx->grp_lock);
     
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    pj_mutex_unlock(stripe->mutex);
 
     TSX_TRACE_((THIS_FILE, 
 		"Finding tsx with hkey=0x%p and key=%.*s: found %p",
@@ -718,26 +815,31 @@ static pj_status_t mod_tsx_layer_start(void)
 static pj_status_t mod_tsx_layer_stop(void)
 {
     pj_hash_iterator_t it_buf, *it;
+    unsigned i;
 
     PJ_LOG(4,(THIS_FILE, "Stopping transaction layer module"));
 
-    pj_mutex_lock(mod_tsx_layer.mutex);
-
     /* Destroy all transactions. */
-    it = pj_hash_first(mod_tsx_layer.htable, &it_buf);
-    while (it) {
-	pjsip_transaction *tsx = (pjsip_transaction*) 
-				 pj_hash_this(mod_tsx_layer.htable, it);
-	pj_hash_iterator_t *next = pj_hash_next(mod_tsx_layer.htable, it);
-	if (tsx) {
-	    pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
-	    mod_tsx_layer_unregister_tsx(tsx);
-	    tsx_shutdown(tsx);
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i) {
+	tsx_stripe *stripe = &mod_tsx_layer.stripe[i];
+
+	pj_mutex_lock(stripe->mutex);
+
+	it = pj_hash_first(stripe->htable, &it_buf);
+	while (it) {
+	    pjsip_transaction *tsx = (pjsip_transaction*) 
+				     pj_hash_this(stripe->htable, it);
+	    pj_hash_iterator_t *next = pj_hash_next(stripe->htable, it);
+	    if (tsx) {
+		pjsip_tsx_terminate(tsx, PJSIP_SC_SERVICE_UNAVAILABLE);
+		mod_tsx_layer_unregister_tsx(tsx);
+		tsx_shutdown(tsx);
+	    }
+	    it = next;
 	}
-	it = next;
-    }
 
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+	pj_mutex_unlock(stripe->mutex);
+    }
 
     PJ_LOG(4,(THIS_FILE, "Stopped transaction layer module"));
 
@@ -750,8 +852,8 @@ static void tsx_layer_destroy(pjsip_endpoint *endpt)
 {
     PJ_UNUSED_ARG(endpt);
 
-    /* Destroy mutex. */
-    pj_mutex_destroy(mod_tsx_layer.mutex);
+    /* Destroy mutexes. */
+    destroy_stripes();
 
     /* Release pool. */
     pjsip_endpt_release_pool(mod_tsx_layer.endpt, mod_tsx_layer.pool);
@@ -774,7 +876,7 @@ static pj_status_t mod_tsx_layer_unload(void)
      * crash when the pending transaction finally got error response
      * from transport and when it tries to unregister itself.
      */
-    if (pj_hash_count(mod_tsx_layer.htable) != 0) {
+    if (get_tsx_count() != 0) {
 	if (pjsip_endpt_atexit(mod_tsx_layer.endpt, &tsx_layer_destroy) !=
 	    PJ_SUCCESS)
 	{
@@ -796,17 +898,20 @@ static pj_status_t mod_tsx_layer_unload(void)
 static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
+    tsx_stripe *stripe;
     pjsip_transaction *tsx;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAS,
 			 &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_seeded_tolower(NULL, &key);
+    stripe = get_stripe(hval);
+    pj_mutex_lock( stripe->mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+    	  pj_hash_get_lower( stripe->htable, key.ptr, (unsigned)key.slen, 
 			     &hval );
 
 
@@ -820,7 +925,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 	 * Reject the request so that endpoint passes the request to
 	 * upper layer modules.
 	 */
-	pj_mutex_unlock( mod_tsx_layer.mutex);
+	pj_mutex_unlock( stripe->mutex);
 	return PJ_FALSE;
     }
 
@@ -830,7 +935,7 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
     
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( stripe->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -850,17 +955,20 @@ static pj_bool_t mod_tsx_layer_on_rx_request(pjsip_rx_data *rdata)
 static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 {
     pj_str_t key;
-    pj_uint32_t hval = 0;
+    pj_uint32_t hval;
+    tsx_stripe *stripe;
     pjsip_transaction *tsx;
 
     pjsip_tsx_create_key(rdata->tp_info.pool, &key, PJSIP_ROLE_UAC,
 			 &rdata->msg_info.cseq->method, rdata);
 
     /* Find transaction. */
-    pj_mutex_lock( mod_tsx_layer.mutex );
+    hval = pj_hash_calc_seeded_tolower(NULL, &key);
+    stripe = get_stripe(hval);
+    pj_mutex_lock( stripe->mutex );
 
     tsx = (pjsip_transaction*) 
-    	  pj_hash_get_lower( mod_tsx_layer.htable, key.ptr, (unsigned)key.slen, 
+    	  pj_hash_get_lower( stripe->htable, key.ptr, (unsigned)key.slen, 
 			     &hval );
 
 
@@ -874,7 +982,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
 	 * Reject the request so that endpoint passes the request to
 	 * upper layer modules.
 	 */
-	pj_mutex_unlock( mod_tsx_layer.mutex);
+	pj_mutex_unlock( stripe->mutex);
 	return PJ_FALSE;
     }
 
@@ -884,7 +992,7 @@ static pj_bool_t mod_tsx_layer_on_rx_response(pjsip_rx_data *rdata)
     pj_grp_lock_add_ref(tsx->grp_lock);
 
     /* Unlock hash table. */
-    pj_mutex_unlock( mod_tsx_layer.mutex );
+    pj_mutex_unlock( stripe->mutex );
 
     /* Simulate race condition! */
     PJ_RACE_ME(5);
@@ -915,38 +1023,42 @@ PJ_DEF(void) pjsip_tsx_layer_dump(pj_bool_t detail)
 {
 #if PJ_LOG_MAX_LEVEL >= 3
     pj_hash_iterator_t itbuf, *it;
+    unsigned i;
 
-    /* Lock mutex. */
-    pj_mutex_lock(mod_tsx_layer.mutex);
+    /* Lock mutexes. */
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i)
+	pj_mutex_lock(mod_tsx_layer.stripe[i].mutex);
 
     PJ_LOG(3, (THIS_FILE, "Dumping transaction table:"));
-    PJ_LOG(3, (THIS_FILE, " Total %d transactions", 
-			  pj_hash_count(mod_tsx_layer.htable)));
+    PJ_LOG(3, (THIS_FILE, " Total %d transactions", get_tsx_count()));
 
-    if (detail) {
-	it = pj_hash_first(mod_tsx_layer.htable, &itbuf);
-	if (it == NULL) {
-	    PJ_LOG(3, (THIS_FILE, " - none - "));
-	} else {
-	    while (it != NULL) {
-		pjsip_transaction *tsx = (pjsip_transaction*) 
-					 pj_hash_this(mod_tsx_layer.htable,it);
-
-		PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
-			   tsx->obj_name,
-			   (tsx->last_tx? 
-				pjsip_tx_data_get_info(tsx->last_tx): 
-				"none"),
-			   tsx->status_code,
-			   pjsip_tsx_state_str(tsx->state)));
-
-		it = pj_hash_next(mod_tsx_layer.htable, it);
-	    }
+    if (detail && get_tsx_count() == 0) {
+	PJ_LOG(3, (THIS_FILE, " - none - "));
+    }
+
+    for (i=0; detail && i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i) {
+	pj_hash_table_t *htable = mod_tsx_layer.stripe[i].htable;
+
+	it = pj_hash_first(htable, &itbuf);
+	while (it != NULL) {
+	    pjsip_transaction *tsx = (pjsip_transaction*) 
+				     pj_hash_this(htable,it);
+
+	    PJ_LOG(3, (THIS_FILE, " %s %s|%d|%s",
+		       tsx->obj_name,
+		       (tsx->last_tx? 
+			    pjsip_tx_data_get_info(tsx->last_tx): 
+			    "none"),
+		       tsx->status_code,
+		       pjsip_tsx_state_str(tsx->state)));
+
+	    it = pj_hash_next(htable, it);
 	}
     }
 
-    /* Unlock mutex. */
-    pj_mutex_unlock(mod_tsx_layer.mutex);
+    /* Unlock mutexes. */
+    for (i=0; i<PJSIP_TSX_LAYER_LOCK_STRIPES; ++i)
+	pj_mutex_unlock(mod_tsx_layer.stripe[i].mutex);
 #endif
 }
 
@@ -1004,8 +1116,8 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
     pjsip_transaction *tsx;
     pj_status_t status;
 
-    pool = pjsip_endpt_create_pool( mod_tsx_layer.endpt, "tsx", 
-				    PJSIP_POOL_TSX_LEN, PJSIP_POOL_TSX_INC );
+    pool = pjsip_endpt_acquire_pool( mod_tsx_layer.endpt,
+				     PJSIP_ENDPT_POOL_TSX, "tsx" );
     if (!pool)
 	return PJ_ENOMEM;
 
@@ -1035,7 +1147,8 @@ static pj_status_t tsx_create( pjsip_module *tsx_user,
 	status = pj_grp_lock_create_w_handler(pool, NULL, tsx, &tsx_on_destroy,
 					      &tsx->grp_lock);
 	if (status != PJ_SUCCESS) {
-	    pjsip_endpt_release_pool(mod_tsx_layer.endpt, pool);
+	    pjsip_endpt_recycle_pool(mod_tsx_layer.endpt,
+				     PJSIP_ENDPT_POOL_TSX, pool);
 	    return status;
 	}
 	
@@ -1060,7 +1173,7 @@ static void tsx_on_destroy( void *arg )
     PJ_LOG(5,(tsx->obj_name, "Transaction destroyed!"));
 
     pj_mutex_destroy(tsx->mutex_b);
-    pjsip_endpt_release_pool(tsx->endpt, tsx->pool);
+    pjsip_endpt_recycle_pool(tsx->endpt, PJSIP_ENDPT_POOL_TSX, tsx->pool);
 }
 
 /* Shutdown transaction. */
@@ -1412,7 +1525,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uac2(pjsip_module *tsx_user,
 
     /* Calculate hashed key value. */
 #ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
+    tsx->hashed_key = pj_hash_calc_seeded_tolower(NULL, &tsx->transaction_key);
 #endif
 
     PJ_LOG(6, (tsx->obj_name, "tsx_key=%.*s", tsx->transaction_key.slen,
@@ -1554,7 +1667,7 @@ PJ_DEF(pj_status_t) pjsip_tsx_create_uas2(pjsip_module *tsx_user,
 
     /* Calculate hashed key value. */
 #ifdef PRECALC_HASH
-    tsx->hashed_key = pj_hash_calc_tolower(0, NULL, &tsx->transaction_key);
+    tsx->hashed_key = pj_hash_calc_seeded_tolower(NULL, &tsx->transaction_key);
 #endif
 
     /* Duplicate branch parameter for transaction. */
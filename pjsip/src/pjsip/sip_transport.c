@@ -424,9 +424,8 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     PJ_ASSERT_RETURN(mgr && p_tdata, PJ_EINVAL);
 
-    pool = pjsip_endpt_create_pool( mgr->endpt, "tdta%p",
-				    PJSIP_POOL_LEN_TDATA,
-				    PJSIP_POOL_INC_TDATA );
+    pool = pjsip_endpt_acquire_pool( mgr->endpt, PJSIP_ENDPT_POOL_TDATA,
+				     "tdta%p" );
     if (!pool)
 	return PJ_ENOMEM;
 
@@ -438,14 +437,16 @@ PJ_DEF(pj_status_t) pjsip_tx_data_create( pjsip_tpmgr *mgr,
 
     status = pj_atomic_create(tdata->pool, 0, &tdata->ref_cnt);
     if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+	pjsip_endpt_recycle_pool( mgr->endpt, PJSIP_ENDPT_POOL_TDATA,
+				  tdata->pool );
 	return status;
     }
     
     //status = pj_lock_create_simple_mutex(pool, "tdta%p", &tdata->lock);
     status = pj_lock_create_null_mutex(pool, "tdta%p", &tdata->lock);
     if (status != PJ_SUCCESS) {
-	pjsip_endpt_release_pool( mgr->endpt, tdata->pool );
+	pjsip_endpt_recycle_pool( mgr->endpt, PJSIP_ENDPT_POOL_TDATA,
+				  tdata->pool );
 	return status;
     }
 
@@ -494,7 +495,8 @@ static void tx_data_destroy(pjsip_tx_data *tdata)
 
     pj_atomic_destroy( tdata->ref_cnt );
     pj_lock_destroy( tdata->lock );
-    pjsip_endpt_release_pool( tdata->mgr->endpt, tdata->pool );
+    pjsip_endpt_recycle_pool( tdata->mgr->endpt, PJSIP_ENDPT_POOL_TDATA,
+			      tdata->pool );
 }
 
 /*
@@ -517,6 +519,274 @@ PJ_DEF(pj_status_t) pjsip_tx_data_dec_ref( pjsip_tx_data *tdata )
     }
 }
 
+/*
+ * Print cache of tx_data.
+ *
+ * Each part of the message (the start line, and each header) is recorded
+ * as a segment of the printed text in tdata->buf. When some of them are
+ * invalidated with pjsip_tx_data_invalidate_hdr(), the message is printed
+ * again by copying the text of the valid segments from the previous print,
+ * and printing only the invalidated headers, new headers, and the body.
+ */
+
+/* Where a part of the message is printed in the buffer. */
+typedef struct print_seg
+{
+    const pjsip_hdr *hdr;	/* The header, or NULL for the start line.  */
+    unsigned	     offset;	/* Offset in the buffer.		    */
+    unsigned	     len;	/* Length, including the CRLF.		    */
+    pj_bool_t	     dirty;	/* Has been invalidated.		    */
+} print_seg;
+
+struct pjsip_tx_data_print_cache
+{
+    pj_bool_t	     valid;	/* Segments describe the buffer content.    */
+    unsigned	     len;	/* Length of the printed text.		    */
+    unsigned	     count;	/* Number of segments, seg[0] is start line.*/
+    unsigned	     max;	/* Capacity of seg and new_seg.		    */
+    print_seg	    *seg;	/* Segments of the printed text.	    */
+    print_seg	    *new_seg;	/* Segments while printing again.	    */
+    char	    *old;	/* Copy of the text while printing again.   */
+    unsigned	     old_size;	/* Capacity of old.			    */
+};
+
+/* Find the segment of the header, starting the search from index start. */
+static print_seg *find_print_seg(struct pjsip_tx_data_print_cache *cache,
+				 const pjsip_hdr *hdr, unsigned start)
+{
+    unsigned i;
+
+    for (i=start; i<cache->count; ++i) {
+	if (cache->seg[i].hdr == hdr)
+	    return &cache->seg[i];
+    }
+    for (i=1; i<start && i<cache->count; ++i) {
+	if (cache->seg[i].hdr == hdr)
+	    return &cache->seg[i];
+    }
+    return NULL;
+}
+
+/* Make sure that the cache can hold segments for the message. */
+static pj_status_t init_print_cache(pjsip_tx_data *tdata)
+{
+    struct pjsip_tx_data_print_cache *cache = tdata->print_cache;
+    const pjsip_hdr *hdr;
+    unsigned count = 1;
+
+    if (cache == NULL) {
+	cache = PJ_POOL_ZALLOC_T(tdata->pool,
+				 struct pjsip_tx_data_print_cache);
+	if (cache == NULL)
+	    return PJ_ENOMEM;
+	tdata->print_cache = cache;
+    }
+
+    for (hdr=tdata->msg->hdr.next; hdr!=&tdata->msg->hdr; hdr=hdr->next)
+	++count;
+
+    if (count > cache->max) {
+	/* Leave some room for headers added later, e.g. Via by proxy */
+	unsigned max = count + 4;
+
+	cache->seg = (print_seg*)
+		     pj_pool_alloc(tdata->pool, max * sizeof(print_seg));
+	cache->new_seg = (print_seg*)
+			 pj_pool_alloc(tdata->pool, max * sizeof(print_seg));
+	if (!cache->seg || !cache->new_seg)
+	    return PJ_ENOMEM;
+
+	cache->max = max;
+	cache->count = 0;
+	cache->valid = PJ_FALSE;
+    }
+
+    return PJ_SUCCESS;
+}
+
+#if PJSIP_TX_DATA_PRINT_CACHE
+/* Print the message to the buffer, reusing the valid segments of the
+ * previous print if there is one.
+ */
+static pj_ssize_t print_msg_cached(pjsip_tx_data *tdata)
+{
+    struct pjsip_tx_data_print_cache *cache;
+    const pjsip_msg *msg = tdata->msg;
+    const pjsip_hdr *hdr;
+    char *p = tdata->buf.start, *end = tdata->buf.end;
+    print_seg *seg, *old_seg;
+    pj_bool_t reuse;
+    unsigned count, next;
+    pj_ssize_t len;
+
+    if (init_print_cache(tdata) != PJ_SUCCESS)
+	return -1;
+
+    cache = tdata->print_cache;
+    reuse = cache->valid;
+    cache->valid = PJ_FALSE;
+
+    /* Keep the previous text, since the new text is printed over it */
+    if (reuse) {
+	if (cache->old_size < cache->len) {
+	    cache->old = (char*) pj_pool_alloc(tdata->pool, cache->len);
+	    if (!cache->old)
+		return -1;
+	    cache->old_size = cache->len;
+	}
+	pj_memcpy(cache->old, tdata->buf.start, cache->len);
+    }
+
+    /* Print request line or status line */
+    seg = &cache->new_seg[0];
+    old_seg = reuse ? &cache->seg[0] : NULL;
+    if (old_seg && !old_seg->dirty) {
+	len = old_seg->len;
+	pj_memcpy(p, cache->old + old_seg->offset, len);
+    } else {
+	len = pjsip_msg_print_start_line(msg, p, end-p);
+	if (len < 0)
+	    return -1;
+    }
+    seg->hdr = NULL;
+    seg->offset = 0;
+    seg->len = (unsigned)len;
+    seg->dirty = PJ_FALSE;
+    p += len;
+
+    /* Print each of the headers */
+    count = 1;
+    next = 1;
+    for (hdr=msg->hdr.next; hdr!=&msg->hdr; hdr=hdr->next, ++count) {
+	old_seg = reuse ? find_print_seg(cache, hdr, next) : NULL;
+	if (old_seg && !old_seg->dirty) {
+	    len = old_seg->len;
+	    if (end-p <= len)
+		return -1;
+	    pj_memcpy(p, cache->old + old_seg->offset, len);
+	} else {
+	    len = pjsip_hdr_print_on((void*)hdr, p, end-p);
+	    if (len < 0)
+		return -1;
+
+	    if (len > 0) {
+		if (p+len+3 >= end)
+		    return -1;
+		p[len++] = '\r';
+		p[len++] = '\n';
+	    }
+	}
+	if (old_seg)
+	    next = (unsigned)(old_seg - cache->seg) + 1;
+
+	seg = &cache->new_seg[count];
+	seg->hdr = hdr;
+	seg->offset = (unsigned)(p - tdata->buf.start);
+	seg->len = (unsigned)len;
+	seg->dirty = PJ_FALSE;
+	p += len;
+    }
+
+    /* Process message body, and the headers generated from it */
+    len = pjsip_msg_print_body_part(msg, p, end-p);
+    if (len < 0)
+	return -1;
+    p += len;
+
+    /* Swap the segment arrays */
+    seg = cache->seg;
+    cache->seg = cache->new_seg;
+    cache->new_seg = seg;
+    cache->count = count;
+    cache->len = (unsigned)(p - tdata->buf.start);
+    cache->valid = PJ_TRUE;
+
+    return p - tdata->buf.start;
+}
+#endif	/* PJSIP_TX_DATA_PRINT_CACHE */
+
+/*
+ * Create a new transmit buffer with a copy of the message.
+ */
+PJ_DEF(pj_status_t) pjsip_tx_data_clone(const pjsip_tx_data *src,
+					unsigned flags,
+					pjsip_tx_data **p_tdata)
+{
+    const struct pjsip_tx_data_print_cache *src_cache;
+    struct pjsip_tx_data_print_cache *cache;
+    const pjsip_hdr *sh, *dh;
+    pjsip_tx_data *tdata;
+    unsigned i, count;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(src && src->msg && p_tdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(flags == 0, PJ_EINVAL);
+
+    status = pjsip_tx_data_create(src->mgr, &tdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    pjsip_tx_data_add_ref(tdata);
+
+    tdata->msg = pjsip_msg_clone(tdata->pool, src->msg);
+
+    /* Reuse the printed text only when it is still valid */
+    src_cache = src->print_cache;
+    if (!src_cache || !src_cache->valid || 
+	src->buf.cur == src->buf.start)
+    {
+	*p_tdata = tdata;
+	return PJ_SUCCESS;
+    }
+
+    /* Cloning lazy headers may change the number of headers */
+    count = 1;
+    for (dh=tdata->msg->hdr.next; dh!=&tdata->msg->hdr; dh=dh->next)
+	++count;
+    if (count != src_cache->count) {
+	*p_tdata = tdata;
+	return PJ_SUCCESS;
+    }
+
+    tdata->buf.start = (char*) pj_pool_alloc(tdata->pool, PJSIP_MAX_PKT_LEN);
+    tdata->buf.end = tdata->buf.start + PJSIP_MAX_PKT_LEN;
+    pj_memcpy(tdata->buf.start, src->buf.start, src_cache->len);
+    tdata->buf.cur = tdata->buf.start + src_cache->len;
+    *tdata->buf.cur = '\0';
+
+    status = init_print_cache(tdata);
+    if (status != PJ_SUCCESS) {
+	pjsip_tx_data_dec_ref(tdata);
+	return status;
+    }
+    cache = tdata->print_cache;
+
+    /* Segments are in the order of the headers, so map the header of
+     * each segment to the header at the same position in the new message.
+     */
+    cache->seg[0] = src_cache->seg[0];
+    sh = src->msg->hdr.next;
+    dh = tdata->msg->hdr.next;
+    for (i=1; i<count; ++i) {
+	/* Lazy header may have been replaced after it's printed */
+	if (src_cache->seg[i].hdr != sh) {
+	    pjsip_tx_data_invalidate_msg(tdata);
+	    *p_tdata = tdata;
+	    return PJ_SUCCESS;
+	}
+	cache->seg[i] = src_cache->seg[i];
+	cache->seg[i].hdr = dh;
+	sh = sh->next;
+	dh = dh->next;
+    }
+    cache->count = count;
+    cache->len = src_cache->len;
+    cache->valid = PJ_TRUE;
+
+    *p_tdata = tdata;
+    return PJ_SUCCESS;
+}
+
 /*
  * Invalidate the content of the print buffer to force the message to be
  * re-printed when sent.
@@ -525,6 +795,34 @@ PJ_DEF(void) pjsip_tx_data_invalidate_msg( pjsip_tx_data *tdata )
 {
     tdata->buf.cur = tdata->buf.start;
     tdata->info = NULL;
+    if (tdata->print_cache)
+	tdata->print_cache->valid = PJ_FALSE;
+}
+
+/*
+ * Invalidate only the part of the print buffer where the header is
+ * printed.
+ */
+PJ_DEF(void) pjsip_tx_data_invalidate_hdr( pjsip_tx_data *tdata,
+					   const void *hdr )
+{
+    struct pjsip_tx_data_print_cache *cache = tdata->print_cache;
+
+    if (cache && cache->valid) {
+	print_seg *seg;
+
+	if (hdr == NULL)
+	    seg = &cache->seg[0];
+	else
+	    seg = find_print_seg(cache, (const pjsip_hdr*)hdr, 1);
+
+	/* Header that has not been printed will be printed anyway */
+	if (seg)
+	    seg->dirty = PJ_TRUE;
+    }
+
+    tdata->buf.cur = tdata->buf.start;
+    tdata->info = NULL;
 }
 
 /*
@@ -553,9 +851,15 @@ PJ_DEF(pj_status_t) pjsip_tx_data_encode(pjsip_tx_data *tdata)
     if (!pjsip_tx_data_is_valid(tdata)) {
 	pj_ssize_t size;
 
+#if PJSIP_TX_DATA_PRINT_CACHE
+	size = print_msg_cached(tdata);
+#else
 	size = pjsip_msg_print( tdata->msg, tdata->buf.start, 
 			        tdata->buf.end - tdata->buf.start);
+#endif
 	if (size < 0) {
+	    if (tdata->print_cache)
+		tdata->print_cache->valid = PJ_FALSE;
 	    return PJSIP_EMSGTOOLONG;
 	}
 	pj_assert(size != 0);
@@ -661,6 +965,103 @@ PJ_DEF(char*) pjsip_rx_data_get_info(pjsip_rx_data *rdata)
     return rdata->msg_info.info;
 }
 
+/* Clone rdata sharing the packet and the parsed message of src. */
+static pj_status_t rx_data_clone_shared(const pjsip_rx_data *src,
+					pjsip_rx_data **p_rdata)
+{
+    pjsip_rx_data *owner;
+    pj_pool_t *pool;
+    pjsip_rx_data *dst;
+
+    owner = src->tp_info.buf_owner ? src->tp_info.buf_owner :
+				     (pjsip_rx_data*)src;
+
+    /* The clones share the message, so parse the lazy headers now rather
+     * than letting threads replace them in the shared header list.
+     */
+    if (src->msg_info.msg)
+	pjsip_msg_parse_lazy_hdrs(src->msg_info.msg);
+
+    /* The rdata embeds the packet array, so size the pool to hold it in
+     * the first block.
+     */
+    pool = pj_pool_create(src->tp_info.pool->factory,
+                          "rtd%p",
+                          sizeof(pjsip_rx_data) + 512,
+                          PJSIP_POOL_RDATA_INC,
+                          NULL);
+    if (!pool)
+	return PJ_ENOMEM;
+
+    /* Don't zero the whole rdata, only the received bytes are copied */
+    dst = PJ_POOL_ALLOC_T(pool, pjsip_rx_data);
+
+    pj_bzero(&dst->tp_info, sizeof(dst->tp_info));
+    dst->tp_info.pool = pool;
+    dst->tp_info.transport = (pjsip_transport*)src->tp_info.transport;
+    dst->tp_info.buf_owner = owner;
+    dst->tp_info.buf_flag = PJSIP_RX_DATA_BUF_CLONED;
+
+    /* Copy the received bytes so that pkt_info stays usable, while the
+     * parsed message keeps pointing to the packet of the owner.
+     */
+    dst->pkt_info.timestamp = src->pkt_info.timestamp;
+    dst->pkt_info.len = owner->pkt_info.len;
+    if (dst->pkt_info.len > PJSIP_MAX_PKT_LEN)
+	dst->pkt_info.len = PJSIP_MAX_PKT_LEN;
+    pj_memcpy(dst->pkt_info.packet, owner->pkt_info.packet,
+	      dst->pkt_info.len);
+    if (dst->pkt_info.len < PJSIP_MAX_PKT_LEN)
+	dst->pkt_info.packet[dst->pkt_info.len] = '\0';
+    dst->pkt_info.zero = 0;
+    pj_memcpy(&dst->pkt_info.src_addr, &src->pkt_info.src_addr,
+	      sizeof(src->pkt_info.src_addr));
+    dst->pkt_info.src_addr_len = src->pkt_info.src_addr_len;
+    pj_memcpy(dst->pkt_info.src_name, src->pkt_info.src_name,
+	      sizeof(src->pkt_info.src_name));
+    dst->pkt_info.src_port = src->pkt_info.src_port;
+
+    /* msg_info points to the owner's buffer */
+    pj_memcpy(&dst->msg_info, &src->msg_info, sizeof(src->msg_info));
+    pj_list_init(&dst->msg_info.parse_err);
+
+    pj_bzero(&dst->endpt_info, sizeof(dst->endpt_info));
+
+    pj_lock_acquire(owner->tp_info.transport->lock);
+    ++owner->tp_info.buf_ref_cnt;
+    pj_lock_release(owner->tp_info.transport->lock);
+
+    *p_rdata = dst;
+
+    /* Finally add transport ref */
+    return pjsip_transport_add_ref(dst->tp_info.transport);
+}
+
+/* Release a reference to a shared buffer, and destroy the buffer if its
+ * owner has given it up.
+ */
+static void rx_buf_dec_ref(pjsip_rx_data *buf)
+{
+    pjsip_transport *tp = buf->tp_info.transport;
+    pj_bool_t destroy;
+
+    pj_lock_acquire(tp->lock);
+    pj_assert(buf->tp_info.buf_ref_cnt > 0);
+    --buf->tp_info.buf_ref_cnt;
+    destroy = (buf->tp_info.buf_ref_cnt == 0 &&
+	       (buf->tp_info.buf_flag & PJSIP_RX_DATA_BUF_DETACHED));
+    pj_lock_release(tp->lock);
+
+    if (destroy) {
+	/* A cloned owner still holds its own transport reference, while
+	 * a detached transport buffer lives in its pool only.
+	 */
+	if (buf->tp_info.buf_flag & PJSIP_RX_DATA_BUF_CLONED)
+	    pjsip_transport_dec_ref(tp);
+	pj_pool_release(buf->tp_info.pool);
+    }
+}
+
 /* Clone pjsip_rx_data. */
 PJ_DEF(pj_status_t) pjsip_rx_data_clone( const pjsip_rx_data *src,
                                          unsigned flags,
@@ -670,7 +1071,16 @@ PJ_DEF(pj_status_t) pjsip_rx_data_clone( const pjsip_rx_data *src,
     pjsip_rx_data *dst;
     pjsip_hdr *hdr;
 
-    PJ_ASSERT_RETURN(src && flags==0 && p_rdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(src && p_rdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN((flags & ~PJSIP_RX_DATA_CLONE_SHARED) == 0, PJ_EINVAL);
+
+    /* Only share buffers that can outlive the transport's processing */
+    if ((flags & PJSIP_RX_DATA_CLONE_SHARED) &&
+	(src->tp_info.buf_flag & (PJSIP_RX_DATA_BUF_DETACHABLE |
+				  PJSIP_RX_DATA_BUF_CLONED)))
+    {
+	return rx_data_clone_shared(src, p_rdata);
+    }
 
     pool = pj_pool_create(src->tp_info.pool->factory,
                           "rtd%p",
@@ -685,9 +1095,17 @@ PJ_DEF(pj_status_t) pjsip_rx_data_clone( const pjsip_rx_data *src,
     /* Parts of tp_info */
     dst->tp_info.pool = pool;
     dst->tp_info.transport = (pjsip_transport*)src->tp_info.transport;
+    dst->tp_info.buf_flag = PJSIP_RX_DATA_BUF_CLONED;
 
-    /* pkt_info can be memcopied */
-    pj_memcpy(&dst->pkt_info, &src->pkt_info, sizeof(src->pkt_info));
+    /* pkt_info can be memcopied, the packet of shared clone is kept in
+     * its owner.
+     */
+    if (src->tp_info.buf_owner) {
+	pj_memcpy(&dst->pkt_info, &src->tp_info.buf_owner->pkt_info,
+		  sizeof(src->pkt_info));
+    } else {
+	pj_memcpy(&dst->pkt_info, &src->pkt_info, sizeof(src->pkt_info));
+    }
 
     /* msg_info needs deep clone */
     dst->msg_info.msg_buf = dst->pkt_info.packet;
@@ -738,12 +1156,47 @@ PJ_DEF(pj_status_t) pjsip_rx_data_free_cloned(pjsip_rx_data *rdata)
 {
     PJ_ASSERT_RETURN(rdata, PJ_EINVAL);
 
+    if (rdata->tp_info.buf_owner) {
+	rx_buf_dec_ref(rdata->tp_info.buf_owner);
+    } else {
+	pjsip_transport *tp = rdata->tp_info.transport;
+	pj_bool_t shared;
+
+	/* Keep the buffer while shared clones still refer to it. */
+	pj_lock_acquire(tp->lock);
+	shared = (rdata->tp_info.buf_ref_cnt != 0);
+	if (shared)
+	    rdata->tp_info.buf_flag |= PJSIP_RX_DATA_BUF_DETACHED;
+	pj_lock_release(tp->lock);
+
+	if (shared)
+	    return PJ_SUCCESS;
+    }
+
     pjsip_transport_dec_ref(rdata->tp_info.transport);
     pj_pool_release(rdata->tp_info.pool);
 
     return PJ_SUCCESS;
 }
 
+/* Give up transport's receive buffer if it's still shared by clones. */
+PJ_DEF(pj_bool_t) pjsip_rx_data_detach_buffer(pjsip_rx_data *rdata)
+{
+    pjsip_transport *tp = rdata->tp_info.transport;
+    pj_bool_t detached;
+
+    PJ_ASSERT_RETURN(rdata->tp_info.buf_flag & PJSIP_RX_DATA_BUF_DETACHABLE,
+		     PJ_FALSE);
+
+    pj_lock_acquire(tp->lock);
+    detached = (rdata->tp_info.buf_ref_cnt != 0);
+    if (detached)
+	rdata->tp_info.buf_flag |= PJSIP_RX_DATA_BUF_DETACHED;
+    pj_lock_release(tp->lock);
+
+    return detached;
+}
+
 /*****************************************************************************
  *
  * TRANSPORT KEY
@@ -935,6 +1388,10 @@ PJ_DEF(pj_status_t) pjsip_tpmgr_send_raw(pjsip_tpmgr *mgr,
 	pj_memcpy(tdata->buf.start, raw_data, data_len);
     }
     tdata->buf.cur = tdata->buf.start + data_len;
+
+    /* The buffer no longer contains the printed message */
+    if (tdata->print_cache)
+	tdata->print_cache->valid = PJ_FALSE;
  
     /* Save callback data. */
     tdata->token = token;
@@ -37,6 +37,7 @@
 #define THIS_FILE	"sip_transport_tcp.c"
 
 #define MAX_ASYNC_CNT	16
+#define MAX_LISTENER_CNT 16
 #define POOL_LIS_INIT	512
 #define POOL_LIS_INC	512
 #define POOL_TP_INIT	512
@@ -56,13 +57,16 @@ struct tcp_listener
     pj_bool_t		     is_registered;
     pjsip_endpoint	    *endpt;
     pjsip_tpmgr		    *tpmgr;
-    pj_activesock_t	    *asock;
+    pj_activesock_t	    *asock[MAX_LISTENER_CNT];
+    unsigned		     asock_cnt;
     pj_sockaddr		     bound_addr;
     pj_qos_type		     qos_type;
     pj_qos_params	     qos_params;
     pj_sockopt_params	     sockopt_params;
     pj_bool_t		     reuse_addr;        
     unsigned		     async_cnt;    
+    int			     backlog;
+    unsigned		     listener_cnt;
 
     /* Group lock to be used by TCP listener and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
@@ -74,7 +78,8 @@ struct tcp_listener
  * A delayed transmission occurs when application sends tx_data when
  * the TCP connect/establishment is still in progress. These delayed
  * transmission will be "flushed" once the socket is connected (either
- * successfully or with errors).
+ * successfully or with errors). The same structure is used to queue
+ * tx_data while another send operation is in progress (see tx_list).
  */
 struct delayed_tdata
 {
@@ -121,6 +126,14 @@ struct tcp_transport
     /* Pending transmission list. */
     struct delayed_tdata     delayed_list;
 
+    /* Transmit queue. Only one send operation is submitted to the ioqueue
+     * at a time, packets sent meanwhile are queued here and will be sent
+     * together with a single sendv when the operation completes.
+     */
+    struct delayed_tdata     tx_list;
+    pj_bool_t		     tx_busy;
+    pj_ssize_t		     tx_offset;
+
     /* Group lock to be used by TCP transport and ioqueue key */
     pj_grp_lock_t	    *grp_lock;
 };
@@ -235,6 +248,8 @@ PJ_DEF(void) pjsip_tcp_transport_cfg_default(pjsip_tcp_transport_cfg *cfg,
     cfg->af = af;
     pj_sockaddr_init(cfg->af, &cfg->bind_addr, NULL, 0);
     cfg->async_cnt = 1;
+    cfg->backlog = PJSIP_TCP_TRANSPORT_BACKLOG;
+    cfg->listener_cnt = 1;
     cfg->reuse_addr = PJSIP_TCP_TRANSPORT_REUSEADDR;
 }
 
@@ -343,12 +358,14 @@ static void update_transport_info(struct tcp_listener *listener)
 	    listener->factory.addr_name.host.ptr,
 	    listener->factory.addr_name.port);
 
-    if (listener->asock) {
+    if (listener->asock_cnt) {
 	PJ_LOG(4, (listener->factory.obj_name,
-	       "SIP TCP listener ready for incoming connections at %.*s:%d",
+	       "SIP TCP listener ready for incoming connections at %.*s:%d "
+	       "(%u socket(s))",
 	       (int)listener->factory.addr_name.host.slen,
 	       listener->factory.addr_name.host.ptr,
-	       listener->factory.addr_name.port));
+	       listener->factory.addr_name.port,
+	       listener->asock_cnt));
     } else {
 	PJ_LOG(4, (listener->factory.obj_name, "SIP TCP is ready "
 	       "(client only)"));
@@ -388,6 +405,8 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_start3(
     listener->qos_type = cfg->qos_type;
     listener->reuse_addr = cfg->reuse_addr;
     listener->async_cnt = cfg->async_cnt;
+    listener->backlog = cfg->backlog;
+    listener->listener_cnt = cfg->listener_cnt;
     pj_memcpy(&listener->qos_params, &cfg->qos_params,
 	      sizeof(cfg->qos_params));
     pj_memcpy(&listener->sockopt_params, &cfg->sockopt_params,
@@ -512,6 +531,17 @@ static void lis_on_destroy(void *arg)
     }
 }
 
+/* This will close the listening sockets. */
+static void lis_close_asock(struct tcp_listener *listener)
+{
+    while (listener->asock_cnt) {
+	unsigned i = --listener->asock_cnt;
+
+	pj_activesock_close(listener->asock[i]);
+	listener->asock[i] = NULL;
+    }
+}
+
 /* This will close the listener. */
 static void lis_close(struct tcp_listener *listener)
 {
@@ -520,10 +550,7 @@ static void lis_close(struct tcp_listener *listener)
 	listener->is_registered = PJ_FALSE;
     }
 
-    if (listener->asock) {
-	pj_activesock_close(listener->asock);
-	listener->asock = NULL;
-    }
+    lis_close_asock(listener);
 }
 
 /* This callback is called by transport manager to destroy listener */
@@ -584,6 +611,14 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 			      pj_ioqueue_op_key_t *send_key,
 			      pj_ssize_t sent);
 
+/* Callback when send operation completes */
+static pj_bool_t on_send_complete(pj_activesock_t *asock,
+				  pj_ioqueue_op_key_t *send_key,
+				  pj_ssize_t sent);
+
+/* Send queued packets */
+static void tcp_flush_tx(struct tcp_transport *tcp);
+
 /* Callback when connect completes */
 static pj_bool_t on_connect_complete(pj_activesock_t *asock,
 				     pj_status_t status);
@@ -631,6 +666,7 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
     tcp->sock = sock;
     /*tcp->listener = listener;*/
     pj_list_init(&tcp->delayed_list);
+    pj_list_init(&tcp->tx_list);
     tcp->base.pool = pool;
 
     pj_ansi_snprintf(tcp->base.obj_name, PJ_MAX_OBJ_NAME, 
@@ -687,7 +723,7 @@ static pj_status_t tcp_create( struct tcp_listener *listener,
 
     pj_bzero(&tcp_callback, sizeof(tcp_callback));
     tcp_callback.on_data_read = &on_data_read;
-    tcp_callback.on_data_sent = &on_data_sent;
+    tcp_callback.on_data_sent = &on_send_complete;
     tcp_callback.on_connect_complete = &on_connect_complete;
 
     ioqueue = pjsip_endpt_get_ioqueue(listener->endpt);
@@ -729,40 +765,139 @@ on_error:
 static void tcp_flush_pending_tx(struct tcp_transport *tcp)
 {
     pj_time_val now;
+    pj_bool_t flush = PJ_FALSE;
 
     pj_gettickcount(&now);
     pj_lock_acquire(tcp->base.lock);
+
+    /* Move the delayed transmits to the front of the transmit queue,
+     * keeping their order.
+     */
     while (!pj_list_empty(&tcp->delayed_list)) {
 	struct delayed_tdata *pending_tx;
-	pjsip_tx_data *tdata;
-	pj_ioqueue_op_key_t *op_key;
-	pj_ssize_t size;
-	pj_status_t status;
 
-	pending_tx = tcp->delayed_list.next;
+	pending_tx = tcp->delayed_list.prev;
 	pj_list_erase(pending_tx);
 
-	tdata = pending_tx->tdata_op_key->tdata;
-	op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
-
         if (pending_tx->timeout.sec > 0 &&
             PJ_TIME_VAL_GT(now, pending_tx->timeout))
         {
             continue;
         }
 
-	/* send! */
-	size = tdata->buf.cur - tdata->buf.start;
-	status = pj_activesock_send(tcp->asock, op_key, tdata->buf.start, 
-				    &size, 0);
-	if (status != PJ_EPENDING) {
-            pj_lock_release(tcp->base.lock);
-	    on_data_sent(tcp->asock, op_key, size);
-            pj_lock_acquire(tcp->base.lock);
-	}
+	pj_list_push_front(&tcp->tx_list, pending_tx);
+    }
 
+    if (!tcp->tx_busy && !pj_list_empty(&tcp->tx_list)) {
+	tcp->tx_busy = PJ_TRUE;
+	flush = PJ_TRUE;
     }
     pj_lock_release(tcp->base.lock);
+
+    /* send! */
+    if (flush)
+	tcp_flush_tx(tcp);
+}
+
+
+/* Send the queued packets, gathering as many as possible into a single
+ * sendv. The caller must have set tx_busy, and there must be no send
+ * operation pending in the ioqueue. The function returns when the queue
+ * is empty (tx_busy is cleared), or when a send operation is pending in
+ * the ioqueue (tx_busy stays set until on_send_complete()).
+ */
+static void tcp_flush_tx(struct tcp_transport *tcp)
+{
+    for (;;) {
+	struct delayed_tdata *tx[PJSIP_TCP_SEND_COALESCE];
+	pj_sock_iovec iov[PJSIP_TCP_SEND_COALESCE];
+	pj_ioqueue_op_key_t *op_key;
+	pj_status_t status;
+	pj_ssize_t sent, size;
+	unsigned i, cnt, done;
+
+	/* Gather the queued packets */
+	pj_lock_acquire(tcp->base.lock);
+	if (pj_list_empty(&tcp->tx_list)) {
+	    tcp->tx_busy = PJ_FALSE;
+	    pj_lock_release(tcp->base.lock);
+	    return;
+	}
+
+	for (cnt = 0; cnt < PJSIP_TCP_SEND_COALESCE &&
+		      !pj_list_empty(&tcp->tx_list); ++cnt)
+	{
+	    pjsip_tx_data *tdata;
+
+	    tx[cnt] = tcp->tx_list.next;
+	    pj_list_erase(tx[cnt]);
+
+	    tdata = tx[cnt]->tdata_op_key->tdata;
+	    iov[cnt].buf = tdata->buf.start;
+	    iov[cnt].len = tdata->buf.cur - tdata->buf.start;
+	}
+	status = tcp->close_reason;
+	pj_lock_release(tcp->base.lock);
+
+	/* Transport has failed, cancel the packets */
+	if (status != PJ_SUCCESS) {
+	    for (i = 0; i < cnt; ++i) {
+		op_key = (pj_ioqueue_op_key_t*)tx[i]->tdata_op_key;
+		on_data_sent(tcp->asock, op_key, -status);
+	    }
+	    continue;
+	}
+
+	/* Send as much as the socket takes now. On error, leave it to the
+	 * ioqueue send below to retry and report the error.
+	 */
+	sent = 0;
+	if (cnt > 1) {
+	    status = pj_sock_sendv(tcp->sock, iov, cnt, &sent, 0);
+	    if (status != PJ_SUCCESS)
+		sent = 0;
+	}
+
+	for (done = 0; done < cnt && sent >= (pj_ssize_t)iov[done].len;
+	     ++done)
+	{
+	    sent -= iov[done].len;
+	}
+
+	/* Put back the packets which are not going to be sent now */
+	if (done + 1 < cnt) {
+	    pj_lock_acquire(tcp->base.lock);
+	    for (i = cnt - 1; i > done; --i)
+		pj_list_push_front(&tcp->tx_list, tx[i]);
+	    pj_lock_release(tcp->base.lock);
+	}
+
+	/* Notify the packets which have been sent completely */
+	for (i = 0; i < done; ++i) {
+	    op_key = (pj_ioqueue_op_key_t*)tx[i]->tdata_op_key;
+	    on_data_sent(tcp->asock, op_key, iov[i].len);
+	}
+
+	if (done == cnt)
+	    continue;
+
+	/* Send the (rest of the) next packet with the ioqueue */
+	op_key = (pj_ioqueue_op_key_t*)tx[done]->tdata_op_key;
+	size = iov[done].len - sent;
+	tcp->tx_offset = sent;
+	status = pj_activesock_send(tcp->asock, op_key,
+				    (const char*)iov[done].buf + sent,
+				    &size, 0);
+	if (status == PJ_EPENDING)
+	    return;
+
+	tcp->tx_offset = 0;
+	if (status != PJ_SUCCESS)
+	    size = -status;
+	else if (size > 0)
+	    size += sent;
+	on_data_sent(tcp->asock, op_key, size);
+    }
 }
 
 
@@ -821,6 +956,19 @@ static pj_status_t tcp_destroy(pjsip_transport *transport,
 	on_data_sent(tcp->asock, op_key, -reason);
     }
 
+    /* Cancel all queued transmits */
+    while (!pj_list_empty(&tcp->tx_list)) {
+	struct delayed_tdata *pending_tx;
+	pj_ioqueue_op_key_t *op_key;
+
+	pending_tx = tcp->tx_list.next;
+	pj_list_erase(pending_tx);
+
+	op_key = (pj_ioqueue_op_key_t*)pending_tx->tdata_op_key;
+
+	on_data_sent(tcp->asock, op_key, -reason);
+    }
+
     if (tcp->asock) {
 	pj_activesock_close(tcp->asock);
 	tcp->asock = NULL;
@@ -1214,6 +1362,32 @@ static pj_bool_t on_data_sent(pj_activesock_t *asock,
 }
 
 
+/* 
+ * Callback from ioqueue when the send operation completes.
+ */
+static pj_bool_t on_send_complete(pj_activesock_t *asock,
+				  pj_ioqueue_op_key_t *op_key,
+				  pj_ssize_t bytes_sent)
+{
+    struct tcp_transport *tcp = (struct tcp_transport*) 
+    				pj_activesock_get_user_data(asock);
+
+    /* Report the whole packet length if the packet was partially sent
+     * by tcp_flush_tx().
+     */
+    if (bytes_sent > 0)
+	bytes_sent += tcp->tx_offset;
+    tcp->tx_offset = 0;
+
+    on_data_sent(asock, op_key, bytes_sent);
+
+    /* Continue with the queued packets */
+    tcp_flush_tx(tcp);
+
+    return PJ_TRUE;
+}
+
+
 /* 
  * This callback is called by transport manager to send SIP message 
  */
@@ -1288,6 +1462,26 @@ static pj_status_t tcp_send_msg(pjsip_transport *transport,
     } 
     
     if (!delayed) {
+	/*
+	 * If another send operation is in progress, queue the packet. It
+	 * will be sent together with other queued packets once the
+	 * operation completes.
+	 */
+	pj_lock_acquire(tcp->base.lock);
+	if (tcp->tx_busy) {
+	    struct delayed_tdata *queued_tdata;
+
+	    queued_tdata = PJ_POOL_ZALLOC_T(tdata->pool,
+					    struct delayed_tdata);
+	    queued_tdata->tdata_op_key = &tdata->op_key;
+	    pj_list_push_back(&tcp->tx_list, queued_tdata);
+	    pj_lock_release(tcp->base.lock);
+
+	    return PJ_EPENDING;
+	}
+	tcp->tx_busy = PJ_TRUE;
+	pj_lock_release(tcp->base.lock);
+
 	/*
 	 * Transport is ready to go. Send the packet to ioqueue to be
 	 * sent asynchronously.
@@ -1312,6 +1506,9 @@ static pj_status_t tcp_send_msg(pjsip_transport *transport,
 
 		tcp_init_shutdown(tcp, status);
 	    }
+
+	    /* Send packets that were queued meanwhile */
+	    tcp_flush_tx(tcp);
 	}
     }
 
@@ -1552,6 +1749,17 @@ static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 	      tcp->base.remote_name.host.ptr,
 	      tcp->base.remote_name.port));
 
+    /* Keep-alive takes turn with the queued packets, so skip it when
+     * there is transmission in progress.
+     */
+    pj_lock_acquire(tcp->base.lock);
+    if (tcp->tx_busy) {
+	pj_lock_release(tcp->base.lock);
+	goto on_schedule;
+    }
+    tcp->tx_busy = PJ_TRUE;
+    pj_lock_release(tcp->base.lock);
+
     /* Send the data */
     size = tcp->ka_pkt.slen;
     status = pj_activesock_send(tcp->asock, &tcp->ka_op_key.key,
@@ -1561,9 +1769,15 @@ static void tcp_keep_alive_timer(pj_timer_heap_t *th, pj_timer_entry *e)
 	tcp_perror(tcp->base.obj_name, 
 		   "Error sending keep-alive packet", status);
 	tcp_init_shutdown(tcp, status);
+	tcp_flush_tx(tcp);
 	return;
     }
 
+    /* Send packets that were queued meanwhile */
+    if (status == PJ_SUCCESS)
+	tcp_flush_tx(tcp);
+
+on_schedule:
     /* Register next keep-alive */
     delay.sec = pjsip_cfg()->tcp.keep_alive_interval;
     delay.msec = 0;
@@ -1593,65 +1807,32 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_lis_start(pjsip_tpfactory *factory,
     int addr_len, af;    
     struct tcp_listener *listener = (struct tcp_listener *)factory;
     pj_sockaddr *listener_addr = &factory->local_addr;
+    pj_sockaddr bind_addr;
+    unsigned i, lis_cnt;
     pj_status_t status = PJ_SUCCESS;
 
     /* Nothing to be done, if listener already started. */
-    if (listener->asock)
+    if (listener->asock_cnt)
 	return PJ_SUCCESS;
     
     update_bound_addr(listener, local);
       
     addr_len = pj_sockaddr_get_len(listener_addr);
     af = pjsip_transport_type_get_af(listener->factory.type);
-
-    /* Create socket */
-    status = pj_sock_socket(af, pj_SOCK_STREAM(), 0, &sock);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-    /* Apply QoS, if specified */
-    status = pj_sock_apply_qos2(sock, listener->qos_type,
-				&listener->qos_params, 2,
-				listener->factory.obj_name,
-				"SIP TCP listener socket");
-
-    /* Apply SO_REUSEADDR */
-    if (listener->reuse_addr) {
-	int enabled = 1;
-	status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(), pj_SO_REUSEADDR(),
-				    &enabled, sizeof(enabled));
-	if (status != PJ_SUCCESS) {
-	    PJ_LOG(1, ("TRACE", "fail set reuseaddr"));
-	    PJ_PERROR(4, (listener->factory.obj_name, status,
-		"Warning: error applying SO_REUSEADDR"));
-	}
+    pj_sockaddr_cp(&bind_addr, listener_addr);
+
+    /* Several listening sockets on the same address need SO_REUSEPORT */
+    lis_cnt = listener->listener_cnt;
+    if (lis_cnt == 0)
+	lis_cnt = 1;
+    else if (lis_cnt > MAX_LISTENER_CNT)
+	lis_cnt = MAX_LISTENER_CNT;
+    if (lis_cnt > 1 && pj_SO_REUSEPORT() == 0xFFFF) {
+	PJ_LOG(3, (listener->factory.obj_name, "Warning: SO_REUSEPORT is "
+		   "not supported, using one listening socket"));
+	lis_cnt = 1;
     }
 
-    /* Apply socket options, if specified */
-    if (listener->sockopt_params.cnt)
-	status = pj_sock_setsockopt_params(sock, &listener->sockopt_params);
-
-    status = pj_sock_bind(sock, listener_addr, addr_len);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-    /* Retrieve the bound address */
-    status = pj_sock_getsockname(sock, &listener->factory.local_addr, 
-				 &addr_len);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-    status = update_factory_addr(listener, a_name);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-    /* Start listening to the address */
-    status = pj_sock_listen(sock, PJSIP_TCP_TRANSPORT_BACKLOG);
-    if (status != PJ_SUCCESS)
-	goto on_error;
-
-
-    /* Create active socket */
     pj_activesock_cfg_default(&asock_cfg);
     if (listener->async_cnt > MAX_ASYNC_CNT)
 	asock_cfg.async_cnt = MAX_ASYNC_CNT;
@@ -1662,23 +1843,127 @@ PJ_DEF(pj_status_t) pjsip_tcp_transport_lis_start(pjsip_tpfactory *factory,
     pj_bzero(&listener_cb, sizeof(listener_cb));
     listener_cb.on_accept_complete = &on_accept_complete;
 
-    status = pj_activesock_create(listener->factory.pool, sock,
-				  pj_SOCK_STREAM(), &asock_cfg,
-				  pjsip_endpt_get_ioqueue(listener->endpt),
-				  &listener_cb, listener,
-				  &listener->asock);
+    for (i = 0; i < lis_cnt; ++i) {
+	pj_activesock_t *asock;
+
+	/* Create socket */
+	status = pj_sock_socket(af, pj_SOCK_STREAM(), 0, &sock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	/* Apply QoS, if specified */
+	status = pj_sock_apply_qos2(sock, listener->qos_type,
+				    &listener->qos_params, 2,
+				    listener->factory.obj_name,
+				    "SIP TCP listener socket");
+
+	/* Apply SO_REUSEADDR */
+	if (listener->reuse_addr) {
+	    int enabled = 1;
+	    status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(),
+					pj_SO_REUSEADDR(),
+					&enabled, sizeof(enabled));
+	    if (status != PJ_SUCCESS) {
+		PJ_LOG(1, ("TRACE", "fail set reuseaddr"));
+		PJ_PERROR(4, (listener->factory.obj_name, status,
+		    "Warning: error applying SO_REUSEADDR"));
+	    }
+	}
+
+	/* Apply SO_REUSEPORT, so that the kernel balances incoming
+	 * connections among the listening sockets.
+	 */
+	if (lis_cnt > 1) {
+	    int enabled = 1;
+	    status = pj_sock_setsockopt(sock, pj_SOL_SOCKET(),
+					pj_SO_REUSEPORT(),
+					&enabled, sizeof(enabled));
+	    if (status != PJ_SUCCESS) {
+		PJ_PERROR(3, (listener->factory.obj_name, status,
+		    "Warning: error applying SO_REUSEPORT, using %u "
+		    "listening socket(s)", i ? i : 1));
+		if (i == 0) {
+		    lis_cnt = 1;
+		} else {
+		    pj_sock_close(sock);
+		    sock = PJ_INVALID_SOCKET;
+		    status = PJ_SUCCESS;
+		    break;
+		}
+	    }
+	}
+
+	/* Apply socket options, if specified */
+	if (listener->sockopt_params.cnt)
+	    status = pj_sock_setsockopt_params(sock,
+					       &listener->sockopt_params);
+
+	status = pj_sock_bind(sock, &bind_addr, addr_len);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	if (i == 0) {
+	    /* Retrieve the bound address */
+	    status = pj_sock_getsockname(sock, &listener->factory.local_addr, 
+					 &addr_len);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+
+	    /* The other sockets must be bound to the same port */
+	    pj_sockaddr_set_port(&bind_addr,
+				 pj_sockaddr_get_port(listener_addr));
+
+	    status = update_factory_addr(listener, a_name);
+	    if (status != PJ_SUCCESS)
+		goto on_error;
+	}
+
+	/* Start listening to the address */
+	status = pj_sock_listen(sock, listener->backlog);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+
+	/* Create active socket */
+	status = pj_activesock_create(listener->factory.pool, sock,
+				      pj_SOCK_STREAM(), &asock_cfg,
+				      pjsip_endpt_get_ioqueue(listener->endpt),
+				      &listener_cb, listener, &asock);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
 
-    /* Start pending accept() operations */
-    status = pj_activesock_start_accept(listener->asock,
-					listener->factory.pool);
+	sock = PJ_INVALID_SOCKET;
+	listener->asock[listener->asock_cnt++] = asock;
+
+	/* Put each listening socket on its own ioqueue shard, so that
+	 * the worker threads accept connections in parallel.
+	 */
+	if (lis_cnt > 1) {
+	    pj_ioqueue_t *ioq = pjsip_endpt_get_ioqueue(listener->endpt);
+	    pj_status_t st;
+
+	    st = pj_ioqueue_set_shard(pj_activesock_get_key(asock),
+				      i % pj_ioqueue_get_shard_count(ioq));
+	    if (st != PJ_SUCCESS) {
+		PJ_PERROR(3, (listener->factory.obj_name, st,
+			      "Warning: unable to move listening socket %u "
+			      "to its own ioqueue shard", i));
+	    }
+	}
+
+	/* Start pending accept() operations */
+	status = pj_activesock_start_accept(asock, listener->factory.pool);
+	if (status != PJ_SUCCESS)
+	    goto on_error;
+    }
 
     update_transport_info(listener);
 
     return status;
 
 on_error:
-    if (listener->asock == NULL && sock != PJ_INVALID_SOCKET)
+    if (sock != PJ_INVALID_SOCKET)
 	pj_sock_close(sock);
+    lis_close_asock(listener);
 
     return status;
 }
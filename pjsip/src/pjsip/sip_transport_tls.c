@@ -315,6 +315,7 @@ static void set_ssock_param(pj_ssl_sock_param *ssock_param,
     ssock_param->entropy_type = listener->tls_setting.entropy_type;
     ssock_param->entropy_path = listener->tls_setting.entropy_path;
     ssock_param->reuse_addr = listener->tls_setting.reuse_addr;
+    ssock_param->backlog = listener->tls_setting.backlog;
     ssock_param->qos_type = listener->tls_setting.qos_type;
     ssock_param->qos_ignore_error = listener->tls_setting.qos_ignore_error;
     pj_memcpy(&ssock_param->qos_params, &listener->tls_setting.qos_params,
@@ -322,6 +323,7 @@ static void set_ssock_param(pj_ssl_sock_param *ssock_param,
 
     ssock_param->sockopt_ignore_error =
 				    listener->tls_setting.sockopt_ignore_error;
+    ssock_param->enable_ktls = listener->tls_setting.enable_ktls;
     /* Copy the sockopt */
     pj_memcpy(&ssock_param->sockopt_params,
 	      &listener->tls_setting.sockopt_params,
@@ -1172,6 +1174,7 @@ static pj_status_t lis_create_transport(pjsip_tpfactory *factory,
 
     ssock_param.sockopt_ignore_error = 
 				     listener->tls_setting.sockopt_ignore_error;
+    ssock_param.enable_ktls = listener->tls_setting.enable_ktls;
     /* Copy the sockopt */
     pj_memcpy(&ssock_param.sockopt_params, 
 	      &listener->tls_setting.sockopt_params,
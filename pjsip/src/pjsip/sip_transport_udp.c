@@ -102,6 +102,7 @@ static void init_rdata(struct udp_transport *tp, unsigned rdata_index,
     rdata->tp_info.transport = &tp->base;
     rdata->tp_info.tp_data = (void*)(pj_ssize_t)rdata_index;
     rdata->tp_info.op_key.rdata = rdata;
+    rdata->tp_info.buf_flag = PJSIP_RX_DATA_BUF_DETACHABLE;
     pj_ioqueue_op_key_init(&rdata->tp_info.op_key.op_key, 
 			   sizeof(pj_ioqueue_op_key_t));
 
@@ -216,7 +217,33 @@ static void udp_on_read_complete( pj_ioqueue_key_t *key,
 	    rdata_index = (unsigned)(unsigned long)(pj_ssize_t)
 			  rdata->tp_info.tp_data;
 
-	    pj_pool_reset(rdata_pool);
+	    if (rdata->tp_info.buf_ref_cnt) {
+		/* The buffer may still be shared by cloned rdata, which
+		 * will then release its pool. Create the pool for the next
+		 * packet before giving up the buffer.
+		 */
+		pj_pool_t *new_pool;
+
+		new_pool = pjsip_endpt_create_pool(rdata_tp->base.endpt,
+						   "rtd%p",
+						   PJSIP_POOL_RDATA_LEN,
+						   PJSIP_POOL_RDATA_INC);
+		if (!new_pool) {
+		    PJ_LOG(1,(rdata_tp->base.obj_name,
+			      "FATAL: unable to allocate receive buffer, "
+			      "UDP transport stopping!"));
+		    break;
+		}
+
+		if (pjsip_rx_data_detach_buffer(rdata)) {
+		    rdata_pool = new_pool;
+		} else {
+		    pjsip_endpt_release_pool(rdata_tp->base.endpt, new_pool);
+		    pj_pool_reset(rdata_pool);
+		}
+	    } else {
+		pj_pool_reset(rdata_pool);
+	    }
 	    init_rdata(rdata_tp, rdata_index, rdata_pool, &rdata);
 
 	    /* Change some vars to point to new location after
@@ -341,7 +368,9 @@ static pj_status_t udp_send_msg( pjsip_transport *transport,
     /* Send to ioqueue! */
     size = tdata->buf.cur - tdata->buf.start;
     status = pj_ioqueue_sendto(tp->key, (pj_ioqueue_op_key_t*)&tdata->op_key,
-			       tdata->buf.start, &size, 0,
+			       tdata->buf.start, &size,
+			       (PJSIP_UDP_SEND_BATCH > 1 ?
+				    PJ_IOQUEUE_BATCH_SEND : 0),
 			       rem_addr, addr_len);
 
     if (status != PJ_EPENDING)
@@ -650,8 +679,20 @@ static pj_status_t register_to_ioqueue(struct udp_transport *tp)
     ioqueue_cb.on_read_complete = &udp_on_read_complete;
     ioqueue_cb.on_write_complete = &udp_on_write_complete;
 
-    return pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
-				     tp->grp_lock, tp, &ioqueue_cb, &tp->key);
+    status = pj_ioqueue_register_sock2(tp->base.pool, ioqueue, tp->sock,
+				       tp->grp_lock, tp, &ioqueue_cb,
+				       &tp->key);
+    if (status != PJ_SUCCESS)
+	return status;
+
+#if PJSIP_UDP_SEND_BATCH > 1
+    /* Enable batched send. Failure is not fatal, messages will just be
+     * sent one by one.
+     */
+    pj_ioqueue_set_send_batch(tp->key, PJSIP_UDP_SEND_BATCH);
+#endif
+
+    return PJ_SUCCESS;
 }
 
 /* Start ioqueue asynchronous reading to all rdata */
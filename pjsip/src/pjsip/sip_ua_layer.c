@@ -122,7 +122,8 @@ static pj_status_t mod_ua_load(pjsip_endpoint *endpt)
     if (status != PJ_SUCCESS)
 	return status;
 
-    mod_ua.dlg_table = pj_hash_create(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT);
+    mod_ua.dlg_table = pj_hash_create2(mod_ua.pool, PJSIP_MAX_DIALOG_COUNT,
+				       PJ_HASH_GROWABLE);
     if (mod_ua.dlg_table == NULL)
 	return PJ_ENOMEM;
 
@@ -106,20 +106,19 @@ PJ_DEF(pj_status_t) pjsip_target_set_add_from_msg( pjsip_target_set *tset,
     PJ_ASSERT_RETURN(tset && pool && msg, PJ_EINVAL);
 
     /* Scan for Contact headers and add the URI */
-    hdr = msg->hdr.next;
-    while (hdr != &msg->hdr) {
-	if (hdr->type == PJSIP_H_CONTACT) {
-	    const pjsip_contact_hdr *cn_hdr = (const pjsip_contact_hdr*)hdr;
-
-	    if (!cn_hdr->star) {
-		pj_status_t rc;
-		rc = pjsip_target_set_add_uri(tset, pool, cn_hdr->uri, 
-					      cn_hdr->q1000);
-		if (rc == PJ_SUCCESS)
-		    ++added;
-	    }
+    hdr = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+    while (hdr) {
+	const pjsip_contact_hdr *cn_hdr = (const pjsip_contact_hdr*)hdr;
+
+	if (!cn_hdr->star) {
+	    pj_status_t rc;
+	    rc = pjsip_target_set_add_uri(tset, pool, cn_hdr->uri, 
+					  cn_hdr->q1000);
+	    if (rc == PJ_SUCCESS)
+		++added;
 	}
-	hdr = hdr->next;
+	hdr = (const pjsip_hdr*) pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT,
+						    hdr->next);
     }
 
     return added ? PJ_SUCCESS : PJ_EEXISTS;
@@ -276,6 +275,7 @@ static void init_request_throw( pjsip_endpoint *endpt,
 	pj_memcpy(body->data, param_text->ptr, param_text->slen);
 	body->len = (unsigned)param_text->slen;
 	body->print_body = &pjsip_print_text_body;
+	body->clone_data = &pjsip_clone_text_data;
 	msg->body = body;
     }
 
@@ -1251,7 +1251,14 @@ static void stateless_send_transport_cb( void *token,
 	    }
 	}
 
-	pjsip_tx_data_invalidate_msg(tdata);
+	/* On the first attempt only the Via header has been changed. When
+	 * retrying, application callback may have modified the message too,
+	 * so print it all again.
+	 */
+	if (sent == -PJ_EPENDING)
+	    pjsip_tx_data_invalidate_hdr(tdata, via);
+	else
+	    pjsip_tx_data_invalidate_msg(tdata);
 
 	/* Send message using this transport. */
 	status = pjsip_transport_send( stateless_data->cur_transport,
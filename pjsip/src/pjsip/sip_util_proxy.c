@@ -246,6 +246,52 @@ on_error:
 }
 
 
+/*
+ * Create another copy of a request being forwarded, for the next target
+ * when forking.
+ */
+PJ_DEF(pj_status_t) pjsip_endpt_clone_request_fwd(pjsip_endpoint *endpt,
+						  const pjsip_tx_data *src,
+						  const pjsip_uri *uri,
+						  const pj_str_t *branch,
+						  pjsip_tx_data **p_tdata)
+{
+    pjsip_tx_data *tdata;
+    pjsip_via_hdr *via;
+    pj_status_t status;
+
+    PJ_ASSERT_RETURN(endpt && src && src->msg && p_tdata, PJ_EINVAL);
+    PJ_ASSERT_RETURN(src->msg->type == PJSIP_REQUEST_MSG,
+		     PJSIP_ENOTREQUESTMSG);
+
+    status = pjsip_tx_data_clone(src, 0, &tdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    /* Update the Request-URI */
+    if (uri) {
+	tdata->msg->line.req.uri = (pjsip_uri*)
+				   pjsip_uri_clone(tdata->pool, uri);
+	pjsip_tx_data_invalidate_hdr(tdata, NULL);
+    }
+
+    /* Each fork needs its own branch. When the branch is not specified,
+     * clear it so that a unique one is generated when the request is sent.
+     */
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, NULL);
+    if (via) {
+	if (branch)
+	    pj_strdup(tdata->pool, &via->branch_param, branch);
+	else
+	    via->branch_param.slen = 0;
+	pjsip_tx_data_invalidate_hdr(tdata, via);
+    }
+
+    *p_tdata = tdata;
+    return PJ_SUCCESS;
+}
+
+
 PJ_DEF(pj_status_t) pjsip_endpt_create_response_fwd( pjsip_endpoint *endpt,
 						     pjsip_rx_data *rdata, 
 						     unsigned options,
@@ -1243,8 +1243,11 @@ pj_bool_t pjsua_call_on_incoming(pjsip_rx_data *rdata)
     }
 
     if (!replaced_dlg) {
-	/* Clone rdata. */
-	pjsip_rx_data_clone(rdata, 0, &call->incoming_data);
+	/* Clone rdata. The message is only read afterwards, so share it
+	 * instead of copying it.
+	 */
+	pjsip_rx_data_clone(rdata, PJSIP_RX_DATA_CLONE_SHARED,
+			    &call->incoming_data);
     }
 
     /*
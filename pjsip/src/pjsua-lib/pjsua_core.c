@@ -695,8 +695,18 @@ PJ_DEF(pj_status_t) pjsua_reconfigure_logging(const pjsua_logging_config *cfg)
 static int worker_thread(void *arg)
 {
     enum { TIMEOUT = 10 };
+    pj_ioqueue_t *ioqueue = pjsip_endpt_get_ioqueue(pjsua_var.endpt);
+    pj_timer_heap_t *timer_heap = pjsip_endpt_get_timer_heap(pjsua_var.endpt);
+    unsigned shard_cnt = pj_ioqueue_get_shard_count(ioqueue);
+    unsigned timer_shard_cnt = pj_timer_heap_get_shard_count(timer_heap);
 
-    PJ_UNUSED_ARG(arg);
+    /* Bind to a shard of the ioqueue and of the timer heap, as long as
+     * there are enough worker threads to poll all shards.
+     */
+    if (shard_cnt > 1 && pjsua_var.ua_cfg.thread_cnt >= shard_cnt)
+	pj_ioqueue_set_thread_shard(ioqueue, (int)(pj_ssize_t)arg);
+    if (timer_shard_cnt > 1 && pjsua_var.ua_cfg.thread_cnt >= timer_shard_cnt)
+	pj_timer_heap_set_thread_shard(timer_heap, (int)(pj_ssize_t)arg);
 
     while (!pjsua_var.thread_quit_flag) {
 	int count;
@@ -706,6 +716,7 @@ static int worker_thread(void *arg)
 	    pj_thread_sleep(TIMEOUT);
     }
 
+    pjsip_endpt_release_thread_pools(pjsua_var.endpt);
     return 0;
 }
 
@@ -1116,7 +1127,8 @@ PJ_DEF(pj_status_t) pjsua_init( const pjsua_config *ua_cfg,
 	    char thread_name[16];
 	    pj_ansi_snprintf(thread_name, 16, "pjsua_%d", ii);
 	    status = pj_thread_create(pjsua_var.pool, thread_name, &worker_thread,
-				      NULL, 0, 0, &pjsua_var.thread[ii]);
+				      (void*)(pj_ssize_t)ii, 0, 0,
+				      &pjsua_var.thread[ii]);
 	    if (status != PJ_SUCCESS)
 		goto on_error;
 	}
@@ -2373,6 +2385,17 @@ PJ_DEF(pj_status_t) pjsua_transport_create( pjsip_transport_type_e type,
 	pj_memcpy(&tcp_cfg.sockopt_params, &cfg->sockopt_params,
 		  sizeof(tcp_cfg.sockopt_params));
 
+	/* When the worker threads are bound to the ioqueue shards, give
+	 * each of them its own listening socket.
+	 */
+	{
+	    pj_ioqueue_t *ioq = pjsip_endpt_get_ioqueue(pjsua_var.endpt);
+	    unsigned shard_cnt = pj_ioqueue_get_shard_count(ioq);
+
+	    if (shard_cnt > 1 && pjsua_var.ua_cfg.thread_cnt >= shard_cnt)
+		tcp_cfg.listener_cnt = shard_cnt;
+	}
+
 	/* Create the TCP transport */
 	status = pjsip_tcp_transport_start3(pjsua_var.endpt, &tcp_cfg, &tcp);
 
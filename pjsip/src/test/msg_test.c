@@ -843,8 +843,149 @@ static pj_status_t simple_test(void)
     return PJ_SUCCESS;
 }
 
+/* Lazy parsing must give the same message as full parsing once all headers
+ * are parsed, and the unparsed headers must be found by type.
+ */
+static int lazy_parse_test(void)
+{
+    unsigned i, lazy_cnt = 0;
+    char buf1[PJSIP_MAX_PKT_LEN];
+    char buf2[PJSIP_MAX_PKT_LEN];
+    int rc = 0;
+
+    PJ_LOG(3,(THIS_FILE, "  lazy parsing test.."));
+
+    for (i=0; i<PJ_ARRAY_SIZE(test_array) && rc==0; ++i) {
+	struct test_msg *entry = &test_array[i];
+	pj_pool_t *pool;
+	pjsip_msg *msg1, *msg2;
+	pjsip_hdr *h1, *h2;
+	pj_ssize_t len1, len2;
+
+	if (entry->len==0)
+	    entry->len = pj_ansi_strlen(entry->msg);
+
+	pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+	msg1 = pjsip_parse_msg(pool, entry->msg, entry->len, NULL);
+	msg2 = pjsip_parse_msg2(pool, entry->msg, entry->len,
+				PJSIP_PARSE_MSG_LAZY_HDR, NULL);
+	if (!msg1 || !msg2) {
+	    rc = -1000;
+	    goto next;
+	}
+
+	for (h2=msg2->hdr.next; h2!=&msg2->hdr; h2=h2->next) {
+	    if (pjsip_hdr_is_lazy(h2))
+		++lazy_cnt;
+	}
+
+	/* Contact headers are parsed lazily */
+	h1 = (pjsip_hdr*) pjsip_msg_find_hdr(msg1, PJSIP_H_CONTACT, NULL);
+	h2 = (pjsip_hdr*) pjsip_msg_find_hdr(msg2, PJSIP_H_CONTACT, NULL);
+	while (h1 && h2) {
+	    pjsip_contact_hdr *c1 = (pjsip_contact_hdr*)h1;
+	    pjsip_contact_hdr *c2 = (pjsip_contact_hdr*)h2;
+
+	    if (c1->star != c2->star || c1->q1000 != c2->q1000 ||
+		(c1->uri && pjsip_uri_cmp(PJSIP_URI_IN_CONTACT_HDR,
+					  c1->uri, c2->uri) != 0))
+	    {
+		rc = -1010;
+		goto next;
+	    }
+	    h1 = (pjsip_hdr*) pjsip_msg_find_hdr(msg1, PJSIP_H_CONTACT,
+						 h1->next);
+	    h2 = (pjsip_hdr*) pjsip_msg_find_hdr(msg2, PJSIP_H_CONTACT,
+						 h2->next);
+	}
+	if (h1 || h2) {
+	    rc = -1020;
+	    goto next;
+	}
+
+	/* Parse the rest and compare the whole message */
+	pjsip_msg_parse_lazy_hdrs(msg2);
+	len1 = pjsip_msg_print(msg1, buf1, sizeof(buf1));
+	len2 = pjsip_msg_print(msg2, buf2, sizeof(buf2));
+	if (len1 < 1 || len1 != len2 || pj_memcmp(buf1, buf2, len1) != 0) {
+	    rc = -1030;
+	    goto next;
+	}
+
+next:
+	pjsip_endpt_release_pool(endpt, pool);
+	if (rc != 0) {
+	    PJ_LOG(3,(THIS_FILE, "   error: message %d: rc=%d", i, rc));
+	}
+    }
+
+    if (rc == 0 && lazy_cnt == 0) {
+	PJ_LOG(3,(THIS_FILE, "   error: no header is parsed lazily"));
+	rc = -1040;
+    }
+
+    return rc;
+}
+
 
 #if INCLUDE_BENCHMARKS
+/* Parse the messages in lazy mode, looking up the headers that a stateless
+ * proxy needs.
+ */
+static int lazy_benchmark(unsigned *p_parse)
+{
+    pj_pool_t *pool;
+    int i, loop;
+    pj_timestamp zero, t1, t2, total;
+    pj_time_val elapsed;
+    pj_highprec_t len, avg_parse;
+
+    zero.u64 = total.u64 = 0;
+    len = 0;
+
+    for (loop=0; loop<LOOP; ++loop) {
+	for (i=0; i<(int)PJ_ARRAY_SIZE(test_array); ++i) {
+	    struct test_msg *entry = &test_array[i];
+	    pjsip_msg *msg;
+
+	    pool = pjsip_endpt_create_pool(endpt, NULL, POOL_SIZE, POOL_SIZE);
+
+	    pj_get_timestamp(&t1);
+	    msg = pjsip_parse_msg2(pool, entry->msg, entry->len,
+				   PJSIP_PARSE_MSG_LAZY_HDR, NULL);
+	    if (msg) {
+		pjsip_msg_find_hdr(msg, PJSIP_H_VIA, NULL);
+		pjsip_msg_find_hdr(msg, PJSIP_H_ROUTE, NULL);
+		pjsip_msg_find_hdr(msg, PJSIP_H_MAX_FORWARDS, NULL);
+	    }
+	    pj_get_timestamp(&t2);
+	    pj_sub_timestamp(&t2, &t1);
+	    pj_add_timestamp(&total, &t2);
+
+	    pjsip_endpt_release_pool(endpt, pool);
+
+	    if (msg == NULL)
+		return -1100;
+	    len = len + entry->len;
+	}
+    }
+
+    elapsed = pj_elapsed_time(&zero, &total);
+    avg_parse = pj_elapsed_usec(&zero, &total);
+    pj_highprec_mul(avg_parse, AVERAGE_MSG_LEN);
+    pj_highprec_div(avg_parse, len);
+    avg_parse = 1000000 / avg_parse;
+
+    PJ_LOG(3,(THIS_FILE, 
+	      "    %u MB lazily parsed in %d.%03ds (avg=%d msg parsing/sec)", 
+	      (unsigned)(len/1000000), elapsed.sec, elapsed.msec,
+	      (unsigned)avg_parse));
+    *p_parse = (unsigned)avg_parse;
+
+    return PJ_SUCCESS;
+}
+
 static int msg_benchmark(unsigned *p_detect, unsigned *p_parse, 
 			 unsigned *p_print)
 {
@@ -1994,6 +2135,7 @@ int msg_test(void)
 	unsigned detect;
 	unsigned parse;
 	unsigned print;
+	unsigned lazy_parse;
     } run[COUNT];
     unsigned i, max, avg_len;
     char desc[250];
@@ -2007,12 +2149,20 @@ int msg_test(void)
     if (status != PJ_SUCCESS)
 	return status;
 
+    status = lazy_parse_test();
+    if (status != PJ_SUCCESS)
+	return status;
+
 #if INCLUDE_BENCHMARKS
     for (i=0; i<COUNT; ++i) {
 	PJ_LOG(3,(THIS_FILE, "  benchmarking (%d of %d)..", i+1, COUNT));
 	status = msg_benchmark(&run[i].detect, &run[i].parse, &run[i].print);
 	if (status != PJ_SUCCESS)
 	    return status;
+
+	status = lazy_benchmark(&run[i].lazy_parse);
+	if (status != PJ_SUCCESS)
+	    return status;
     }
 
     /* Calculate average message length */
@@ -2054,6 +2204,21 @@ int msg_test(void)
 		" worth of SIP messages that can be parsed per second). "
 		"The value is derived from msg-parse-per-sec above.");
 
+    /* Print maximum lazy parse/sec */
+    for (i=0, max=0; i<COUNT; ++i)
+	if (run[i].lazy_parse > max) max = run[i].lazy_parse;
+
+    PJ_LOG(3,("", "  Maximum message lazy parsing/sec=%u", max));
+
+    pj_ansi_sprintf(desc, "Number of SIP messages "
+			  "can be parsed in lazy mode by "
+			  "<tt>pjsip_parse_msg2()</tt> and have their Via, "
+			  "Route, and Max-Forwards looked up per second "
+			  "(tested with %d message sets with "
+			  "average message length of "
+			  "%d bytes)", (int)PJ_ARRAY_SIZE(test_array), avg_len);
+    report_ival("msg-lazy-parse-per-sec", max, "msg/sec", desc);
+
 
     /* Print maximum print/sec */
     for (i=0, max=0; i<COUNT; ++i)
@@ -148,12 +148,13 @@ static pj_bool_t regs_rx_request(pjsip_rx_data *rdata)
 	{
 	    pjsip_hdr *hsrc;
 
-	    for (hsrc=msg->hdr.next; hsrc!=&msg->hdr; hsrc=hsrc->next) {
+	    for (hsrc=(pjsip_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT, NULL);
+		 hsrc;
+		 hsrc=(pjsip_hdr*)pjsip_msg_find_hdr(msg, PJSIP_H_CONTACT,
+						     hsrc->next))
+	    {
 		pjsip_contact_hdr *hdst;
 
-		if (hsrc->type != PJSIP_H_CONTACT)
-		    continue;
-
 		hdst = (pjsip_contact_hdr*)
 		       pjsip_hdr_clone(rdata->tp_info.pool, hsrc);
 
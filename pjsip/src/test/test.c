@@ -150,6 +150,13 @@ static pj_status_t init_report(void)
     report_sval("build-type", (PJ_DEBUG ? "Debug" : "Release"), "", "Build type");
 
 
+    /* Parser error handling, which affects the parsing benchmarks */
+    report_sval("parser-error-mode",
+		(PJSIP_PARSER_USE_EXCEPTION ? "Exception" : "Return value"),
+		"", "How SIP parser reports syntax error "
+		"(PJSIP_PARSER_USE_EXCEPTION)");
+
+
     /* Write timestamp */
     pj_gettimeofday(&timestamp);
     report_ival("timestamp", timestamp.sec, "", "System timestamp of the test");
@@ -25,10 +25,288 @@
 #define THIS_FILE   "transport_tcp_test.c"
 
 
+#if PJ_HAS_TCP
+
+/*
+ * Throughput test: send a burst of requests without polling in between,
+ * so that the transport queues and coalesces them, and check that they
+ * are all received in order.
+ */
+#define TPUT_CALL_ID	"TCP-Throughput-Test"
+
+static pj_bool_t tput_on_rx_request(pjsip_rx_data *rdata);
+
+static struct
+{
+    pjsip_module    mod;
+    unsigned	    sent;
+    unsigned	    send_err;
+    unsigned	    recv;
+    pj_bool_t	    err;
+    pj_timestamp    last_recv;
+} tput =
+{
+    {
+	NULL, NULL,			    /* prev and next	*/
+	{ "mod-tput", 8},		    /* Name.		*/
+	-1,				    /* Id		*/
+	PJSIP_MOD_PRIORITY_TSX_LAYER-1,	    /* Priority		*/
+	NULL,				    /* load()		*/
+	NULL,				    /* start()		*/
+	NULL,				    /* stop()		*/
+	NULL,				    /* unload()		*/
+	&tput_on_rx_request,		    /* on_rx_request()	*/
+	NULL,				    /* on_rx_response()	*/
+	NULL,				    /* on_tsx_state()	*/
+    }
+};
+
+static pj_bool_t tput_on_rx_request(pjsip_rx_data *rdata)
+{
+    if (pj_strcmp2(&rdata->msg_info.cid->id, TPUT_CALL_ID) != 0)
+	return PJ_FALSE;
+
+    if (rdata->msg_info.cseq->cseq != (pj_int32_t)tput.recv) {
+	PJ_LOG(3,(THIS_FILE, "   error: expecting cseq %u, got %u",
+		  tput.recv, rdata->msg_info.cseq->cseq));
+	tput.err = PJ_TRUE;
+    }
+
+    tput.recv++;
+    pj_get_timestamp(&tput.last_recv);
+    return PJ_TRUE;
+}
+
+static void tput_on_sent(pjsip_send_state *send_state,
+			 pj_ssize_t sent, pj_bool_t *cont)
+{
+    PJ_UNUSED_ARG(send_state);
+
+    if (sent > 0)
+	tput.sent++;
+    else
+	tput.send_err++;
+
+    *cont = PJ_FALSE;
+}
+
+static int tput_test(char *target_url)
+{
+    enum { COUNT = 5000, TIMEOUT = 10 };
+    pj_str_t target, from, call_id;
+    pj_timestamp start;
+    pj_time_val timeout;
+    pj_bool_t msg_log_enabled;
+    unsigned i, msec;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  TCP throughput test..."));
+
+    status = pjsip_endpt_register_module(endpt, &tput.mod);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error registering module", status);
+	return -100;
+    }
+
+    tput.sent = tput.send_err = tput.recv = 0;
+    tput.err = PJ_FALSE;
+
+    msg_log_enabled = msg_logger_set_enabled(0);
+
+    target = pj_str(target_url);
+    from = pj_str("<sip:user@host>");
+    call_id = pj_str(TPUT_CALL_ID);
+
+    pj_get_timestamp(&start);
+
+    for (i=0; i<COUNT; ++i) {
+	pjsip_tx_data *tdata;
+
+	status = pjsip_endpt_create_request(endpt, &pjsip_options_method,
+					    &target, &from, &target, &from,
+					    &call_id, i, NULL, &tdata);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error creating request", status);
+	    rc = -110;
+	    goto on_return;
+	}
+
+	status = pjsip_endpt_send_request_stateless(endpt, tdata, NULL,
+						    &tput_on_sent);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error sending request", status);
+	    rc = -120;
+	    goto on_return;
+	}
+    }
+
+    /* Wait until all requests are received */
+    pj_gettimeofday(&timeout);
+    timeout.sec += TIMEOUT;
+
+    while (tput.recv < COUNT || tput.sent + tput.send_err < COUNT) {
+	pj_time_val now, delay = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: timeout, sent=%u, recv=%u",
+		      tput.sent, tput.recv));
+	    rc = -130;
+	    goto on_return;
+	}
+
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    if (tput.send_err || tput.err) {
+	PJ_LOG(3,(THIS_FILE, "   error: %u send error(s)", tput.send_err));
+	rc = -140;
+	goto on_return;
+    }
+
+    msec = pj_elapsed_msec(&start, &tput.last_recv);
+    if (msec == 0)
+	msec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "    %u requests in %u msec", COUNT, msec));
+    report_ival("tcp-throughput", COUNT * 1000 / msec, "msg/sec",
+		"Number of requests sent and received per second over a "
+		"single TCP connection, when requests are sent in a burst");
+
+on_return:
+    msg_logger_set_enabled(msg_log_enabled);
+    pjsip_endpt_unregister_module(endpt, &tput.mod);
+    return rc;
+}
+
+
+/*
+ * Reconnection storm test: connect many clients to a listener at once, as
+ * happens when clients reconnect after an outage, and measure how fast the
+ * listener accepts the connections and creates their transports.
+ */
+static int accept_storm_test(void)
+{
+    enum { COUNT = 32, TIMEOUT = 5 };
+    pjsip_tcp_transport_cfg cfg;
+    pjsip_tpfactory *tpfactory;
+    pjsip_tpmgr *tpmgr = pjsip_endpt_get_tpmgr(endpt);
+    pj_sock_t csock[COUNT];
+    pj_sockaddr_in rem_addr;
+    pj_timestamp start, end;
+    pj_time_val timeout;
+    unsigned i, tp_cnt, msec;
+    int rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  TCP reconnection storm test..."));
+
+    for (i=0; i<COUNT; ++i)
+	csock[i] = PJ_INVALID_SOCKET;
+
+    /* Start a listener with two SO_REUSEPORT sockets, when supported */
+    pjsip_tcp_transport_cfg_default(&cfg, pj_AF_INET());
+    cfg.listener_cnt = 2;
+    status = pjsip_tcp_transport_start3(endpt, &cfg, &tpfactory);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start TCP listener", status);
+	return -200;
+    }
+
+    status = pj_sockaddr_in_init(&rem_addr, &tpfactory->addr_name.host,
+				 (pj_uint16_t)tpfactory->addr_name.port);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: invalid TCP address name", status);
+	rc = -205;
+	goto on_return;
+    }
+
+    tp_cnt = pjsip_tpmgr_get_transport_count(tpmgr);
+
+    /* The connections are completed by the kernel as long as they fit in
+     * the backlog, so they queue up until the listener accepts them.
+     */
+    pj_get_timestamp(&start);
+
+    for (i=0; i<COUNT; ++i) {
+	status = pj_sock_socket(pj_AF_INET(), pj_SOCK_STREAM(), 0, &csock[i]);
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error creating socket", status);
+	    rc = -210;
+	    goto on_return;
+	}
+
+	status = pj_sock_connect(csock[i], &rem_addr, sizeof(rem_addr));
+	if (status != PJ_SUCCESS) {
+	    app_perror("   error connecting socket", status);
+	    rc = -220;
+	    goto on_return;
+	}
+    }
+
+    /* Wait until all connections have got their transport */
+    pj_gettimeofday(&timeout);
+    timeout.sec += TIMEOUT;
+
+    while (pjsip_tpmgr_get_transport_count(tpmgr) < tp_cnt + COUNT) {
+	pj_time_val now, delay = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: timeout, accepted %u of %u",
+		      pjsip_tpmgr_get_transport_count(tpmgr) - tp_cnt,
+		      COUNT));
+	    rc = -230;
+	    goto on_return;
+	}
+
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    pj_get_timestamp(&end);
+    msec = pj_elapsed_msec(&start, &end);
+    if (msec == 0)
+	msec = 1;
+
+    PJ_LOG(3,(THIS_FILE, "    %u connections accepted in %u msec",
+	      COUNT, msec));
+    report_ival("tcp-accept-storm", COUNT * 1000 / msec, "conn/sec",
+		"Number of incoming TCP connections accepted per second, "
+		"when many clients connect to the listener at the same time");
+
+on_return:
+    for (i=0; i<COUNT; ++i) {
+	if (csock[i] != PJ_INVALID_SOCKET)
+	    pj_sock_close(csock[i]);
+    }
+
+    /* The incoming transports are destroyed as the clients disconnect */
+    pj_gettimeofday(&timeout);
+    timeout.sec += TIMEOUT;
+
+    while (rc == 0 && pjsip_tpmgr_get_transport_count(tpmgr) > tp_cnt) {
+	pj_time_val now, delay = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: transports are not destroyed"));
+	    rc = -240;
+	    break;
+	}
+
+	pjsip_endpt_handle_events(endpt, &delay);
+    }
+
+    pjsip_tpmgr_unregister_tpfactory(tpmgr, tpfactory);
+    flush_events(500);
+    return rc;
+}
+
+
 /*
  * TCP transport test.
  */
-#if PJ_HAS_TCP
 int transport_tcp_test(void)
 {
     enum { SEND_RECV_LOOP = 8 };
@@ -92,6 +370,14 @@ int transport_tcp_test(void)
     if (transport_load_test(url) != 0)
 	return -60;
 
+    /* Throughput test */
+    status = tput_test(url);
+    if (status != 0) {
+	pjsip_transport_dec_ref(tcp);
+	flush_events(500);
+	return status;
+    }
+
     /* Basic transport's send/receive loopback test. */
     for (i=0; i<SEND_RECV_LOOP; ++i) {
 	status = transport_send_recv_test(PJSIP_TRANSPORT_TCP, tcp, url, &rtt[i]);
@@ -142,6 +428,11 @@ int transport_tcp_test(void)
     if (status != PJ_SUCCESS)
 	return -95;
 
+    /* Reconnection storm test */
+    status = accept_storm_test();
+    if (status != 0)
+	return status;
+
     /* Flush events. */
     PJ_LOG(3,(THIS_FILE, "   Flushing events, 1 second..."));
     flush_events(1000);
@@ -95,6 +95,9 @@ static int send_status = NO_STATUS;
 static int recv_status = NO_STATUS;
 static pj_timestamp my_send_time, my_recv_time;
 
+/* Shared clones of the received response, and a clone of that clone. */
+static pjsip_rx_data *rx_clone, *rx_clone2;
+
 /* Module to receive messages for this test. */
 static pjsip_module my_module = 
 {
@@ -122,11 +125,19 @@ static pj_bool_t my_on_rx_request(pjsip_rx_data *rdata)
 	pjsip_response_addr res_addr;
 	pj_status_t status;
 
+	const pjsip_hdr *allow;
+
 	status = pjsip_endpt_create_response( endpt, rdata, 200, NULL, &tdata);
 	if (status != PJ_SUCCESS) {
 	    recv_status = status;
 	    return PJ_TRUE;
 	}
+	/* Header that is not parsed until looked up in lazy mode */
+	allow = pjsip_endpt_get_capability(endpt, PJSIP_H_ALLOW, NULL);
+	if (allow) {
+	    pjsip_msg_add_hdr(tdata->msg, (pjsip_hdr*)
+			      pjsip_hdr_clone(tdata->pool, allow));
+	}
 	status = pjsip_get_response_addr( tdata->pool, rdata, &res_addr);
 	if (status != PJ_SUCCESS) {
 	    recv_status = status;
@@ -149,13 +160,57 @@ static pj_bool_t my_on_rx_request(pjsip_rx_data *rdata)
 static pj_bool_t my_on_rx_response(pjsip_rx_data *rdata)
 {
     if (pj_strcmp2(&rdata->msg_info.cid->id, CALL_ID_HDR) == 0) {
+	pj_status_t status;
+
 	pj_get_timestamp(&my_recv_time);
-	recv_status = PJ_SUCCESS;
+
+	/* Keep the response after the transport has reused its buffer */
+	if (rx_clone)
+	    return PJ_TRUE;
+	status = pjsip_rx_data_clone(rdata, PJSIP_RX_DATA_CLONE_SHARED,
+				     &rx_clone);
+	if (status == PJ_SUCCESS) {
+	    status = pjsip_rx_data_clone(rx_clone,
+					 PJSIP_RX_DATA_CLONE_SHARED,
+					 &rx_clone2);
+	}
+	recv_status = status;
 	return PJ_TRUE;
     }
     return PJ_FALSE;
 }
 
+/* Check the response that was kept by the shared clones. */
+static int check_rx_clone(pjsip_rx_data *rdata)
+{
+    const pjsip_hdr *hdr;
+
+    if (pj_strcmp2(&rdata->msg_info.cid->id, CALL_ID_HDR) != 0)
+	return -570;
+    if (rdata->msg_info.cseq->cseq != CSEQ_VALUE)
+	return -571;
+    if (rdata->msg_info.msg->line.status.code != 200)
+	return -572;
+    if (rdata->msg_info.len <= 0 ||
+	pj_ansi_strncmp(rdata->msg_info.msg_buf, "SIP/2.0 200", 11) != 0)
+    {
+	return -573;
+    }
+    if (rdata->pkt_info.len <= 0 ||
+	pj_ansi_strncmp(rdata->pkt_info.packet, "SIP/2.0 200", 11) != 0)
+    {
+	return -574;
+    }
+    /* Shared message must not have headers that are parsed on lookup */
+    for (hdr=rdata->msg_info.msg->hdr.next; hdr!=&rdata->msg_info.msg->hdr;
+	 hdr=hdr->next)
+    {
+	if (pjsip_hdr_is_lazy(hdr))
+	    return -575;
+    }
+    return 0;
+}
+
 /* Transport callback. */
 static void send_msg_callback(pjsip_send_state *stateless_data,
 			      pj_ssize_t sent, pj_bool_t *cont)
@@ -180,7 +235,7 @@ int transport_send_recv_test( pjsip_transport_type_e tp_type,
 			      char *target_url,
 			      int *p_usec_rtt)
 {
-    pj_bool_t msg_log_enabled;
+    pj_bool_t msg_log_enabled, lazy_hdr_parse;
     pj_status_t status;
     pj_str_t target, from, to, contact, call_id, body;
     pjsip_method method;
@@ -204,6 +259,10 @@ int transport_send_recv_test( pjsip_transport_type_e tp_type,
     /* Disable message logging. */
     msg_log_enabled = msg_logger_set_enabled(0);
 
+    /* Parse in lazy mode, the shared clones must not see lazy headers. */
+    lazy_hdr_parse = pjsip_cfg()->endpt.lazy_hdr_parse;
+    pjsip_cfg()->endpt.lazy_hdr_parse = PJ_TRUE;
+
     /* Create a request message. */
     target = pj_str(target_url);
     from = pj_str(FROM_HDR);
@@ -218,11 +277,13 @@ int transport_send_recv_test( pjsip_transport_type_e tp_type,
 					 &body, &tdata );
     if (status != PJ_SUCCESS) {
 	app_perror("   error: unable to create request", status);
-	return -510;
+	status = -510;
+	goto on_return;
     }
 
     /* Reset statuses */
     send_status = recv_status = NO_STATUS;
+    rx_clone = rx_clone2 = NULL;
 
     /* Start time. */
     pj_get_timestamp(&my_send_time);
@@ -284,12 +345,27 @@ int transport_send_recv_test( pjsip_transport_type_e tp_type,
 	*p_usec_rtt = usec_rt;
     }
 
+    /* Free the first clone before the clone that shares its buffer. */
+    status = check_rx_clone(rx_clone);
+    pjsip_rx_data_free_cloned(rx_clone);
+    rx_clone = NULL;
+    if (status == PJ_SUCCESS)
+	status = check_rx_clone(rx_clone2);
+    if (status != PJ_SUCCESS)
+	goto on_return;
+
     /* Restore message logging. */
     msg_logger_set_enabled(msg_log_enabled);
 
     status = PJ_SUCCESS;
 
 on_return:
+    pjsip_cfg()->endpt.lazy_hdr_parse = lazy_hdr_parse;
+    if (rx_clone)
+	pjsip_rx_data_free_cloned(rx_clone);
+    if (rx_clone2)
+	pjsip_rx_data_free_cloned(rx_clone2);
+    rx_clone = rx_clone2 = NULL;
     return status;
 }
 
@@ -24,6 +24,181 @@
 
 #define THIS_FILE   "transport_udp_test.c"
 
+#define RXW_PORT    (TEST_UDP_PORT+2)
+
+/*
+ * Rx worker test: the test endpoint is temporarily given two rx workers,
+ * requests received on a separate UDP transport are processed by them,
+ * and requests with the same Call-ID must be processed in the order they
+ * were sent.
+ */
+enum { RXW_CALL_CNT = 4, RXW_CSEQ_CNT = 25 };
+
+static struct rxw_test
+{
+    pj_thread_t	    *poll_thread;
+    pj_atomic_t	    *rx_cnt;
+    int		     last_cseq[RXW_CALL_CNT];
+    int		     err;
+} rxw;
+
+static pj_bool_t rxw_on_rx_request(pjsip_rx_data *rdata)
+{
+    const pj_str_t *call_id = &rdata->msg_info.cid->id;
+    int idx;
+
+    if (call_id->slen != 5 || pj_strncmp2(call_id, "rxw-", 4) != 0)
+	return PJ_FALSE;
+
+    idx = call_id->ptr[4] - '0';
+    if (idx < 0 || idx >= RXW_CALL_CNT) {
+	rxw.err = -110;
+    } else if (rdata->msg_info.cseq->cseq != rxw.last_cseq[idx] + 1) {
+	/* Out of order */
+	rxw.err = -120;
+    } else {
+	rxw.last_cseq[idx] = rdata->msg_info.cseq->cseq;
+    }
+
+    /* Must not be processed by the thread that polls the transport */
+    if (pj_thread_this() == rxw.poll_thread)
+	rxw.err = -130;
+
+    pj_atomic_inc(rxw.rx_cnt);
+    return PJ_TRUE;
+}
+
+static pjsip_module rxw_module =
+{
+    NULL, NULL,				/* prev and next	*/
+    { "RxWorker-Test", 13},		/* Name.		*/
+    -1,					/* Id			*/
+    PJSIP_MOD_PRIORITY_APPLICATION,	/* Priority		*/
+    NULL,				/* load()		*/
+    NULL,				/* start()		*/
+    NULL,				/* stop()		*/
+    NULL,				/* unload()		*/
+    &rxw_on_rx_request,			/* on_rx_request()	*/
+    NULL,				/* on_rx_response()	*/
+    NULL,				/* on_tsx_state()	*/
+};
+
+static int rx_worker_test(void)
+{
+    pjsip_transport *rxw_tp = NULL;
+    pj_pool_t *pool;
+    pj_sockaddr_in addr;
+    pj_sock_t sock = PJ_INVALID_SOCKET;
+    pj_time_val timeout;
+    int i, j, rc = 0;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "  rx worker test..."));
+
+    pj_bzero(&rxw, sizeof(rxw));
+    rxw.poll_thread = pj_thread_this();
+
+    pool = pjsip_endpt_create_pool(endpt, "rxw", 512, 512);
+    status = pj_atomic_create(pool, 0, &rxw.rx_cnt);
+    if (status != PJ_SUCCESS) {
+	rc = -10;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_set_rx_worker_cnt(endpt, 2);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start rx workers", status);
+	rc = -20;
+	goto on_return;
+    }
+
+    pj_sockaddr_in_init(&addr, NULL, (pj_uint16_t)RXW_PORT);
+    status = pjsip_udp_transport_start(endpt, &addr, NULL, 1, &rxw_tp);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to start UDP transport", status);
+	rc = -30;
+	goto on_return;
+    }
+
+    status = pjsip_endpt_register_module(endpt, &rxw_module);
+    if (status != PJ_SUCCESS) {
+	rc = -40;
+	goto on_return;
+    }
+
+    status = pj_sock_socket(pj_AF_INET(), pj_SOCK_DGRAM(), 0, &sock);
+    if (status != PJ_SUCCESS) {
+	rc = -50;
+	goto on_return;
+    }
+
+    /* Send interleaved requests of several calls */
+    pj_sockaddr_in_init(&addr, NULL, (pj_uint16_t)RXW_PORT);
+    addr.sin_addr.s_addr = pj_htonl(0x7F000001);
+    for (j=1; j<=RXW_CSEQ_CNT; ++j) {
+	for (i=0; i<RXW_CALL_CNT; ++i) {
+	    char msg[512];
+	    pj_ssize_t len;
+
+	    len = pj_ansi_snprintf(msg, sizeof(msg),
+		"OPTIONS sip:rxw@127.0.0.1:%d SIP/2.0\r\n"
+		"Via: SIP/2.0/UDP 127.0.0.1:%d;branch=z9hG4bKrxw-%d-%d\r\n"
+		"From: <sip:alice@127.0.0.1>;tag=rxw\r\n"
+		"To: <sip:bob@127.0.0.1>\r\n"
+		"Call-ID: rxw-%d\r\n"
+		"CSeq: %d OPTIONS\r\n"
+		"Max-Forwards: 70\r\n"
+		"Content-Length: 0\r\n"
+		"\r\n",
+		RXW_PORT, RXW_PORT, i, j, i, j);
+
+	    status = pj_sock_sendto(sock, msg, &len, 0, &addr, sizeof(addr));
+	    if (status != PJ_SUCCESS) {
+		rc = -60;
+		goto on_return;
+	    }
+	}
+    }
+
+    /* Poll the endpoint until all requests have been processed */
+    pj_gettimeofday(&timeout);
+    timeout.sec += 5;
+    while (pj_atomic_get(rxw.rx_cnt) < RXW_CALL_CNT * RXW_CSEQ_CNT &&
+	   rxw.err == 0)
+    {
+	pj_time_val now, poll_interval = { 0, 10 };
+
+	pj_gettimeofday(&now);
+	if (PJ_TIME_VAL_GTE(now, timeout)) {
+	    PJ_LOG(3,(THIS_FILE, "   error: only %d of %d requests received",
+		      pj_atomic_get(rxw.rx_cnt),
+		      RXW_CALL_CNT * RXW_CSEQ_CNT));
+	    rc = -70;
+	    goto on_return;
+	}
+	pjsip_endpt_handle_events(endpt, &poll_interval);
+    }
+
+    if (rxw.err) {
+	PJ_LOG(3,(THIS_FILE, "   error: rx worker test failed (%d)", rxw.err));
+	rc = rxw.err;
+    }
+
+on_return:
+    if (sock != PJ_INVALID_SOCKET)
+	pj_sock_close(sock);
+    pjsip_endpt_set_rx_worker_cnt(endpt, 0);
+    if (rxw_module.id != -1)
+	pjsip_endpt_unregister_module(endpt, &rxw_module);
+    if (rxw_tp) {
+	pjsip_transport_dec_ref(rxw_tp);
+	pjsip_transport_destroy(rxw_tp);
+	flush_events(500);
+    }
+    pj_pool_release(pool);
+    return rc;
+}
+
 
 /*
  * UDP transport test.
@@ -123,6 +298,11 @@ int transport_udp_test(void)
     PJ_LOG(3,(THIS_FILE, "   Flushing events, 1 second..."));
     flush_events(1000);
 
+    /* Rx worker test. */
+    status = rx_worker_test();
+    if (status != 0)
+	return status;
+
     /* Done */
     return 0;
 }
@@ -95,16 +95,15 @@ on_error:
 
 
 
-static int uas_tsx_bench(unsigned working_set, pj_timestamp *p_elapsed)
+/* Create INVITE request and a "dummy" rdata from it for creating UAS
+ * transactions.
+ */
+static pj_status_t create_uas_request(pjsip_tx_data **p_request,
+				      pjsip_rx_data *rdata)
 {
-    unsigned i;
     pjsip_tx_data *request;
     pjsip_via_hdr *via;
-    pjsip_rx_data rdata;
     pj_sockaddr_in remote;
-    pjsip_transaction **tsx;
-    pj_timestamp t1, t2, elapsed;
-    char branch_buf[80] = PJSIP_RFC3261_BRANCH_ID "0000000000";
     pj_status_t status;
 
     /* Create the request first. */
@@ -133,24 +132,47 @@ static int uas_tsx_bench(unsigned working_set, pj_timestamp *p_elapsed)
     
 
     /* Create "dummy" rdata from the tdata */
-    pj_bzero(&rdata, sizeof(pjsip_rx_data));
-    rdata.tp_info.pool = request->pool;
-    rdata.msg_info.msg = request->msg;
-    rdata.msg_info.from = (pjsip_from_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_FROM, NULL);
-    rdata.msg_info.to = (pjsip_to_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_TO, NULL);
-    rdata.msg_info.cseq = (pjsip_cseq_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_CSEQ, NULL);
-    rdata.msg_info.cid = (pjsip_cid_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_FROM, NULL);
-    rdata.msg_info.via = via;
+    pj_bzero(rdata, sizeof(pjsip_rx_data));
+    rdata->tp_info.pool = request->pool;
+    rdata->msg_info.msg = request->msg;
+    rdata->msg_info.from = (pjsip_from_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_FROM, NULL);
+    rdata->msg_info.to = (pjsip_to_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_TO, NULL);
+    rdata->msg_info.cseq = (pjsip_cseq_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_CSEQ, NULL);
+    rdata->msg_info.cid = (pjsip_cid_hdr*) pjsip_msg_find_hdr(request->msg, PJSIP_H_FROM, NULL);
+    rdata->msg_info.via = via;
     
     pj_sockaddr_in_init(&remote, 0, 0);
     status = pjsip_endpt_acquire_transport(endpt, PJSIP_TRANSPORT_LOOP_DGRAM, 
 					   &remote, sizeof(pj_sockaddr_in),
-					   NULL, &rdata.tp_info.transport);
+					   NULL, &rdata->tp_info.transport);
     if (status != PJ_SUCCESS) {
 	app_perror("    error: unable to get loop transport", status);
+	pjsip_tx_data_dec_ref(request);
 	return status;
     }
 
+    *p_request = request;
+    return PJ_SUCCESS;
+}
+
+
+static int uas_tsx_bench(unsigned working_set, pj_timestamp *p_elapsed)
+{
+    unsigned i;
+    pjsip_tx_data *request;
+    pjsip_via_hdr *via;
+    pjsip_rx_data rdata;
+    pjsip_transaction **tsx;
+    pj_timestamp t1, t2, elapsed;
+    char branch_buf[80] = PJSIP_RFC3261_BRANCH_ID "0000000000";
+    pj_status_t status;
+
+    status = create_uas_request(&request, &rdata);
+    if (status != PJ_SUCCESS)
+	return status;
+
+    via = rdata.msg_info.via;
+
 
     /* Create transaction array */
     tsx = (pjsip_transaction**) pj_pool_zalloc(request->pool, working_set * sizeof(pj_pool_t*));
@@ -199,10 +221,132 @@ on_error:
 
 
 
+/*
+ * Multi-threaded UAS benchmark: each thread creates transactions with its
+ * own branch parameters, looks each of them up a few times like incoming
+ * retransmissions would, and terminates them. Since all threads work on
+ * distinct transactions, this shows how the transaction table scales with
+ * the number of threads.
+ */
+#define MT_MAX_THREADS	8
+#define MT_TSX_COUNT	5000
+#define MT_LOOKUPS	4
+
+typedef struct mt_bench_thread
+{
+    unsigned		 idx;
+    pjsip_tx_data	*request;
+    pjsip_rx_data	 rdata;
+    pj_thread_t		*thread;
+    pj_status_t		 status;
+} mt_bench_thread;
+
+static int mt_tsx_bench_thread(void *arg)
+{
+    mt_bench_thread *bt = (mt_bench_thread*)arg;
+    pjsip_via_hdr *via = bt->rdata.msg_info.via;
+    pj_timer_heap_t *th = pjsip_endpt_get_timer_heap(endpt);
+    char branch_buf[80];
+    unsigned i, j;
+
+    for (i=0; i<MT_TSX_COUNT && bt->status==PJ_SUCCESS; ++i) {
+	pjsip_transaction *tsx;
+
+	via->branch_param.ptr = branch_buf;
+	via->branch_param.slen = pj_ansi_snprintf(branch_buf,
+						  sizeof(branch_buf),
+						  PJSIP_RFC3261_BRANCH_ID
+						  "-mt%u-%u", bt->idx, i);
+	bt->status = pjsip_tsx_create_uas(&mod_tsx_user, &bt->rdata, &tsx);
+	if (bt->status != PJ_SUCCESS)
+	    break;
+
+	for (j=0; j<MT_LOOKUPS; ++j) {
+	    if (pjsip_tsx_layer_find_tsx(&tsx->transaction_key,
+					 PJ_FALSE) != tsx)
+	    {
+		bt->status = PJ_ENOTFOUND;
+		break;
+	    }
+	}
+
+	pjsip_tsx_terminate(tsx, 601);
+	pj_timer_heap_poll(th, NULL);
+    }
+
+    return 0;
+}
+
+static int mt_tsx_bench(unsigned thread_cnt, unsigned *p_speed,
+			unsigned *p_hit_pct)
+{
+    mt_bench_thread bt[MT_MAX_THREADS];
+    pjsip_endpt_pool_stat stat1, stat2;
+    pj_pool_t *pool;
+    pj_timestamp t1, t2, freq;
+    unsigned i;
+    pj_status_t status = PJ_SUCCESS;
+
+    pj_get_timestamp_freq(&freq);
+    pool = pjsip_endpt_create_pool(endpt, "tsxbench", 4000, 4000);
+
+    pj_bzero(bt, sizeof(bt));
+    pj_bzero(&mod_tsx_user, sizeof(mod_tsx_user));
+    mod_tsx_user.id = -1;
+
+    for (i=0; i<thread_cnt && status==PJ_SUCCESS; ++i) {
+	bt[i].idx = i;
+	status = create_uas_request(&bt[i].request, &bt[i].rdata);
+    }
+
+    pjsip_endpt_get_pool_stat(endpt, PJSIP_ENDPT_POOL_TSX, &stat1);
+    pj_get_timestamp(&t1);
+    for (i=0; i<thread_cnt && status==PJ_SUCCESS; ++i) {
+	status = pj_thread_create(pool, "tsxbench%p", &mt_tsx_bench_thread,
+				  &bt[i], 0, 0, &bt[i].thread);
+	if (status != PJ_SUCCESS)
+	    app_perror("    error: unable to create thread", status);
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+	if (bt[i].thread) {
+	    pj_thread_join(bt[i].thread);
+	    pj_thread_destroy(bt[i].thread);
+	}
+	if (status == PJ_SUCCESS && bt[i].status != PJ_SUCCESS) {
+	    app_perror("    error: transaction benchmark failed",
+		       bt[i].status);
+	    status = bt[i].status;
+	}
+    }
+    pj_get_timestamp(&t2);
+
+    if (status == PJ_SUCCESS) {
+	pj_sub_timestamp(&t2, &t1);
+	*p_speed = (unsigned)(freq.u64 * thread_cnt * MT_TSX_COUNT / t2.u64);
+
+	pjsip_endpt_get_pool_stat(endpt, PJSIP_ENDPT_POOL_TSX, &stat2);
+	*p_hit_pct = (stat2.hit - stat1.hit) * 100 /
+		     (thread_cnt * MT_TSX_COUNT);
+    }
+
+    for (i=0; i<thread_cnt; ++i) {
+	if (bt[i].rdata.tp_info.transport)
+	    pjsip_transport_dec_ref(bt[i].rdata.tp_info.transport);
+	if (bt[i].request)
+	    pjsip_tx_data_dec_ref(bt[i].request);
+    }
+    pj_pool_release(pool);
+    flush_events(500);
+
+    return status;
+}
+
+
 int tsx_bench(void)
 {
     enum { WORKING_SET=10000, REPEAT = 4 };
-    unsigned i, speed;
+    unsigned i, speed, thread_cnt;
     pj_timestamp usec[REPEAT], min, freq;
     char desc[250];
     int status;
@@ -290,6 +434,30 @@ int tsx_bench(void)
     report_ival("create-uas-tsx-per-sec", 
 		speed, "tsx/sec", desc);
 
+
+    /*
+     * Benchmark UAS with multiple threads
+     */
+    PJ_LOG(3,(THIS_FILE, "   benchmarking multi-threaded UAS transaction "
+			 "create/lookup/terminate:"));
+    for (thread_cnt=1; thread_cnt<=MT_MAX_THREADS; thread_cnt*=2) {
+	char name[40];
+	unsigned hit_pct;
+
+	status = mt_tsx_bench(thread_cnt, &speed, &hit_pct);
+	if (status != PJ_SUCCESS)
+	    return status;
+
+	PJ_LOG(3,(THIS_FILE, "    %d thread(s): %d tsx/sec, pool free list "
+		  "hit rate %u%%", thread_cnt, speed, hit_pct));
+
+	pj_ansi_sprintf(name, "mt-uas-tsx-per-sec-%d", thread_cnt);
+	pj_ansi_sprintf(desc, "Number of UAS transactions created, looked up "
+			      "%d times, and terminated per second by %d "
+			      "thread(s)", MT_LOOKUPS, thread_cnt);
+	report_ival(name, speed, "tsx/sec", desc);
+    }
+
     return PJ_SUCCESS;
 }
 
@@ -405,6 +405,157 @@ static int gcc_test()
 #endif
 
 
+/* Check that the printed message in the transmit buffer is the same as
+ * the message printed from scratch.
+ */
+static int check_print_cache(pjsip_tx_data *tdata, int rc)
+{
+    char msgbuf[PJSIP_MAX_PKT_LEN];
+    pj_ssize_t len;
+    pj_status_t status;
+
+    status = pjsip_tx_data_encode(tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: encoding message", status);
+	return rc;
+    }
+
+    len = pjsip_msg_print(tdata->msg, msgbuf, sizeof(msgbuf));
+    if (len < 1)
+	return rc-1;
+
+    if (len != tdata->buf.cur - tdata->buf.start ||
+	pj_memcmp(msgbuf, tdata->buf.start, len) != 0)
+    {
+	msgbuf[len] = '\0';
+	PJ_LOG(3,(THIS_FILE, "   error: printed message mismatch.\n"
+		  "Expecting:\n%s\nGot:\n%s", msgbuf, tdata->buf.start));
+	return rc-2;
+    }
+
+    if (tdata->buf.start[len] != '\0')
+	return rc-3;
+
+    return 0;
+}
+
+/* This tests that a message which is modified after it's printed is
+ * printed correctly by reprinting only the modified parts, and that
+ * cloned transmit buffer reuses the printed text correctly.
+ */
+static int txdata_test_print_cache(void)
+{
+    pj_str_t target = pj_str("sip:bob@example.com");
+    pj_str_t from = pj_str("<sip:alice@example.com>");
+    pj_str_t contact = pj_str("<sip:alice@127.0.0.1>");
+    pj_str_t body = pj_str("Hello world!");
+    pj_str_t hname = pj_str("X-Test");
+    pj_str_t hvalue = pj_str("value");
+    pj_str_t branch = pj_str("z9hG4bKfork2");
+    pjsip_tx_data *tdata, *clone, *fork;
+    pjsip_generic_string_hdr *xhdr;
+    pjsip_via_hdr *via;
+    pjsip_hdr *hdr;
+    pjsip_uri *uri;
+    int rc;
+    pj_status_t status;
+
+    PJ_LOG(3,(THIS_FILE, "   print cache of transmit buffer"));
+
+    status = pjsip_endpt_create_request(endpt, &pjsip_invite_method, &target,
+					&from, &target, &contact, NULL, 1,
+					&body, &tdata);
+    if (status != PJ_SUCCESS) {
+	app_perror("   error: unable to create request", status);
+	return -600;
+    }
+
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_VIA, NULL);
+    via->transport = pj_str("UDP");
+    via->sent_by.host = pj_str("127.0.0.1");
+
+    rc = check_print_cache(tdata, -610);
+    if (rc != 0)
+	goto on_return;
+
+    /* Modify the Via header */
+    via->branch_param = pj_str("z9hG4bKbranch1");
+    via->sent_by.port = 5080;
+    pjsip_tx_data_invalidate_hdr(tdata, via);
+    rc = check_print_cache(tdata, -620);
+    if (rc != 0)
+	goto on_return;
+
+    /* Add a new header */
+    xhdr = pjsip_generic_string_hdr_create(tdata->pool, &hname, &hvalue);
+    pjsip_msg_insert_first_hdr(tdata->msg, (pjsip_hdr*)xhdr);
+    pjsip_tx_data_invalidate_hdr(tdata, xhdr);
+    rc = check_print_cache(tdata, -630);
+    if (rc != 0)
+	goto on_return;
+
+    /* Remove a header */
+    hdr = (pjsip_hdr*) pjsip_msg_find_hdr(tdata->msg, PJSIP_H_CONTACT, NULL);
+    pj_list_erase(hdr);
+    pjsip_tx_data_invalidate_hdr(tdata, hdr);
+    rc = check_print_cache(tdata, -640);
+    if (rc != 0)
+	goto on_return;
+
+    /* Change the request line */
+    tdata->msg->line.req.uri = pjsip_parse_uri(tdata->pool,
+					       "sip:carol@example.org", 21, 0);
+    pjsip_tx_data_invalidate_hdr(tdata, NULL);
+    rc = check_print_cache(tdata, -650);
+    if (rc != 0)
+	goto on_return;
+
+    /* Clone must be printed the same */
+    status = pjsip_tx_data_clone(tdata, 0, &clone);
+    if (status != PJ_SUCCESS) {
+	rc = -660;
+	goto on_return;
+    }
+#if PJSIP_TX_DATA_PRINT_CACHE
+    if (!pjsip_tx_data_is_valid(clone)) {
+	PJ_LOG(3,(THIS_FILE, "   error: clone should reuse the printed text"));
+	pjsip_tx_data_dec_ref(clone);
+	rc = -661;
+	goto on_return;
+    }
+#endif
+    rc = check_print_cache(clone, -662);
+    pjsip_tx_data_dec_ref(clone);
+    if (rc != 0)
+	goto on_return;
+
+    /* Fork the request to another target */
+    uri = pjsip_parse_uri(tdata->pool, "sip:dave@example.net", 20, 0);
+    status = pjsip_endpt_clone_request_fwd(endpt, tdata, uri, &branch, &fork);
+    if (status != PJ_SUCCESS) {
+	rc = -670;
+	goto on_return;
+    }
+    via = (pjsip_via_hdr*) pjsip_msg_find_hdr(fork->msg, PJSIP_H_VIA, NULL);
+    if (pj_strcmp(&via->branch_param, &branch) != 0) {
+	pjsip_tx_data_dec_ref(fork);
+	rc = -671;
+	goto on_return;
+    }
+    rc = check_print_cache(fork, -672);
+    pjsip_tx_data_dec_ref(fork);
+    if (rc != 0)
+	goto on_return;
+
+    /* The source is not affected */
+    rc = check_print_cache(tdata, -680);
+
+on_return:
+    pjsip_tx_data_dec_ref(tdata);
+    return rc;
+}
+
+
 /* This tests the request creating functions against the following
  * requirements:
  *  - header params in URI creates header in the request.
@@ -628,6 +779,55 @@ static int txdata_test_uri_params(void)
 /*
  * create request benchmark
  */
+/* Benchmark creating and destroying transmit buffer, which reuses the
+ * pools in the free list of the thread.
+ */
+static int create_tdata_bench(pj_timestamp *p_elapsed, unsigned *p_hit_pct)
+{
+    enum { COUNT = 8 };
+    unsigned i, j;
+    pjsip_tx_data *tdata[COUNT];
+    pjsip_endpt_pool_stat stat1, stat2;
+    pj_timestamp t1, t2;
+    pj_status_t status;
+
+    pjsip_endpt_get_pool_stat(endpt, PJSIP_ENDPT_POOL_TDATA, &stat1);
+    pj_get_timestamp(&t1);
+
+    for (i=0; i<LOOP; i+=COUNT) {
+	for (j=0; j<COUNT; ++j) {
+	    status = pjsip_endpt_create_tdata(endpt, &tdata[j]);
+	    if (status != PJ_SUCCESS) {
+		app_perror("    error: unable to create tdata", status);
+		while (j)
+		    pjsip_tx_data_dec_ref(tdata[--j]);
+		return -700;
+	    }
+	    pjsip_tx_data_add_ref(tdata[j]);
+	}
+	for (j=0; j<COUNT; ++j)
+	    pjsip_tx_data_dec_ref(tdata[j]);
+    }
+
+    pj_get_timestamp(&t2);
+    pj_sub_timestamp(&t2, &t1);
+    pjsip_endpt_get_pool_stat(endpt, PJSIP_ENDPT_POOL_TDATA, &stat2);
+
+    p_elapsed->u64 = t2.u64;
+    *p_hit_pct = (stat2.hit - stat1.hit) * 100 / LOOP;
+
+#if PJSIP_POOL_FREE_LIST_SIZE >= COUNT
+    /* All but the first round should reuse the pools */
+    if (stat2.hit - stat1.hit < LOOP - COUNT) {
+	PJ_LOG(3,(THIS_FILE, "    error: pools are not reused (hit=%u)",
+		  stat2.hit - stat1.hit));
+	return -710;
+    }
+#endif
+
+    return PJ_SUCCESS;
+}
+
 static int create_request_bench(pj_timestamp *p_elapsed)
 {
     enum { COUNT = 100 };
@@ -796,6 +996,40 @@ int txdata_test(void)
     if (status != 0)
 	return status;
 
+    status = txdata_test_print_cache();
+    if (status != 0)
+	return status;
+
+
+    /*
+     * Benchmark creating and destroying tdata
+     */
+    PJ_LOG(3,(THIS_FILE, "   benchmarking tdata creation:"));
+    for (i=0; i<REPEAT; ++i) {
+	unsigned hit_pct;
+
+	PJ_LOG(3,(THIS_FILE, "    test %d of %d..",
+		  i+1, REPEAT));
+	status = create_tdata_bench(&usec[i], &hit_pct);
+	if (status != PJ_SUCCESS)
+	    return status;
+	PJ_LOG(3,(THIS_FILE, "    pool free list hit rate: %u%%", hit_pct));
+    }
+
+    min.u64 = PJ_UINT64(0xFFFFFFFFFFFFFFF);
+    for (i=0; i<REPEAT; ++i) {
+	if (usec[i].u64 < min.u64) min.u64 = usec[i].u64;
+    }
+
+    msgs = (unsigned)(freq.u64 * LOOP / min.u64);
+
+    PJ_LOG(3,(THIS_FILE, "    tdata created at %d tdata/sec", msgs));
+
+    report_ival("create-tdata-per-sec", 
+		msgs, "tdata/sec",
+		"Number of transmit buffers that can be created and destroyed "
+		"per second with <tt>pjsip_endpt_create_tdata()</tt>");
+
 
     /*
      * Benchmark create_request()